@@ -1,5 +1,7 @@
 #include "bounding_box.h"
 
+#include <algorithm>
+
 namespace cblt {
     
     BoundingBox::BoundingBox(const Vec3 &mn, const Vec3 &mx) :
@@ -20,6 +22,11 @@ namespace cblt {
                 );
     }
 
+    bool BoundingBox::Contains(const BoundingBox &other) const {
+        return min_.x <= other.min_.x && min_.y <= other.min_.y && min_.z <= other.min_.z &&
+               max_.x >= other.max_.x && max_.y >= other.max_.y && max_.z >= other.max_.z;
+    }
+
     BoundingBox BoundingBox::Union(const BoundingBox &other) const {
         BoundingBox uni;
         uni.min_.x = std::min(min_.x, other.min_.x);
@@ -33,6 +40,24 @@ namespace cblt {
         return uni;
     }
 
+    BoundingBox BoundingBox::Transformed(const Affine &xform) const {
+        // Arvo's method - each output axis is the translation plus the extreme contribution of every input axis
+        BoundingBox result;
+        for (int i = 0; i < 3; ++i)
+        {
+            result.min_.xyz[i] = result.max_.xyz[i] = xform.At(i, 3);
+            for (int j = 0; j < 3; ++j)
+            {
+                float a = xform.At(i, j) * min_.xyz[j];
+                float b = xform.At(i, j) * max_.xyz[j];
+                result.min_.xyz[i] += std::min(a, b);
+                result.max_.xyz[i] += std::max(a, b);
+            }
+        }
+        result.CalculateCenter();
+        return result;
+    }
+
     bool BoundingBox::Intersect(const Ray &ray, float &intersect_time)
     {
         float tmin(-inf_F), tmax(inf_F);
@@ -55,8 +80,9 @@ namespace cblt {
         
         if (tmax > 0.f && tmax >= tmin)
         {
-            float use_min = static_cast<float>(tmin >= 0.f);
-            intersect_time = use_min * tmin + !use_min * tmax;
+            // report where the ray enters the box, which is the origin if it starts inside, so the
+            // time can be compared against the closest hit found so far
+            intersect_time = std::max(tmin, 0.f);
             return true;
         }
         return false;
@@ -3,6 +3,7 @@
 
 #include "math\vec.h"
 #include "math\constants.h"
+#include "math/affine.h"
 #include "ray.h"
 #include <numeric>
 
@@ -18,6 +19,12 @@ namespace cblt {
         void CalculateCenter();
         BoundingBox Union(const BoundingBox &other) const;
         float SurfaceArea() const;
+        // true if nothing has been added to the box yet
+        bool Empty() const { return min_.x > max_.x; };
+        // true if other lies entirely inside this box
+        bool Contains(const BoundingBox &other) const;
+        // bounds of the transformed box, equivalent to transforming all 8 corners
+        BoundingBox Transformed(const Affine &xform) const;
         bool Intersect(const Ray &ray, float &intersect_time);
     };
 
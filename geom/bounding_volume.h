@@ -4,12 +4,16 @@
 #include "ray.h"
 #include "hit_info.h"
 #include "bounding_box.h"
+#include "mem/memory_arena.h"
 
 #include <functional>
 #include <vector>
 #include <memory>
 
 namespace cblt {
+
+    // refits are allowed to make the SAH cost of the tree this much worse than a fresh build before rebuilding
+    const float bvh_rebuild_ratio = 1.5f;
     
     template <class T>
     class BoundingVolume {
@@ -17,16 +21,30 @@ namespace cblt {
             BoundingVolume();
             BoundingVolume(std::vector<std::shared_ptr<T>> &prims);
             BoundingVolume(std::vector<std::shared_ptr<T>> &prims, std::function<BoundingBox(T)> bounds_calc);
-            bool Intersect(const Ray& ray, HitInfo &collison_pt);
+            bool Intersect(const Ray& ray, HitRecord &collison_pt);
             BoundingBox GetBounds() const;
 
+            // incremental edits, which refit the nodes above the edited leaf instead of rebuilding the tree
+            void Insert(const std::shared_ptr<T> &prim);
+            // prim_bnds are the bounds of the prim when it was inserted or last updated
+            bool Remove(const std::shared_ptr<T> &prim, const BoundingBox &prim_bnds);
+            bool Update(const std::shared_ptr<T> &prim, const BoundingBox &old_bnds);
+            // build the tree from scratch over the prims currently in it
+            void Rebuild();
+            // ratio of the current SAH cost to the cost right after the last build
+            float Quality() const;
+            bool NeedsRebuild() const { return Quality() > bvh_rebuild_ratio; };
+
         private:
 
             struct BoundingNode {
                 BoundingBox bnds_;  //! bounding box which encapsulates the node
                 //int l_child_ = -1;  //! integer offset to left child node
                 int r_child_ = -1;  //! integer offset to right child node
-                std::vector<std::shared_ptr<T>> prims_;  //! integer offsets to all primitives in this node
+                int parent_ = -1;  //! integer offset to the parent node, used to refit after edits
+                bool leaf_ = false;  //! leaves stay leaves even if removals leave them empty
+                int prim_offset_ = 0;  //! integer offset to the first primitive of a leaf in the flat primitive array
+                int prim_count_ = 0;  //! number of primitives in a leaf
             };
 
             struct PrimInfo {
@@ -50,21 +68,37 @@ namespace cblt {
               */
             struct Bucket {
                 BoundingBox bnds_;
-                std::vector<PrimInfo> prims_;
+                int count_ = 0;
             };
 
-            using PrimIter = typename std::vector<PrimInfo>::iterator;
+            // the node & primitive arrays live as long as the tree, while the primitive info is only needed during
+            // a build, so it is carved out of the thread's scratch arena
+            template <class U>
+            using BvhVector = std::vector<U, TrackedAllocator<U, mem_bvh>>;
+            using PrimInfoVector = std::vector<PrimInfo, ArenaAllocator<PrimInfo>>;
+            using PrimIter = typename PrimInfoVector::iterator;
 
             int max_prims_in_leaf_;
-            std::vector<BoundingNode> tree_;
+            BvhVector<BoundingNode> tree_;
+            BvhVector<std::shared_ptr<T>> prims_;  //! primitives of every leaf, stored contiguously per leaf
+            std::function<BoundingBox(T)> bounds_calc_;  //! optional, replaces T::GetBounds() when set
+            float sah_sum_ = 0.f;  //! sum of the SAH cost of every node, kept up to date by refits
+            float build_cost_ = 0.f;  //! normalized SAH cost right after the last build
+
+            void Build(PrimInfoVector &prims_info);
+            BoundingBox PrimBounds(const std::shared_ptr<T> &prim);
+            float NodeCost(const BoundingNode &node) const;
+            float TreeCost() const;
+            int FindLeaf(const std::shared_ptr<T> &prim, const BoundingBox &prim_bnds) const;
+            void Refit(int node_offset);
 
             BoundingBox GetExtent(PrimIter prim_start, PrimIter prim_end);
-            BoundingBox GetExtent(const std::vector<Vec3> &centroids);
+            BoundingBox GetCentroidExtent(PrimIter prim_start, PrimIter prim_end);
 
             bool SplitSAH(PrimIter prim_start, PrimIter prim_end, PrimIter &prim_split);
             bool SplitMidpoint(PrimIter prim_start, PrimIter prim_end, PrimIter &prim_split);
             void BuildRecurse(int node_offset, PrimIter prims_start, PrimIter prims_end);
-            bool IntersectIterative(const Ray &ray, HitInfo &hit);
+            bool IntersectIterative(const Ray &ray, HitRecord &hit);
     };
 }
 
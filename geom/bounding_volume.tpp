@@ -11,8 +11,9 @@ namespace cblt {
     template <class T>
     BoundingVolume<T>::BoundingVolume() {
         max_prims_in_leaf_ = 255;
-        BoundingNode root;
-        tree_.push_back(root);
+        ScratchScope scratch(*ThreadScratch());
+        PrimInfoVector prims_info(ArenaAllocator<PrimInfo>(ThreadScratch(), mem_scratch));
+        Build(prims_info);
     }
 
     template <class T>
@@ -20,44 +21,59 @@ namespace cblt {
     {
         max_prims_in_leaf_ = 16;
         // get the bounds of the primitives, and store them in primitive info structures
-        std::vector<PrimInfo> prims_info;
+        ScratchScope scratch(*ThreadScratch());
+        PrimInfoVector prims_info(ArenaAllocator<PrimInfo>(ThreadScratch(), mem_scratch));
         prims_info.reserve(prims.size());
 
         for (const std::shared_ptr<T> & prim : prims) {
             prims_info.emplace_back(prim->GetBounds(), prim);
         }
-        BoundingNode root;
-        tree_.push_back(root);
-        BuildRecurse(0, prims_info.begin(), prims_info.end());
+        Build(prims_info);
     }
 
     template <class T>
     BoundingVolume<T>::BoundingVolume(std::vector<std::shared_ptr<T>> &prims, std::function<BoundingBox(T)> bounds_calc)
     {
         max_prims_in_leaf_ = 4;
+        bounds_calc_ = bounds_calc;
         // get the bounds of the primitives, and store them in primitive info structures
-        std::vector<PrimInfo> prims_info;
+        ScratchScope scratch(*ThreadScratch());
+        PrimInfoVector prims_info(ArenaAllocator<PrimInfo>(ThreadScratch(), mem_scratch));
         prims_info.reserve(prims.size());
 
         for (const std::shared_ptr<T> & prim : prims) {
             prims_info.emplace_back(bounds_calc(*prim), prim);
         }
+        Build(prims_info);
+    }
 
+    template <class T>
+    void BoundingVolume<T>::Build(PrimInfoVector &prims_info)
+    {
+        tree_.clear();
+        prims_.clear();
+        prims_.reserve(prims_info.size());
         BoundingNode root;
+        // an empty tree is a single empty leaf, so traversal never steps past the end of the tree
+        root.leaf_ = prims_info.empty();
         tree_.push_back(root);
         BuildRecurse(0, prims_info.begin(), prims_info.end());
+
+        sah_sum_ = TreeCost();
+        float root_sa = tree_[0].bnds_.SurfaceArea();
+        build_cost_ = (tree_[0].bnds_.Empty() || !(root_sa > 0.f)) ? 0.f : sah_sum_ / root_sa;
     }
-    
+
     /**
-     * @brief Check if the ray(p, d) intersects the tree, and populate the HitInfo
+     * @brief Check if the ray(p, d) intersects the tree, and populate the HitRecord
      * with information about the collision point
      * 
      * @param ray ray to intersect with the bounding volume heirarchy
-     * @param hit HitInfo structure which the triangle collision information is stored in
+     * @param hit HitRecord which the closest collision found so far is stored in
      * @return true/false If the ray has collided with a triangle
      */
     template<class T>
-    bool BoundingVolume<T>::Intersect(const Ray& ray, HitInfo &collison_pt) {
+    bool BoundingVolume<T>::Intersect(const Ray& ray, HitRecord &collison_pt) {
         return IntersectIterative(ray, collison_pt);
     }
 
@@ -66,6 +82,224 @@ namespace cblt {
         return tree_[0].bnds_;
     }
 
+    /**
+     * @brief Add a primitive without rebuilding the tree. The primitive is pushed down the child whose surface
+     * area grows the least, and the nodes above the leaf it lands in are refit.
+     */
+    template<class T>
+    void BoundingVolume<T>::Insert(const std::shared_ptr<T> &prim)
+    {
+        BoundingBox prim_bnds = PrimBounds(prim);
+        auto growth = [&prim_bnds](const BoundingBox &bnds) {
+            if (bnds.Empty()) {
+                // empty node, it grows to the size of the primitive
+                return prim_bnds.SurfaceArea();
+            }
+            return bnds.Union(prim_bnds).SurfaceArea() - bnds.SurfaceArea();
+        };
+
+        int node_offset = 0;
+        while (!tree_[node_offset].leaf_) {
+            if (tree_[node_offset].r_child_ == -1) {
+                // single child node, so give it a second child instead of descending
+                BoundingNode new_leaf;
+                new_leaf.leaf_ = true;
+                new_leaf.parent_ = node_offset;
+                tree_.push_back(new_leaf);
+                tree_[node_offset].r_child_ = static_cast<int>(tree_.size()) - 1;
+                node_offset = tree_[node_offset].r_child_;
+                break;
+            }
+            int l_offset = node_offset + 1;
+            int r_offset = tree_[node_offset].r_child_;
+            node_offset = (growth(tree_[l_offset].bnds_) <= growth(tree_[r_offset].bnds_)) ? l_offset : r_offset;
+        }
+
+        // the leaf's cost depends on its primitive count, so swap it out around the edit
+        BoundingNode &leaf = tree_[node_offset];
+        sah_sum_ -= NodeCost(leaf);
+        if (leaf.prim_offset_ + leaf.prim_count_ != static_cast<int>(prims_.size())) {
+            // the leaf's range can't grow in place, so move it to the end of the array, the hole it leaves is
+            // reclaimed by the next rebuild
+            int new_offset = static_cast<int>(prims_.size());
+            prims_.reserve(prims_.size() + leaf.prim_count_ + 1);
+            for (int i = 0; i < leaf.prim_count_; ++i) {
+                prims_.push_back(std::move(prims_[leaf.prim_offset_ + i]));
+            }
+            leaf.prim_offset_ = new_offset;
+        }
+        prims_.push_back(prim);
+        ++leaf.prim_count_;
+        sah_sum_ += NodeCost(leaf);
+        Refit(node_offset);
+    }
+
+    /**
+     * @brief Take a primitive out of the tree without rebuilding it. The leaf is found by only descending into
+     * nodes which contain prim_bnds, so these must match the bounds the primitive had when it was added.
+     * @return false if the primitive isn't in the tree
+     */
+    template<class T>
+    bool BoundingVolume<T>::Remove(const std::shared_ptr<T> &prim, const BoundingBox &prim_bnds)
+    {
+        int leaf_offset = FindLeaf(prim, prim_bnds);
+        if (leaf_offset == -1) {
+            return false;
+        }
+        BoundingNode &leaf = tree_[leaf_offset];
+        sah_sum_ -= NodeCost(leaf);
+        // swap the prim with the last one in the leaf, so the leaf's range stays contiguous
+        auto leaf_begin = prims_.begin() + leaf.prim_offset_;
+        auto leaf_last = leaf_begin + (leaf.prim_count_ - 1);
+        std::iter_swap(std::find(leaf_begin, leaf_last + 1, prim), leaf_last);
+        leaf_last->reset();
+        --leaf.prim_count_;
+        if (leaf.prim_offset_ + leaf.prim_count_ + 1 == static_cast<int>(prims_.size())) {
+            prims_.pop_back();
+        }
+        sah_sum_ += NodeCost(leaf);
+        Refit(leaf_offset);
+        return true;
+    }
+
+    /**
+     * @brief Move a primitive whose bounds have changed, e.g. an animated instance. Small motions are handled by
+     * reinserting the primitive, callers should check NeedsRebuild() afterwards.
+     */
+    template<class T>
+    bool BoundingVolume<T>::Update(const std::shared_ptr<T> &prim, const BoundingBox &old_bnds)
+    {
+        if (!Remove(prim, old_bnds)) {
+            return false;
+        }
+        Insert(prim);
+        return true;
+    }
+
+    template<class T>
+    void BoundingVolume<T>::Rebuild()
+    {
+        ScratchScope scratch(*ThreadScratch());
+        PrimInfoVector prims_info(ArenaAllocator<PrimInfo>(ThreadScratch(), mem_scratch));
+        prims_info.reserve(prims_.size());
+        for (const BoundingNode &node : tree_) {
+            if (!node.leaf_) {
+                continue;
+            }
+            for (int i = node.prim_offset_; i < node.prim_offset_ + node.prim_count_; ++i) {
+                prims_info.emplace_back(PrimBounds(prims_[i]), prims_[i]);
+            }
+        }
+        Build(prims_info);
+    }
+
+    /**
+     * @brief Compare the surface area heuristic cost of the tree with its cost right after it was built. Refits
+     * shrink nodes as well as grow them, but reinserted primitives land in leaves chosen greedily rather than by
+     * the SAH split, so this tends to drift upwards as primitives are edited.
+     */
+    template<class T>
+    float BoundingVolume<T>::Quality() const
+    {
+        float root_sa = tree_[0].bnds_.SurfaceArea();
+        if (tree_[0].bnds_.Empty() || !(root_sa > 0.f)) {
+            return 1.f;
+        }
+        float cost = sah_sum_ / root_sa;
+        if (build_cost_ <= 0.f) {
+            // built empty, any primitives since then are in one unsplit leaf
+            return (cost > 0.f) ? inf_F : 1.f;
+        }
+        return cost / build_cost_;
+    }
+
+    template<class T>
+    BoundingBox BoundingVolume<T>::PrimBounds(const std::shared_ptr<T> &prim)
+    {
+        return bounds_calc_ ? bounds_calc_(*prim) : prim->GetBounds();
+    }
+
+    /**
+     * @brief Unnormalized SAH cost of a node, interior nodes cost one traversal step and leaves cost one
+     * intersection test per primitive.
+     */
+    template<class T>
+    float BoundingVolume<T>::NodeCost(const BoundingNode &node) const
+    {
+        if (node.bnds_.Empty() || (node.leaf_ && node.prim_count_ == 0)) {
+            return 0.f;
+        }
+        float sa = node.bnds_.SurfaceArea();
+        return node.leaf_ ? sa * static_cast<float>(node.prim_count_) : sa * .125f;
+    }
+
+    template<class T>
+    float BoundingVolume<T>::TreeCost() const
+    {
+        float cost = 0.f;
+        for (const BoundingNode &node : tree_) {
+            cost += NodeCost(node);
+        }
+        return cost;
+    }
+
+    template<class T>
+    int BoundingVolume<T>::FindLeaf(const std::shared_ptr<T> &prim, const BoundingBox &prim_bnds) const
+    {
+        std::stack<int> nodes;
+        nodes.push(0);
+        while (!nodes.empty()) {
+            int node_offset = nodes.top();
+            nodes.pop();
+            const BoundingNode &node = tree_[node_offset];
+            if (!node.bnds_.Contains(prim_bnds)) {
+                continue;
+            }
+            if (node.leaf_) {
+                auto leaf_begin = prims_.begin() + node.prim_offset_;
+                auto leaf_end = leaf_begin + node.prim_count_;
+                if (std::find(leaf_begin, leaf_end, prim) != leaf_end) {
+                    return node_offset;
+                }
+                continue;
+            }
+            if (node.r_child_ != -1) {
+                nodes.push(node.r_child_);
+            }
+            nodes.push(node_offset + 1);
+        }
+        return -1;
+    }
+
+    /**
+     * @brief Recompute the bounds of a node and all of its ancestors after an edit, keeping the running SAH cost
+     * of the tree in sync.
+     */
+    template<class T>
+    void BoundingVolume<T>::Refit(int node_offset)
+    {
+        while (node_offset != -1) {
+            BoundingNode &node = tree_[node_offset];
+            sah_sum_ -= NodeCost(node);
+            BoundingBox bnds;
+            if (node.leaf_) {
+                for (int i = node.prim_offset_; i < node.prim_offset_ + node.prim_count_; ++i) {
+                    bnds = bnds.Union(PrimBounds(prims_[i]));
+                }
+            }
+            else {
+                bnds = tree_[node_offset + 1].bnds_;
+                if (node.r_child_ != -1) {
+                    bnds = bnds.Union(tree_[node.r_child_].bnds_);
+                }
+            }
+            bnds.CalculateCenter();
+            node.bnds_ = bnds;
+            sah_sum_ += NodeCost(node);
+            node_offset = node.parent_;
+        }
+    }
+
     /**
      * Determine the smallest boundary that encapsulates all the
      * prims
@@ -88,10 +322,11 @@ namespace cblt {
     }
 
     template<class T>
-    BoundingBox BoundingVolume<T>::GetExtent(const std::vector<Vec3> &centroids)
+    BoundingBox BoundingVolume<T>::GetCentroidExtent(PrimIter prim_start, PrimIter prim_end)
     {
         BoundingBox extent;
-        for (const Vec3 &cen : centroids) {
+        for (PrimIter iter = prim_start; iter != prim_end; ++iter) {
+            const Vec3 &cen = iter->bnds_.cen_;
 
             extent.max_.x = std::max(extent.max_.x, cen.x);
             extent.max_.y = std::max(extent.max_.y, cen.y);
@@ -113,12 +348,18 @@ namespace cblt {
     void BoundingVolume<T>::BuildRecurse(int node_offset, PrimIter prim_start, PrimIter prim_end) {
         if (std::distance(prim_start, prim_end) == 2) {
             BoundingNode l_child, r_child;
+            l_child.parent_ = r_child.parent_ = node_offset;
+            l_child.leaf_ = r_child.leaf_ = true;
             l_child.bnds_ = prim_start->bnds_;
-            l_child.prims_.push_back(prim_start->elem_);
+            l_child.prim_offset_ = static_cast<int>(prims_.size());
+            l_child.prim_count_ = 1;
+            prims_.push_back(prim_start->elem_);
 
             PrimInfo next_prim = *(std::next(prim_start, 1));
             r_child.bnds_ = next_prim.bnds_;
-            r_child.prims_.push_back(next_prim.elem_);
+            r_child.prim_offset_ = static_cast<int>(prims_.size());
+            r_child.prim_count_ = 1;
+            prims_.push_back(next_prim.elem_);
 
             tree_.push_back(l_child);
             tree_.push_back(r_child);
@@ -129,8 +370,12 @@ namespace cblt {
         }
         else if (std::distance(prim_start, prim_end) == 1) {
             BoundingNode l_child;
+            l_child.parent_ = node_offset;
+            l_child.leaf_ = true;
             l_child.bnds_ = prim_start->bnds_;
-            l_child.prims_.push_back(prim_start->elem_);
+            l_child.prim_offset_ = static_cast<int>(prims_.size());
+            l_child.prim_count_ = 1;
+            prims_.push_back(prim_start->elem_);
 
             tree_.push_back(l_child);
 
@@ -148,8 +393,11 @@ namespace cblt {
         if (!SplitSAH(prim_start, prim_end, prim_mid)) {
             // stop recursing, since the sub-child split would be worse than the current split
             tree_[node_offset].r_child_ = -1;
+            tree_[node_offset].leaf_ = true;
+            tree_[node_offset].prim_offset_ = static_cast<int>(prims_.size());
+            tree_[node_offset].prim_count_ = static_cast<int>(std::distance(prim_start, prim_end));
             for (PrimIter iter = prim_start; iter != prim_end; iter++) {
-                tree_[node_offset].prims_.push_back(iter->elem_);
+                prims_.push_back(iter->elem_);
             }
             return;
         }
@@ -157,6 +405,7 @@ namespace cblt {
         int size_right = std::distance(prim_mid, prim_end);
         // create left child
         BoundingNode new_node;
+        new_node.parent_ = node_offset;
         tree_.push_back(new_node);
         int l_offset = node_offset + 1;
         BuildRecurse(l_offset, prim_start, prim_mid);
@@ -173,14 +422,7 @@ namespace cblt {
         // bound the node
         BoundingBox scene_bnds = GetExtent(prim_start, prim_end);
         int prim_size = static_cast<int>(std::distance(prim_start, prim_end));
-        std::vector<Vec3> centroid_pts;
-        centroid_pts.reserve(prim_size);
-
-        for(PrimIter iter = prim_start; iter != prim_end; ++iter) {
-            centroid_pts.push_back(iter->bnds_.cen_);
-        }
-
-        BoundingBox centroid_bnds = GetExtent(centroid_pts);
+        BoundingBox centroid_bnds = GetCentroidExtent(prim_start, prim_end);
         float range_x = centroid_bnds.max_.x - centroid_bnds.min_.x;
         float range_y = centroid_bnds.max_.y - centroid_bnds.min_.y;
         float range_z = centroid_bnds.max_.z - centroid_bnds.min_.z;
@@ -212,12 +454,9 @@ namespace cblt {
             float centroid_pos = (axis == 0) ? iter->bnds_.cen_.x : (axis == 1) ? iter->bnds_.cen_.y : iter->bnds_.cen_.z;
             float normalized_position = (centroid_pos - centroid_min) / range;
             int bucket_index = std::min(static_cast<int>(num_bins * normalized_position), num_bins - 1);
-            bins[bucket_index].prims_.push_back(*iter);
-        }
-
-        // get the size of each bin
-        for(Bucket &bin : bins) {
-                bin.bnds_ = GetExtent(bin.prims_.begin(), bin.prims_.end());
+            // only the bin's bounds & count matter, so the primitives don't need to be copied into it
+            bins[bucket_index].bnds_ = bins[bucket_index].bnds_.Union(iter->bnds_);
+            ++bins[bucket_index].count_;
         }
         constexpr int buckets_minus_1 = num_bins - 1;
         std::array<float, buckets_minus_1> costs;
@@ -229,12 +468,12 @@ namespace cblt {
             // this is one half split
             for(; j <= i; ++j) {
                 bound1 = bound1.Union(bins[j].bnds_);
-                num_prims1 += static_cast<int>(bins[j].prims_.size());
+                num_prims1 += bins[j].count_;
             }
             // this is the other half split
             for(; j < num_bins; ++j) {
                 bound2 = bound2.Union(bins[j].bnds_);
-                num_prims2 += static_cast<int>(bins[j].prims_.size());
+                num_prims2 += bins[j].count_;
             }
             // finally, calculate the SAH!
             costs[i] = .125f + (num_prims1 * bound1.SurfaceArea() + num_prims2 * bound2.SurfaceArea()) / parent_sa;
@@ -310,14 +549,12 @@ namespace cblt {
      * @brief Use Depth First Search to traverse through the bounding volume heirarchy
      * to find a triangle which collisdes with ray(p, d)
      * @param ray ray to intersect with the bounding volume heirarchy
-     * @param hit HitInfo structure which the triangle collision information is stored in
+     * @param hit HitRecord which the closest collision found so far is stored in
      * @return true/false If the ray has collided with a triangle 
      */
     template <class T>
-    bool BoundingVolume<T>::IntersectIterative(const Ray &ray, HitInfo &hit)
+    bool BoundingVolume<T>::IntersectIterative(const Ray &ray, HitRecord &hit)
     {
-        HitInfo prim_hit;
-        
         int nodes[2048];
         int stack_idx = 0;
         nodes[0] = 0;
@@ -336,17 +573,15 @@ namespace cblt {
                 continue;
             }
             
-            if(cur_node.prims_.size() > 0)
+            if(cur_node.leaf_)
             {
                 // check to see if there is a collision
-                for (const std::shared_ptr<T> &prim : cur_node.prims_)
+                for (int i = cur_node.prim_offset_; i < cur_node.prim_offset_ + cur_node.prim_count_; ++i)
                 {
-                    prim_hit.hit_time = inf_F;
-                    result = prim->Intersect(ray, prim_hit) || result;
-                    if (prim_hit.hit_time < hit.hit_time)
+                    // prims only write to the hit info when they are closer than the current hit
+                    if (prims_[i]->Intersect(ray, hit))
                     {
-                        // this is a closer item than the previous one
-                        hit = prim_hit;
+                        result = true;
                         best_time = hit.hit_time;
                     }
                 }
@@ -1,10 +1,18 @@
 #include "camera.h"
 
+#include <algorithm>
 #include <cmath>
 
 namespace cblt
 {
     Camera::Camera(Vec3 eye, Vec3 forward, Vec3 up, float half_angle_fov, camera_type proj_type) {
+        Orient(eye, forward, up, half_angle_fov);
+        cam_type_ = proj_type;
+        near_plane_ = .1f;
+        pixel_spread_ = 0.f;
+    }
+
+    void Camera::Orient(Vec3 eye, Vec3 forward, Vec3 up, float half_angle_fov) {
         cam_eye_ = eye;
 
         cam_fwd_ = forward;
@@ -15,17 +23,21 @@ namespace cblt
         cam_fwd_ = Normalize(cam_fwd_);
         cam_right_ = Normalize(cam_right_);
         cam_up_ = Normalize(cam_up_);
-
-        cam_type_ = proj_type;
-        near_plane_ = .1f;
     }
 
     void Camera::ConfigureExtent(float img_w, float img_h) {
         // calculate the distance from the eye to the image plane
         near_plane_ = (img_h * .5f) / std::tanf(half_angle_fov_);
+        // the image plane is measured in pixels, so one pixel at the near plane subtends this angle
+        pixel_spread_ = 1.f / near_plane_;
+    }
+
+    void Camera::SetShutter(float open, float close) {
+        shutter_open_ = open;
+        shutter_close_ = std::max(open, close);
     }
 
-    Ray Camera::CreateRay(float img_x, float img_y) {
+    Ray Camera::CreateRay(float img_x, float img_y, float shutter_u) {
         Vec3 world_pt = cam_eye_ - near_plane_ * cam_fwd_ + img_x * cam_right_ + img_y * cam_up_;
         Ray scene_ray;
         // now make a ray based on the type
@@ -33,7 +45,9 @@ namespace cblt
             case orthographic:
             scene_ray.pos = world_pt + near_plane_ * cam_fwd_;
             scene_ray.dir = -1.f * cam_fwd_;
-            scene_ray.inv = 1.f / (scene_ray.dir + Vec3(eps_zero_F, eps_zero_F, eps_zero_F));
+            // parallel rays, so the footprint stays a single pixel wide
+            scene_ray.cone_width = 1.f;
+            scene_ray.cone_spread = 0.f;
             break;
             case cavalier:
             //break;
@@ -43,11 +57,14 @@ namespace cblt
             default:
             scene_ray.pos = cam_eye_;
             scene_ray.dir = world_pt - cam_eye_;
-            scene_ray.inv = 1.f / (scene_ray.dir + Vec3(eps_zero_F, eps_zero_F, eps_zero_F));
+            scene_ray.cone_width = 0.f;
+            scene_ray.cone_spread = pixel_spread_;
             break;
         }
         scene_ray.dir = Normalize(scene_ray.dir);
-        scene_ray.inv = Normalize(scene_ray.inv);
+        // the slab test needs the true reciprocal, so the box hit times match the hit times along the ray
+        scene_ray.inv = 1.f / (scene_ray.dir + Vec3(eps_zero_F, eps_zero_F, eps_zero_F));
+        scene_ray.time = shutter_open_ + shutter_u * (shutter_close_ - shutter_open_);
         return scene_ray;
     }
 }
\ No newline at end of file
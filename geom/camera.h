@@ -21,7 +21,15 @@ namespace cblt
         Camera(Vec3 eye = Vec3(0.f,0.f,0.f), Vec3 forward = Vec3(0.f,0.f,-1.f), Vec3 up = Vec3(0.f,1.f,0.f), float horiz_half_fov = PI_f/4.f, camera_type proj_type = camera_type::perspective);
         void ConfigureExtent(float img_w, float img_h);
         Vec3 Eye() { return cam_eye_; };
-        Ray CreateRay(float img_x, float img_y);
+        Vec3 Forward() { return cam_fwd_; };
+        Vec3 Up() { return cam_up_; };
+        float HalfFov() { return half_angle_fov_; };
+        // move & turn the camera, keeping its projection & shutter. ConfigureExtent must be called again after
+        void Orient(Vec3 eye, Vec3 forward, Vec3 up, float horiz_half_fov);
+        // shutter_u in [0, 1) picks the moment within the shutter interval at which the ray is traced
+        Ray CreateRay(float img_x, float img_y, float shutter_u = 0.f);
+        // the shutter is open over [open, close], an instant shutter (open == close) disables motion blur
+        void SetShutter(float open, float close);
     private:
         camera_type cam_type_;
         Vec3 cam_eye_;
@@ -30,6 +38,9 @@ namespace cblt
         Vec3 cam_right_;
         float half_angle_fov_;  //! half the horizontal field of view (FOV)
         float near_plane_;  //! distance from eye to the image plane
+        float pixel_spread_;  //! angle subtended by a single pixel, used as the spread of primary ray cones
+        float shutter_open_ = 0.f;
+        float shutter_close_ = 0.f;
     };
 }
 #endif  // CBLT_CAMERA_H
\ No newline at end of file
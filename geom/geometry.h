@@ -10,7 +10,8 @@ namespace cblt
     class Geometry : public Boundable
     {
         public:
-            virtual bool Intersect(const Ray &ray, HitInfo &collision_pt) = 0;
+            // only updates collision_pt if the geometry is hit closer than collision_pt.hit_time
+            virtual bool Intersect(const Ray &ray, HitRecord &collision_pt) = 0;
     };
 }
 #endif  // GEOMETRY_H
\ No newline at end of file
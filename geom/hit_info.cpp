@@ -8,10 +8,8 @@ namespace cblt
 {
     HitInfo::HitInfo()
     {
-        float hit_time = inf_F;
-        shading_basis = Mat4(1.f);
+        hit_time = inf_F;
         medium_ior  = 1.f;
-        m = nullptr;
         geom = nullptr;
     }
 
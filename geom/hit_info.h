@@ -2,16 +2,35 @@
 #define CBLT_HIT_INFO_H
 #include "math\vec.h"
 #include "math\mat4.h"
+#include "math/constants.h"
 
 #include "mat/image_lib.h"
 
+#include <cstdint>
 #include <memory>
 
 namespace cblt
 {
 
-    class Material;
+    // index of a material in the scene's MaterialTable
+    using MaterialId = uint32_t;
+    const MaterialId invalid_material = UINT32_MAX;
     class ScenePrim;
+    class Triangle;
+
+    /**
+     * @brief The minimum needed to identify a hit, written during traversal while the closest hit is searched for.
+     * It holds no reference counted pointers or matrices, so recording a closer hit is a handful of stores. The
+     * full HitInfo is only built once per ray, by ScenePrim::FillHitInfo(), after traversal is done.
+     */
+    struct HitRecord
+    {
+        float hit_time = inf_F;
+        Vec2 bary;  // barycentric coordinates of the 2nd & 3rd vertices
+        int light_idx = -1;  // the area light which was hit, only written when searching the scene's area lights
+        const Triangle *tri = nullptr;  // the triangle which was hit, in the local space of geom
+        ScenePrim *geom = nullptr;  // the instance which was hit
+    };
 
     class HitInfo final
     {
@@ -22,12 +41,22 @@ namespace cblt
         Vec3 norm;
         Vec3 pos;
         Vec2 uv;
+        Vec2 bary;  // barycentric coordinates of the 2nd & 3rd vertices, surface attributes are only interpolated for the closest hit
+        Vec3 tangent;  // world space direction of increasing u, used to orient normal maps
         float hit_time;
-        Mat4 shading_basis;
+        float time = 0.f;  // shutter time of the ray which found this hit, rays spawned from here share it
+        float uv_footprint = 0.f;  // width of the ray's footprint in uv space, used to filter texture lookups
         float medium_ior;  // IOR for the medium which the ray was traveling through when it hit this surface
+        int emit_idx = -1;  // index of the hit triangle amongst the emissive triangles of its mesh, or -1
+
+        // material parameters with any textures applied, filled once per shading point by Material::EvaluateTextures()
+        Color albedo;
+        float roughness = 1.f;
+        float metallic = 0.f;
 
-        std::shared_ptr<Material> m = nullptr;
+        MaterialId mat_id = invalid_material;
         ScenePrim *geom = nullptr;
+        const Triangle *tri = nullptr;  // the triangle which was hit, in the local space of geom
     };
 }
 
@@ -10,11 +10,16 @@ namespace cblt
         Vec3 pos;
         Vec3 dir;
         Vec3 inv;
+        // ray cone used to estimate the footprint of the ray for texture filtering
+        float cone_width = 0.f;  // width of the cone at the ray origin
+        float cone_spread = 0.f;  // growth in width per unit distance travelled
+        float time = 0.f;  // moment within the camera shutter interval at which the ray is traced
         Ray() {};
-        Ray(Vec3 _pos, Vec3 _dir)
+        Ray(Vec3 _pos, Vec3 _dir, float _time = 0.f)
         {
             pos = _pos;
             dir = _dir;
+            time = _time;
             inv = Vec3(1.0f / (dir.x + eps_zero_F), 1.0f / (dir.y + eps_zero_F), 1.0f / (dir.z + eps_zero_F));
         }
     };
@@ -1,68 +1,297 @@
 #include "scene.h"
 
-#include "mat/material.h"
+#include "triangle_mesh.h"
+
 #include "mat/multiple_importance_heuristics.h"
+#include "mat/sd_tree.h"
+
+#include "light/triangle_light.h"
+#include "light/environment_light.h"
+#include "light/area_light.h"
+
+#include <algorithm>
+#include <cmath>
 
 namespace cblt
 {
-    Scene::Scene(const Camera &camera, std::vector<std::shared_ptr<ScenePrim>> &s_prims, std::vector<std::shared_ptr<Light>> &l_prims)
+    Scene::Scene(const Camera &camera, std::vector<std::shared_ptr<ScenePrim>> &s_prims, std::vector<std::shared_ptr<Light>> &l_prims, const std::shared_ptr<MaterialTable> &materials)
     {
         cam_ = camera;
+        materials_ = materials;
         
         s_prims_ = s_prims;
         l_prims_ = l_prims;
         accel_ = BoundingVolume<ScenePrim>(s_prims_);
-        // TODO - materials: Should the pointers also be held here, or just in the primitives?
+        for (const std::shared_ptr<ScenePrim> &s_prim : s_prims_)
+        {
+            AddEmitters(s_prim);
+        }
+        light_sampler_ = LightBVH(l_prims_);
+        IndexLights();
     }
 
     void Scene::AddPrim(const std::shared_ptr<ScenePrim> &s_prim)
     {
         s_prims_.push_back(s_prim);
-        // TODO - rebuild BVH?
+        accel_.Insert(s_prim);
+        RebuildIfDegraded();
+        AddEmitters(s_prim);
+        if (s_prim->light_offset_ != -1)
+        {
+            lights_dirty_ = true;
+        }
+    }
+
+    bool Scene::RemovePrim(const std::shared_ptr<ScenePrim> &s_prim)
+    {
+        auto iter = std::find(s_prims_.begin(), s_prims_.end(), s_prim);
+        if (iter == s_prims_.end())
+        {
+            return false;
+        }
+        s_prims_.erase(iter);
+        accel_.Remove(s_prim, s_prim->GetBounds());
+        RebuildIfDegraded();
+
+        if (s_prim->light_offset_ != -1)
+        {
+            // drop this prim's lights, and shift the lights of every prim stored after them
+            int num_emitters = static_cast<int>(std::dynamic_pointer_cast<TriangleMesh>(s_prim->model_)->Emitters().size());
+            l_prims_.erase(l_prims_.begin() + s_prim->light_offset_, l_prims_.begin() + s_prim->light_offset_ + num_emitters);
+            for (const std::shared_ptr<ScenePrim> &other : s_prims_)
+            {
+                if (other->light_offset_ > s_prim->light_offset_)
+                {
+                    other->light_offset_ -= num_emitters;
+                }
+            }
+            s_prim->light_offset_ = -1;
+            lights_dirty_ = true;
+        }
+        return true;
+    }
+
+    bool Scene::UpdateTransform(const std::shared_ptr<ScenePrim> &s_prim, const Mat4 &transform)
+    {
+        // the prim is taken out before it moves, so one which isn't in the scene is left as it was
+        if (!accel_.Remove(s_prim, s_prim->GetBounds()))
+        {
+            return false;
+        }
+        s_prim->SetTransform(transform);
+        accel_.Insert(s_prim);
+        RebuildIfDegraded();
+
+        if (s_prim->light_offset_ != -1)
+        {
+            // the lights are in world space, so they have to follow the prim
+            std::shared_ptr<TriangleMesh> mesh = std::dynamic_pointer_cast<TriangleMesh>(s_prim->model_);
+            for (size_t i = 0; i < mesh->Emitters().size(); ++i)
+            {
+                l_prims_[s_prim->light_offset_ + i] = MakeEmitter(s_prim, mesh->Emitters()[i]);
+            }
+            lights_dirty_ = true;
+        }
+        return true;
+    }
+
+    void Scene::RebuildIfDegraded()
+    {
+        // refits keep edits cheap, but a tree which has been refit too many times traverses poorly
+        if (accel_.NeedsRebuild())
+        {
+            accel_.Rebuild();
+        }
+    }
+
+    void Scene::AddEmitters(const std::shared_ptr<ScenePrim> &s_prim)
+    {
+        std::shared_ptr<TriangleMesh> mesh = std::dynamic_pointer_cast<TriangleMesh>(s_prim->model_);
+        if (!mesh || mesh->Emitters().empty())
+        {
+            return;
+        }
+        // every instance of an emissive mesh gets its own set of world space lights
+        s_prim->light_offset_ = static_cast<int>(l_prims_.size());
+        for (const std::shared_ptr<Triangle> &tri : mesh->Emitters())
+        {
+            l_prims_.push_back(MakeEmitter(s_prim, tri));
+        }
+    }
+
+    std::shared_ptr<Light> Scene::MakeEmitter(const std::shared_ptr<ScenePrim> &s_prim, const std::shared_ptr<Triangle> &tri)
+    {
+        Vec3 p1, p2, p3;
+        tri->GetVertices(p1, p2, p3);
+        return std::make_shared<TriangleLight>(s_prim->local_to_world_.Point(p1),
+                                               s_prim->local_to_world_.Point(p2),
+                                               s_prim->local_to_world_.Point(p3),
+                                               materials_->Emittance(tri->GetMaterial()));
     }
 
     void Scene::AddPrim(const std::shared_ptr<Light> &l_prim)
     {
         l_prims_.push_back(l_prim);
+        lights_dirty_ = true;
+    }
+
+    void Scene::UpdateLights()
+    {
+        std::lock_guard<std::mutex> lock(lights_mutex_);
+        if (!lights_dirty_)
+        {
+            return;
+        }
+        light_sampler_ = LightBVH(l_prims_);
+        IndexLights();
+        lights_dirty_ = false;
+    }
+
+    void Scene::IndexLights()
+    {
+        env_light_idx_ = -1;
+        area_light_idx_.clear();
+        std::vector<std::shared_ptr<AreaLightRef>> area_lights;
+        for (size_t i = 0; i < l_prims_.size(); ++i)
+        {
+            if (std::dynamic_pointer_cast<EnvironmentLight>(l_prims_[i]))
+            {
+                env_light_idx_ = static_cast<int>(i);
+            }
+            else if (std::shared_ptr<AreaLight> area_light = std::dynamic_pointer_cast<AreaLight>(l_prims_[i]))
+            {
+                area_light_idx_.push_back(static_cast<int>(i));
+                area_lights.push_back(std::make_shared<AreaLightRef>(AreaLightRef{ area_light, static_cast<int>(i) }));
+            }
+        }
+        area_light_accel_ = BoundingVolume<AreaLightRef>(area_lights);
+
+        // the power estimated for the light BVH, lights without bounds have no estimate so they are given the
+        // average power of the others
+        std::vector<float> power(l_prims_.size(), -1.f);
+        float tot_power = 0.f;
+        int num_bounded = 0;
+        for (size_t i = 0; i < l_prims_.size(); ++i)
+        {
+            LightBounds bnds;
+            if (l_prims_[i]->GetLightBounds(bnds))
+            {
+                // degenerate lights, e.g. zero area, can't be chosen
+                power[i] = (std::isfinite(bnds.phi_)) ? std::max(0.f, bnds.phi_) : 0.f;
+                tot_power += power[i];
+                ++num_bounded;
+            }
+        }
+        float avg_power = (num_bounded > 0 && tot_power > 0.f) ? tot_power / num_bounded : 1.f;
+        std::replace(power.begin(), power.end(), -1.f, avg_power);
+        emitter_distrib_ = (power.empty()) ? Distribution1D() : Distribution1D(power.data(), static_cast<int>(power.size()));
+    }
+
+    int Scene::SampleEmitter(float u, float &pmf) const
+    {
+        if (emitter_distrib_.Count() == 0)
+        {
+            pmf = 0.f;
+            return -1;
+        }
+        int light_idx;
+        emitter_distrib_.SampleContinuous(u, pmf, light_idx);
+        pmf = EmitterPmf(light_idx);
+        return light_idx;
+    }
+
+    float Scene::EmitterPmf(int light_idx) const
+    {
+        if (light_idx < 0 || light_idx >= emitter_distrib_.Count())
+        {
+            return 0.f;
+        }
+        if (emitter_distrib_.Integral() <= 0.f)
+        {
+            return 1.f / emitter_distrib_.Count();
+        }
+        return emitter_distrib_.Func(light_idx) / (emitter_distrib_.Integral() * emitter_distrib_.Count());
+    }
+
+    int Scene::EmitterIndex(const HitInfo &hit) const
+    {
+        if (hit.geom == nullptr || hit.geom->light_offset_ == -1 || hit.emit_idx == -1)
+        {
+            return -1;
+        }
+        return hit.geom->light_offset_ + hit.emit_idx;
+    }
+
+    void Scene::BoundingSphere(Vec3 &cen, float &radius) const
+    {
+        BoundingBox bnds = (s_prims_.empty()) ? BoundingBox() : accel_.GetBounds();
+        if (!area_light_idx_.empty())
+        {
+            bnds = bnds.Union(area_light_accel_.GetBounds());
+        }
+        if (bnds.Empty())
+        {
+            cen = Vec3(0.f, 0.f, 0.f);
+            radius = 1.f;
+            return;
+        }
+        cen = (bnds.min_ + bnds.max_) * .5f;
+        radius = std::max(Magnitude(bnds.max_ - cen), eps_zero_F);
     }
 
     bool Scene::Intersects(const Ray &ray, float &time)
     {
-        HitInfo collision_pt;
-        collision_pt.hit_time = inf_F;
-        bool hit = accel_.Intersect(ray, collision_pt);
-        time = collision_pt.hit_time;
+        HitRecord record;
+        bool hit = accel_.Intersect(ray, record);
+        time = record.hit_time;
         return hit;
     }
 
     bool Scene::ClosestIntersection(const Ray &ray, HitInfo &collision_pt)
     {
-        return accel_.Intersect(ray, collision_pt);
+        HitRecord record;
+        record.hit_time = collision_pt.hit_time;
+        if (!accel_.Intersect(ray, record))
+        {
+            return false;
+        }
+        // the closest hit is known, so build its shading record & evaluate textures exactly once
+        record.geom->FillHitInfo(ray, record, *materials_, collision_pt);
+        if (collision_pt.mat_id != invalid_material)
+        {
+            materials_->EvaluateTextures(collision_pt.mat_id, collision_pt);
+        }
+        return true;
     }
 
-    Color Scene::SampleSingleLight(const Vec3 &outgoing, const HitInfo &collision_pt, std::shared_ptr<Sampler> &sampler)
+    Color Scene::SampleSingleLight(const Vec3 &outgoing, const HitInfo &collision_pt, std::shared_ptr<Sampler> &sampler, bool single_sample_mis,
+                                   const DTree *guide, float guide_fraction)
     {
         if (l_prims_.size() == 0)
         {
             return Color::GreyScale(0.f);
         }
         
-        // choose a random light from all light sources in the scene
-        float light_num, light_pdf, light_len;
+        // choose a light proportionally to its estimated contribution at this point
+        float light_num, light_pmf;
         sampler->Next1D(light_num);
 
-        int light_idx = static_cast<int>(std::round(light_num * l_prims_.size()));
-        light_idx = std::min(static_cast<int>(l_prims_.size()) - 1, light_idx);
+        int light_idx = light_sampler_.Sample(collision_pt.pos, collision_pt.norm, light_num, light_pmf);
+        if (light_idx == -1 || light_pmf <= 0.f)
+        {
+            return Color::GreyScale(0.f);
+        }
         std::shared_ptr<Light> &selected_light = l_prims_[light_idx];
 
         Color radiance = Color::GreyScale(0.f);
 
-        radiance = radiance + DirectLight(outgoing, selected_light, collision_pt, sampler) * l_prims_.size();
+        radiance = radiance + DirectLight(outgoing, selected_light, light_pmf, collision_pt, sampler, single_sample_mis, guide, guide_fraction) / light_pmf;
 
         return radiance;
     }
 
-    Color Scene::DirectLight(const Vec3 &outgoing, std::shared_ptr<Light> &light, const HitInfo &collision_pt, std::shared_ptr<Sampler> &sampler)
+    Color Scene::DirectLight(const Vec3 &outgoing, std::shared_ptr<Light> &light, float light_pmf, const HitInfo &collision_pt, std::shared_ptr<Sampler> &sampler, bool single_sample_mis,
+                             const DTree *guide, float guide_fraction)
     {
         Color radiance = Color::GreyScale(0.f);
         Vec3 to_light;
@@ -70,21 +299,31 @@ namespace cblt
         Color light_rad = light->Sample(to_light, collision_pt.pos, collision_pt.norm, light_len, light_pdf, sampler);
         
         light_rad = light_rad * AbsDot(collision_pt.norm, to_light);
+
+        // Emissive surfaces are found by the path itself, so their BRDF half is weighed by the integrator using
+        // LightPdf(), which includes the probability of choosing the light. Area lights aren't part of the scene
+        // geometry, so either the integrator looks for them along its next bounce with AreaLightRadiance(), or both
+        // halves of MIS are evaluated here, conditioned on the light having been chosen.
+        std::shared_ptr<Geometry> area_light_geom = (single_sample_mis) ? nullptr : std::dynamic_pointer_cast<cblt::Geometry>(light);
+        float mis_pmf = (area_light_geom) ? 1.f : light_pmf;
         
-        // check to see if the light is occuluded or not
-        HitInfo occluder_info;
-        occluder_info.hit_time = inf_F;
+        // check to see if the light is occuluded or not, only the distance is needed so the surface isn't shaded
+        float occluder_time = inf_F;
         
-        Ray shadow_ray(collision_pt.pos + to_light * eps_zero_F, to_light);
-        bool hit = ClosestIntersection(shadow_ray, occluder_info);
-        if (light_rad.Luminance() <= eps_zero_F || (light_len - occluder_info.hit_time) > eps_zero_F)
+        Ray shadow_ray(collision_pt.pos + to_light * eps_zero_F, to_light, collision_pt.time);
+        bool hit = Intersects(shadow_ray, occluder_time);
+        if (light_rad.Luminance() <= eps_zero_F || light_pdf <= 0.f || occluder_time < light_len * (1.f - eps_shadow_F))
         {
             radiance = Color::GreyScale(0.f);
         }
         else
         {
             float brdf_pdf;
-            Color surf_refl = collision_pt.m->BRDF(to_light, outgoing, collision_pt, brdf_pdf);
+            Color surf_refl = materials_->BRDF(collision_pt.mat_id, to_light, outgoing, collision_pt, brdf_pdf);
+            if (guide && !area_light_geom)
+            {
+                brdf_pdf = guide_fraction * guide->Pdf(to_light) + (1.f - guide_fraction) * brdf_pdf;
+            }
 
             if (light->isDiracDelta())
             {
@@ -94,54 +333,113 @@ namespace cblt
             else
             {
                 // Multiple importance sample
-                float MIS = PowerHeuristic(light_pdf, brdf_pdf, 2.f);
+                float MIS = PowerHeuristic(mis_pmf * light_pdf, brdf_pdf, 2.f);
                 radiance = surf_refl * light_rad * MIS / light_pdf;
             }
         }
-        if (light->isDiracDelta())
+        if (light->isDiracDelta() || !area_light_geom)
         {
             // prevent multiple importance sampling when the light is a dirac delta
-            // BUT is occluded
+            // BUT is occluded, or when the BRDF sample is handled by the integrator
             return radiance;
         }
         
         // now sample the BRDF
         Vec3 brdf_dir;
         float brdf_pdf;
-        Color surf_refl = collision_pt.m->Sample(outgoing, brdf_dir, brdf_pdf, collision_pt, sampler);
+        Color surf_refl = materials_->Sample(collision_pt.mat_id, outgoing, brdf_dir, brdf_pdf, collision_pt, sampler);
         surf_refl = surf_refl * AbsDot(brdf_dir, collision_pt.norm);
         
         // check if we hit the light source after leaving this sample
-        std::shared_ptr<Geometry> area_light_geom = std::dynamic_pointer_cast<cblt::Geometry>(light);
-        if (area_light_geom.get())
-        {
-            // this is an area light - need to do extra geometry checks
-            float light_pdf = 0.f;
-            
-            Ray brdf_ray(collision_pt.pos + brdf_dir * eps_zero_F, brdf_dir);
-            HitInfo light_info;
-            occluder_info.hit_time = inf_F;
-
-            bool hit_scene = ClosestIntersection(brdf_ray, occluder_info);
-            bool hit_light = area_light_geom->Intersect(brdf_ray, light_info);
-            light_rad = light->Radiance(light_info.pos, collision_pt.pos, collision_pt.norm, light_pdf);
-            if (!hit_light || light_pdf == 0.f || (light_info.hit_time - occluder_info.hit_time) > eps_zero_F)
-            {
-                // didn't hit the light source
-                return radiance;
-            }
-            
-            // compute direct lighting using MIS again
-            float MIS = PowerHeuristic(brdf_pdf, light_pdf, 2.f);
-            radiance = radiance + (surf_refl * light_rad * MIS / brdf_pdf);
+        // this is an area light - need to do extra geometry checks
+        light_pdf = 0.f;
+        
+        Ray brdf_ray(collision_pt.pos + brdf_dir * eps_zero_F, brdf_dir, collision_pt.time);
+        HitRecord light_info;
+        occluder_time = inf_F;
+
+        bool hit_scene = Intersects(brdf_ray, occluder_time);
+        bool hit_light = area_light_geom->Intersect(brdf_ray, light_info);
+        Vec3 light_pos = brdf_ray.pos + brdf_ray.dir * light_info.hit_time;
+        light_rad = light->Radiance(light_pos, collision_pt.pos, collision_pt.norm, light_pdf);
+        if (!hit_light || light_pdf == 0.f || brdf_pdf <= 0.f || (light_info.hit_time - occluder_time) > eps_zero_F)
+        {
+            // didn't hit the light source
+            return radiance;
         }
-        else
+        
+        // compute direct lighting using MIS again
+        float MIS = PowerHeuristic(brdf_pdf, light_pdf, 2.f);
+        radiance = radiance + (surf_refl * light_rad * MIS / brdf_pdf);
+        return radiance;
+    }
+
+    float Scene::LightPdf(const Vec3 &ref_pos, const Vec3 &ref_norm, const HitInfo &light_pt)
+    {
+        if (light_pt.geom == nullptr || light_pt.geom->light_offset_ == -1 || light_pt.emit_idx == -1)
         {
-            // this is not an area light
-            // currently, there are only area lights and direction lights, the latter which
-            // is a dirac delta. Therefore, the code should never reach this point, but that
-            // may change in the future if I add environment maps & IBL.
+            return 0.f;
+        }
+        int light_idx = light_pt.geom->light_offset_ + light_pt.emit_idx;
+        float light_pdf;
+        l_prims_[light_idx]->Radiance(light_pt.pos, ref_pos, ref_norm, light_pdf);
+        return light_sampler_.Pmf(ref_pos, ref_norm, light_idx) * light_pdf;
+    }
+
+    Color Scene::AreaLightRadiance(const Ray &ray, float max_time, const Vec3 &ref_pos, const Vec3 &ref_norm, float &light_pdf)
+    {
+        light_pdf = 0.f;
+        // lights just behind the closest surface still count, as they did for the shadow rays in DirectLight()
+        float hit_time;
+        int light_idx = IntersectAreaLights(ray, max_time + eps_zero_F, hit_time);
+        if (light_idx == -1)
+        {
+            return Color::GreyScale(0.f);
+        }
+        Vec3 light_pos = ray.pos + ray.dir * hit_time;
+        Color radiance = l_prims_[light_idx]->Radiance(light_pos, ref_pos, ref_norm, light_pdf);
+        light_pdf *= light_sampler_.Pmf(ref_pos, ref_norm, light_idx);
+        return radiance;
+    }
+
+    int Scene::IntersectAreaLights(const Ray &ray, float max_time, float &hit_time)
+    {
+        HitRecord light_info;
+        light_info.hit_time = max_time;
+        hit_time = max_time;
+        if (area_light_idx_.empty() || !area_light_accel_.Intersect(ray, light_info))
+        {
+            return -1;
+        }
+        hit_time = light_info.hit_time;
+        return light_info.light_idx;
+    }
+
+    bool Scene::AreaLightRef::Intersect(const Ray &ray, HitRecord &collision_pt)
+    {
+        if (!light_->Intersect(ray, collision_pt))
+        {
+            return false;
+        }
+        collision_pt.light_idx = light_idx_;
+        return true;
+    }
+
+    BoundingBox Scene::AreaLightRef::GetBounds()
+    {
+        return light_->GetBounds();
+    }
+
+    Color Scene::EnvironmentRadiance(const Vec3 &ref_pos, const Vec3 &ref_norm, const Vec3 &dir, float &light_pdf)
+    {
+        light_pdf = 0.f;
+        if (env_light_idx_ == -1)
+        {
+            return Color::GreyScale(0.f);
         }
+        std::shared_ptr<EnvironmentLight> env_light = std::static_pointer_cast<EnvironmentLight>(l_prims_[env_light_idx_]);
+        Color radiance = env_light->Le(dir, light_pdf);
+        light_pdf *= light_sampler_.Pmf(ref_pos, ref_norm, env_light_idx_);
         return radiance;
     }
 }
\ No newline at end of file
@@ -6,28 +6,101 @@
 #include "camera.h"
 
 #include "light/light.h"
+#include "light/light_bvh.h"
+
+#include "mat/material_table.h"
+#include "mat/distribution.h"
 
 
 #include <vector>
 #include <memory>
+#include <mutex>
 
 namespace cblt
 {
+    class Triangle;
+    class DTree;
+    class AreaLight;
+
     class Scene
     {
         public:
-        Scene(const Camera & camera, std::vector<std::shared_ptr<ScenePrim>> &s_prims, std::vector<std::shared_ptr<Light>> &l_prims);
+        Scene(const Camera & camera, std::vector<std::shared_ptr<ScenePrim>> &s_prims, std::vector<std::shared_ptr<Light>> &l_prims, const std::shared_ptr<MaterialTable> &materials);
+        // edits only mark the light distributions as stale, so many lights can be added for the cost of one build.
+        // UpdateLights() must be called after editing & before sampling lights, the ray tracer does so per render
         void AddPrim(const std::shared_ptr<ScenePrim> &prim);
         void AddPrim(const std::shared_ptr<Light> &prim);
+        // take a primitive, and any lights created from its emissive triangles, out of the scene
+        bool RemovePrim(const std::shared_ptr<ScenePrim> &prim);
+        // move a primitive, refitting the acceleration structure rather than rebuilding it. Returns false, leaving
+        // the primitive as it was, if it isn't in the scene
+        bool UpdateTransform(const std::shared_ptr<ScenePrim> &prim, const Mat4 &transform);
+        // rebuild the light BVH & distributions if the lights changed since they were built, safe to call from
+        // several renders of the scene at once
+        void UpdateLights();
         bool Intersects(const Ray &ray, float &time);
         bool ClosestIntersection(const Ray &ray, HitInfo &collision_pt);
-        Color SampleSingleLight(const Vec3 &outgoing, const HitInfo &collision_pt, std::shared_ptr<Sampler> &sampler);
-        Color DirectLight(const Vec3 &outgoing, std::shared_ptr<Light> &light, const HitInfo &collision_pt, std::shared_ptr<Sampler> &sampler);
+        // with single_sample_mis the BRDF half of MIS for area lights is left to the integrator, which finds them
+        // along the bounce ray it traces anyway with AreaLightRadiance(). When the integrator chooses its bounce
+        // from guide with probability guide_fraction, the BRDF half is weighed with the same mixture density
+        Color SampleSingleLight(const Vec3 &outgoing, const HitInfo &collision_pt, std::shared_ptr<Sampler> &sampler, bool single_sample_mis = false,
+                                const DTree *guide = nullptr, float guide_fraction = 0.f);
+        Color DirectLight(const Vec3 &outgoing, std::shared_ptr<Light> &light, float light_pmf, const HitInfo &collision_pt, std::shared_ptr<Sampler> &sampler, bool single_sample_mis = false,
+                          const DTree *guide = nullptr, float guide_fraction = 0.f);
+        // choose a light for a shading point as SampleSingleLight does, for integrators which sample the light
+        // themselves. Returns the index of the light or -1
+        int SampleLight(const Vec3 &pos, const Vec3 &norm, float u, float &pmf) const { return light_sampler_.Sample(pos, norm, u, pmf); };
+        // solid angle density with which SampleSingleLight would have chosen the emissive surface at light_pt
+        float LightPdf(const Vec3 &ref_pos, const Vec3 &ref_norm, const HitInfo &light_pt);
+        // radiance from the environment along a direction which escaped the scene, light_pdf is the solid angle
+        // density with which SampleSingleLight would have chosen the same direction
+        Color EnvironmentRadiance(const Vec3 &ref_pos, const Vec3 &ref_norm, const Vec3 &dir, float &light_pdf);
+        // radiance from the closest area light the ray hits no further than max_time, light_pdf is the solid angle
+        // density with which SampleSingleLight would have chosen the same point
+        Color AreaLightRadiance(const Ray &ray, float max_time, const Vec3 &ref_pos, const Vec3 &ref_norm, float &light_pdf);
+        // index of the closest area light the ray hits no further than max_time, or -1
+        int IntersectAreaLights(const Ray &ray, float max_time, float &hit_time);
+
+        // choose a light proportionally to its power, regardless of any shading point, for paths which start at
+        // the lights. Returns the index of the light or -1 if the scene has none
+        int SampleEmitter(float u, float &pmf) const;
+        // probability that SampleEmitter() chooses the light at light_idx
+        float EmitterPmf(int light_idx) const;
+        // index of the light created for an emissive surface which was hit, or -1
+        int EmitterIndex(const HitInfo &hit) const;
+        int EnvironmentIndex() const { return env_light_idx_; };
+        const std::shared_ptr<Light> &GetLight(int light_idx) const { return l_prims_[light_idx]; };
+        // sphere around the geometry & the lights, which lights at infinity emit paths towards
+        void BoundingSphere(Vec3 &cen, float &radius) const;
+        const MaterialTable &Materials() const { return *materials_; };
         Camera cam_;
         private:
+        void AddEmitters(const std::shared_ptr<ScenePrim> &s_prim);
+        std::shared_ptr<Light> MakeEmitter(const std::shared_ptr<ScenePrim> &s_prim, const std::shared_ptr<Triangle> &tri);
+        void RebuildIfDegraded();
+        // find the lights which the integrators look up by type, & build the distribution over their power
+        void IndexLights();
+
+        // an area light in area_light_accel_, which records its index in l_prims_ when it's hit
+        struct AreaLightRef
+        {
+            std::shared_ptr<AreaLight> light_;
+            int light_idx_;
+            bool Intersect(const Ray &ray, HitRecord &collision_pt);
+            BoundingBox GetBounds();
+        };
+
         std::vector<std::shared_ptr<Light>> l_prims_;
         std::vector<std::shared_ptr<ScenePrim>> s_prims_;
         BoundingVolume<ScenePrim> accel_;
+        std::shared_ptr<MaterialTable> materials_;  //! every material referenced by the primitives' triangles
+        LightBVH light_sampler_;
+        int env_light_idx_ = -1;  //! index of the environment light in l_prims_, if the scene has one
+        std::vector<int> area_light_idx_;  //! indices of the area lights in l_prims_
+        BoundingVolume<AreaLightRef> area_light_accel_;  //! the area lights, which bounce rays search at every vertex
+        Distribution1D emitter_distrib_;  //! power of each light in l_prims_
+        bool lights_dirty_ = false;  //! whether l_prims_ changed since light_sampler_ & the light indices were built
+        std::mutex lights_mutex_;
     };
 }
 
@@ -1,68 +1,177 @@
 #include "scene_prim.h"
+#include "triangle.h"
+
 #include "mat/shading_helpers.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
 namespace cblt
 {
+    namespace
+    {
+        // the transforms of an animated instance at one ray time
+        struct CachedTransforms
+        {
+            uint64_t motion_id = 0;
+            float time = 0.f;
+            Affine local_to_world;
+            Affine world_to_local;
+        };
+
+        const uint64_t transform_cache_size = 64;
+        std::atomic<uint64_t> next_motion_id{ 1 };
+    }
+
     ScenePrim::ScenePrim(const std::shared_ptr<Geometry> &model, const Mat4 &transform /*Material*/)
     {
         model_ = model;
-        local_to_world_ = transform;
-        world_to_local_ = Inverse(transform);
+        SetTransform(transform);
     }
 
-    BoundingBox ScenePrim::GetBounds()
+    ScenePrim::ScenePrim(const std::shared_ptr<Geometry> &model, const AnimatedAffine &motion)
+    {
+        model_ = model;
+        SetMotion(motion);
+    }
+
+    void ScenePrim::SetTransform(const Mat4 &transform)
+    {
+        SetMotion(AnimatedAffine(Affine(transform)));
+    }
+
+    void ScenePrim::SetMotion(const AnimatedAffine &motion)
+    {
+        motion_ = motion;
+        // a new id, so transforms cached for the old motion are never mistaken for the new one
+        motion_id_ = next_motion_id.fetch_add(1);
+        local_to_world_ = motion_.Interpolate(motion_.KeyTime(0));
+        world_to_local_ = Inverse(local_to_world_);
+        world_bnds_ = MotionBounds();
+    }
+
+    void ScenePrim::TransformsAt(float time, Affine &local_to_world, Affine &world_to_local) const
+    {
+        if (!motion_.IsAnimated())
+        {
+            local_to_world = local_to_world_;
+            world_to_local = world_to_local_;
+            return;
+        }
+        // ids are handed out in order, so consecutive instances land in different slots
+        thread_local CachedTransforms cache[transform_cache_size];
+        CachedTransforms &entry = cache[motion_id_ % transform_cache_size];
+        if (entry.motion_id != motion_id_ || entry.time != time)
+        {
+            entry.motion_id = motion_id_;
+            entry.time = time;
+            entry.local_to_world = motion_.Interpolate(time);
+            entry.world_to_local = Inverse(entry.local_to_world);
+        }
+        local_to_world = entry.local_to_world;
+        world_to_local = entry.world_to_local;
+    }
+
+    BoundingBox ScenePrim::MotionBounds() const
     {
         BoundingBox local_bnds = model_->GetBounds();
-        Vec4 world_min = local_to_world_ * Vec4(local_bnds.min_, 1.0f);
-        Vec4 world_max = local_to_world_ * Vec4(local_bnds.max_, 1.0f);
-        local_bnds.min_ = Vec3(world_min.x, world_min.y, world_min.z);
-        local_bnds.max_ = Vec3(world_max.x, world_max.y, world_max.z);
-        local_bnds.CalculateCenter();
-        return local_bnds;
+        if (!motion_.IsAnimated())
+        {
+            return local_bnds.Transformed(local_to_world_);
+        }
+        // union the bounds at evenly spaced times through each keyframe segment. Between the samples a rotating
+        // corner can bulge past the chord joining them, so pad by the largest possible gap (the sagitta of the arc)
+        const int steps = 16;
+        BoundingBox bnds;
+        for (int key = 0; key + 1 < motion_.NumKeys(); ++key)
+        {
+            float t0 = motion_.KeyTime(key);
+            float t1 = motion_.KeyTime(key + 1);
+            float radius = 0.f;
+            for (int step = 0; step <= steps; ++step)
+            {
+                Affine xform = motion_.Interpolate(t0 + (t1 - t0) * step / steps);
+                BoundingBox step_bnds = local_bnds.Transformed(xform);
+                Vec3 center(xform.At(0, 3), xform.At(1, 3), xform.At(2, 3));
+                Vec3 reach(std::max(std::abs(step_bnds.min_.x - center.x), std::abs(step_bnds.max_.x - center.x)),
+                           std::max(std::abs(step_bnds.min_.y - center.y), std::abs(step_bnds.max_.y - center.y)),
+                           std::max(std::abs(step_bnds.min_.z - center.z), std::abs(step_bnds.max_.z - center.z)));
+                radius = std::max(radius, Magnitude(reach));
+                bnds = bnds.Union(step_bnds);
+            }
+            float pad = radius * (1.f - std::cos(motion_.SegmentAngle(key) / (2.f * steps)));
+            bnds.min_ = bnds.min_ - Vec3(pad, pad, pad);
+            bnds.max_ = bnds.max_ + Vec3(pad, pad, pad);
+        }
+        bnds.CalculateCenter();
+        return bnds;
+    }
+
+    BoundingBox ScenePrim::GetBounds()
+    {
+        return world_bnds_;
     }
 
     Ray ScenePrim::TransformRay(const Ray &world_ray)
     {
-        Vec4 loc_pos = world_to_local_ * Vec4(world_ray.pos, 1.f);
-        Vec4 loc_dir = world_to_local_ * Vec4(world_ray.dir, 0.f);
+        Affine local_to_world, world_to_local;
+        TransformsAt(world_ray.time, local_to_world, world_to_local);
+        return TransformRay(world_ray, world_to_local);
+    }
+
+    Ray ScenePrim::TransformRay(const Ray &world_ray, const Affine &world_to_local) const
+    {
         Ray local_ray;
-        local_ray.pos = Vec3(loc_pos.x, loc_pos.y, loc_pos.z);
-        local_ray.dir = Vec3(loc_dir.x, loc_dir.y, loc_dir.z);
+        local_ray.pos = world_to_local.Point(world_ray.pos);
+        // the direction isn't renormalized, so hit times in local space are also valid in world space
+        local_ray.dir = world_to_local.Vector(world_ray.dir);
         local_ray.inv = Vec3(1.0f / (local_ray.dir.x + eps_zero_F), 1.0f / (local_ray.dir.y + eps_zero_F), 1.0f / (local_ray.dir.z + eps_zero_F));
-        local_ray.dir = Normalize(local_ray.dir);
-        local_ray.inv = Normalize(local_ray.inv);
+        // the ray cone stays in world units, triangles rescale it using the length of the local direction
+        local_ray.cone_width = world_ray.cone_width;
+        local_ray.cone_spread = world_ray.cone_spread;
+        local_ray.time = world_ray.time;
         return local_ray;
     }
 
-    bool ScenePrim::Intersect(const Ray &ray, HitInfo &collision_pt)
+    bool ScenePrim::Intersect(const Ray &ray, HitRecord &collision_pt)
     {
-        // transform to local reference frame
+        // transform to local reference frame, and intersect the shared model directly into the record. The
+        // model only writes to it when it finds a hit closer than collision_pt.hit_time
         Ray local_ray = TransformRay(ray);
-        // intersect againt the model in its local reference frame
-        HitInfo local_hit;
-        local_hit.hit_time = inf_F;
-        bool hit = model_->Intersect(local_ray, local_hit);
-        if (hit)
+        if (!model_->Intersect(local_ray, collision_pt))
         {
-            // transform the hit info back into world space
-            Vec4 world_pos = local_to_world_ * Vec4(local_hit.pos, 1.f);
-            Vec4 world_norm = local_to_world_ * Vec4(local_hit.norm, 0.f);
-            collision_pt.pos = Vec3(world_pos.x, world_pos.y, world_pos.z);
-            collision_pt.norm = Normalize(Vec3(world_norm.x, world_norm.y, world_norm.z));
-            collision_pt.shading_basis = local_hit.shading_basis * world_to_local_;
-            collision_pt.hit_time = Magnitude(ray.pos - collision_pt.pos);
-            collision_pt.m = local_hit.m;
-
-            // make orthonormal basis for shading
-            Vec3 tan, bitan;
-            OrthonormalBasis(collision_pt.norm, tan, bitan);
-            collision_pt.shading_basis = Mat4(Vec4(tan, 1.f), Vec4(collision_pt.norm, 1.f), Vec4(bitan, 1.f), Vec4(0.f, 0.f, 0.f, 1.f)); 
-            collision_pt.geom = this;
-            return true;
+            return false;
         }
-        else
+        collision_pt.geom = this;
+        return true;
+    }
+
+    void ScenePrim::FillHitInfo(const Ray &ray, const HitRecord &record, const MaterialTable &materials, HitInfo &collision_pt)
+    {
+        Affine local_to_world, world_to_local;
+        TransformsAt(ray.time, local_to_world, world_to_local);
+
+        collision_pt.hit_time = record.hit_time;
+        collision_pt.time = ray.time;
+        collision_pt.pos = ray.pos + ray.dir * record.hit_time;
+        collision_pt.bary = record.bary;
+        collision_pt.tri = record.tri;
+        collision_pt.geom = this;
+        if (collision_pt.tri == nullptr)
         {
-            return false;
+            return;
         }
+        // the triangle fills the parts which depend on the ray in local space, like the footprint
+        collision_pt.tri->FillHitInfo(TransformRay(ray, world_to_local), materials, collision_pt);
+
+        // normals are carried by the inverse transpose, which keeps them on the same side as the ray
+        collision_pt.norm = Normalize(world_to_local.TransposeVector(collision_pt.norm));
+        Vec3 local_norm, local_tan;
+        collision_pt.tri->SurfaceAttributes(collision_pt.bary, local_norm, collision_pt.uv, local_tan);
+        Vec3 shading_norm = Normalize(world_to_local.TransposeVector(local_norm));
+        // the geometric normal already faces the incoming ray, so keep the shading normal on the same side
+        collision_pt.norm = (Dot(shading_norm, collision_pt.norm) < 0.f) ? -shading_norm : shading_norm;
+        collision_pt.tangent = local_to_world.Vector(local_tan);
     }
 }
\ No newline at end of file
@@ -4,23 +4,47 @@
 #include "boundable.h"
 #include "geometry.h"
 #include "math\mat4.h"
+#include "math/affine.h"
+#include "math/animated_affine.h"
 #include "ray.h"
 
+#include <cstdint>
 #include <memory>
 
 namespace cblt
 {
+    class MaterialTable;
+
     class ScenePrim : public Boundable
     {
         public:
         ScenePrim(const std::shared_ptr<Geometry> &model, const Mat4 &transform /*Material*/);
+        // an instance which moves during the shutter interval, rays are intersected against it at their own time
+        ScenePrim(const std::shared_ptr<Geometry> &model, const AnimatedAffine &motion);
+        // bounds of the instance over its whole motion, so the top level structure stays valid at any ray time
         BoundingBox GetBounds();
+        // move the instance, the scene is responsible for updating its acceleration structure afterwards
+        void SetTransform(const Mat4 &transform);
+        void SetMotion(const AnimatedAffine &motion);
         Ray TransformRay(const Ray &world_ray);
-        bool Intersect(const Ray &ray, HitInfo &collision_pt);
+        // only updates collision_pt if the model is hit closer than collision_pt.hit_time
+        bool Intersect(const Ray &ray, HitRecord &collision_pt);
+        // build the full shading record for the closest hit, once per ray after traversal has found it
+        void FillHitInfo(const Ray &ray, const HitRecord &record, const MaterialTable &materials, HitInfo &collision_pt);
         private:
-        Mat4 local_to_world_;
-        Mat4 world_to_local_;
-        std::shared_ptr<Geometry> model_;
+        // an animated instance's transforms are interpolated & inverted once per thread & ray time, then reused by
+        // the other rays of the same camera sample, which share its time
+        void TransformsAt(float time, Affine &local_to_world, Affine &world_to_local) const;
+        Ray TransformRay(const Ray &world_ray, const Affine &world_to_local) const;
+        BoundingBox MotionBounds() const;
+
+        AnimatedAffine motion_;
+        Affine local_to_world_;  //! transform at the first keyframe, used directly by instances which don't move
+        Affine world_to_local_;
+        uint64_t motion_id_ = 0;  //! unique to each motion ever set, identifies it in the per thread transform cache
+        std::shared_ptr<Geometry> model_;  //! bottom level acceleration structure, shared by every instance of the model
+        BoundingBox world_bnds_;  //! cached world space bounds, used to build the top level structure
+        int light_offset_ = -1;  //! index of the first light created from this prim's emissive triangles
 
         friend class Scene;
     };
@@ -1,19 +1,24 @@
 #include "triangle.h"
 
+#include "mat/material_table.h"
+#include "mat/shading_helpers.h"
+
 
 #include <algorithm>
+#include <cmath>
 
 namespace cblt {
 
-	Triangle::Triangle() : use_vertex_norms_(false), use_vertex_uvs_(false), face_norm_len_(0.f)
+	Triangle::Triangle() : use_vertex_norms_(false), use_vertex_uvs_(false), face_norm_len_(0.f), uv_density_(0.f)
 	{
 		
 	};
 
-    Triangle::Triangle(const Vec3 &p1, const Vec3 &p2, const Vec3 &p3, std::shared_ptr<Material> &mat) :
+    Triangle::Triangle(const Vec3 &p1, const Vec3 &p2, const Vec3 &p3, MaterialId mat) :
     pos1_(p1), pos2_(p2), pos3_(p3)
     {
         use_vertex_norms_ = use_vertex_uvs_ = false;
+        uv_density_ = 0.f;
         // calculate the per-face normal
         Vec3 v1 = pos3_ - pos1_;
         Vec3 v2 = pos2_ - pos1_;
@@ -24,11 +29,12 @@ namespace cblt {
     }
 
     Triangle::Triangle(const Vec3 &p1, const Vec3 &p2, const Vec3 &p3, 
-                       const Vec3 &n1, const Vec3 &n2, const Vec3 &n3, std::shared_ptr<Material> &mat) :
+                       const Vec3 &n1, const Vec3 &n2, const Vec3 &n3, MaterialId mat) :
     pos1_(p1), pos2_(p2), pos3_(p3), norm1_(n1), norm2_(n2), norm3_(n3)
     {
         use_vertex_norms_ = true;
         use_vertex_uvs_ = false;
+        uv_density_ = 0.f;
 		// calculate the per-face normal
         Vec3 v1 = pos3_ - pos1_;
         Vec3 v2 = pos2_ - pos1_;
@@ -40,7 +46,7 @@ namespace cblt {
 
     Triangle::Triangle(const Vec3 &p1, const Vec3 &p2, const Vec3 &p3, 
                       const Vec3 &n1, const Vec3 &n2, const Vec3 &n3,
-                      const Vec2 &uv1, const Vec2 &uv2, const Vec2 &uv3, std::shared_ptr<Material> &mat) :
+                      const Vec2 &uv1, const Vec2 &uv2, const Vec2 &uv3, MaterialId mat) :
     pos1_(p1), pos2_(p2), pos3_(p3), 
     norm1_(n1), norm2_(n2), norm3_(n3),
     uv1_(uv1), uv2_(uv2), uv3_(uv3)
@@ -53,9 +59,27 @@ namespace cblt {
         face_norm_len_ = Magnitude(face_norm_);
         face_norm_ = Normalize(face_norm_);
 		mat_ = mat;
+
+        // both areas are doubled, so the ratio is unaffected
+        Vec2 duv1 = uv3_ - uv1_;
+        Vec2 duv2 = uv2_ - uv1_;
+        float uv_area = std::abs(duv1.x * duv2.y - duv1.y * duv2.x);
+        uv_density_ = (face_norm_len_ > 0.f) ? std::sqrt(uv_area / face_norm_len_) : 0.f;
+
+        // tangent follows the direction of increasing u across the face
+        float det = duv2.x * duv1.y - duv1.x * duv2.y;
+        if (std::abs(det) > eps_zero_F)
+        {
+            tangent_ = Normalize((v2 * duv1.y - v1 * duv2.y) / det);
+        }
+        else
+        {
+            Vec3 bitangent;
+            OrthonormalBasis(face_norm_, tangent_, bitangent);
+        }
     }
 
-    bool Triangle::Intersect(const Ray &ray, HitInfo &collision_pt)
+    bool Triangle::Intersect(const Ray &ray, HitRecord &collision_pt)
     {
 
   	    float dt = Dot(ray.dir, face_norm_);
@@ -66,9 +90,9 @@ namespace cblt {
   	    }
 
   	    float hit_t = Dot(pos1_ - ray.pos, face_norm_) / dt;
-  	    if (hit_t < eps_zero_F)
+  	    if (hit_t < eps_zero_F || hit_t >= collision_pt.hit_time)
         {
-  	        // only go forward in the direction
+  	        // only go forward in the direction, and only if this is closer than the current hit
   	        return false;
   	    }
 	
@@ -86,49 +110,54 @@ namespace cblt {
 		float one = 1.f + eps_zero_F;
   	    if(a <= one && b <= one && c <= one && a + b + c <= one)
         {
-    	    collision_pt.pos = hit_pos;
+    	    // only record which triangle was hit & where, everything else is filled by FillHitInfo() once the
+    	    // closest hit is known
     	    collision_pt.hit_time = hit_t;
-    	
-    	    if (use_vertex_norms_)
-            {
-                collision_pt.norm = norm1_ * a + norm2_ * b + norm3_ * c;
-				collision_pt.norm = Normalize(collision_pt.norm);
-            }
-			else
-            {
-				collision_pt.norm = face_norm_;
-			}
-    	
-    	    collision_pt.m = mat_;
-    	    Vec2 uv = uv1_ * a + uv2_ * b + uv3_ * c;
-    	    /*if (use_vertex_uvs_) {
-    	        // TODO: Move Texture sampling for normal vectors & base color to after the closest collision has been determined
-    	        Vec3 tangent = a * (t1_) + b * (t2_) + c * (t3_);
-    	        Vec3 bitangent = a * (bt1_) + b * (bt2_) + c * (bt3_);
-    	        Vec3 normal = a * (n1_) + b * (n2_) + c * (n3_);
-    	        Mat4 TBN(Vec4(tangent, 0), Vec4(bitangent, 0), Vec4(normal, 0), Vec4(0, 0, 0, 1));
-    	        // Get normal from texture
-    	        Color norm_clr = mat_->normal_map_->sample(hit.uv.x, hit.uv.y);
-    	        Vec4 tex_norm = Vec4(norm_clr.r, norm_clr.g, norm_clr.b) * 2.f - 1.0f;
-    	        tex_norm = TBN * tex_norm;
-    	        hit.norm = Vec3(tex_norm.x, tex_norm.y, tex_norm.z);
-    	    }*/
-		    if (Dot(collision_pt.norm, ray.dir) > 0.f)
-            {
-				// we are exiting this medium, since the normals are facing the same direction 
-				collision_pt.medium_ior = mat_->IOR();
-				collision_pt.norm = -collision_pt.norm;
-			}
-			else
-            {
-				// we are entering the medium, so use 1.0 to represent air for now
-				collision_pt.medium_ior = 1.f;
-			}
+    	    collision_pt.bary = Vec2(b, c);
+    	    collision_pt.tri = this;
 		    return true;
   	    }
   	    return false;
     }
 
+    void Triangle::FillHitInfo(const Ray &ray, const MaterialTable &materials, HitInfo &collision_pt) const
+    {
+        collision_pt.norm = face_norm_;
+        collision_pt.mat_id = mat_;
+        collision_pt.emit_idx = emit_idx_;
+        // project the width of the ray cone onto the surface, then scale it into uv space. The ray direction is
+        // the world space direction carried into local space, so its length rescales world widths & dt
+        float dt = Dot(ray.dir, face_norm_);
+        float cone_width = ray.cone_width + ray.cone_spread * collision_pt.hit_time;
+        collision_pt.uv_footprint = cone_width * MagnitudeSqr(ray.dir) * uv_density_ / std::abs(dt);
+        if (dt > 0.f)
+        {
+            // we are exiting this medium, since the normals are facing the same direction 
+            collision_pt.medium_ior = (mat_ != invalid_material) ? materials.IOR(mat_) : 1.f;
+            collision_pt.norm = -collision_pt.norm;
+        }
+        else
+        {
+            // we are entering the medium, so use 1.0 to represent air for now
+            collision_pt.medium_ior = 1.f;
+        }
+    }
+
+	void Triangle::SurfaceAttributes(const Vec2 &bary, Vec3 &norm, Vec2 &uv, Vec3 &tangent) const
+	{
+		float a = 1.f - bary.x - bary.y;
+		norm = (use_vertex_norms_) ? Normalize(norm1_ * a + norm2_ * bary.x + norm3_ * bary.y) : face_norm_;
+		uv = (use_vertex_uvs_) ? uv1_ * a + uv2_ * bary.x + uv3_ * bary.y : Vec2(0.f, 0.f);
+		tangent = tangent_;
+	}
+
+	void Triangle::GetVertices(Vec3 &p1, Vec3 &p2, Vec3 &p3) const
+	{
+		p1 = pos1_;
+		p2 = pos2_;
+		p3 = pos3_;
+	}
+
 	BoundingBox Triangle::GetBounds()
 	{
 		std::pair<float, float> x_rng = std::minmax( {pos1_.x, pos2_.x, pos3_.x} );
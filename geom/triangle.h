@@ -3,24 +3,33 @@
 
 #include "geometry.h"
 #include "math/vec.h"
-#include "mat/material.h"
+#include "geom/hit_info.h"
 
 #include <memory>
 
 namespace cblt
 {
+    class MaterialTable;
+
     class Triangle final : public Geometry
     {
         public:
             Triangle();
-            Triangle(const Vec3 &p1, const Vec3 &p2, const Vec3 &p3, std::shared_ptr<Material> &mat);
+            Triangle(const Vec3 &p1, const Vec3 &p2, const Vec3 &p3, MaterialId mat);
             Triangle(const Vec3 &p1, const Vec3 &p2, const Vec3 &p3, 
-                     const Vec3 &n1, const Vec3 &n2, const Vec3 &n3, std::shared_ptr<Material> &mat);
+                     const Vec3 &n1, const Vec3 &n2, const Vec3 &n3, MaterialId mat);
             Triangle(const Vec3 &p1, const Vec3 &p2, const Vec3 &p3, 
                      const Vec3 &n1, const Vec3 &n2, const Vec3 &n3,
-                     const Vec2 &uv1, const Vec2 &uv2, const Vec2 &uv3, std::shared_ptr<Material> &mat);
-            bool Intersect(const Ray &ray, HitInfo &collision_pt) override;
+                     const Vec2 &uv1, const Vec2 &uv2, const Vec2 &uv3, MaterialId mat);
+            bool Intersect(const Ray &ray, HitRecord &collision_pt) override;
+            // fill the local space geometric normal, material & ray footprint of a hit found by Intersect()
+            void FillHitInfo(const Ray &ray, const MaterialTable &materials, HitInfo &collision_pt) const;
             BoundingBox GetBounds() override;
+            // interpolate the local space shading normal, uvs & tangent at the barycentric coordinates of a hit
+            void SurfaceAttributes(const Vec2 &bary, Vec3 &norm, Vec2 &uv, Vec3 &tangent) const;
+            void GetVertices(Vec3 &p1, Vec3 &p2, Vec3 &p3) const;
+            float Area() const { return .5f * face_norm_len_; };
+            MaterialId GetMaterial() const { return mat_; };
         private:
 
             // position attributes
@@ -41,9 +50,14 @@ namespace cblt
             Vec2 uv1_;
             Vec2 uv2_;
             Vec2 uv3_;
+            Vec3 tangent_;  //! direction of increasing u across the face
+            float uv_density_;  //! sqrt of the ratio of uv area to surface area, converts footprint widths into uv widths
 
             // material
-            std::shared_ptr<Material> mat_;
+            MaterialId mat_ = invalid_material;
+            int emit_idx_ = -1;  //! index amongst the emissive triangles of the owning mesh
+
+            friend class TriangleMesh;
     };
 }
 
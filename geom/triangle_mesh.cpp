@@ -1,12 +1,21 @@
 #include "triangle_mesh.h"
 
 namespace cblt {
-    TriangleMesh::TriangleMesh(std::vector<std::shared_ptr<Triangle>> &tris)
+    TriangleMesh::TriangleMesh(std::vector<std::shared_ptr<Triangle>> &tris, const MaterialTable &materials)
     {
         triangles_ = BoundingVolume<Triangle>(tris);
+        // remember the emissive triangles so the scene can turn them into lights
+        for (const std::shared_ptr<Triangle> &tri : tris)
+        {
+            if (tri->mat_ != invalid_material && materials.Emittance(tri->mat_).Luminance() > 0.f)
+            {
+                tri->emit_idx_ = static_cast<int>(emitters_.size());
+                emitters_.push_back(tri);
+            }
+        }
     }
 
-    bool TriangleMesh::Intersect(const Ray &ray, HitInfo &collision_pt) 
+    bool TriangleMesh::Intersect(const Ray &ray, HitRecord &collision_pt) 
     {
         return triangles_.Intersect(ray, collision_pt); 
     }
@@ -4,6 +4,7 @@
 #include "geometry.h"
 #include "triangle.h"
 #include "bounding_volume.h"
+#include "mat/material_table.h"
 
 #include <vector>
 
@@ -12,11 +13,13 @@ namespace cblt
     class TriangleMesh final : public Geometry
     {
         public:
-            TriangleMesh(std::vector<std::shared_ptr<Triangle>> &tris);
-            bool Intersect(const Ray &ray, HitInfo &collision_pt) override;
+            TriangleMesh(std::vector<std::shared_ptr<Triangle>> &tris, const MaterialTable &materials);
+            bool Intersect(const Ray &ray, HitRecord &collision_pt) override;
             BoundingBox GetBounds() override;
+            const std::vector<std::shared_ptr<Triangle>> &Emitters() const { return emitters_; };
         private:
             BoundingVolume<Triangle> triangles_;
+            std::vector<std::shared_ptr<Triangle>> emitters_;  //! triangles whose material has a non-zero emittance
     };
 }
 
@@ -0,0 +1,122 @@
+#ifndef CBLT_H
+#define CBLT_H
+
+// The renderer's library interface, for applications which build their scenes in memory & render them in process
+// rather than writing a scene file & running Path_Tracer. Only standard headers are needed to use it
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace cblt
+{
+    class Scene;
+
+    // an indexed triangle mesh, the arrays are copied so they only need to live until AddMesh() returns
+    struct MeshData
+    {
+        const float *positions = nullptr;  //! 3 floats per vertex
+        const float *normals = nullptr;  //! optional, 3 floats per vertex, otherwise faces are shaded flat
+        const float *uvs = nullptr;  //! optional, 2 floats per vertex
+        size_t num_verts = 0;
+        const uint32_t *indices = nullptr;  //! 3 vertex indices per triangle
+        size_t num_tris = 0;
+        const uint32_t *materials = nullptr;  //! optional, the material of each triangle, otherwise material is used
+        uint32_t material = 0;
+    };
+
+    // parameters of the Disney principled BRDF, the defaults are a grey dielectric
+    struct PrincipledMaterialData
+    {
+        float base_color[3] = { .8f, .8f, .8f };
+        float subsurface = 0.f;
+        float metallic = 0.f;
+        float specular = .5f;
+        float specular_tint = 0.f;
+        float roughness = .5f;
+        float anisotropic = 0.f;
+        float sheen = 0.f;
+        float sheen_tint = 0.f;
+        float clearcoat = 0.f;
+        float clearcoat_gloss = 0.f;
+        float ior = 1.45f;
+        std::string base_texture;  //! optional image file which replaces base_color
+    };
+
+    // parameters of the Cook Torrence BRDF, emissive surfaces become area lights
+    struct CookTorrenceMaterialData
+    {
+        float albedo[3] = { .8f, .8f, .8f };
+        float specular[3] = { 1.f, 1.f, 1.f };
+        float emissive[3] = { 0.f, 0.f, 0.f };
+        float ior = 1.45f;
+        float roughness = .5f;
+        float metallic = 0.f;
+        std::string albedo_texture;  //! optional image file which replaces albedo
+    };
+
+    // Collects the contents of a scene, then builds the acceleration structures & light distributions once in
+    // Build(). Materials & meshes are referred to by the handle their Add method returns
+    class SceneBuilder
+    {
+        public:
+        SceneBuilder();
+        ~SceneBuilder();
+        SceneBuilder(const SceneBuilder &) = delete;
+        SceneBuilder &operator=(const SceneBuilder &) = delete;
+
+        // horiz_half_fov is half the horizontal field of view in degrees
+        void SetCamera(const float eye[3], const float forward[3], const float up[3], float horiz_half_fov);
+        // the shutter is open over [open, close], which instance keyframes are timed against
+        void SetShutter(float open, float close);
+        // return the material's handle, or UINT32_MAX if its texture can't be loaded
+        uint32_t AddMaterial(const PrincipledMaterialData &material);
+        uint32_t AddMaterial(const CookTorrenceMaterialData &material);
+        // return the mesh's handle, which may be instanced any number of times, or UINT32_MAX for invalid indices
+        uint32_t AddMesh(const MeshData &mesh);
+        // place a mesh in the scene with a 4x4 transform, rows first as in an SDesc Transform
+        bool AddInstance(uint32_t mesh, const float transform[16]);
+        // a moving instance, with a transform at each of num_keys times
+        bool AddInstance(uint32_t mesh, const float *times, const float *transforms, size_t num_keys);
+        // a rectangle emitting on one side, pos is its center & normal the side it lights. length & width are
+        // measured along length_dir & width_dir
+        void AddAreaLight(const float pos[3], const float length_dir[3], const float normal[3], const float width_dir[3],
+                          const float color[3], float power, float length, float width);
+        void AddDirectionLight(const float dir[3], const float color[3], float power, float angular_spread = 0.f);
+        // light from every direction from an HDR image, false if it can't be loaded
+        bool AddEnvironmentLight(const std::string &file_name, float power = 1.f);
+        // the finished scene, after which the builder is empty again
+        std::shared_ptr<Scene> Build();
+
+        private:
+        struct Contents;
+        std::unique_ptr<Contents> contents_;
+    };
+
+    // Renders scenes into buffers the caller owns
+    class Renderer
+    {
+        public:
+        // called as each tile finishes with the region of the buffer which was just updated, from the render
+        // threads but never concurrently. Tiles are reported again as later passes refine them
+        typedef std::function<void(int start_x, int start_y, int count_x, int count_y)> TileCallback;
+
+        Renderer();
+        ~Renderer();
+        // change settings written as in a configuration file, e.g. "width: 640 height: 480 num_samples: 16".
+        // Returns false if a setting is unknown or malformed, in which case none are changed
+        bool Configure(const std::string &settings);
+        int Width() const;
+        int Height() const;
+        // render the scene into rgb, 3 * Width() * Height() floats of linear radiance, row by row from the top
+        bool Render(const std::shared_ptr<Scene> &scene, float *rgb, const TileCallback &on_tile = nullptr);
+
+        private:
+        struct Settings;
+        std::unique_ptr<Settings> settings_;
+    };
+}
+
+#endif  // CBLT_H
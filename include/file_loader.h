@@ -1,9 +1,13 @@
 #ifndef FILE_LOADER_H
 #define FILE_LOADER_H
+#include <ostream>
 #include <string>
 #include <memory>
 
 #include "geom/scene.h"
+#include "mat/texture.h"
+
+#include <vector>
 // Interface for File Loading- Allows for easy support of new file formats
 // without needing to manipulate existing code
 class FileLoader {
@@ -11,4 +15,10 @@ class FileLoader {
     virtual std::shared_ptr<cblt::Scene> LoadScene(std::string file_name) = 0;
 };
 
+// load a scene with the loader for its file's extension, nullptr if the format isn't supported. Textures come from
+// textures if given, so every scene loaded with it shares them. Any other files the scene reads, e.g. its textures,
+// are added to dependencies if given. What was loaded, & why a scene couldn't be, is written to log if given
+std::shared_ptr<cblt::Scene> LoadSceneFile(const std::string &file_name, const std::shared_ptr<cblt::TextureLibrary> &textures = nullptr,
+                                           std::vector<std::string> *dependencies = nullptr, std::ostream *log = nullptr);
+
 #endif  // FILE_LOADER_H
\ No newline at end of file
@@ -5,33 +5,110 @@
 
 #include "geom/scene.h"
 #include "sampler.h"
+#include "sd_tree.h"
 
+#include <functional>
+#include <istream>
 #include <string>
 #include <vector>
 #include <memory>
 
+enum integrator_type
+{
+    path_tracing,
+    bidirectional_path_tracing,
+    progressive_photon_mapping
+};
+
 struct RenderSettings
 {
     int img_width;
     int img_height;
-    int num_samples;
+    int num_samples;  // per pixel, progressive photon mapping traces one camera path per pixel each iteration
     int num_threads;
     int path_depth;
     int tile_size;
+    // area lights found by the bounce ray are weighed against light sampling by the integrator, rather than
+    // sampling the BRDF & tracing a second ray towards them during direct lighting
+    bool single_sample_mis;
+    integrator_type integrator;
+    // learn where indirect light comes from over passes with doubling sample counts, & sample bounces from what
+    // was learnt as well as from the BRDF. Only the path tracer is guided
+    bool path_guiding;
+    // ReSTIR, resample the direct light at each pixel's first hit from many candidates, reusing them across
+    // neighbouring pixels & successive samples, then trace one shadow ray. Only used by the path tracer, unguided
+    bool resampled_direct;
+    // write how far the render has got to stdout, for the command line. Embedding applications are told through
+    // the tile callback instead
+    bool show_progress;
+};
+
+// read the value of a "key:" token of a configuration file from in. Returns false if key is not a setting
+bool ParseSetting(const std::string &key, std::istream &in, RenderSettings &settings);
+
+// the first vertex of a camera path, when it's found & its direct light is sampled before the path is traced
+struct PrimaryVertex
+{
+    cblt::HitInfo hit;
+    bool found;
+    Color direct;
+};
+
+// a region of the image which finished rendering. radiance points at its top left pixel within the radiance
+// accumulated for the whole image, or for just the tile when streaming, whose rows are stride pixels apart, & scale
+// turns it into the average so far
+struct TileUpdate
+{
+    int start_x;
+    int start_y;
+    int count_x;
+    int count_y;
+    const Color *radiance;
+    int stride;
+    float scale;
 };
 
 class RayTracer
 {
 public:
+    // called from the render threads as each tile finishes, concurrently for different tiles, so it must be
+    // thread safe. Integrators which render a frame at a time report the whole image as one tile
+    typedef std::function<void(const TileUpdate &)> TileCallback;
+
     RayTracer(int width, int height, std::shared_ptr<cblt::Scene> &image_scene_);
     RayTracer(const RenderSettings &settings, std::shared_ptr<cblt::Scene> &image_scene_);
+    // render through camera rather than the scene's own, e.g. to move it without changing a shared scene
+    RayTracer(const RenderSettings &settings, std::shared_ptr<cblt::Scene> &image_scene_, const cblt::Camera &camera);
     ~RayTracer();
     std::shared_ptr<Image> Render();
+    // the average radiance reaching each pixel, row by row from the top, before tone mapping
+    std::vector<Color> RenderRadiance();
+    // render a tile at a time with all of its samples, handing each one to the tile callback as it finishes without
+    // ever holding the whole frame, so memory is bounded by the tiles in flight. Returns false without rendering
+    // if the integrator needs the whole frame at once, as photon mapping, ReSTIR & path guiding do
+    bool RenderStreaming();
+    bool CanStream() const;
+    void SetTileCallback(const TileCallback &callback) { tile_callback_ = callback; };
 private:
     RenderSettings image_settings_;
     std::shared_ptr<cblt::Scene> image_scene_;
+    cblt::Camera camera_;  //! fitted to this image, a copy so renders sharing a scene don't race on its camera
+    std::shared_ptr<cblt::SDTree> guide_;
+    bool record_guide_ = false;  //! whether paths add what they find to guide_ during this pass
+    TileCallback tile_callback_;
 
-    Color PathTraceIterative(cblt::Ray cam_ray, std::shared_ptr<cblt::Sampler> &generator);
+    // render every tile with the path tracer or bidirectional path tracer, into the returned frame or, when
+    // streaming, into buffers which only live until the tile callback has seen them
+    std::vector<Color> RenderTiles(bool stream);
+    Color PathTraceIterative(cblt::Ray cam_ray, std::shared_ptr<cblt::Sampler> &generator, const PrimaryVertex *primary = nullptr);
+    // implemented in bidirectional_path_tracer.cpp, scene_cen & scene_radius are the scene's bounding sphere
+    Color BidirectionalPathTrace(cblt::Ray cam_ray, std::shared_ptr<cblt::Sampler> &generator, const cblt::Vec3 &scene_cen, float scene_radius);
+    // implemented in photon_mapper.cpp, renders every pixel once per iteration rather than tile by tile
+    std::vector<Color> RenderProgressivePhotons();
+    // implemented in resampled_direct_light.cpp, renders a frame at a time so pixels can share light samples
+    std::vector<Color> RenderResampledDirect();
+    // Reinhard tone map & gamma correct the radiance of every pixel, after scaling it
+    std::shared_ptr<Image> ToneMap(const std::vector<Color> &radiance, float scale) const;
     bool SceneIntersect(cblt::Ray ray, cblt::HitInfo &hit);
 };
 
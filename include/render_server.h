@@ -0,0 +1,72 @@
+#ifndef RENDER_SERVER_H
+#define RENDER_SERVER_H
+
+#include "ray_tracer.h"
+
+#include "geom/scene.h"
+#include "mat/image_writer.h"
+#include "mat/texture.h"
+
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Scenes loaded by the render server, keyed by the scene file's path & checked against the modification time of
+// the file & of every texture or environment map it reads. Scenes are loaded with one texture library, so textures
+// the scenes share are only decoded once. Once more than capacity scenes are loaded, the least recently rendered
+// one is released along with its meshes & BVHs, & any textures no other scene uses
+class SceneCache
+{
+    public:
+    SceneCache(size_t capacity, const std::shared_ptr<cblt::TextureLibrary> &textures);
+    // the scene in file_name, which is only loaded if it isn't cached or any of its files changed since. loaded
+    // tells which happened. nullptr if the file is missing or can't be loaded
+    std::shared_ptr<cblt::Scene> Get(const std::string &file_name, bool &loaded);
+    size_t Size() const { return entries_.size(); };
+    private:
+    struct Entry
+    {
+        std::string file_name;
+        // the scene file & the files it reads, with their modification times when it was loaded
+        std::vector<std::pair<std::string, std::filesystem::file_time_type>> files;
+        std::shared_ptr<cblt::Scene> scene;
+    };
+    std::list<Entry> entries_;  //! most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> lookup_;
+    size_t capacity_;
+    std::shared_ptr<cblt::TextureLibrary> textures_;
+};
+
+// Long running render process, which renders jobs sent over a local socket against scenes it keeps loaded, so
+// only the first job on a scene pays for parsing, texture decoding & building the BVH. A job is one line of
+// "key: value" tokens, any key of a configuration file plus
+//   input: <scene file>  output: <image file>  camera_pos: x y z  camera_fwd: x y z  camera_up: x y z  camera_fov_ha: degrees
+// relative paths are relative to the data directory, as on the command line. Each job is answered with one line,
+// "ok <output file> <render milliseconds> <loaded|cached>" once the image is written, or "error <reason>", which
+// includes the image failing to write. Images
+// are encoded in the background, so a client which sends several jobs without waiting for their replies has each
+// one rendered while the previous one is written. The line "shutdown" stops the server
+class RenderServer
+{
+    public:
+    RenderServer(const RenderSettings &defaults, size_t cache_size);
+    // listen on endpoint, either a TCP port on the loopback interface or the path of a Unix domain socket, &
+    // serve clients one at a time until one asks to shutdown. Returns false if the socket can't be opened
+    bool Run(const std::string &endpoint);
+    // render the job on a single line & write its image, returning the reply
+    std::string RenderJob(const std::string &job);
+    private:
+    // render the job & queue its image to be written to output, write_ticket is 0 if there's nothing to wait for
+    std::string StartJob(const std::string &job, size_t &write_ticket, std::string &output);
+
+    RenderSettings defaults_;  //! settings of every job, unless the job overrides them
+    std::shared_ptr<cblt::TextureLibrary> textures_;  //! shared by every scene, so jobs on different scenes share assets
+    SceneCache scenes_;
+    cblt::ImageWriter writer_;
+};
+
+#endif  // RENDER_SERVER_H
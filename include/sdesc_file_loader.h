@@ -4,30 +4,78 @@
 #include "file_loader.h"
 #include "light/light.h"
 
-#include "mat/material.h"
+#include "mat/material_table.h"
+#include "mem/memory_arena.h"
 
 #include <pugixml.hpp>
 
 #include <unordered_map>
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <ostream>
 #include <string>
+#include <vector>
 
+// Loads SDesc scenes in stages. Materials, with their textures, & lights are read in parallel while each mesh's
+// arrays are parsed, then every mesh's triangles & BVH are built in parallel once the materials they refer to
+// exist. The results of each stage are committed in file order, so material ids don't depend on scheduling.
+// Exported scenes often repeat assets, so a texture file is only loaded once however many materials use it, &
+// geometry identical to an earlier node's is instanced rather than built again
 class SDescFileLoader final : public FileLoader {
     public:
+    // textures come from textures if given, so every scene loaded with it shares them, or else from the loader's own.
+    // Files which can't be loaded, & what was shared, are written to log if given
+    SDescFileLoader(const std::shared_ptr<cblt::TextureLibrary> &textures = nullptr, std::ostream *log = nullptr);
     std::shared_ptr<cblt::Scene> LoadScene(std::string file_name) override;
+    // the files the last scene loaded reads besides the scene file, i.e. its textures & environment maps
+    const std::vector<std::string> &Dependencies() const { return dependencies_; };
     private:
+    // the arrays of a geometry node, parsed before its materials are known
+    struct MeshArrays
+    {
+        std::vector<float> verts, norms, uvs;
+        std::vector<int> inds, mat_inds;
+        std::vector<std::string> surfs;
+        bool has_norms = false;
+        bool has_uvs = false;
+        uint64_t hash = 0;  //! of every array, to find duplicate geometry before comparing it in full
+
+        bool operator==(const MeshArrays &rhs) const
+        {
+            return hash == rhs.hash && has_norms == rhs.has_norms && has_uvs == rhs.has_uvs && verts == rhs.verts && norms == rhs.norms &&
+                   uvs == rhs.uvs && inds == rhs.inds && mat_inds == rhs.mat_inds && surfs == rhs.surfs;
+        };
+    };
+
     bool ProcessCamera(pugi::xml_node &camera_node);
-    bool ProcessPrincipledMaterial(pugi::xml_node &mat_node);
-    bool ProcessTorrenceMaterial(pugi::xml_node &mat_node);
-    bool ProcessMesh(pugi::xml_node &mesh_node);
+    // the Process methods below are run as tasks, so they only read the loader & return what they made
+    bool ProcessMaterial(pugi::xml_node &mat_node, std::optional<cblt::MaterialVariant> &material);
+    bool ProcessPrincipledMaterial(pugi::xml_node &mat_node, std::optional<cblt::MaterialVariant> &material);
+    bool ProcessTorrenceMaterial(pugi::xml_node &mat_node, std::optional<cblt::MaterialVariant> &material);
+    bool ProcessMaterialMaps(pugi::xml_node &mat_node, cblt::Material &material);
+    bool LoadTexture(pugi::xml_node &tex_node, std::shared_ptr<cblt::Texture> &tex);
+    bool ParseMesh(pugi::xml_node &mesh_node, MeshArrays &arrays);
+    // triangles are allocated from arena, which must only be used by the calling thread
+    std::shared_ptr<cblt::Geometry> BuildMesh(const MeshArrays &arrays, const std::shared_ptr<cblt::MemoryArena> &arena);
     bool ProcessPrim(pugi::xml_node &elem_node);
-    bool ProcessLight(pugi::xml_node &light_node);
-    bool ProcessAreaLight(pugi::xml_node &light_node);
-    bool ProcessDirLight(pugi::xml_node &light_node);
+    bool ProcessLight(pugi::xml_node &light_node, std::shared_ptr<cblt::Light> &light);
+    bool ProcessAreaLight(pugi::xml_node &light_node, std::shared_ptr<cblt::Light> &light);
+    bool ProcessDirLight(pugi::xml_node &light_node, std::shared_ptr<cblt::Light> &light);
+    bool ProcessEnvLight(pugi::xml_node &light_node, std::shared_ptr<cblt::Light> &light);
+    // write a line to log_, if there is one, from any of the loading tasks
+    void Log(const std::string &message);
 
     cblt::Camera cam_;
-    std::unordered_map<std::string, std::shared_ptr<cblt::Material>> material_map_;
+    // triangles are packed into an arena per loading thread, each one keeps its arena alive for as long as the
+    // scene uses it
+    std::vector<std::shared_ptr<cblt::MemoryArena>> thread_arenas_;
+    std::shared_ptr<cblt::MaterialTable> materials_ = std::make_shared<cblt::MaterialTable>();
+    std::unordered_map<std::string, cblt::MaterialId> material_map_;
     std::unordered_map<std::string, std::shared_ptr<cblt::Geometry>> mesh_map_;
     std::vector<std::shared_ptr<cblt::Light>> lights_;
+    std::shared_ptr<cblt::TextureLibrary> textures_;
+    std::vector<std::string> dependencies_;
+    std::ostream *log_;
 };
 #endif  // SDESC_FILE_LOADER_H
\ No newline at end of file
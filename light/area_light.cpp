@@ -1,5 +1,7 @@
 #include "area_light.h"
 
+#include "mat/sampling_helpers.h"
+
 #include <algorithm>
 
 namespace cblt
@@ -25,14 +27,32 @@ namespace cblt
         Vec3 light_pos = pos_ + dir_X_ * x + dir_Z_ * z;
         // to light is un-normalized, 
         to_light = light_pos - surf_pos;
-        float len_sqr = MagnitudeSqr(to_light);
-        dist = std::sqrt(len_sqr);
+        dist = Magnitude(to_light);
         to_light = to_light / dist;
-        pdf = 1.f / area_;
-        return color_ * power_ * std::max(0.f, -Dot(to_light, dir_Y_)) / (len_sqr);
+        return Radiance(light_pos, surf_pos, surf_norm, pdf);
     }
 
-    bool AreaLight::Intersect(const Ray &ray, HitInfo &collision_pt)
+    Color AreaLight::SampleLe(Ray &ray, Vec3 &norm, float &pos_pdf, float &dir_pdf, const Vec3 &scene_cen, float scene_radius, std::shared_ptr<Sampler> &sampler)
+    {
+        float u, v;
+        sampler->Next2D(u, v);
+        Vec3 light_pos = pos_ + dir_X_ * (length_ * (u - .5f)) + dir_Z_ * (width_ * (v - .5f));
+        // the radiance is constant over the hemisphere, so cosine weighted directions carry equal power
+        sampler->Next2D(u, v);
+        Vec3 dir = RandomUnitVectorInCosineWeightedHemisphere(dir_X_, dir_Y_, dir_Z_, dir_pdf, u, v);
+        pos_pdf = 1.f / area_;
+        norm = dir_Y_;
+        ray = Ray(light_pos + dir * eps_zero_F, dir);
+        return color_ * power_;
+    }
+
+    void AreaLight::PdfLe(const Vec3 &light_pos, const Vec3 &dir, float scene_radius, float &pos_pdf, float &dir_pdf)
+    {
+        pos_pdf = 1.f / area_;
+        dir_pdf = std::max(0.f, Dot(dir, dir_Y_)) * INV_PI_f;
+    }
+
+    bool AreaLight::Intersect(const Ray &ray, HitRecord &collision_pt)
     {
         float dt = Dot(ray.dir, dir_Y_);
         if (std::abs(dt) < eps_zero_F)
@@ -43,9 +63,9 @@ namespace cblt
 
   	    float hit_t = Dot(pos_ - ray.pos, dir_Y_) / dt;
   	    
-        if (hit_t < eps_zero_F)
+        if (hit_t < eps_zero_F || hit_t >= collision_pt.hit_time)
         {
-  	        // only go forward in the direction
+  	        // only go forward in the direction, and only accept hits closer than the best one so far
   	        return false;
   	    }
 	
@@ -69,28 +89,54 @@ namespace cblt
         if (in)
         {
             collision_pt.hit_time = hit_t;
-            collision_pt.norm = dir_Y_;
-            collision_pt.pos = hit_pos;
         }
         return in;
     }
 
     BoundingBox AreaLight::GetBounds()
     {
-        Vec3 min_pt(-.5f * length_, 0.f, -.5f * width_), 
-             max_pt( .5f * length_, 0.f,  .5f * width_);
-        return BoundingBox(min_pt, max_pt);
+        // the corners of the quad in world space
+        Vec3 half_l = dir_X_ * (.5f * length_);
+        Vec3 half_w = dir_Z_ * (.5f * width_);
+        BoundingBox quad_bnds;
+        for (const Vec3 &corner : { pos_ - half_l - half_w, pos_ + half_l - half_w, pos_ + half_l + half_w, pos_ - half_l + half_w })
+        {
+            quad_bnds = quad_bnds.Union(BoundingBox(corner, corner));
+        }
+        quad_bnds.CalculateCenter();
+        return quad_bnds;
     }
 
     Color AreaLight::Radiance(const Vec3 &light_pos, const Vec3 &surf_pos, const Vec3 &surf_norm, float &pdf)
     {
         // Area lighting Integral from Sebastian Legarde "Moving Frostbite to PBR 3.0"
-        // We need to account for the distance attenuation when directly sampling the area light
+        // The distance attenuation is accounted for by the solid angle pdf when directly sampling the area light
         Vec3 to_light = light_pos - surf_pos;
         float length_sqr = MagnitudeSqr(to_light);
         // Normalize
         to_light = to_light / std::sqrt(length_sqr);
-        pdf = 1.f / area_;
-        return color_ * power_ * std::max(0.f, -Dot(to_light, dir_Y_)) / length_sqr;
+        float cos_light = -Dot(to_light, dir_Y_);
+        if (cos_light <= eps_zero_F)
+        {
+            // the surface is behind the light
+            pdf = 0.f;
+            return Color::GreyScale(0.f);
+        }
+        // convert the uniform area density into a solid angle density, so it can be
+        // weighed against BRDF samples
+        pdf = length_sqr / (cos_light * area_);
+        return color_ * power_;
+    }
+
+    bool AreaLight::GetLightBounds(LightBounds &bnds)
+    {
+        bnds.bnds_ = GetBounds();
+        // the quad emits a constant radiance over the hemisphere around Y
+        bnds.axis_ = dir_Y_;
+        bnds.phi_ = color_.Luminance() * power_ * area_ * PI_f;
+        bnds.cos_theta_o_ = 1.f;
+        bnds.cos_theta_e_ = 0.f;
+        bnds.two_sided_ = false;
+        return true;
     }
 }
\ No newline at end of file
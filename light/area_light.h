@@ -13,11 +13,16 @@ namespace cblt
 
         // since area lights have ... area ..., they are possible to
         // intersect during path tracing, so we must inherit from geometry
-        bool Intersect(const Ray &ray, HitInfo &collision_pt) override;
+        bool Intersect(const Ray &ray, HitRecord &collision_pt) override;
         BoundingBox GetBounds() override;
 
         Color Sample(Vec3 &to_light, const Vec3 &surf_pos, const Vec3 &surf_norm, float &dist, float &pdf, std::shared_ptr<Sampler> &sampler) override;
         Color Radiance(const Vec3 &light_pos, const Vec3 &surf_pos, const Vec3 &surf_norm, float &pdf) override;
+        Color SampleLe(Ray &ray, Vec3 &norm, float &pos_pdf, float &dir_pdf, const Vec3 &scene_cen, float scene_radius, std::shared_ptr<Sampler> &sampler) override;
+        void PdfLe(const Vec3 &light_pos, const Vec3 &dir, float scene_radius, float &pos_pdf, float &dir_pdf) override;
+        bool GetLightBounds(LightBounds &bnds) override;
+        // the side of the quad which emits light
+        Vec3 Normal(const Vec3 &light_pos) override { return dir_Y_; };
         private:
         
         // area light radiance info
@@ -54,8 +54,37 @@ namespace cblt
         return color_ * power_ / PI_f;
     }
 
+    Color DirectionLight::SampleLe(Ray &ray, Vec3 &norm, float &pos_pdf, float &dir_pdf, const Vec3 &scene_cen, float scene_radius, std::shared_ptr<Sampler> &sampler)
+    {
+        // parallel rays start from a disk which covers the scene, facing along the light's direction. The spread
+        // is ignored, it is narrow enough that every ray is treated as leaving along the light's direction
+        Vec3 tangent, bitangent;
+        OrthonormalBasis(dir_, tangent, bitangent);
+        float u, v;
+        sampler->Next2D(u, v);
+        Vec2 disk_sample = ConcentricPointOnUnitDisk(u, v) * scene_radius;
+        Vec3 origin = scene_cen - dir_ * scene_radius + tangent * disk_sample.x + bitangent * disk_sample.y;
+        ray = Ray(origin, dir_);
+        norm = dir_;
+        pos_pdf = 1.f / (PI_f * scene_radius * scene_radius);
+        dir_pdf = 1.f;
+        return color_ * power_;
+    }
+
+    void DirectionLight::PdfLe(const Vec3 &light_pos, const Vec3 &dir, float scene_radius, float &pos_pdf, float &dir_pdf)
+    {
+        pos_pdf = 1.f / (PI_f * scene_radius * scene_radius);
+        // only the dirac delta direction is ever emitted
+        dir_pdf = 0.f;
+    }
+
     bool DirectionLight::isDiracDelta()
     {
         return true;
     }
+
+    bool DirectionLight::isInfinite()
+    {
+        return true;
+    }
 }
\ No newline at end of file
@@ -11,7 +11,10 @@ namespace cblt
         DirectionLight(Vec3 &dir, Color &clr, float pwr, float anglular_spread = 0.f);
         Color Sample(Vec3 &to_light, const Vec3 &surf_pos, const Vec3 &surf_norm, float &dist, float &pdf, std::shared_ptr<Sampler> &sampler) override;
         Color Radiance(const Vec3 &light_pos, const Vec3 &surf_pos, const Vec3 &surf_norm, float &pdf) override;
+        Color SampleLe(Ray &ray, Vec3 &norm, float &pos_pdf, float &dir_pdf, const Vec3 &scene_cen, float scene_radius, std::shared_ptr<Sampler> &sampler) override;
+        void PdfLe(const Vec3 &light_pos, const Vec3 &dir, float scene_radius, float &pos_pdf, float &dir_pdf) override;
         bool isDiracDelta() override;
+        bool isInfinite() override;
         private:
         Color color_;
         Vec3 dir_;
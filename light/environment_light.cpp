@@ -0,0 +1,121 @@
+#include "environment_light.h"
+
+#include "math/constants.h"
+
+#include "mat/sampling_helpers.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cblt
+{
+    EnvironmentLight::EnvironmentLight(const std::string &file_name, float power) : power_(power)
+    {
+        int num_components;
+        float *data = stbi_loadf(file_name.c_str(), &width_, &height_, &num_components, 3);
+        if (data == nullptr)
+        {
+            // keep a single black texel so lookups are still well defined
+            width_ = height_ = 1;
+            pixels_.assign(1, Color::GreyScale(0.f));
+        }
+        else
+        {
+            valid_ = true;
+            pixels_.resize(static_cast<size_t>(width_) * height_);
+            for (size_t i = 0; i < pixels_.size(); ++i)
+            {
+                pixels_[i] = Color(data[3 * i], data[3 * i + 1], data[3 * i + 2]);
+            }
+            stbi_image_free(data);
+        }
+
+        // build the sampling distribution, rows near the poles cover less solid angle so they are scaled down
+        std::vector<float> func(pixels_.size());
+        for (int y = 0; y < height_; ++y)
+        {
+            float sin_theta = std::sin(PI_f * (y + .5f) / height_);
+            for (int x = 0; x < width_; ++x)
+            {
+                func[y * width_ + x] = pixels_[y * width_ + x].Luminance() * sin_theta;
+            }
+        }
+        distrib_ = Distribution2D(func.data(), width_, height_);
+    }
+
+    Color EnvironmentLight::Sample(Vec3 &to_light, const Vec3 &surf_pos, const Vec3 &surf_norm, float &dist, float &pdf, std::shared_ptr<Sampler> &sampler)
+    {
+        float u, v;
+        sampler->Next2D(u, v);
+
+        float map_pdf;
+        Vec2 uv = distrib_.SampleContinuous(u, v, map_pdf);
+
+        float theta = uv.y * PI_f;
+        float phi = uv.x * 2.f * PI_f;
+        float sin_theta = std::sin(theta);
+        to_light = Vec3(sin_theta * std::cos(phi), std::cos(theta), sin_theta * std::sin(phi));
+        dist = inf_F;
+        if (map_pdf <= 0.f || sin_theta <= 0.f)
+        {
+            pdf = 0.f;
+            return Color::GreyScale(0.f);
+        }
+        // change of variables from the image to the sphere of directions
+        pdf = map_pdf / (2.f * PI_f * PI_f * sin_theta);
+        return Lookup(uv);
+    }
+
+    Color EnvironmentLight::Radiance(const Vec3 &light_pos, const Vec3 &surf_pos, const Vec3 &surf_norm, float &pdf)
+    {
+        return Le(Normalize(light_pos - surf_pos), pdf);
+    }
+
+    Color EnvironmentLight::SampleLe(Ray &ray, Vec3 &norm, float &pos_pdf, float &dir_pdf, const Vec3 &scene_cen, float scene_radius, std::shared_ptr<Sampler> &sampler)
+    {
+        // choose the direction the light arrives from as for direct lighting, then start the ray on a disk which
+        // covers the scene from that side
+        Vec3 to_light;
+        float dist;
+        Color radiance = Sample(to_light, scene_cen, Y_axis_F, dist, dir_pdf, sampler);
+        Vec3 tangent, bitangent;
+        OrthonormalBasis(to_light, tangent, bitangent);
+        float u, v;
+        sampler->Next2D(u, v);
+        Vec2 disk_sample = ConcentricPointOnUnitDisk(u, v) * scene_radius;
+        Vec3 origin = scene_cen + to_light * scene_radius + tangent * disk_sample.x + bitangent * disk_sample.y;
+        ray = Ray(origin, -to_light);
+        norm = -to_light;
+        pos_pdf = 1.f / (PI_f * scene_radius * scene_radius);
+        return radiance;
+    }
+
+    void EnvironmentLight::PdfLe(const Vec3 &light_pos, const Vec3 &dir, float scene_radius, float &pos_pdf, float &dir_pdf)
+    {
+        pos_pdf = 1.f / (PI_f * scene_radius * scene_radius);
+        Le(-dir, dir_pdf);
+    }
+
+    Color EnvironmentLight::Le(const Vec3 &dir, float &pdf) const
+    {
+        float theta = std::acos(std::max(-1.f, std::min(dir.y, 1.f)));
+        float phi = std::atan2(dir.z, dir.x);
+        if (phi < 0.f)
+        {
+            phi += 2.f * PI_f;
+        }
+        Vec2 uv(phi / (2.f * PI_f), theta / PI_f);
+
+        float sin_theta = std::sin(theta);
+        pdf = (sin_theta > 0.f) ? distrib_.Pdf(uv) / (2.f * PI_f * PI_f * sin_theta) : 0.f;
+        return Lookup(uv);
+    }
+
+    Color EnvironmentLight::Lookup(const Vec2 &uv) const
+    {
+        // nearest texel, which keeps the radiance consistent with the piecewise constant sampling density
+        int x = std::max(0, std::min(static_cast<int>(uv.x * width_), width_ - 1));
+        int y = std::max(0, std::min(static_cast<int>(uv.y * height_), height_ - 1));
+        return pixels_[y * width_ + x] * power_;
+    }
+}
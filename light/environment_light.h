@@ -0,0 +1,45 @@
+#ifndef CBLT_ENVIRONMENT_LIGHT_H
+#define CBLT_ENVIRONMENT_LIGHT_H
+
+#include "light.h"
+
+#include "mat/distribution.h"
+
+#include <string>
+#include <vector>
+
+namespace cblt
+{
+    /**
+     * @brief An infinitely distant light which surrounds the scene, with radiance read from a high dynamic range
+     * image in equirectangular (latitude-longitude) layout. The top row of the image maps to the +Y axis.
+     * Directions are importance sampled proportionally to the luminance of the map, so small bright features
+     * like the sun are found without needing many samples.
+     */
+    class EnvironmentLight : public Light
+    {
+        public:
+        EnvironmentLight(const std::string &file_name, float power = 1.f);
+        Color Sample(Vec3 &to_light, const Vec3 &surf_pos, const Vec3 &surf_norm, float &dist, float &pdf, std::shared_ptr<Sampler> &sampler) override;
+        Color Radiance(const Vec3 &light_pos, const Vec3 &surf_pos, const Vec3 &surf_norm, float &pdf) override;
+        Color SampleLe(Ray &ray, Vec3 &norm, float &pos_pdf, float &dir_pdf, const Vec3 &scene_cen, float scene_radius, std::shared_ptr<Sampler> &sampler) override;
+        void PdfLe(const Vec3 &light_pos, const Vec3 &dir, float scene_radius, float &pos_pdf, float &dir_pdf) override;
+        bool isInfinite() override { return true; };
+        // radiance arriving along the direction dir, pdf is the solid angle density of sampling dir
+        Color Le(const Vec3 &dir, float &pdf) const;
+        // false if the image could not be loaded, in which case the light emits nothing
+        bool Valid() const { return valid_; };
+        private:
+        Color Lookup(const Vec2 &uv) const;
+
+        std::vector<Color> pixels_;  //! linear radiance, stored row major
+        int width_ = 1;
+        int height_ = 1;
+        float power_;
+        bool valid_ = false;
+
+        Distribution2D distrib_;  //! luminance weighted by sin(theta), to account for the stretching near the poles
+    };
+}
+
+#endif  // CBLT_ENVIRONMENT_LIGHT_H
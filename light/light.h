@@ -2,11 +2,13 @@
 #define CBLT_LIGHT_H
 
 #include "math/vec.h"
+#include "light_bounds.h"
 
 #include "mat/sampler.h"
 #include "mat/image_lib.h"
 
 #include "geom/hit_info.h"
+#include "geom/ray.h"
 
 namespace cblt
 {
@@ -16,12 +18,42 @@ namespace cblt
         // obtain a random point on the light's surface OR a light direction vector (depending on the light type)
         virtual Color Sample(Vec3 &to_light, const Vec3 &surf_pos, const Vec3 &surf_norm, float &dist, float &pdf, std::shared_ptr<Sampler> &sampler) = 0;
         virtual Color Radiance(const Vec3 &light_pos, const Vec3 &surf_pos, const Vec3 &surf_norm, float &pdf) = 0;
+        // emit a ray from the light, for integrators which also trace paths starting at the lights. pos_pdf is the
+        // area density of the ray's origin & dir_pdf the solid angle density of its direction. norm is the surface
+        // normal at the origin, or the ray direction for lights at infinity, which emit from a disk covering the
+        // scene's bounding sphere. Returns black with zero densities if the light can't emit rays
+        virtual Color SampleLe(Ray &ray, Vec3 &norm, float &pos_pdf, float &dir_pdf, const Vec3 &scene_cen, float scene_radius, std::shared_ptr<Sampler> &sampler)
+        {
+            pos_pdf = dir_pdf = 0.f;
+            return Color::GreyScale(0.f);
+        }
+        // the densities with which SampleLe() would have emitted a ray from light_pos along dir
+        virtual void PdfLe(const Vec3 &light_pos, const Vec3 &dir, float scene_radius, float &pos_pdf, float &dir_pdf)
+        {
+            pos_pdf = dir_pdf = 0.f;
+        }
+        // surface normal at a point on the light, lights without a surface have none
+        virtual Vec3 Normal(const Vec3 &light_pos)
+        {
+            return Vec3(0.f, 0.f, 0.f);
+        }
+        // lights at infinity have no position, so paths reach them by direction only
+        virtual bool isInfinite()
+        {
+            return false;
+        }
         // I want to add support for directional lights in addition to area lights, so
         // we will need to take care when integrating over the light source (and sample)
         virtual bool isDiracDelta()
         {
             return false;
         }
+        // spatial & directional bounds used for many-light sampling, returns false if the light
+        // has no finite extent (i.e. directional lights)
+        virtual bool GetLightBounds(LightBounds &bnds)
+        {
+            return false;
+        }
     };
 }
 
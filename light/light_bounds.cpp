@@ -0,0 +1,146 @@
+#include "light_bounds.h"
+
+#include "math/math_helpers.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cblt
+{
+    namespace
+    {
+        inline float SafeSqrt(float x)
+        {
+            return std::sqrt(std::max(0.f, x));
+        }
+
+        inline float SafeACos(float x)
+        {
+            return std::acos(std::min(1.f, std::max(-1.f, x)));
+        }
+
+        // cos(theta_a - theta_b), clamped to 1 when theta_a < theta_b
+        inline float CosSubClamped(float sin_a, float cos_a, float sin_b, float cos_b)
+        {
+            if (cos_a > cos_b)
+            {
+                return 1.f;
+            }
+            return cos_a * cos_b + sin_a * sin_b;
+        }
+
+        // sin(theta_a - theta_b), clamped to 0 when theta_a < theta_b
+        inline float SinSubClamped(float sin_a, float cos_a, float sin_b, float cos_b)
+        {
+            if (cos_a > cos_b)
+            {
+                return 0.f;
+            }
+            return sin_a * cos_b - cos_a * sin_b;
+        }
+
+        // rotate vec about the unit length axis by theta radians (Rodrigues' rotation formula)
+        inline Vec3 RotateAbout(const Vec3 &vec, const Vec3 &axis, float theta)
+        {
+            float cos_t = std::cos(theta), sin_t = std::sin(theta);
+            return vec * cos_t + Cross(axis, vec) * sin_t + axis * (Dot(axis, vec) * (1.f - cos_t));
+        }
+    }
+
+    float LightBounds::Importance(const Vec3 &pos, const Vec3 &norm) const
+    {
+        Vec3 center = (bnds_.min_ + bnds_.max_) * .5f;
+        Vec3 to_pos = pos - center;
+        // clamp the distance to the size of the bounds so that points inside the
+        // cluster don't blow up the estimate
+        float dist_sqr = std::max(MagnitudeSqr(to_pos), .5f * Magnitude(bnds_.max_ - bnds_.min_));
+        // the angles below need the true direction, which the clamped distance no longer normalizes. A point at
+        // the very center is taken to lie along the axis
+        float dist = Magnitude(to_pos);
+        Vec3 dir = (dist > 0.f) ? to_pos * (1.f / dist) : axis_;
+
+        // angle between the emission axis and the direction towards the shading point
+        float cos_theta_w = Dot(dir, axis_);
+        if (two_sided_)
+        {
+            cos_theta_w = std::abs(cos_theta_w);
+        }
+        float sin_theta_w = SafeSqrt(1.f - sqr(cos_theta_w));
+
+        // angle subtended by the bounding sphere of the cluster, as seen from the shading point
+        float radius_sqr = .25f * MagnitudeSqr(bnds_.max_ - bnds_.min_);
+        float cos_theta_b = (MagnitudeSqr(to_pos) < radius_sqr) ? -1.f : SafeSqrt(1.f - radius_sqr / MagnitudeSqr(to_pos));
+        float sin_theta_b = SafeSqrt(1.f - sqr(cos_theta_b));
+
+        // find the minimum angle between the emission cone and the shading point
+        float sin_theta_o = SafeSqrt(1.f - sqr(cos_theta_o_));
+        float cos_theta_x = CosSubClamped(sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o_);
+        float sin_theta_x = SinSubClamped(sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o_);
+        float cos_theta_p = CosSubClamped(sin_theta_x, cos_theta_x, sin_theta_b, cos_theta_b);
+        if (cos_theta_p <= cos_theta_e_)
+        {
+            // the shading point is outside of the emission cone
+            return 0.f;
+        }
+
+        float importance = phi_ * cos_theta_p / dist_sqr;
+
+        // account for the incident angle at the shading point
+        if (MagnitudeSqr(norm) > 0.f)
+        {
+            float cos_theta_i = std::abs(Dot(dir, norm));
+            float sin_theta_i = SafeSqrt(1.f - sqr(cos_theta_i));
+            importance *= CosSubClamped(sin_theta_i, cos_theta_i, sin_theta_b, cos_theta_b);
+        }
+        return std::max(0.f, importance);
+    }
+
+    LightBounds LightBounds::Union(const LightBounds &other) const
+    {
+        if (phi_ == 0.f)
+        {
+            return other;
+        }
+        if (other.phi_ == 0.f)
+        {
+            return *this;
+        }
+
+        LightBounds uni;
+        uni.bnds_ = bnds_.Union(other.bnds_);
+        uni.bnds_.CalculateCenter();
+        uni.phi_ = phi_ + other.phi_;
+        uni.cos_theta_e_ = std::min(cos_theta_e_, other.cos_theta_e_);
+        uni.two_sided_ = two_sided_ || other.two_sided_;
+
+        // merge the two normal cones into the smallest cone which contains both
+        float theta_a = SafeACos(cos_theta_o_);
+        float theta_b = SafeACos(other.cos_theta_o_);
+        float theta_d = SafeACos(Dot(axis_, other.axis_));
+        if (std::min(theta_d + theta_b, PI_f) <= theta_a)
+        {
+            uni.axis_ = axis_;
+            uni.cos_theta_o_ = cos_theta_o_;
+            return uni;
+        }
+        if (std::min(theta_d + theta_a, PI_f) <= theta_b)
+        {
+            uni.axis_ = other.axis_;
+            uni.cos_theta_o_ = other.cos_theta_o_;
+            return uni;
+        }
+
+        float theta_o = .5f * (theta_a + theta_d + theta_b);
+        Vec3 rot_axis = Cross(axis_, other.axis_);
+        if (theta_o >= PI_f || MagnitudeSqr(rot_axis) < eps_zero_F)
+        {
+            // the cone covers the entire sphere of directions
+            uni.axis_ = axis_;
+            uni.cos_theta_o_ = -1.f;
+            return uni;
+        }
+        uni.axis_ = Normalize(RotateAbout(axis_, Normalize(rot_axis), theta_o - theta_a));
+        uni.cos_theta_o_ = std::cos(theta_o);
+        return uni;
+    }
+}
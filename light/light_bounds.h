@@ -0,0 +1,29 @@
+#ifndef CBLT_LIGHT_BOUNDS_H
+#define CBLT_LIGHT_BOUNDS_H
+
+#include "math/vec.h"
+#include "math/constants.h"
+#include "geom/bounding_box.h"
+
+namespace cblt
+{
+    /**
+     * @brief Conservative spatial and directional bounds of an emitter (or a cluster of emitters).
+     * The light BVH uses these to estimate how much light could reach a shading point, following
+     * "Importance Sampling of Many Lights with Adaptive Tree Splitting" by Conty Estevez & Kulla.
+     */
+    struct LightBounds
+    {
+        BoundingBox bnds_;  //! world space bounds of the emitting surface
+        Vec3 axis_ = Y_axis_F;  //! principal direction of emission
+        float phi_ = 0.f;  //! emitted power (luminance)
+        float cos_theta_o_ = 1.f;  //! cosine of the angle which bounds the surface normals around the axis
+        float cos_theta_e_ = 0.f;  //! cosine of the angle past theta_o at which emission falls to zero
+        bool two_sided_ = false;  //! whether the emitter radiates from both sides of its surface
+
+        float Importance(const Vec3 &pos, const Vec3 &norm) const;
+        LightBounds Union(const LightBounds &other) const;
+    };
+}
+
+#endif  // CBLT_LIGHT_BOUNDS_H
@@ -0,0 +1,233 @@
+#include "light_bvh.h"
+
+#include <algorithm>
+#include <array>
+
+namespace cblt
+{
+    LightBVH::LightBVH(const std::vector<std::shared_ptr<Light>> &lights)
+    {
+        std::vector<LightInfo> lights_info;
+        light_to_node_.assign(lights.size(), -1);
+        for (int i = 0; i < static_cast<int>(lights.size()); ++i)
+        {
+            LightBounds bnds;
+            if (!lights[i]->GetLightBounds(bnds))
+            {
+                infinite_lights_.push_back(i);
+            }
+            else if (bnds.phi_ > 0.f)
+            {
+                LightInfo info;
+                info.bnds_ = bnds;
+                info.cen_ = (bnds.bnds_.min_ + bnds.bnds_.max_) * .5f;
+                info.light_idx_ = i;
+                lights_info.push_back(info);
+            }
+        }
+
+        if (!lights_info.empty())
+        {
+            tree_.reserve(2 * lights_info.size());
+            tree_.emplace_back();
+            BuildRecurse(0, lights_info.begin(), lights_info.end());
+        }
+
+        // give every infinite light the same chance as the entire tree
+        int num_strategies = static_cast<int>(infinite_lights_.size()) + (tree_.empty() ? 0 : 1);
+        infinite_pmf_ = (num_strategies > 0) ? static_cast<float>(infinite_lights_.size()) / num_strategies : 0.f;
+    }
+
+    void LightBVH::BuildRecurse(int node_offset, LightIter light_start, LightIter light_end)
+    {
+        if (std::distance(light_start, light_end) == 1)
+        {
+            tree_[node_offset].bnds_ = light_start->bnds_;
+            tree_[node_offset].light_idx_ = light_start->light_idx_;
+            light_to_node_[light_start->light_idx_] = node_offset;
+            return;
+        }
+
+        LightIter light_mid = Split(light_start, light_end);
+
+        // create left child
+        tree_.emplace_back();
+        int l_offset = node_offset + 1;
+        tree_[l_offset].parent_ = node_offset;
+        BuildRecurse(l_offset, light_start, light_mid);
+
+        // create right child
+        tree_.emplace_back();
+        int r_offset = static_cast<int>(tree_.size()) - 1;
+        tree_[r_offset].parent_ = node_offset;
+        tree_[node_offset].r_child_ = r_offset;
+        BuildRecurse(r_offset, light_mid, light_end);
+
+        tree_[node_offset].bnds_ = tree_[l_offset].bnds_.Union(tree_[r_offset].bnds_);
+    }
+
+    LightBVH::LightIter LightBVH::Split(LightIter light_start, LightIter light_end)
+    {
+        BoundingBox centroid_bnds;
+        for (LightIter iter = light_start; iter != light_end; ++iter)
+        {
+            centroid_bnds = centroid_bnds.Union(BoundingBox(iter->cen_, iter->cen_));
+        }
+        Vec3 range = centroid_bnds.max_ - centroid_bnds.min_;
+        int axis = 0;
+        for (int i = 1; i < 3; ++i)
+        {
+            if (range.xyz[i] > range.xyz[axis])
+            {
+                axis = i;
+            }
+        }
+
+        if (range.xyz[axis] > eps_zero_F)
+        {
+            // bin the lights along the major axis and evaluate a power weighted surface area cost
+            const int num_bins = 12;
+            std::array<LightBounds, num_bins> bins;
+            auto bin_index = [&](const LightInfo &info) {
+                float normalized_position = (info.cen_.xyz[axis] - centroid_bnds.min_.xyz[axis]) / range.xyz[axis];
+                return std::min(static_cast<int>(num_bins * normalized_position), num_bins - 1);
+            };
+            for (LightIter iter = light_start; iter != light_end; ++iter)
+            {
+                int idx = bin_index(*iter);
+                bins[idx] = bins[idx].Union(iter->bnds_);
+            }
+
+            float min_cost = inf_F;
+            int min_split = -1;
+            for (int i = 0; i < num_bins - 1; ++i)
+            {
+                LightBounds bound1, bound2;
+                for (int j = 0; j <= i; ++j)
+                {
+                    bound1 = bound1.Union(bins[j]);
+                }
+                for (int j = i + 1; j < num_bins; ++j)
+                {
+                    bound2 = bound2.Union(bins[j]);
+                }
+                if (bound1.phi_ == 0.f || bound2.phi_ == 0.f)
+                {
+                    continue;
+                }
+                float cost = bound1.phi_ * bound1.bnds_.SurfaceArea() + bound2.phi_ * bound2.bnds_.SurfaceArea();
+                if (cost < min_cost)
+                {
+                    min_cost = cost;
+                    min_split = i;
+                }
+            }
+
+            if (min_split != -1)
+            {
+                LightIter light_mid = std::partition(light_start, light_end, [&](const LightInfo &info) {
+                    return bin_index(info) <= min_split;
+                });
+                if (light_mid != light_start && light_mid != light_end)
+                {
+                    return light_mid;
+                }
+            }
+        }
+
+        // the lights are (nearly) coincident, so just split them in half
+        LightIter light_mid = std::next(light_start, std::distance(light_start, light_end) / 2);
+        std::nth_element(light_start, light_mid, light_end, [axis](const LightInfo &a, const LightInfo &b) {
+            return a.cen_.xyz[axis] < b.cen_.xyz[axis];
+        });
+        return light_mid;
+    }
+
+    int LightBVH::Sample(const Vec3 &pos, const Vec3 &norm, float u, float &pmf) const
+    {
+        pmf = 0.f;
+        if (u < infinite_pmf_)
+        {
+            // choose one of the infinite lights uniformly
+            int num_infinite = static_cast<int>(infinite_lights_.size());
+            int idx = std::min(static_cast<int>(u / infinite_pmf_ * num_infinite), num_infinite - 1);
+            pmf = infinite_pmf_ / num_infinite;
+            return infinite_lights_[idx];
+        }
+        if (tree_.empty())
+        {
+            return -1;
+        }
+
+        // reuse the random number while traversing the tree
+        u = std::min((u - infinite_pmf_) / (1.f - infinite_pmf_), 1.f - eps_zero_F);
+        pmf = 1.f - infinite_pmf_;
+        int node_idx = 0;
+        while (tree_[node_idx].light_idx_ == -1)
+        {
+            int l_child = node_idx + 1;
+            int r_child = tree_[node_idx].r_child_;
+            float l_importance = tree_[l_child].bnds_.Importance(pos, norm);
+            float r_importance = tree_[r_child].bnds_.Importance(pos, norm);
+            if (l_importance + r_importance <= 0.f)
+            {
+                pmf = 0.f;
+                return -1;
+            }
+
+            float l_prob = l_importance / (l_importance + r_importance);
+            if (u < l_prob)
+            {
+                node_idx = l_child;
+                u = std::min(u / l_prob, 1.f - eps_zero_F);
+                pmf *= l_prob;
+            }
+            else
+            {
+                node_idx = r_child;
+                u = std::min((u - l_prob) / (1.f - l_prob), 1.f - eps_zero_F);
+                pmf *= 1.f - l_prob;
+            }
+        }
+
+        if (node_idx == 0 && tree_[0].bnds_.Importance(pos, norm) <= 0.f)
+        {
+            // a single light in the tree, which can't illuminate this point
+            pmf = 0.f;
+            return -1;
+        }
+        return tree_[node_idx].light_idx_;
+    }
+
+    float LightBVH::Pmf(const Vec3 &pos, const Vec3 &norm, int light_idx) const
+    {
+        if (light_idx < 0 || light_idx >= static_cast<int>(light_to_node_.size()))
+        {
+            return 0.f;
+        }
+
+        int node_idx = light_to_node_[light_idx];
+        if (node_idx == -1)
+        {
+            bool infinite = std::find(infinite_lights_.begin(), infinite_lights_.end(), light_idx) != infinite_lights_.end();
+            return infinite ? infinite_pmf_ / infinite_lights_.size() : 0.f;
+        }
+
+        // walk back up the tree, accumulating the probability of each decision
+        float pmf = 1.f - infinite_pmf_;
+        while (tree_[node_idx].parent_ != -1)
+        {
+            int parent = tree_[node_idx].parent_;
+            int sibling = (node_idx == parent + 1) ? tree_[parent].r_child_ : parent + 1;
+            float importance = tree_[node_idx].bnds_.Importance(pos, norm);
+            float sibling_importance = tree_[sibling].bnds_.Importance(pos, norm);
+            if (importance <= 0.f)
+            {
+                return 0.f;
+            }
+            pmf *= importance / (importance + sibling_importance);
+            node_idx = parent;
+        }
+        return pmf;
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef CBLT_LIGHT_BVH_H
+#define CBLT_LIGHT_BVH_H
+
+#include "light.h"
+#include "light_bounds.h"
+
+#include <memory>
+#include <vector>
+
+namespace cblt
+{
+    /**
+     * @brief A bounding volume heirarchy over the emitters in the scene, used to choose a single light
+     * proportionally to its estimated contribution at a shading point. Lights without finite bounds
+     * (directional, environment) are kept out of the tree and chosen uniformly.
+     */
+    class LightBVH
+    {
+        public:
+        LightBVH() {};
+        LightBVH(const std::vector<std::shared_ptr<Light>> &lights);
+        // choose a light for the shading point, returns the index of the light or -1 if no light can contribute
+        int Sample(const Vec3 &pos, const Vec3 &norm, float u, float &pmf) const;
+        // probability that Sample() chooses the light at light_idx for the shading point
+        float Pmf(const Vec3 &pos, const Vec3 &norm, int light_idx) const;
+
+        private:
+        struct LightNode {
+            LightBounds bnds_;  //! bounds of all emitters beneath this node
+            int r_child_ = -1;  //! integer offset to right child node, the left child is always the next node
+            int parent_ = -1;  //! integer offset to the parent node
+            int light_idx_ = -1;  //! index of the light if this node is a leaf
+        };
+
+        struct LightInfo {
+            LightBounds bnds_;  //! bounds of the light
+            Vec3 cen_;  //! center of the light bounds, used for splitting
+            int light_idx_;  //! index of the light in the scene's light collection
+        };
+
+        using LightIter = std::vector<LightInfo>::iterator;
+
+        std::vector<LightNode> tree_;
+        std::vector<int> infinite_lights_;  //! lights without bounds, which are sampled uniformly
+        std::vector<int> light_to_node_;  //! leaf node for each bounded light, or -1 for infinite lights
+        float infinite_pmf_ = 0.f;  //! probability of choosing one of the infinite lights instead of the tree
+
+        void BuildRecurse(int node_offset, LightIter light_start, LightIter light_end);
+        LightIter Split(LightIter light_start, LightIter light_end);
+    };
+}
+
+#endif  // CBLT_LIGHT_BVH_H
@@ -0,0 +1,96 @@
+#include "triangle_light.h"
+
+#include "math/constants.h"
+
+#include "mat/sampling_helpers.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cblt
+{
+    TriangleLight::TriangleLight(const Vec3 &p1, const Vec3 &p2, const Vec3 &p3, const Color &emission) :
+        pos1_(p1), pos2_(p2), pos3_(p3), emission_(emission)
+    {
+        norm_ = Cross(pos3_ - pos1_, pos2_ - pos1_);
+        area_ = .5f * Magnitude(norm_);
+        norm_ = Normalize(norm_);
+    }
+
+    Color TriangleLight::Sample(Vec3 &to_light, const Vec3 &surf_pos, const Vec3 &surf_norm, float &dist, float &pdf, std::shared_ptr<Sampler> &sampler)
+    {
+        float u, v;
+        sampler->Next2D(u, v);
+        // uniformly sample the triangle's barycentric coordinates
+        float sqrt_u = std::sqrt(u);
+        float b1 = 1.f - sqrt_u;
+        float b2 = v * sqrt_u;
+        Vec3 light_pos = pos1_ * b1 + pos2_ * b2 + pos3_ * (1.f - b1 - b2);
+
+        to_light = light_pos - surf_pos;
+        dist = Magnitude(to_light);
+        to_light = to_light / dist;
+        return Radiance(light_pos, surf_pos, surf_norm, pdf);
+    }
+
+    Color TriangleLight::Radiance(const Vec3 &light_pos, const Vec3 &surf_pos, const Vec3 &surf_norm, float &pdf)
+    {
+        Vec3 to_light = light_pos - surf_pos;
+        float len_sqr = MagnitudeSqr(to_light);
+        float cos_light = AbsDot(norm_, to_light) / std::sqrt(len_sqr);
+        if (len_sqr <= 0.f || cos_light <= eps_zero_F)
+        {
+            pdf = 0.f;
+            return Color::GreyScale(0.f);
+        }
+        // convert the uniform area density into a solid angle density
+        pdf = len_sqr / (cos_light * area_);
+        return emission_;
+    }
+
+    Color TriangleLight::SampleLe(Ray &ray, Vec3 &norm, float &pos_pdf, float &dir_pdf, const Vec3 &scene_cen, float scene_radius, std::shared_ptr<Sampler> &sampler)
+    {
+        float u, v;
+        sampler->Next2D(u, v);
+        float sqrt_u = std::sqrt(u);
+        float b1 = 1.f - sqrt_u;
+        float b2 = v * sqrt_u;
+        Vec3 light_pos = pos1_ * b1 + pos2_ * b2 + pos3_ * (1.f - b1 - b2);
+
+        // pick either face with a sample of its own, then a cosine weighted direction about it. Each face is picked
+        // half the time, which halves the direction's pdf
+        float side;
+        sampler->Next1D(side);
+        norm = (side < .5f) ? norm_ : -norm_;
+        Vec3 tangent, bitangent;
+        OrthonormalBasis(norm, bitangent, tangent);
+        sampler->Next2D(u, v);
+        Vec3 dir = RandomUnitVectorInCosineWeightedHemisphere(bitangent, norm, tangent, dir_pdf, u, v);
+        dir_pdf *= .5f;
+        pos_pdf = 1.f / area_;
+        ray = Ray(light_pos + dir * eps_zero_F, dir);
+        return emission_;
+    }
+
+    void TriangleLight::PdfLe(const Vec3 &light_pos, const Vec3 &dir, float scene_radius, float &pos_pdf, float &dir_pdf)
+    {
+        pos_pdf = 1.f / area_;
+        dir_pdf = .5f * AbsDot(dir, norm_) * INV_PI_f;
+    }
+
+    bool TriangleLight::GetLightBounds(LightBounds &bnds)
+    {
+        std::pair<float, float> x_rng = std::minmax( {pos1_.x, pos2_.x, pos3_.x} );
+        std::pair<float, float> y_rng = std::minmax( {pos1_.y, pos2_.y, pos3_.y} );
+        std::pair<float, float> z_rng = std::minmax( {pos1_.z, pos2_.z, pos3_.z} );
+
+        bnds.bnds_ = BoundingBox(Vec3(x_rng.first, y_rng.first, z_rng.first), Vec3(x_rng.second, y_rng.second, z_rng.second));
+        bnds.axis_ = norm_;
+        // the power is proportional to the area, so larger triangles are chosen more often
+        bnds.phi_ = 2.f * emission_.Luminance() * area_ * PI_f;
+        bnds.cos_theta_o_ = 1.f;
+        bnds.cos_theta_e_ = 0.f;
+        bnds.two_sided_ = true;
+        return true;
+    }
+}
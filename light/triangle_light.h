@@ -0,0 +1,36 @@
+#ifndef CBLT_TRIANGLE_LIGHT_H
+#define CBLT_TRIANGLE_LIGHT_H
+
+#include "light.h"
+
+namespace cblt
+{
+    /**
+     * @brief A single world space triangle of an emissive mesh. These are created automatically by the scene
+     * for every instance of a mesh whose materials have a non-zero emittance. Unlike the area light, the
+     * triangle is part of the scene geometry, so the BRDF sampling half of MIS is handled by the integrator
+     * when a path hits the emitter.
+     */
+    class TriangleLight : public Light
+    {
+        public:
+        TriangleLight(const Vec3 &p1, const Vec3 &p2, const Vec3 &p3, const Color &emission);
+        Color Sample(Vec3 &to_light, const Vec3 &surf_pos, const Vec3 &surf_norm, float &dist, float &pdf, std::shared_ptr<Sampler> &sampler) override;
+        Color Radiance(const Vec3 &light_pos, const Vec3 &surf_pos, const Vec3 &surf_norm, float &pdf) override;
+        Color SampleLe(Ray &ray, Vec3 &norm, float &pos_pdf, float &dir_pdf, const Vec3 &scene_cen, float scene_radius, std::shared_ptr<Sampler> &sampler) override;
+        void PdfLe(const Vec3 &light_pos, const Vec3 &dir, float scene_radius, float &pos_pdf, float &dir_pdf) override;
+        bool GetLightBounds(LightBounds &bnds) override;
+        Vec3 Normal(const Vec3 &light_pos) override { return norm_; };
+        private:
+        // position attributes
+        Vec3 pos1_;
+        Vec3 pos2_;
+        Vec3 pos3_;
+        Vec3 norm_;
+        float area_;
+
+        Color emission_;  //! emitted radiance, the triangle emits from both faces
+    };
+}
+
+#endif  // CBLT_TRIANGLE_LIGHT_H
@@ -14,19 +14,25 @@
 namespace cblt
 {
     CookTorrenceMaterial::CookTorrenceMaterial(Color albedo, Color specular, Color emissive, float ior, float rough, float metal) : 
-    albedo_(albedo), specular_(specular), emissive_(emissive), ior_(ior), roughness_(rough), metalness_(metal)
+    albedo_(albedo), specular_(specular), emissive_(emissive), roughness_(rough), metalness_(metal)
     {
+        ior_ = ior;
     }
 
-    Color CookTorrenceMaterial::Sample(const Vec3 &outgoing, Vec3 &incoming, float &pdf, const HitInfo &collisionPt, std::shared_ptr<Sampler> &BRDF_sampler)
+    void CookTorrenceMaterial::EvaluateTextures(HitInfo &collision_pt) const
+    {
+        EvaluateParams(collision_pt, albedo_, roughness_, metalness_);
+    }
+
+    Color CookTorrenceMaterial::Sample(const Vec3 &outgoing, Vec3 &incoming, float &pdf, const HitInfo &collisionPt, std::shared_ptr<Sampler> &BRDF_sampler) const
     {
         // Illuminate using Cook-Torence reflectance model
         // First, determine which BRDF we need to use for this ray
         float x;
         BRDF_sampler->Next1D(x);
         float tot_luminance = 1.f;
-        float percent_diffuse = 1.f - metalness_;
-        float percent_spec = metalness_;
+        float percent_diffuse = 1.f - collisionPt.metallic;
+        float percent_spec = collisionPt.metallic;
 
         // Construct Orthonormal Basis for sampling
         Vec3 bitangent, tangent;
@@ -43,7 +49,7 @@ namespace cblt
         else
         {
             // specular
-            incoming = RandomUnitVectorInGGX(bitangent, collisionPt.norm, tangent, outgoing, sqr(roughness_), pdf, u1, u2);
+            incoming = RandomUnitVectorInGGX(bitangent, collisionPt.norm, tangent, outgoing, sqr(collisionPt.roughness), pdf, u1, u2);
         }
         return BRDF(incoming, outgoing, collisionPt, pdf);
     }
@@ -51,7 +57,7 @@ namespace cblt
     // nomenclature guide:
     // incoming -> omega_i -> toLight (L) -> The light arriving at this point
     // outgoing -> omega_o -> toEye (V) -> The light reflected at this point
-    Color CookTorrenceMaterial::BRDF(const Vec3 &incoming, const Vec3 &outgoing, const HitInfo &collision_pt, float &pdf)
+    Color CookTorrenceMaterial::BRDF(const Vec3 &incoming, const Vec3 &outgoing, const HitInfo &collision_pt, float &pdf) const
     {
         
         float d_pdf(0.f), s_pdf(0.f);
@@ -66,12 +72,12 @@ namespace cblt
         }
 
         // lambertian diffuse BRDF
-        Color diffuse = (albedo_map_) ? albedo_map_->sample(collision_pt.uv.x, collision_pt.uv.y) : albedo_;
+        Color diffuse = collision_pt.albedo;
         diffuse = diffuse * INV_PI_f;
         d_pdf = in_dot_n * INV_PI_f;
 
         // specular
-        float rough_sqr = sqr(roughness_);
+        float rough_sqr = sqr(collision_pt.roughness);
 
         Vec3 halfway = Normalize(incoming + outgoing);
 
@@ -91,12 +97,13 @@ namespace cblt
         
         s_pdf = D * n_dot_h / (4.f * o_dot_h);
 
-        pdf = d_pdf * (1.f - metalness_) + s_pdf * metalness_;
+        float metal = collision_pt.metallic;
+        pdf = d_pdf * (1.f - metal) + s_pdf * metal;
         
-        return diffuse * (1.f - metalness_) + reflective * metalness_;
+        return diffuse * (1.f - metal) + reflective * metal;
     }
 
-    Color CookTorrenceMaterial::Emittance()
+    Color CookTorrenceMaterial::Emittance() const
     {
         return emissive_;
     }
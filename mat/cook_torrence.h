@@ -10,14 +10,14 @@ namespace cblt
     public:
         CookTorrenceMaterial(Color albedo, Color specular, Color emissive, float ior, float rough_, float metal);
 
-        Color Sample(const Vec3 &incoming, Vec3 &outgoing, float &pdf, const HitInfo &collisionPt, std::shared_ptr<Sampler> &BRDF_sampler);
-        Color BRDF(const Vec3 &incoming, const Vec3 &outgoing, const HitInfo &collision_pt, float &pdf);
-        Color Emittance();
+        Color Sample(const Vec3 &incoming, Vec3 &outgoing, float &pdf, const HitInfo &collisionPt, std::shared_ptr<Sampler> &BRDF_sampler) const;
+        Color BRDF(const Vec3 &incoming, const Vec3 &outgoing, const HitInfo &collision_pt, float &pdf) const;
+        Color Emittance() const;
+        void EvaluateTextures(HitInfo &collision_pt) const;
     private:
         Color albedo_;
         Color specular_;
         Color emissive_;
-        float ior_;
         float roughness_;
         float metalness_;
     };
@@ -14,17 +14,16 @@ namespace cblt
             sheen_tint_(sheen_tint), clrcoat_(clearcoat), clrcoat_gloss_(clearcoat_gloss), thin_(thin)
     {
         ior_ = ior;
-        
-        float diffuse_weight = 1.f - metal_;
-        float specular_weight = metal_;
-        float clrcoat_weight = .25f * clrcoat_;
-        float tot = diffuse_weight + specular_weight + clrcoat_weight;
-        d_pdf_ = diffuse_weight;
-        s_pdf_ = specular_weight;
-        cc_pdf_ = clrcoat_weight;
+        // the diffuse & specular lobe weights depend on the (possibly textured) metallic value of each hit
+        cc_pdf_ = .25f * clrcoat_;
+    }
+
+    void DisneyPrincipledMaterial::EvaluateTextures(HitInfo &collision_pt) const
+    {
+        EvaluateParams(collision_pt, base_, rough_, metal_);
     }
 
-    Color DisneyPrincipledMaterial::Sample(const Vec3 &outgoing, Vec3 &incoming, float &pdf, const HitInfo &collision_pt, std::shared_ptr<Sampler> &BRDF_sampler)
+    Color DisneyPrincipledMaterial::Sample(const Vec3 &outgoing, Vec3 &incoming, float &pdf, const HitInfo &collision_pt, std::shared_ptr<Sampler> &BRDF_sampler) const
     {
         // First, determine which BRDF we need to use for this ray
         Vec3 bitangent, tangent;
@@ -34,26 +33,26 @@ namespace cblt
         float lobe_weight;
         BRDF_sampler->Next1D(lobe_weight);
         // lobe weights
+        float d_pdf = 1.f - collision_pt.metallic;
+        float s_pdf = collision_pt.metallic;
 
-        if (lobe_weight < d_pdf_)
+        if (lobe_weight < d_pdf)
         {
             // diffuse lobe sampling
             float u1, u2;
             BRDF_sampler->Next2D(u1, u2);
             incoming = cblt::RandomUnitVectorInCosineWeightedHemisphere(bitangent, collision_pt.norm, tangent, pdf, u1, u2);
         }
-        else if (lobe_weight < d_pdf_ + s_pdf_)
+        else if (lobe_weight < d_pdf + s_pdf)
         {
             float alpha_x, alpha_y;
-            GetAnisoParams(alpha_x, alpha_y);
+            GetAnisoParams(collision_pt.roughness, alpha_x, alpha_y);
 
             float u1, u2;
             BRDF_sampler->Next2D(u1, u2);
 
-            Mat4 Tan_To_World(Vec4(bitangent, 0.f), Vec4(collision_pt.norm, 0.f), Vec4(tangent, 0.f), Vec4(0.f, 0.f, 0.f, 1.f));
-            Mat4 World_To_Tan = OrthoInverse(Tan_To_World);
-            Vec4 out_tan = World_To_Tan * Vec4(outgoing, 0.f);
-            Vec3 w_o(out_tan.x, out_tan.y, out_tan.z);
+            Frame BNT(bitangent, collision_pt.norm, tangent);
+            Vec3 w_o = BNT.ToLocal(outgoing);
 
             Vec3 sample_h = SampleVisibleGGX(w_o, alpha_x, alpha_y, u1, u2);
             // reflect about sampled halfway to get the incoming light vector
@@ -67,8 +66,7 @@ namespace cblt
             pdf = (D_aniso * G1_aniso) / (4.f * O_dot_N);
 
             // take back from tangent space to world space
-            Vec4 out_vec = Tan_To_World * Vec4(w_i, 0.f);
-            incoming = Normalize(Vec3(out_vec.x, out_vec.y, out_vec.z));
+            incoming = Normalize(BNT.FromLocal(w_i));
         }
         else
         {
@@ -83,7 +81,7 @@ namespace cblt
     // nomenclature guide:
     // incoming -> omega_i -> toLight (L) -> The light arriving at this point
     // outgoing -> omega_o -> toEye (V) -> The light reflected at this point
-    Color DisneyPrincipledMaterial::BRDF(const Vec3 &incoming, const Vec3 &outgoing, const HitInfo &collision_pt, float &pdf)
+    Color DisneyPrincipledMaterial::BRDF(const Vec3 &incoming, const Vec3 &outgoing, const HitInfo &collision_pt, float &pdf) const
     {
         float d_pdf, s_pdf, c_pdf;
         if (Dot(incoming, collision_pt.norm) < eps_zero_F || Dot(outgoing, collision_pt.norm) < eps_zero_F)
@@ -98,12 +96,13 @@ namespace cblt
         Color specular = DisneySpecular(incoming, outgoing, halfway, collision_pt, s_pdf);
         Color clearcoat = DisneyClearcoat(incoming, outgoing, halfway, collision_pt, c_pdf);
         Color sheen = DisneySheen(incoming, outgoing, halfway, collision_pt);
-        pdf = (d_pdf_ * d_pdf + s_pdf_ * s_pdf + cc_pdf_ * c_pdf);
+        float metal = collision_pt.metallic;
+        pdf = ((1.f - metal) * d_pdf + metal * s_pdf + cc_pdf_ * c_pdf);
         
-        return (diffuse + sheen) * (1.f - metal_) + specular + clearcoat;
+        return (diffuse + sheen) * (1.f - metal) + specular + clearcoat;
     }
 
-    Color DisneyPrincipledMaterial::DisneyDiffuse(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt, float &pdf)
+    Color DisneyPrincipledMaterial::DisneyDiffuse(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt, float &pdf) const
     {
         float n_dot_i = Dot(collision_pt.norm, incoming);
         float n_dot_o = Dot(collision_pt.norm, outgoing);
@@ -112,7 +111,7 @@ namespace cblt
         float fresnel_i = FresnelSchlick(0.f, n_dot_i);
         float fresnel_o = FresnelSchlick(0.f, n_dot_o);
 
-        float fresnel_d90 = 2.f * rough_ * cblt::sqr(h_dot_i);
+        float fresnel_d90 = 2.f * collision_pt.roughness * cblt::sqr(h_dot_i);
         float diffuse = (1.f - .5f * fresnel_i) * (1.f - .5f * fresnel_o);
         
         // retro-reflection
@@ -125,10 +124,10 @@ namespace cblt
         
         pdf = n_dot_i * INV_PI_f;
 
-        return base_ * INV_PI_f * (diffuse + retro_refl);
+        return collision_pt.albedo * INV_PI_f * (diffuse + retro_refl);
     }
 
-    Color DisneyPrincipledMaterial::DisneySpecular(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt, float &pdf)
+    Color DisneyPrincipledMaterial::DisneySpecular(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt, float &pdf) const
     {
         Vec3 X, Y;
         OrthonormalBasis(collision_pt.norm, X, Y);
@@ -151,13 +150,14 @@ namespace cblt
 
         float fresnel_h = FresnelCoef(h_dot_i);
 
-        float luminance = base_.Luminance();
-        Color tint = (luminance > 0.f) ? base_ / luminance : white;
+        Color base = collision_pt.albedo;
+        float luminance = base.Luminance();
+        Color tint = (luminance > 0.f) ? base / luminance : white;
         Color k_s = cblt::lerp<Color>(white, tint, spec_tint_) * 0.08f * spec_; 
-        Color spec = cblt::lerp<Color>(k_s, base_, metal_);
+        Color spec = cblt::lerp<Color>(k_s, base, collision_pt.metallic);
 
         float alpha_x, alpha_y;
-        GetAnisoParams(alpha_x, alpha_y);
+        GetAnisoParams(collision_pt.roughness, alpha_x, alpha_y);
 
         float D_s = GGX_aniso(alpha_x, alpha_y, h_dot_x, h_dot_y, n_dot_h);
         float G_s = SmithGeomAniso(incoming, outgoing, collision_pt.norm, X, Y, alpha_x, alpha_y);
@@ -169,7 +169,7 @@ namespace cblt
         return F_s * D_s * G_s / (4.f * n_dot_i * n_dot_o);
     }
 
-    Color DisneyPrincipledMaterial::DisneyClearcoat(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt, float &pdf)
+    Color DisneyPrincipledMaterial::DisneyClearcoat(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt, float &pdf) const
     {
         float n_dot_o = AbsDot(outgoing, collision_pt.norm);
         float n_dot_i = AbsDot(incoming, collision_pt.norm);
@@ -187,27 +187,28 @@ namespace cblt
         return Color::GreyScale(.25f * clrcoat_ * D_cc * F_cc * G_cc);
     }
 
-    Color DisneyPrincipledMaterial::DisneySheen(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt)
+    Color DisneyPrincipledMaterial::DisneySheen(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt) const
     {
-        Color tint = base_.Luminance() > 0.f ? base_ / base_.Luminance() : Color::GreyScale(1.f);
+        Color base = collision_pt.albedo;
+        Color tint = base.Luminance() > 0.f ? base / base.Luminance() : Color::GreyScale(1.f);
         return lerp(Color::GreyScale(1.f), tint, sheen_tint_) * sheen_ * FresnelCoef(Dot(halfway, incoming));
     }
 
-    Color DisneyPrincipledMaterial::DisneyTransmission(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt)
+    Color DisneyPrincipledMaterial::DisneyTransmission(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt) const
     {
         // TODO
         return Color::GreyScale(0.f);
     }
 
-    Color DisneyPrincipledMaterial::Emittance()
+    Color DisneyPrincipledMaterial::Emittance() const
     {
         return Color(0.f, 0.f, 0.f);
     }
 
-    void DisneyPrincipledMaterial::GetAnisoParams(float &a_x, float &a_y)
+    void DisneyPrincipledMaterial::GetAnisoParams(float rough, float &a_x, float &a_y) const
     {
         float aspect = std::sqrt(1.f - 0.9f * aniso_);
-        a_x = std::max(.0001f, cblt::sqr(rough_) / aspect);
-        a_y = std::max(.0001f, cblt::sqr(rough_) * aspect);
+        a_x = std::max(.0001f, cblt::sqr(rough) / aspect);
+        a_y = std::max(.0001f, cblt::sqr(rough) * aspect);
     }
 }
\ No newline at end of file
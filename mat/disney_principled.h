@@ -2,6 +2,7 @@
 #define CBLT_DISNEY_PRINCIPLED
 
 #include "material.h"
+#include "shading_packet.h"
 
 namespace cblt
 {
@@ -11,9 +12,16 @@ namespace cblt
             float specular_tint, float roughness, float anisotropic, float sheen, float sheen_tint,
             float clearcoat, float clearcoat_gloss, float ior, bool thin);
 
-        Color Sample(const Vec3 &incoming, Vec3 &outgoing, float &pdf, const HitInfo &collisionPt, std::shared_ptr<Sampler> &BRDF_sampler) override;
-        Color BRDF(const Vec3 &incoming, const Vec3 &outgoing, const HitInfo &collision_pt, float &pdf) override;
-        Color Emittance() override;
+        Color Sample(const Vec3 &incoming, Vec3 &outgoing, float &pdf, const HitInfo &collisionPt, std::shared_ptr<Sampler> &BRDF_sampler) const;
+        Color BRDF(const Vec3 &incoming, const Vec3 &outgoing, const HitInfo &collision_pt, float &pdf) const;
+        Color Emittance() const;
+        void EvaluateTextures(HitInfo &collision_pt) const;
+
+        // The same as BRDF() & Sample(), for packet_width shading points at once. Colors are returned with red, green
+        // & blue in x, y & z. The random numbers are supplied by the caller, since samplers work one value at a time
+        void BRDFBatch(const Vec3x8 &incoming, const Vec3x8 &outgoing, const ShadingPacket &pts, Vec3x8 &f, Floatx8 &pdf) const;
+        void SampleBatch(const Vec3x8 &outgoing, const Floatx8 &u_lobe, const Floatx8 &u1, const Floatx8 &u2, const ShadingPacket &pts,
+                         Vec3x8 &incoming, Vec3x8 &f, Floatx8 &pdf) const;
     private:
         Color base_;
         float subsrfc_;
@@ -29,16 +37,14 @@ namespace cblt
         bool thin_;
 
 
-        float d_pdf_;
-        float s_pdf_;
         float cc_pdf_;
-        void GetAnisoParams(float &a_x, float &a_y);
+        void GetAnisoParams(float rough, float &a_x, float &a_y) const;
 
-        Color DisneyDiffuse(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt, float &pdf);
-        Color DisneySpecular(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt, float &pdf);
-        Color DisneyClearcoat(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt, float &pdf);
-        Color DisneySheen(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt);
-        Color DisneyTransmission(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt);
+        Color DisneyDiffuse(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt, float &pdf) const;
+        Color DisneySpecular(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt, float &pdf) const;
+        Color DisneyClearcoat(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt, float &pdf) const;
+        Color DisneySheen(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt) const;
+        Color DisneyTransmission(const Vec3 &incoming, const Vec3 &outgoing, const Vec3 &halfway, const HitInfo &collision_pt) const;
     };
 }
 #endif  // CBLT_DISNEY_PRINCIPLED_H
\ No newline at end of file
@@ -0,0 +1,266 @@
+#include "disney_principled.h"
+
+#include "math/constants.h"
+#include "math/fast_math.h"
+#include "math/math_helpers.h"
+
+#include <algorithm>
+#include <cmath>
+
+// The batched Disney BRDF. Each function is a single loop over the lanes of a packet, written with plain floats
+// rather than Vec3 & Color, so that the compiler vectorizes across lanes instead of within a vector. Branches are
+// written as selects which never guard a division, and libm calls are replaced by the approximations in
+// fast_math.h, which keeps every loop vectorizable. With CBLT_USE_AVX2 a whole packet is shaded in 8 wide registers.
+
+namespace cblt
+{
+    namespace
+    {
+        // the same as Normalize(), including its bias against zero length vectors
+        inline void NormalizeLane(float &x, float &y, float &z)
+        {
+            float inv_len = 1.f / (std::sqrt(x * x + y * y + z * z) + 1e-6f);
+            x *= inv_len;
+            y *= inv_len;
+            z *= inv_len;
+        }
+
+        // the same basis as OrthonormalBasis()
+        inline void BasisLane(float n_x, float n_y, float n_z, float &t_x, float &t_y, float &t_z, float &b_x, float &b_y, float &b_z)
+        {
+            float sign = std::copysign(1.f, n_z);
+            float a = -1.f / (sign + n_z);
+            float b = n_x * n_y * a;
+            t_x = 1.f + sign * n_x * n_x * a;
+            t_y = sign * b;
+            t_z = -sign * n_x;
+            b_x = b;
+            b_y = sign + n_y * n_y * a;
+            b_z = -n_y;
+        }
+    }
+
+    void DisneyPrincipledMaterial::BRDFBatch(const Vec3x8 &incoming, const Vec3x8 &outgoing, const ShadingPacket &pts, Vec3x8 &f, Floatx8 &pdf) const
+    {
+        // terms which only depend on the material are computed once for the whole packet
+        float aspect = std::sqrt(1.f - 0.9f * aniso_);
+        float cc_alpha = cblt::lerp<float>(.1f, .001f, clrcoat_gloss_);
+        float cc_alpha_sqr_1 = cblt::sqr(cc_alpha) - 1.f;
+        // GTR1 is (alpha^2 - 1) / (pi log(alpha^2) (1 + (alpha^2 - 1) cos^2)), and flat once alpha reaches 1
+        float cc_norm = (cc_alpha >= 1.f) ? INV_PI_f : cc_alpha_sqr_1 / (PI_f * std::log(cblt::sqr(cc_alpha)));
+        float cc_slope = (cc_alpha >= 1.f) ? 0.f : cc_alpha_sqr_1;
+        float spec_tint = spec_tint_;
+        float spec = spec_;
+        float sheen_tint = sheen_tint_;
+        float sheen = sheen_;
+        float clrcoat = clrcoat_;
+        float cc_pdf = cc_pdf_;
+
+        #pragma omp simd
+        for (int l = 0; l < packet_width; ++l)
+        {
+            float n_x = pts.norm.x[l], n_y = pts.norm.y[l], n_z = pts.norm.z[l];
+            float i_x = incoming.x[l], i_y = incoming.y[l], i_z = incoming.z[l];
+            float o_x = outgoing.x[l], o_y = outgoing.y[l], o_z = outgoing.z[l];
+            float base_r = pts.albedo.x[l], base_g = pts.albedo.y[l], base_b = pts.albedo.z[l];
+            float rough = pts.roughness[l];
+            float metal = pts.metallic[l];
+
+            float n_dot_i = n_x * i_x + n_y * i_y + n_z * i_z;
+            float n_dot_o = n_x * o_x + n_y * o_y + n_z * o_z;
+            // no support for transmission (yet), so any event below the hemisphere should be non-existant
+            bool valid = n_dot_i >= eps_zero_F && n_dot_o >= eps_zero_F;
+
+            float h_x = i_x + o_x, h_y = i_y + o_y, h_z = i_z + o_z;
+            NormalizeLane(h_x, h_y, h_z);
+            float h_dot_i = h_x * i_x + h_y * i_y + h_z * i_z;
+            float n_dot_h = n_x * h_x + n_y * h_y + n_z * h_z;
+            float fresnel_h = Pow5(1.f - h_dot_i);
+
+            // diffuse & retro-reflection
+            float fresnel_i = Pow5(1.f - n_dot_i);
+            float fresnel_o = Pow5(1.f - n_dot_o);
+            float fresnel_d90 = 2.f * rough * h_dot_i * h_dot_i;
+            float diffuse = (1.f - .5f * fresnel_i) * (1.f - .5f * fresnel_o);
+            float retro_refl = fresnel_d90 * (fresnel_i + fresnel_o + fresnel_i * fresnel_o * (fresnel_d90 - 1.f));
+            float diffuse_w = INV_PI_f * (diffuse + retro_refl);
+            float d_pdf = n_dot_i * INV_PI_f;
+
+            // tint, shared by the specular & sheen lobes
+            float luminance = base_r * .3f + base_g * .59f + base_b * .11f;
+            float inv_lum = 1.f / ((luminance > 0.f) ? luminance : 1.f);
+            float tint_r = (luminance > 0.f) ? base_r * inv_lum : 1.f;
+            float tint_g = (luminance > 0.f) ? base_g * inv_lum : 1.f;
+            float tint_b = (luminance > 0.f) ? base_b * inv_lum : 1.f;
+
+            // anisotropic GGX specular
+            float x_x, x_y, x_z, y_x, y_y, y_z;
+            BasisLane(n_x, n_y, n_z, x_x, x_y, x_z, y_x, y_y, y_z);
+            float h_dot_x = h_x * x_x + h_y * x_y + h_z * x_z;
+            float h_dot_y = h_x * y_x + h_y * y_y + h_z * y_z;
+            float rough_sqr = rough * rough;
+            float alpha_x = std::max(.0001f, rough_sqr / aspect);
+            float alpha_y = std::max(.0001f, rough_sqr * aspect);
+
+            float D_a = cblt::sqr(h_dot_x / alpha_x) + cblt::sqr(h_dot_y / alpha_y) + n_dot_h * n_dot_h;
+            float D_s = 1.f / (PI_f * alpha_x * alpha_y * D_a * D_a);
+
+            float i_dot_x = i_x * x_x + i_y * x_y + i_z * x_z;
+            float i_dot_y = i_x * y_x + i_y * y_y + i_z * y_z;
+            float o_dot_x = o_x * x_x + o_y * x_y + o_z * x_z;
+            float o_dot_y = o_x * y_x + o_y * y_y + o_z * y_z;
+            float tan_sqr_i = (1.f - n_dot_i * n_dot_i) / (n_dot_i * n_dot_i);
+            float tan_sqr_o = (1.f - n_dot_o * n_dot_o) / (n_dot_o * n_dot_o);
+            float lambda_i = std::sqrt(1.f + (cblt::sqr(i_dot_x * alpha_x) + cblt::sqr(i_dot_y * alpha_y)) * tan_sqr_i);
+            float lambda_o = std::sqrt(1.f + (cblt::sqr(o_dot_x * alpha_x) + cblt::sqr(o_dot_y * alpha_y)) * tan_sqr_o);
+            float G_s = 2.f / (lambda_i + lambda_o);
+            float G1_o = 2.f / (1.f + lambda_o);
+            float s_pdf = D_s * G1_o / (4.f * n_dot_o);
+            float spec_w = D_s * G_s / (4.f * n_dot_i * n_dot_o);
+
+            float spec_r = ((1.f - spec_tint) + tint_r * spec_tint) * .08f * spec * (1.f - metal) + base_r * metal;
+            float spec_g = ((1.f - spec_tint) + tint_g * spec_tint) * .08f * spec * (1.f - metal) + base_g * metal;
+            float spec_b = ((1.f - spec_tint) + tint_b * spec_tint) * .08f * spec * (1.f - metal) + base_b * metal;
+            float F_r = spec_r + (1.f - spec_r) * fresnel_h;
+            float F_g = spec_g + (1.f - spec_g) * fresnel_h;
+            float F_b = spec_b + (1.f - spec_b) * fresnel_h;
+
+            // clearcoat
+            float abs_n_dot_h = std::abs(n_dot_h);
+            float D_cc = cc_norm / (1.f + cc_slope * abs_n_dot_h * abs_n_dot_h);
+            float G_cc = 2.f / (1.f + std::sqrt(1.f + .0625f * tan_sqr_i)) * 2.f / (1.f + std::sqrt(1.f + .0625f * tan_sqr_o));
+            float F_cc = .04f + .96f * fresnel_h;
+            float c_pdf = D_cc * abs_n_dot_h / (4.f * h_dot_i);
+            float clearcoat = .25f * clrcoat * D_cc * F_cc * G_cc;
+
+            // sheen
+            float sheen_w = sheen * fresnel_h;
+            float sheen_r = ((1.f - sheen_tint) + tint_r * sheen_tint) * sheen_w;
+            float sheen_g = ((1.f - sheen_tint) + tint_g * sheen_tint) * sheen_w;
+            float sheen_b = ((1.f - sheen_tint) + tint_b * sheen_tint) * sheen_w;
+
+            float lane_pdf = (1.f - metal) * d_pdf + metal * s_pdf + cc_pdf * c_pdf;
+            float f_r = (base_r * diffuse_w + sheen_r) * (1.f - metal) + F_r * spec_w + clearcoat;
+            float f_g = (base_g * diffuse_w + sheen_g) * (1.f - metal) + F_g * spec_w + clearcoat;
+            float f_b = (base_b * diffuse_w + sheen_b) * (1.f - metal) + F_b * spec_w + clearcoat;
+
+            pdf.v[l] = valid ? lane_pdf : 0.f;
+            f.x[l] = valid ? f_r : 0.f;
+            f.y[l] = valid ? f_g : 0.f;
+            f.z[l] = valid ? f_b : 0.f;
+        }
+    }
+
+    void DisneyPrincipledMaterial::SampleBatch(const Vec3x8 &outgoing, const Floatx8 &u_lobe, const Floatx8 &u1, const Floatx8 &u2, const ShadingPacket &pts,
+                                               Vec3x8 &incoming, Vec3x8 &f, Floatx8 &pdf) const
+    {
+        float aspect = std::sqrt(1.f - 0.9f * aniso_);
+        float cc_alpha_sqr = cblt::sqr(cblt::lerp<float>(.1f, .001f, clrcoat_gloss_));
+        float cc_log2_alpha_sqr = std::log2(cc_alpha_sqr);
+
+        // every lobe is sampled in every lane, then each lane keeps the direction of the lobe it chose
+        #pragma omp simd
+        for (int l = 0; l < packet_width; ++l)
+        {
+            float n_x = pts.norm.x[l], n_y = pts.norm.y[l], n_z = pts.norm.z[l];
+            float o_x = outgoing.x[l], o_y = outgoing.y[l], o_z = outgoing.z[l];
+            float metal = pts.metallic[l];
+            float rough = pts.roughness[l];
+            float r1 = u1[l], r2 = u2[l];
+
+            // bitangent, normal & tangent frame, with the normal as the local y axis
+            float b_x, b_y, b_z, t_x, t_y, t_z;
+            BasisLane(n_x, n_y, n_z, b_x, b_y, b_z, t_x, t_y, t_z);
+            float wo_x = o_x * b_x + o_y * b_y + o_z * b_z;
+            float wo_y = o_x * n_x + o_y * n_y + o_z * n_z;
+            float wo_z = o_x * t_x + o_y * t_y + o_z * t_z;
+
+            // diffuse, cosine weighted hemisphere through the concentric disk mapping
+            float d_u1 = 2.f * r1 - 1.f, d_u2 = 2.f * r2 - 1.f;
+            bool major_u1 = std::abs(d_u1) > std::abs(d_u2);
+            bool origin = d_u1 == 0.f && d_u2 == 0.f;
+            float radius = origin ? 0.f : (major_u1 ? d_u1 : d_u2);
+            float ratio = (major_u1 ? d_u2 : d_u1) / (origin ? 1.f : radius);
+            float theta = origin ? 0.f : (major_u1 ? .25f * PI_f * ratio : .5f * PI_f - .25f * PI_f * ratio);
+            float sin_theta, cos_theta;
+            FastSinCos(theta, sin_theta, cos_theta);
+            float disk_x = radius * cos_theta, disk_z = radius * sin_theta;
+            float disk_y = std::sqrt(std::max(0.f, 1.f - disk_x * disk_x - disk_z * disk_z));
+            float d_x = b_x * disk_x + n_x * disk_y + t_x * disk_z;
+            float d_y = b_y * disk_x + n_y * disk_y + t_y * disk_z;
+            float d_z = b_z * disk_x + n_z * disk_y + t_z * disk_z;
+            NormalizeLane(d_x, d_y, d_z);
+
+            // specular, visible normals of the anisotropic GGX distribution
+            float rough_sqr = rough * rough;
+            float alpha_x = std::max(.0001f, rough_sqr / aspect);
+            float alpha_y = std::max(.0001f, rough_sqr * aspect);
+            float v_x = alpha_x * wo_x, v_y = wo_y, v_z = alpha_y * wo_z;
+            NormalizeLane(v_x, v_y, v_z);
+            // cross(v, y axis), or the x axis when v is nearly vertical
+            bool vertical = v_y >= 0.999f;
+            float vb_x = -v_z, vb_y = 0.f, vb_z = v_x;
+            NormalizeLane(vb_x, vb_y, vb_z);
+            vb_x = vertical ? 1.f : vb_x;
+            vb_z = vertical ? 0.f : vb_z;
+            float vt_x = vb_y * v_z - vb_z * v_y;
+            float vt_y = -vb_x * v_z + v_x * vb_z;
+            float vt_z = vb_x * v_y - vb_y * v_x;
+            float vndf_r = std::sqrt(r1);
+            float vndf_a = 1.f / (1.f + v_y);
+            bool lower = r2 < vndf_a;
+            float phi_lower = (r2 / vndf_a) * PI_f;
+            float phi_upper = PI_f + (r2 - vndf_a) / std::max(1.f - vndf_a, eps_zero_F) * PI_f;
+            float phi = lower ? phi_lower : phi_upper;
+            float sin_phi, cos_phi;
+            FastSinCos(phi, sin_phi, cos_phi);
+            float p1 = vndf_r * cos_phi;
+            float p2 = vndf_r * sin_phi * (lower ? 1.f : v_y);
+            float p3 = std::sqrt(std::max(0.f, 1.f - p1 * p1 - p2 * p2));
+            float m_x = vb_x * p1 + vt_x * p2 + v_x * p3;
+            float m_y = vb_y * p1 + vt_y * p2 + v_y * p3;
+            float m_z = vb_z * p1 + vt_z * p2 + v_z * p3;
+            m_x *= alpha_x;
+            m_y = std::max(0.f, m_y);
+            m_z *= alpha_y;
+            NormalizeLane(m_x, m_y, m_z);
+            float o_dot_m = wo_x * m_x + wo_y * m_y + wo_z * m_z;
+            float s_x = 2.f * o_dot_m * m_x - wo_x, s_y = 2.f * o_dot_m * m_y - wo_y, s_z = 2.f * o_dot_m * m_z - wo_z;
+            NormalizeLane(s_x, s_y, s_z);
+            float sw_x = b_x * s_x + n_x * s_y + t_x * s_z;
+            float sw_y = b_y * s_x + n_y * s_y + t_y * s_z;
+            float sw_z = b_z * s_x + n_z * s_y + t_z * s_z;
+            NormalizeLane(sw_x, sw_y, sw_z);
+
+            // clearcoat, GTR1 distribution of normals
+            float cc_cos = std::sqrt(std::max(0.f, (1.f - FastExp2((1.f - r1) * cc_log2_alpha_sqr)) / (1.f - cc_alpha_sqr)));
+            float cc_sin = std::sqrt(std::max(0.f, 1.f - cc_cos * cc_cos));
+            float sin_cc_phi, cos_cc_phi;
+            FastSinCos(2.f * PI_f * r2, sin_cc_phi, cos_cc_phi);
+            float c_x = cc_sin * cos_cc_phi, c_y = cc_cos, c_z = cc_sin * sin_cc_phi;
+            NormalizeLane(c_x, c_y, c_z);
+            float o_dot_c = wo_x * c_x + wo_y * c_y + wo_z * c_z;
+            float flip = (wo_y * c_y < 0.f) ? -1.f : 1.f;
+            c_x *= flip;
+            c_y *= flip;
+            c_z *= flip;
+            o_dot_c *= flip;
+            float cr_x = 2.f * o_dot_c * c_x - wo_x, cr_y = 2.f * o_dot_c * c_y - wo_y, cr_z = 2.f * o_dot_c * c_z - wo_z;
+            NormalizeLane(cr_x, cr_y, cr_z);
+            float cw_x = b_x * cr_x + n_x * cr_y + t_x * cr_z;
+            float cw_y = b_y * cr_x + n_y * cr_y + t_y * cr_z;
+            float cw_z = b_z * cr_x + n_z * cr_y + t_z * cr_z;
+            NormalizeLane(cw_x, cw_y, cw_z);
+
+            // choose lobe to sample, with the same weights as Sample()
+            float d_pdf = 1.f - metal;
+            float s_pdf = metal;
+            bool pick_diffuse = u_lobe[l] < d_pdf;
+            bool pick_spec = u_lobe[l] < d_pdf + s_pdf;
+            incoming.x[l] = pick_diffuse ? d_x : (pick_spec ? sw_x : cw_x);
+            incoming.y[l] = pick_diffuse ? d_y : (pick_spec ? sw_y : cw_y);
+            incoming.z[l] = pick_diffuse ? d_z : (pick_spec ? sw_z : cw_z);
+        }
+        BRDFBatch(incoming, outgoing, pts, f, pdf);
+    }
+}
@@ -0,0 +1,91 @@
+#include "distribution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cblt
+{
+    Distribution1D::Distribution1D(const float *func, int count) : func_(func, func + count), cdf_(count + 1)
+    {
+        // integrate the step function to build the CDF
+        cdf_[0] = 0.f;
+        for (int i = 1; i <= count; ++i)
+        {
+            cdf_[i] = cdf_[i - 1] + std::abs(func_[i - 1]) / count;
+        }
+
+        func_int_ = cdf_[count];
+        if (func_int_ == 0.f)
+        {
+            // nothing to importance sample, so fall back to a uniform distribution
+            for (int i = 1; i <= count; ++i)
+            {
+                cdf_[i] = static_cast<float>(i) / count;
+            }
+        }
+        else
+        {
+            for (int i = 1; i <= count; ++i)
+            {
+                cdf_[i] /= func_int_;
+            }
+        }
+    }
+
+    float Distribution1D::SampleContinuous(float u, float &pdf, int &offset) const
+    {
+        // find the last CDF entry which is <= u
+        auto upper = std::upper_bound(cdf_.begin(), cdf_.end(), u);
+        offset = std::max(0, std::min(static_cast<int>(std::distance(cdf_.begin(), upper)) - 1, Count() - 1));
+
+        // position within the segment
+        float du = u - cdf_[offset];
+        float seg_width = cdf_[offset + 1] - cdf_[offset];
+        if (seg_width > 0.f)
+        {
+            du /= seg_width;
+        }
+
+        pdf = (func_int_ > 0.f) ? func_[offset] / func_int_ : 1.f;
+        return (offset + du) / Count();
+    }
+
+    Distribution2D::Distribution2D(const float *func, int count_u, int count_v)
+    {
+        conditional_.reserve(count_v);
+        for (int v = 0; v < count_v; ++v)
+        {
+            conditional_.emplace_back(&func[v * count_u], count_u);
+        }
+
+        std::vector<float> marginal_func(count_v);
+        for (int v = 0; v < count_v; ++v)
+        {
+            marginal_func[v] = conditional_[v].Integral();
+        }
+        marginal_ = Distribution1D(marginal_func.data(), count_v);
+    }
+
+    Vec2 Distribution2D::SampleContinuous(float u0, float u1, float &pdf) const
+    {
+        float pdfs[2];
+        int u, v;
+        float d1 = marginal_.SampleContinuous(u1, pdfs[1], v);
+        float d0 = conditional_[v].SampleContinuous(u0, pdfs[0], u);
+        pdf = pdfs[0] * pdfs[1];
+        return Vec2(d0, d1);
+    }
+
+    float Distribution2D::Pdf(const Vec2 &uv) const
+    {
+        int count_u = conditional_[0].Count();
+        int count_v = marginal_.Count();
+        int iu = std::max(0, std::min(static_cast<int>(uv.x * count_u), count_u - 1));
+        int iv = std::max(0, std::min(static_cast<int>(uv.y * count_v), count_v - 1));
+        if (marginal_.Integral() == 0.f)
+        {
+            return 1.f;
+        }
+        return conditional_[iv].Func(iu) / marginal_.Integral();
+    }
+}
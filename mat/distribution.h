@@ -0,0 +1,48 @@
+#ifndef CBLT_DISTRIBUTION_H
+#define CBLT_DISTRIBUTION_H
+
+#include "math/vec.h"
+
+#include <vector>
+
+namespace cblt
+{
+    /**
+     * @brief A piecewise constant 1D distribution over [0, 1], sampled by inverting its CDF.
+     * Construction follows Physically Based Rendering 3rd Edition, Section 13.3.
+     */
+    class Distribution1D
+    {
+        public:
+        Distribution1D() {};
+        Distribution1D(const float *func, int count);
+        // sample a continuous value in [0, 1), offset is the index of the segment the sample landed in
+        float SampleContinuous(float u, float &pdf, int &offset) const;
+        int Count() const { return static_cast<int>(func_.size()); };
+        float Integral() const { return func_int_; };
+        float Func(int idx) const { return func_[idx]; };
+        private:
+        std::vector<float> func_;
+        std::vector<float> cdf_;
+        float func_int_ = 0.f;
+    };
+
+    /**
+     * @brief A piecewise constant 2D distribution over [0, 1]^2. The first dimension is chosen from the marginal
+     * distribution of the rows, and the second from the conditional distribution of the chosen row.
+     */
+    class Distribution2D
+    {
+        public:
+        Distribution2D() {};
+        // func is stored row major, with count_u values per row and count_v rows
+        Distribution2D(const float *func, int count_u, int count_v);
+        Vec2 SampleContinuous(float u0, float u1, float &pdf) const;
+        float Pdf(const Vec2 &uv) const;
+        private:
+        std::vector<Distribution1D> conditional_;  //! p(u|v) for each row
+        Distribution1D marginal_;  //! p(v)
+    };
+}
+
+#endif  // CBLT_DISTRIBUTION_H
@@ -0,0 +1,191 @@
+#include "exr_tile_writer.h"
+
+#include <cstring>
+
+namespace
+{
+    // EXR is little endian throughout
+    void Append(std::vector<char> &out, const void *data, size_t size)
+    {
+        const char *bytes = static_cast<const char *>(data);
+        out.insert(out.end(), bytes, bytes + size);
+    }
+
+    void AppendInt(std::vector<char> &out, int32_t value)
+    {
+        uint8_t bytes[4] = { uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24) };
+        Append(out, bytes, 4);
+    }
+
+    void AppendFloat(std::vector<char> &out, float value)
+    {
+        int32_t bits;
+        std::memcpy(&bits, &value, 4);
+        AppendInt(out, bits);
+    }
+
+    void AppendAttribute(std::vector<char> &out, const char *name, const char *type, const std::vector<char> &value)
+    {
+        Append(out, name, std::strlen(name) + 1);
+        Append(out, type, std::strlen(type) + 1);
+        AppendInt(out, static_cast<int32_t>(value.size()));
+        Append(out, value.data(), value.size());
+    }
+
+    std::vector<char> Box(int width, int height)
+    {
+        std::vector<char> box;
+        AppendInt(box, 0);
+        AppendInt(box, 0);
+        AppendInt(box, width - 1);
+        AppendInt(box, height - 1);
+        return box;
+    }
+
+    // channels are stored in alphabetical order, which readers expect
+    const char channel_names[3] = { 'B', 'G', 'R' };
+    const int32_t float_pixels = 2;
+}
+
+namespace cblt
+{
+    TiledEXRWriter::~TiledEXRWriter()
+    {
+        if (file_.is_open())
+        {
+            Close();
+        }
+    }
+
+    bool TiledEXRWriter::Open(const std::string &file_name, int width, int height, int tile_size)
+    {
+        if (width <= 0 || height <= 0 || tile_size <= 0)
+        {
+            return false;
+        }
+        file_.open(file_name, std::ios::binary | std::ios::trunc);
+        if (!file_)
+        {
+            return false;
+        }
+        width_ = width;
+        height_ = height;
+        tile_size_ = tile_size;
+        tiles_x_ = (width + tile_size - 1) / tile_size;
+        int tiles_y = (height + tile_size - 1) / tile_size;
+        offsets_.assign(static_cast<size_t>(tiles_x_) * tiles_y, 0);
+        failed_ = false;
+
+        std::vector<char> header = { 0x76, 0x2f, 0x31, 0x01 };
+        // version 2, single part & tiled
+        AppendInt(header, 2 | 0x200);
+
+        std::vector<char> channels;
+        for (char name : channel_names)
+        {
+            channels.push_back(name);
+            channels.push_back(0);
+            AppendInt(channels, float_pixels);
+            // linear flag & reserved bytes, then x & y sampling
+            channels.insert(channels.end(), 4, 0);
+            AppendInt(channels, 1);
+            AppendInt(channels, 1);
+        }
+        channels.push_back(0);
+        AppendAttribute(header, "channels", "chlist", channels);
+        AppendAttribute(header, "compression", "compression", { 0 });
+        AppendAttribute(header, "dataWindow", "box2i", Box(width, height));
+        AppendAttribute(header, "displayWindow", "box2i", Box(width, height));
+        // tiles are written as they finish rather than top to bottom
+        AppendAttribute(header, "lineOrder", "lineOrder", { 2 });
+        std::vector<char> value;
+        AppendFloat(value, 1.f);
+        AppendAttribute(header, "pixelAspectRatio", "float", value);
+        AppendAttribute(header, "screenWindowWidth", "float", value);
+        value.clear();
+        AppendFloat(value, 0.f);
+        AppendFloat(value, 0.f);
+        AppendAttribute(header, "screenWindowCenter", "v2f", value);
+        // a single resolution level
+        value.clear();
+        AppendInt(value, tile_size);
+        AppendInt(value, tile_size);
+        value.push_back(0);
+        AppendAttribute(header, "tiles", "tiledesc", value);
+        header.push_back(0);
+
+        file_.write(header.data(), header.size());
+        // the offset table is filled in by Close()
+        table_pos_ = static_cast<std::streamoff>(header.size());
+        std::vector<char> table(8 * offsets_.size(), 0);
+        file_.write(table.data(), table.size());
+        return static_cast<bool>(file_);
+    }
+
+    bool TiledEXRWriter::WriteTile(int start_x, int start_y, int count_x, int count_y, const Color *radiance, int stride, float scale)
+    {
+        if (!file_.is_open() || start_x % tile_size_ || start_y % tile_size_ || start_x + count_x > width_ || start_y + count_y > height_)
+        {
+            return false;
+        }
+        int tile_x = start_x / tile_size_;
+        int tile_y = start_y / tile_size_;
+        // the chunk is built before taking the lock, so only the write itself is serialized
+        std::vector<char> chunk;
+        chunk.reserve(20 + 12 * count_x * count_y);
+        AppendInt(chunk, tile_x);
+        AppendInt(chunk, tile_y);
+        AppendInt(chunk, 0);
+        AppendInt(chunk, 0);
+        AppendInt(chunk, 12 * count_x * count_y);
+        // each scanline of the tile holds all of its B values, then G, then R
+        for (int y = 0; y < count_y; ++y)
+        {
+            const Color *row = radiance + y * stride;
+            for (int x = 0; x < count_x; ++x)
+            {
+                AppendFloat(chunk, row[x].b * scale);
+            }
+            for (int x = 0; x < count_x; ++x)
+            {
+                AppendFloat(chunk, row[x].g * scale);
+            }
+            for (int x = 0; x < count_x; ++x)
+            {
+                AppendFloat(chunk, row[x].r * scale);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        offsets_[static_cast<size_t>(tile_y) * tiles_x_ + tile_x] = static_cast<uint64_t>(file_.tellp());
+        file_.write(chunk.data(), chunk.size());
+        if (!file_)
+        {
+            failed_ = true;
+        }
+        return !failed_;
+    }
+
+    bool TiledEXRWriter::Close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!file_.is_open())
+        {
+            return false;
+        }
+        bool complete = !failed_;
+        std::vector<char> table;
+        table.reserve(8 * offsets_.size());
+        for (uint64_t offset : offsets_)
+        {
+            complete = complete && offset != 0;
+            AppendInt(table, static_cast<int32_t>(offset & 0xffffffffu));
+            AppendInt(table, static_cast<int32_t>(offset >> 32));
+        }
+        file_.seekp(table_pos_);
+        file_.write(table.data(), table.size());
+        file_.close();
+        offsets_.clear();
+        return complete && !file_.fail();
+    }
+}
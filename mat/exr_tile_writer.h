@@ -0,0 +1,52 @@
+#ifndef CBLT_EXR_TILE_WRITER_H
+#define CBLT_EXR_TILE_WRITER_H
+
+#include "image_lib.h"
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cblt
+{
+    /**
+     * @brief Writes linear radiance to a tiled, uncompressed OpenEXR file one tile at a time, as tiles finish
+     * rendering, so an image far larger than memory can be written without ever holding it. Tiles are appended in
+     * whatever order they arrive & found through the offset table at the front of the file, which Close() fills in.
+     * Only the offset table is kept, 8 bytes per tile.
+     */
+    class TiledEXRWriter
+    {
+        public:
+        TiledEXRWriter() = default;
+        // closes the file if it's still open
+        ~TiledEXRWriter();
+        TiledEXRWriter(const TiledEXRWriter &) = delete;
+        TiledEXRWriter &operator=(const TiledEXRWriter &) = delete;
+
+        // create file_name for a width x height image of tile_size x tile_size tiles & write its header. Returns
+        // false if the file can't be created
+        bool Open(const std::string &file_name, int width, int height, int tile_size);
+        // write the tile whose top left pixel is start_x, start_y, which must lie on the tile grid. radiance holds
+        // its count_x x count_y pixels, rows stride pixels apart, & is multiplied by scale. Safe to call from
+        // several threads at once
+        bool WriteTile(int start_x, int start_y, int count_x, int count_y, const Color *radiance, int stride, float scale);
+        // fill in the offset table & close the file. Returns false if a tile is missing or a write failed
+        bool Close();
+
+        private:
+        std::ofstream file_;
+        int width_ = 0;
+        int height_ = 0;
+        int tile_size_ = 0;
+        int tiles_x_ = 0;
+        std::streamoff table_pos_ = 0;
+        std::vector<uint64_t> offsets_;  //! where each tile's chunk starts, by tile row then column, 0 until written
+        bool failed_ = false;
+        std::mutex mutex_;
+    };
+}
+
+#endif  // CBLT_EXR_TILE_WRITER_H
@@ -5,50 +5,90 @@
 
 #include "stb_image.h"
 #include "stb_image_write.h"
+#include "png_encoder.h"
 #include <cmath>
 #include <string.h>
 #include <stdlib.h>
 #include <cstdint>
 
+#ifdef CBLT_USE_SSE
+#include <smmintrin.h>
+#endif
+
+// with CBLT_USE_SSE, colors are padded to 4 floats like cblt::Vec3 so their arithmetic fits a single SSE register
+#ifdef CBLT_USE_SSE
+struct alignas(16) Color {
+#else
 struct Color {
+#endif
   float r,g,b;
+#ifdef CBLT_USE_SSE
+  float pad_ = 0.f;
+
+  __m128 Load() const { return _mm_load_ps(&r); };
+  static Color Store(__m128 val) {
+    Color res;
+    _mm_store_ps(&res.r, val);
+    res.pad_ = 0.f;
+    return res;
+  };
+#endif
 
-  Color(float r, float g, float b) : r(r), g(g), b(b) {};
-  Color() : r(0), g(0), b(0) {};
+  constexpr Color(float r, float g, float b) : r(r), g(g), b(b) {};
+  constexpr Color() : r(0), g(0), b(0) {};
 
-  static Color GreyScale(float r) { return Color(r, r, r); };
-  float Luminance();
+  static constexpr Color GreyScale(float r) { return Color(r, r, r); };
+  constexpr float Luminance() const { return r * .3f + g * .59f + b * .11f; };
 };
 
-inline float Color::Luminance() {
-  return r * .3f + g * .59f + b * .11f;
+#ifdef CBLT_USE_SSE
+inline Color operator+(const Color &lhs, const Color &rhs) {
+    return Color::Store(_mm_add_ps(lhs.Load(), rhs.Load()));
+}
+
+inline Color operator-(const Color &lhs, const Color &rhs) {
+    return Color::Store(_mm_sub_ps(lhs.Load(), rhs.Load()));
+}
+
+inline Color operator*(const Color &lhs, const Color &rhs) {
+    return Color::Store(_mm_mul_ps(lhs.Load(), rhs.Load()));
 }
 
-inline Color operator+(Color lhs, Color rhs) {
+inline Color operator*(const Color &lhs, float rhs) {
+    return Color::Store(_mm_mul_ps(lhs.Load(), _mm_set1_ps(rhs)));
+}
+
+inline Color operator/(const Color &lhs, float rhs) {
+    return Color::Store(_mm_div_ps(lhs.Load(), _mm_set1_ps(rhs)));
+}
+#else
+constexpr Color operator+(const Color &lhs, const Color &rhs) {
     return Color(lhs.r+rhs.r, lhs.g+rhs.g, lhs.b+rhs.b);
 }
 
-inline Color operator-(Color lhs, Color rhs) {
+constexpr Color operator-(const Color &lhs, const Color &rhs) {
     return Color(lhs.r-rhs.r, lhs.g-rhs.g, lhs.b-rhs.b);
 }
 
-inline Color operator*(Color lhs, Color rhs) {
+constexpr Color operator*(const Color &lhs, const Color &rhs) {
     return Color(lhs.r * rhs.r, lhs.g*rhs.g, lhs.b*rhs.b);
 }
 
-inline Color operator*(Color lhs, float rhs) {
+constexpr Color operator*(const Color &lhs, float rhs) {
     return Color(lhs.r * rhs, lhs.g * rhs, lhs.b * rhs);
 }
 
-inline Color operator/(Color lhs, float rhs) {
+constexpr Color operator/(const Color &lhs, float rhs) {
     return Color(lhs.r / rhs, lhs.g / rhs, lhs.b / rhs);
 }
+#endif
 
-inline Color operator/(const Color &lhs, const Color &rhs) {
+// divides lane by lane, so the padding never divides by zero
+constexpr Color operator/(const Color &lhs, const Color &rhs) {
     return Color(lhs.r / rhs.r, lhs.g / rhs.g, lhs.b / rhs.b);
 }
 
-inline bool operator==(const Color &lhs, const Color &rhs) {
+constexpr bool operator==(const Color &lhs, const Color &rhs) {
     return (lhs.r == rhs.r) && (lhs.g == rhs.g) && (lhs.b == rhs.b);
 }
 
@@ -114,8 +154,10 @@ struct Image {
 
   uint8_t* toBytes(){
     uint8_t* rawPixels = new uint8_t[width*height*4];
-    for (int i = 0; i < width; i++){
-      for (int j = 0; j < height; j++){
+    // row by row, so both the pixels & the bytes are read & written in order
+    #pragma omp parallel for
+    for (int j = 0; j < height; j++){
+      for (int i = 0; i < width; i++){
         Color col = getPixel(i,j);
         rawPixels[4*(i+j*width)+0] = uint8_t(fmin(col.r,1)*255);
         rawPixels[4*(i+j*width)+1] = uint8_t(fmin(col.g,1)*255);
@@ -126,28 +168,31 @@ struct Image {
     return rawPixels;
   }
 
-  void write(const char* fname){
+  // false if the file couldn't be written
+  bool write(const char* fname){
 
     uint8_t* rawBytes = toBytes();
     
     int lastc = static_cast<int>(strlen(fname));
+    bool written;
 
     switch (fname[lastc-1]){
       case 'g': //jpeg (or jpg) or png
         if (fname[lastc-2] == 'p' || fname[lastc-2] == 'e') //jpeg or jpg
-            stbi_write_jpg(fname, width, height, 4, rawBytes, 95);  //95% jpeg quality
-        else //png
-            stbi_write_png(fname, width, height, 4, rawBytes, width*4);
+            written = stbi_write_jpg(fname, width, height, 4, rawBytes, 95) != 0;  //95% jpeg quality
+        else //png, filtered & deflated on every core
+            written = cblt::WritePNG(fname, width, height, 4, rawBytes);
         break;
       case 'a': //tga (targa)
-        stbi_write_tga(fname, width, height, 4, rawBytes);
+        written = stbi_write_tga(fname, width, height, 4, rawBytes) != 0;
         break;
       case 'p': //bmp
       default:
-        stbi_write_bmp(fname, width, height, 4, rawBytes);
+        written = stbi_write_bmp(fname, width, height, 4, rawBytes) != 0;
     }
 
     delete[] rawBytes;
+    return written;
   }
 
   ~Image(){delete[] pixels;}
@@ -0,0 +1,72 @@
+#include "image_writer.h"
+
+namespace cblt
+{
+    ImageWriter::ImageWriter()
+    {
+        worker_ = std::thread(&ImageWriter::Run, this);
+    }
+
+    ImageWriter::~ImageWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        job_ready_.notify_one();
+        worker_.join();
+    }
+
+    size_t ImageWriter::Write(const std::shared_ptr<Image> &img, const std::string &file_name)
+    {
+        size_t ticket;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back({ img, file_name });
+            ticket = ++queued_;
+        }
+        job_ready_.notify_one();
+        return ticket;
+    }
+
+    bool ImageWriter::Wait(size_t ticket)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        job_done_.wait(lock, [this, ticket]() { return written_ >= ticket; });
+        return failed_.count(ticket) == 0;
+    }
+
+    bool ImageWriter::Wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        size_t ticket = queued_;
+        job_done_.wait(lock, [this, ticket]() { return written_ >= ticket; });
+        return failed_.empty() || *failed_.begin() > ticket;
+    }
+
+    void ImageWriter::Run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+            job_ready_.wait(lock, [this]() { return stop_ || !jobs_.empty(); });
+            // the queue is drained before stopping, so nothing queued is lost
+            if (jobs_.empty())
+            {
+                return;
+            }
+            Job job = std::move(jobs_.front());
+            jobs_.pop_front();
+            lock.unlock();
+            bool written = job.img->write(job.file_name.c_str());
+            job.img = nullptr;
+            lock.lock();
+            ++written_;
+            if (!written)
+            {
+                failed_.insert(written_);
+            }
+            job_done_.notify_all();
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef CBLT_IMAGE_WRITER_H
+#define CBLT_IMAGE_WRITER_H
+
+#include "image_lib.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+namespace cblt
+{
+    /**
+     * @brief Writes images on a background thread, so the caller can start rendering the next frame of a sequence
+     * while the last one is quantized & encoded. Images are written in the order they're queued, each one still
+     * using every core while it's encoded.
+     */
+    class ImageWriter
+    {
+        public:
+        ImageWriter();
+        // waits for every queued image to be written
+        ~ImageWriter();
+        ImageWriter(const ImageWriter &) = delete;
+        ImageWriter &operator=(const ImageWriter &) = delete;
+
+        // queue img to be written to file_name, the image must not change until it has been written. Returns a
+        // ticket to wait on
+        size_t Write(const std::shared_ptr<Image> &img, const std::string &file_name);
+        // block until the image with the ticket, & every one queued before it, has been written. Returns false if
+        // that image couldn't be written
+        bool Wait(size_t ticket);
+        // block until every image queued so far has been written, false if any of them couldn't be
+        bool Wait();
+
+        private:
+        void Run();
+
+        struct Job
+        {
+            std::shared_ptr<Image> img;
+            std::string file_name;
+        };
+        std::deque<Job> jobs_;
+        size_t queued_ = 0;  //! number of images ever queued, the ticket of the last one
+        size_t written_ = 0;
+        std::set<size_t> failed_;  //! tickets of the images which couldn't be written
+        bool stop_ = false;
+        std::mutex mutex_;
+        std::condition_variable job_ready_;
+        std::condition_variable job_done_;
+        std::thread worker_;
+    };
+}
+
+#endif  // CBLT_IMAGE_WRITER_H
@@ -10,7 +10,7 @@ namespace cblt
 
     }
 
-    Color LambertianMaterial::Sample(const Vec3 &incoming, Vec3 &outgoing, float &pdf, const HitInfo &collisionPt, std::shared_ptr<Sampler> &BRDF_sampler)
+    Color LambertianMaterial::Sample(const Vec3 &incoming, Vec3 &outgoing, float &pdf, const HitInfo &collisionPt, std::shared_ptr<Sampler> &BRDF_sampler) const
     {
         float u1, u2;
         Vec3 tangent, bitangent;
@@ -22,13 +22,18 @@ namespace cblt
         return BRDF(incoming, outgoing, collisionPt, pdf);
     }
 
-    Color LambertianMaterial::BRDF(const Vec3 &incoming, const Vec3 &outgoing, const HitInfo &collision_pt, float &pdf)
+    Color LambertianMaterial::BRDF(const Vec3 &incoming, const Vec3 &outgoing, const HitInfo &collision_pt, float &pdf) const
     {
         pdf = .5f * INV_PI_f;
-        return base_ * Dot(collision_pt.norm, incoming) * INV_PI_f;
+        return collision_pt.albedo * Dot(collision_pt.norm, incoming) * INV_PI_f;
     }
 
-    Color LambertianMaterial::Emittance()
+    void LambertianMaterial::EvaluateTextures(HitInfo &collision_pt) const
+    {
+        EvaluateParams(collision_pt, base_, 1.f, 0.f);
+    }
+
+    Color LambertianMaterial::Emittance() const
     {
         return Color::GreyScale(0.f);
     }
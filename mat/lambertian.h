@@ -5,13 +5,14 @@
 
 namespace cblt
 {
-    class LambertianMaterial : public Material
+    class LambertianMaterial final : public Material
     {
         public:
         LambertianMaterial(Color base);
-        virtual Color Sample(const Vec3 &outgoing, Vec3 &incoming, float &pdf, const HitInfo &collisionPt, std::shared_ptr<Sampler> &BRDF_sampler) override;
-        virtual Color BRDF(const Vec3 &outgoing, const Vec3 &incoming, const HitInfo &collision_pt, float &pdf) override;
-        virtual Color Emittance() override;
+        Color Sample(const Vec3 &outgoing, Vec3 &incoming, float &pdf, const HitInfo &collisionPt, std::shared_ptr<Sampler> &BRDF_sampler) const;
+        Color BRDF(const Vec3 &outgoing, const Vec3 &incoming, const HitInfo &collision_pt, float &pdf) const;
+        Color Emittance() const;
+        void EvaluateTextures(HitInfo &collision_pt) const;
         private:
         Color base_;
     };
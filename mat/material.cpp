@@ -0,0 +1,39 @@
+#include "material.h"
+
+#include "math/constants.h"
+
+#include <cmath>
+
+namespace cblt
+{
+    void Material::EvaluateParams(HitInfo &collision_pt, const Color &albedo, float roughness, float metallic) const
+    {
+        const Vec2 &uv = collision_pt.uv;
+        float footprint = collision_pt.uv_footprint;
+
+        collision_pt.albedo = (albedo_map_) ? albedo_map_->Sample(uv, footprint) : albedo;
+        collision_pt.roughness = (roughness_map_) ? roughness_map_->Sample(uv, footprint).r : roughness;
+        collision_pt.metallic = (metallic_map_) ? metallic_map_->Sample(uv, footprint).r : metallic;
+
+        if (normal_map_)
+        {
+            // build the tangent frame, making sure the tangent is perpendicular to the interpolated normal
+            Vec3 norm = collision_pt.norm;
+            Vec3 tangent = collision_pt.tangent - norm * Dot(collision_pt.tangent, norm);
+            float tan_len = Magnitude(tangent);
+            if (tan_len > eps_zero_F)
+            {
+                tangent = tangent / tan_len;
+                Vec3 bitangent = Cross(norm, tangent);
+                // texels are stored in [0, 1], so remap them to [-1, 1]
+                Color tex_norm = normal_map_->Sample(uv, footprint);
+                Vec3 mapped = tangent * (tex_norm.r * 2.f - 1.f) + bitangent * (tex_norm.g * 2.f - 1.f) + norm * (tex_norm.b * 2.f - 1.f);
+                float mapped_len = Magnitude(mapped);
+                if (mapped_len > eps_zero_F)
+                {
+                    collision_pt.norm = mapped / mapped_len;
+                }
+            }
+        }
+    }
+}
@@ -2,6 +2,7 @@
 #define CBLT_MATERIAL_H
 
 #include "image_lib.h"
+#include "texture.h"
 #include "mat/sampler.h"
 #include "geom/ray.h"
 #include "geom/hit_info.h"
@@ -13,28 +14,36 @@ namespace cblt
     class HitInfo;
 
     /**
-     * An interface for defining materials. This defines the essential functions for illumination and sampling
-     * for both Ray Tracing and Path Tracing.
+     * The parameters shared by every material, i.e. the optional texture maps & index of refraction. Materials
+     * aren't polymorphic; each one provides the same non-virtual shading functions, and MaterialTable dispatches
+     * to them with std::visit over its closed set of material types:
+     *
+     * Color Sample(const Vec3 &incoming, Vec3 &outgoing, float &pdf, const HitInfo &collision_pt, std::shared_ptr<Sampler> &BRDF_sampler) const;
+     *     sample an outgoing direction & return the BRDF for it
+     * Color BRDF(const Vec3 &incoming, const Vec3 &outgoing, const HitInfo &collision_pt, float &pdf) const;
+     *     evaluate the BRDF & the pdf with which Sample() would have chosen outgoing
+     * Color Emittance() const;
+     * void EvaluateTextures(HitInfo &collision_pt) const;
+     *     look up the material's textures at the closest hit and store the resulting parameters in the hit info,
+     *     so every BRDF evaluation at the shading point reuses them instead of sampling again
      */ 
     class Material {
     public:    
-
-        // Path Tracing Functions
-        /**
-         * \brief Calculates the material color at the given location and viewing angle
-         * \param incoming Vector which defines the incident light ray
-         * \param collision Data struct containing the collision location and normal
-         * \param outgoing Vector which defines the outgoing direction towards the camera eye
-         */ 
-        virtual Color Sample(const Vec3 &incoming, Vec3 &outgoing, float &pdf, const HitInfo &collisionPt, std::shared_ptr<Sampler> &BRDF_sampler) = 0;
-        virtual Color BRDF(const Vec3 &incoming, const Vec3 &outgoing, const HitInfo &collision_pt, float &pdf) = 0;
-        virtual Color Emittance() = 0;
         float IOR() const { return ior_; };
+        void SetBaseTexture(const std::shared_ptr<Texture> &tex) { albedo_map_ = tex; };
+        void SetNormalTexture(const std::shared_ptr<Texture> &tex) { normal_map_ = tex; };
+        void SetRoughnessTexture(const std::shared_ptr<Texture> &tex) { roughness_map_ = tex; };
+        void SetMetallicTexture(const std::shared_ptr<Texture> &tex) { metallic_map_ = tex; };
         
     protected:
-        Image *albedo_map_ = nullptr;  //! Optional albedo texture for better rendering
-        Image *normal_map_ = nullptr;  //! Optional normal texture for better surface lighting
-        float ior_;  //! index of refraction for the material
+        // fill in the textured parameters of the hit, falling back to the constant values when there is no texture
+        void EvaluateParams(HitInfo &collision_pt, const Color &albedo, float roughness, float metallic) const;
+
+        std::shared_ptr<Texture> albedo_map_ = nullptr;  //! Optional albedo texture for better rendering
+        std::shared_ptr<Texture> normal_map_ = nullptr;  //! Optional normal texture for better surface lighting
+        std::shared_ptr<Texture> roughness_map_ = nullptr;  //! Optional roughness texture, read from the red channel
+        std::shared_ptr<Texture> metallic_map_ = nullptr;  //! Optional metallic texture, read from the red channel
+        float ior_ = 1.f;  //! index of refraction for the material
     };
 }
 #endif  // CBLT_MATERIAL_H
\ No newline at end of file
@@ -0,0 +1,20 @@
+#include "material_table.h"
+
+namespace cblt
+{
+    MaterialId MaterialTable::Add(const MaterialVariant &material)
+    {
+        materials_.push_back(material);
+        return static_cast<MaterialId>(materials_.size() - 1);
+    }
+
+    const Material &MaterialTable::Base(MaterialId id) const
+    {
+        return std::visit([](const auto &mat) -> const Material & { return mat; }, materials_[id]);
+    }
+
+    Material &MaterialTable::Base(MaterialId id)
+    {
+        return std::visit([](auto &mat) -> Material & { return mat; }, materials_[id]);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef CBLT_MATERIAL_TABLE_H
+#define CBLT_MATERIAL_TABLE_H
+
+#include "cook_torrence.h"
+#include "disney_principled.h"
+#include "lambertian.h"
+#include "mem/memory_arena.h"
+
+#include <variant>
+#include <vector>
+
+namespace cblt
+{
+    // every kind of material, the order of the alternatives is the order MaterialTable::Type() reports them in
+    using MaterialVariant = std::variant<DisneyPrincipledMaterial, CookTorrenceMaterial, LambertianMaterial>;
+
+    /**
+     * @brief Every material in a scene, stored by value and referred to by a compact MaterialId. Shading calls are
+     * dispatched with std::visit, which switches on the material's type instead of making an indirect call, so
+     * the compiler is free to inline each material's BRDF into the integrator. Hits carry only the id, so finding
+     * a closer hit never touches a reference count.
+     */
+    class MaterialTable
+    {
+        public:
+        MaterialId Add(const MaterialVariant &material);
+        size_t Size() const { return materials_.size(); };
+        // index of the material's type in MaterialVariant, e.g. for grouping shading work by type
+        size_t Type(MaterialId id) const { return materials_[id].index(); };
+        // the parameters common to every type of material
+        const Material &Base(MaterialId id) const;
+        Material &Base(MaterialId id);
+
+        Color Sample(MaterialId id, const Vec3 &incoming, Vec3 &outgoing, float &pdf, const HitInfo &collision_pt, std::shared_ptr<Sampler> &BRDF_sampler) const
+        {
+            return std::visit([&](const auto &mat) { return mat.Sample(incoming, outgoing, pdf, collision_pt, BRDF_sampler); }, materials_[id]);
+        };
+        Color BRDF(MaterialId id, const Vec3 &incoming, const Vec3 &outgoing, const HitInfo &collision_pt, float &pdf) const
+        {
+            return std::visit([&](const auto &mat) { return mat.BRDF(incoming, outgoing, collision_pt, pdf); }, materials_[id]);
+        };
+        Color Emittance(MaterialId id) const
+        {
+            return std::visit([](const auto &mat) { return mat.Emittance(); }, materials_[id]);
+        };
+        void EvaluateTextures(MaterialId id, HitInfo &collision_pt) const
+        {
+            std::visit([&](const auto &mat) { mat.EvaluateTextures(collision_pt); }, materials_[id]);
+        };
+        float IOR(MaterialId id) const { return Base(id).IOR(); };
+        private:
+        std::vector<MaterialVariant, TrackedAllocator<MaterialVariant, mem_materials>> materials_;
+    };
+}
+
+#endif  // CBLT_MATERIAL_TABLE_H
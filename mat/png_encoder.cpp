@@ -0,0 +1,503 @@
+#include "png_encoder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace cblt
+{
+    namespace
+    {
+        const int chunk_bytes = 1 << 18;  // filtered bytes deflated by each task, & stored in each IDAT
+        const int window_size = 1 << 15;  // furthest back a deflate match may refer
+        const int hash_bits = 15;
+        const int max_chain = 8;  // candidates tried when looking for the longest match
+        const int min_match = 3;
+        const int max_match = 258;
+
+        const int len_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        const int len_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        const int dist_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+                                    4097, 6145, 8193, 12289, 16385, 24577 };
+        const int dist_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+        // writes the least significant bit of each value first, as deflate expects
+        class BitWriter
+        {
+            public:
+            BitWriter(std::vector<uint8_t> &out) : out_(out) {};
+            void Put(uint32_t val, int count)
+            {
+                bits_ |= val << count_;
+                count_ += count;
+                while (count_ >= 8)
+                {
+                    out_.push_back(static_cast<uint8_t>(bits_));
+                    bits_ >>= 8;
+                    count_ -= 8;
+                }
+            }
+            void Align()
+            {
+                if (count_ > 0)
+                {
+                    out_.push_back(static_cast<uint8_t>(bits_));
+                }
+                bits_ = 0;
+                count_ = 0;
+            }
+            private:
+            std::vector<uint8_t> &out_;
+            uint32_t bits_ = 0;
+            int count_ = 0;
+        };
+
+        // the fixed Huffman codes of RFC 1951, bit reversed ready to be packed, & the symbol for each length & distance
+        struct FixedCodes
+        {
+            uint16_t lit_code[288];
+            uint8_t lit_bits[288];
+            uint16_t dist_code[30];
+            uint8_t len_sym[max_match + 1];
+            uint8_t dist_sym[window_size + 1];
+
+            static uint16_t Reverse(uint32_t code, int count)
+            {
+                uint32_t rev = 0;
+                for (int i = 0; i < count; ++i)
+                {
+                    rev = (rev << 1) | ((code >> i) & 1);
+                }
+                return static_cast<uint16_t>(rev);
+            }
+
+            FixedCodes()
+            {
+                for (int sym = 0; sym < 288; ++sym)
+                {
+                    uint32_t code;
+                    if (sym <= 143)
+                    {
+                        code = 0x30 + sym;
+                        lit_bits[sym] = 8;
+                    }
+                    else if (sym <= 255)
+                    {
+                        code = 0x190 + sym - 144;
+                        lit_bits[sym] = 9;
+                    }
+                    else if (sym <= 279)
+                    {
+                        code = sym - 256;
+                        lit_bits[sym] = 7;
+                    }
+                    else
+                    {
+                        code = 0xC0 + sym - 280;
+                        lit_bits[sym] = 8;
+                    }
+                    lit_code[sym] = Reverse(code, lit_bits[sym]);
+                }
+                for (int d = 0; d < 30; ++d)
+                {
+                    dist_code[d] = Reverse(d, 5);
+                }
+                for (int len = min_match, l = 0; len <= max_match; ++len)
+                {
+                    while (l < 28 && len_base[l + 1] <= len)
+                    {
+                        ++l;
+                    }
+                    len_sym[len] = static_cast<uint8_t>(l);
+                }
+                for (int dist = 1, d = 0; dist <= window_size; ++dist)
+                {
+                    while (d < 29 && dist_base[d + 1] <= dist)
+                    {
+                        ++d;
+                    }
+                    dist_sym[dist] = static_cast<uint8_t>(d);
+                }
+            }
+        };
+
+        const FixedCodes &Codes()
+        {
+            static const FixedCodes codes;
+            return codes;
+        }
+
+        void PutSymbol(BitWriter &bits, const FixedCodes &codes, int sym)
+        {
+            bits.Put(codes.lit_code[sym], codes.lit_bits[sym]);
+        }
+
+        void PutMatch(BitWriter &bits, const FixedCodes &codes, int len, int dist)
+        {
+            int l = codes.len_sym[len];
+            PutSymbol(bits, codes, 257 + l);
+            bits.Put(len - len_base[l], len_extra[l]);
+            int d = codes.dist_sym[dist];
+            bits.Put(codes.dist_code[d], 5);
+            bits.Put(dist - dist_base[d], dist_extra[d]);
+        }
+
+        uint32_t Hash(const uint8_t *p)
+        {
+            uint32_t val = p[0] | (p[1] << 8) | (p[2] << 16);
+            return (val * 2654435761U) >> (32 - hash_bits);
+        }
+
+        /**
+         * Deflate data[start, end) with fixed Huffman codes & greedy LZ77 matching, one step lazy. Matches may
+         * start up to a window before start, but never run past end, so each chunk decodes to exactly its bytes
+         */
+        void DeflateChunk(const uint8_t *data, size_t size, size_t start, size_t end, bool last, std::vector<uint8_t> &out)
+        {
+            std::vector<int64_t> head(size_t(1) << hash_bits, -1);
+            std::vector<int64_t> prev(window_size, -1);
+            auto insert = [&](size_t pos)
+            {
+                if (pos + 2 < size)
+                {
+                    uint32_t h = Hash(data + pos);
+                    prev[pos & (window_size - 1)] = head[h];
+                    head[h] = static_cast<int64_t>(pos);
+                }
+            };
+            auto find_match = [&](size_t pos, int &best_dist)
+            {
+                int limit = static_cast<int>(std::min<size_t>(max_match, end - pos));
+                int best_len = 0;
+                if (limit < min_match)
+                {
+                    return 0;
+                }
+                int64_t cand = head[Hash(data + pos)];
+                for (int chain = 0; chain < max_chain && cand >= 0; ++chain)
+                {
+                    int64_t dist = static_cast<int64_t>(pos) - cand;
+                    if (dist <= 0 || dist > window_size)
+                    {
+                        break;
+                    }
+                    const uint8_t *a = data + pos;
+                    const uint8_t *b = data + cand;
+                    if (b[best_len] == a[best_len])
+                    {
+                        int len = 0;
+                        while (len < limit && a[len] == b[len])
+                        {
+                            ++len;
+                        }
+                        if (len > best_len)
+                        {
+                            best_len = len;
+                            best_dist = static_cast<int>(dist);
+                            if (len == limit)
+                            {
+                                break;
+                            }
+                        }
+                    }
+                    // the chain is only valid while it keeps going back, older slots have been reused
+                    int64_t next = prev[cand & (window_size - 1)];
+                    if (next >= cand)
+                    {
+                        break;
+                    }
+                    cand = next;
+                }
+                return (best_len >= min_match) ? best_len : 0;
+            };
+
+            // the window before the chunk is already known to the decoder
+            for (size_t pos = (start > window_size) ? start - window_size : 0; pos < start; ++pos)
+            {
+                insert(pos);
+            }
+
+            const FixedCodes &codes = Codes();
+            BitWriter bits(out);
+            bits.Put(last ? 1 : 0, 1);
+            bits.Put(1, 2);  // fixed Huffman codes
+            size_t pos = start;
+            while (pos < end)
+            {
+                int dist = 0;
+                int len = find_match(pos, dist);
+                if (len > 0 && pos + 1 < end)
+                {
+                    // defer to a longer match starting at the next byte
+                    insert(pos);
+                    int next_dist = 0;
+                    int next_len = find_match(pos + 1, next_dist);
+                    if (next_len > len)
+                    {
+                        PutSymbol(bits, codes, data[pos]);
+                        ++pos;
+                        len = next_len;
+                        dist = next_dist;
+                    }
+                    else
+                    {
+                        // pos is already in the hash chains
+                        PutMatch(bits, codes, len, dist);
+                        for (int i = 1; i < len; ++i)
+                        {
+                            insert(pos + i);
+                        }
+                        pos += len;
+                        continue;
+                    }
+                }
+                if (len > 0)
+                {
+                    PutMatch(bits, codes, len, dist);
+                    for (int i = 0; i < len; ++i)
+                    {
+                        insert(pos + i);
+                    }
+                    pos += len;
+                }
+                else
+                {
+                    PutSymbol(bits, codes, data[pos]);
+                    insert(pos);
+                    ++pos;
+                }
+            }
+            PutSymbol(bits, codes, 256);  // end of block
+            if (!last)
+            {
+                // an empty stored block ends the chunk on a byte boundary
+                bits.Put(0, 3);
+                bits.Align();
+                out.push_back(0x00);
+                out.push_back(0x00);
+                out.push_back(0xFF);
+                out.push_back(0xFF);
+            }
+            else
+            {
+                bits.Align();
+            }
+        }
+
+        uint32_t Adler32(const uint8_t *data, size_t len)
+        {
+            uint32_t s1 = 1, s2 = 0;
+            while (len > 0)
+            {
+                // the sums can't overflow within 5552 bytes
+                size_t block = std::min<size_t>(len, 5552);
+                len -= block;
+                for (size_t i = 0; i < block; ++i)
+                {
+                    s1 += data[i];
+                    s2 += s1;
+                }
+                data += block;
+                s1 %= 65521;
+                s2 %= 65521;
+            }
+            return (s2 << 16) | s1;
+        }
+
+        // checksum of the concatenation of two buffers, the second of which is len2 bytes long
+        uint32_t Adler32Combine(uint32_t adler1, uint32_t adler2, size_t len2)
+        {
+            const uint32_t base = 65521;
+            uint32_t rem = static_cast<uint32_t>(len2 % base);
+            uint32_t sum1 = adler1 & 0xFFFF;
+            uint32_t sum2 = static_cast<uint32_t>((static_cast<uint64_t>(rem) * sum1) % base);
+            sum1 += (adler2 & 0xFFFF) + base - 1;
+            sum2 += (adler1 >> 16) + (adler2 >> 16) + base - rem;
+            sum1 %= base;
+            sum2 %= base;
+            return (sum2 << 16) | sum1;
+        }
+
+        uint32_t Crc32(const uint8_t *data, size_t len, uint32_t crc = 0)
+        {
+            static const struct CrcTable
+            {
+                uint32_t vals[256];
+                CrcTable()
+                {
+                    for (uint32_t i = 0; i < 256; ++i)
+                    {
+                        uint32_t c = i;
+                        for (int k = 0; k < 8; ++k)
+                        {
+                            c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+                        }
+                        vals[i] = c;
+                    }
+                }
+            } table;
+            crc = ~crc;
+            for (size_t i = 0; i < len; ++i)
+            {
+                crc = table.vals[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            }
+            return ~crc;
+        }
+
+        void PutU32(std::vector<uint8_t> &out, uint32_t val)
+        {
+            out.push_back(static_cast<uint8_t>(val >> 24));
+            out.push_back(static_cast<uint8_t>(val >> 16));
+            out.push_back(static_cast<uint8_t>(val >> 8));
+            out.push_back(static_cast<uint8_t>(val));
+        }
+
+        // a PNG chunk of the given type, whose data has already been appended to out after 8 reserved bytes
+        void FinishChunk(std::vector<uint8_t> &out, size_t chunk_start, const char type[4])
+        {
+            uint32_t len = static_cast<uint32_t>(out.size() - chunk_start - 8);
+            for (int i = 0; i < 4; ++i)
+            {
+                out[chunk_start + i] = static_cast<uint8_t>(len >> (24 - 8 * i));
+                out[chunk_start + 4 + i] = static_cast<uint8_t>(type[i]);
+            }
+            PutU32(out, Crc32(out.data() + chunk_start + 4, len + 4));
+        }
+
+        int Paeth(int a, int b, int c)
+        {
+            int p = a + b - c;
+            int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+            if (pa <= pb && pa <= pc)
+            {
+                return a;
+            }
+            return (pb <= pc) ? b : c;
+        }
+
+        // filter one row with whichever of the five filters gives the smallest sum of signed bytes
+        void FilterRow(const uint8_t *row, const uint8_t *above, int row_bytes, int bpp, uint8_t *out)
+        {
+            std::vector<uint8_t> trial(row_bytes);
+            long best_cost = -1;
+            for (int filter = 0; filter < 5; ++filter)
+            {
+                long cost = 0;
+                for (int i = 0; i < row_bytes; ++i)
+                {
+                    int a = (i >= bpp) ? row[i - bpp] : 0;
+                    int b = above ? above[i] : 0;
+                    int c = (above && i >= bpp) ? above[i - bpp] : 0;
+                    int pred = 0;
+                    switch (filter)
+                    {
+                        case 1: pred = a; break;
+                        case 2: pred = b; break;
+                        case 3: pred = (a + b) >> 1; break;
+                        case 4: pred = Paeth(a, b, c); break;
+                        default: break;
+                    }
+                    trial[i] = static_cast<uint8_t>(row[i] - pred);
+                    cost += std::abs(static_cast<int>(static_cast<int8_t>(trial[i])));
+                }
+                if (best_cost < 0 || cost < best_cost)
+                {
+                    best_cost = cost;
+                    out[0] = static_cast<uint8_t>(filter);
+                    std::copy(trial.begin(), trial.end(), out + 1);
+                }
+            }
+        }
+    }
+
+    bool EncodePNG(int width, int height, int channels, const uint8_t *pixels, std::vector<uint8_t> &png)
+    {
+        if (width <= 0 || height <= 0 || (channels != 3 && channels != 4))
+        {
+            return false;
+        }
+        int row_bytes = width * channels;
+        size_t filtered_size = static_cast<size_t>(height) * (row_bytes + 1);
+        std::vector<uint8_t> filtered(filtered_size);
+        #pragma omp parallel for schedule(dynamic, 16)
+        for (int y = 0; y < height; ++y)
+        {
+            const uint8_t *row = pixels + static_cast<size_t>(y) * row_bytes;
+            const uint8_t *above = (y > 0) ? row - row_bytes : nullptr;
+            FilterRow(row, above, row_bytes, channels, filtered.data() + static_cast<size_t>(y) * (row_bytes + 1));
+        }
+
+        // each chunk is deflated straight into its own IDAT, so its CRC is computed in parallel too
+        int num_chunks = static_cast<int>((filtered_size + chunk_bytes - 1) / chunk_bytes);
+        std::vector<std::vector<uint8_t>> idats(num_chunks);
+        std::vector<uint32_t> adlers(num_chunks);
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < num_chunks; ++i)
+        {
+            size_t start = static_cast<size_t>(i) * chunk_bytes;
+            size_t end = std::min(filtered_size, start + chunk_bytes);
+            std::vector<uint8_t> &idat = idats[i];
+            idat.reserve((end - start) / 2 + 64);
+            idat.resize(8);
+            if (i == 0)
+            {
+                // zlib header, deflate with a 32KB window & no preset dictionary
+                idat.push_back(0x78);
+                idat.push_back(0x01);
+            }
+            DeflateChunk(filtered.data(), filtered_size, start, end, i + 1 == num_chunks, idat);
+            FinishChunk(idat, 0, "IDAT");
+            adlers[i] = Adler32(filtered.data() + start, end - start);
+        }
+
+        const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        png.assign(signature, signature + 8);
+        size_t chunk_start = png.size();
+        png.resize(chunk_start + 8);
+        PutU32(png, static_cast<uint32_t>(width));
+        PutU32(png, static_cast<uint32_t>(height));
+        png.push_back(8);  // bit depth
+        png.push_back((channels == 4) ? 6 : 2);  // RGBA or RGB
+        png.push_back(0);  // deflate
+        png.push_back(0);  // adaptive filtering
+        png.push_back(0);  // not interlaced
+        FinishChunk(png, chunk_start, "IHDR");
+
+        uint32_t adler = adlers[0];
+        for (int i = 0; i < num_chunks; ++i)
+        {
+            png.insert(png.end(), idats[i].begin(), idats[i].end());
+            if (i > 0)
+            {
+                size_t start = static_cast<size_t>(i) * chunk_bytes;
+                adler = Adler32Combine(adler, adlers[i], std::min(filtered_size, start + chunk_bytes) - start);
+            }
+        }
+        // the zlib stream ends with the checksum of everything, which only a final IDAT of its own can hold
+        chunk_start = png.size();
+        png.resize(chunk_start + 8);
+        PutU32(png, adler);
+        FinishChunk(png, chunk_start, "IDAT");
+
+        chunk_start = png.size();
+        png.resize(chunk_start + 8);
+        FinishChunk(png, chunk_start, "IEND");
+        return true;
+    }
+
+    bool WritePNG(const char *file_name, int width, int height, int channels, const uint8_t *pixels)
+    {
+        std::vector<uint8_t> png;
+        if (!EncodePNG(width, height, channels, pixels, png))
+        {
+            return false;
+        }
+        FILE *file = std::fopen(file_name, "wb");
+        if (!file)
+        {
+            return false;
+        }
+        bool written = std::fwrite(png.data(), 1, png.size(), file) == png.size();
+        return (std::fclose(file) == 0) && written;
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef CBLT_PNG_ENCODER_H
+#define CBLT_PNG_ENCODER_H
+
+#include <cstdint>
+#include <vector>
+
+namespace cblt
+{
+    /**
+     * @brief Encode 8 bit pixels as a PNG, using every core. Rows are filtered in parallel, then the filtered image
+     * is split into chunks which are deflated in parallel, each into its own IDAT. A chunk may still match data
+     * in the 32KB before it, which the decoder has already seen, so splitting costs little compression. Every
+     * chunk but the last ends on a byte boundary with an empty stored block (a sync flush), so they concatenate
+     * into a single zlib stream.
+     * @param channels 3 for RGB or 4 for RGBA, pixels are row by row from the top
+     */
+    bool EncodePNG(int width, int height, int channels, const uint8_t *pixels, std::vector<uint8_t> &png);
+    bool WritePNG(const char *file_name, int width, int height, int channels, const uint8_t *pixels);
+}
+
+#endif  // CBLT_PNG_ENCODER_H
@@ -4,7 +4,7 @@
 #include "math/math_helpers.h"
 #include "math/constants.h"
 #include "shading_helpers.h"
-#include "mat4.h"
+#include "math/frame.h"
 #include "sampler.h"
 
 #include <memory>
@@ -47,10 +47,8 @@ namespace cblt
         
         Vec3 rand_vec(x, u1, z);
         
-        Mat4 BNT(Vec4(bitangent, 0.f), Vec4(normal, 0.f), Vec4(tangent, 0.f), Vec4(0.f, 0.f, 0.f, 1.f));
-        Vec4 out_vec = BNT * Vec4(rand_vec, 0);
-
-        Vec3 result = Normalize(Vec3(out_vec.x, out_vec.y, out_vec.z));
+        Frame BNT(bitangent, normal, tangent);
+        Vec3 result = Normalize(BNT.FromLocal(rand_vec));
         if(Dot(result, normal) < 0) {
             // make sure the sample is inside the hemisphere
             result = result * -1.f;
@@ -67,10 +65,8 @@ namespace cblt
 
         Vec3 rand_vec(sample.x, y, sample.y);
         
-        Mat4 BNT(Vec4(bitangent, 0.f), Vec4(normal, 0.f), Vec4(tangent, 0.f), Vec4(0.f, 0.f, 0.f, 1.f));
-        Vec4 out_vec = BNT * Vec4(rand_vec, 0);
-
-        Vec3 result = Normalize(Vec3(out_vec.x, out_vec.y, out_vec.z));
+        Frame BNT(bitangent, normal, tangent);
+        Vec3 result = Normalize(BNT.FromLocal(rand_vec));
         pdf = Dot(result, normal) * INV_PI_f;
         return result;
     }
@@ -78,10 +74,8 @@ namespace cblt
     inline Vec3 RandomUnitVectorInGTR1(const Vec3 &bitangent, const Vec3 &normal, const Vec3 &tangent, const Vec3 &outgoing,
                                        const float alpha, float &pdf, const float u1, const float u2)
     {
-        Mat4 Tan_To_World(Vec4(bitangent, 0.f), Vec4(normal, 0.f), Vec4(tangent, 0.f), Vec4(0.f, 0.f, 0.f, 1.f));
-        Mat4 World_To_Tan = OrthoInverse(Tan_To_World);
-        Vec4 out_tan = World_To_Tan * Vec4(outgoing, 0.f);
-        Vec3 w_o = { out_tan.x, out_tan.y, out_tan.z };
+        Frame BNT(bitangent, normal, tangent);
+        Vec3 w_o = BNT.ToLocal(outgoing);
 
         float alpha_sqr = sqr(alpha);
         float cos_theta = std::sqrt((1.f - std::pow(alpha_sqr, 1.f - u1)) / (1.f - alpha_sqr));
@@ -109,18 +103,14 @@ namespace cblt
         pdf = GTR1(cos_theta, alpha) * cos_theta / (4.f * O_dot_S);
     
         // take back from tangent space to world space
-        Vec4 out_vec = Tan_To_World * Vec4(w_i, 0.f);
-        Vec3 result = { out_vec.x, out_vec.y, out_vec.z };
-        return Normalize(result);
+        return Normalize(BNT.FromLocal(w_i));
     }
 
     // Adapted from https://schuttejoe.github.io/post/ggximportancesamplingpart1/
     inline Vec3 RandomUnitVectorInGGX(const Vec3 &bitangent, const Vec3 &normal, const Vec3 &tangent, const Vec3 &outgoing, 
                                       const float alpha, float &pdf, const float u1, const float u2) {
-        Mat4 Tan_To_World(Vec4(bitangent, 0.f), Vec4(normal, 0.f), Vec4(tangent, 0.f), Vec4(0.f, 0.f, 0.f, 1.f));
-        Mat4 World_To_Tan = OrthoInverse(Tan_To_World);
-        Vec4 out_tan = World_To_Tan * Vec4(outgoing, 0.f);
-        Vec3 w_o = { out_tan.x, out_tan.y, out_tan.z };
+        Frame BNT(bitangent, normal, tangent);
+        Vec3 w_o = BNT.ToLocal(outgoing);
 
         // Formula from: https://agraphicsguy.wordpress.com/2015/11/01/sampling-microfacet-brdf/
         float alpha_sqr = alpha * alpha;
@@ -150,17 +140,13 @@ namespace cblt
         pdf = GGX(cos_theta, alpha) * cos_theta / (4.f * O_dot_S);
     
         // take back from tangent space to world space
-        Vec4 out_vec = Tan_To_World * Vec4(w_i, 0.f);
-        Vec3 result = { out_vec.x, out_vec.y, out_vec.z };
-        return Normalize(result);
+        return Normalize(BNT.FromLocal(w_i));
 }
 
     inline Vec3 RandomUnitVectorInGGXAniso(const Vec3 &bitangent, const Vec3 &normal, const Vec3 &tangent, const Vec3 &outgoing, 
                                       const float alpha_x, const float alpha_y, float &pdf, const float u1, const float u2) {
-        Mat4 Tan_To_World(Vec4(bitangent, 0.f), Vec4(normal, 0.f), Vec4(tangent, 0.f), Vec4(0.f, 0.f, 0.f, 1.f));
-        Mat4 World_To_Tan = OrthoInverse(Tan_To_World);
-        Vec4 out_tan = World_To_Tan * Vec4(outgoing, 0.f);
-        Vec3 w_o = { out_tan.x, out_tan.y, out_tan.z };
+        Frame BNT(bitangent, normal, tangent);
+        Vec3 w_o = BNT.ToLocal(outgoing);
 
         // Formula from: https://agraphicsguy.wordpress.com/2018/07/18/sampling-anisotropic-microfacet-brdf/
         float phi = std::atan((alpha_y / alpha_x) * std::tan(2 * cblt::PI_f * u1 + .5f * cblt::PI_f));
@@ -195,9 +181,7 @@ namespace cblt
         pdf = GGX_aniso(alpha_x, alpha_y, sample.x, sample.z, sample.y) * cos_theta / (4.f * O_dot_S);
     
         // take back from tangent space to world space
-        Vec4 out_vec = Tan_To_World * Vec4(w_i, 0.f);
-        Vec3 result = { out_vec.x, out_vec.y, out_vec.z };
-        return Normalize(result);
+        return Normalize(BNT.FromLocal(w_i));
     }
 
     // A Simpler and Exact Sampling Routine for the GGX Distribution of Visible Normals by Eric Heitz
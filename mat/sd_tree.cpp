@@ -0,0 +1,363 @@
+#include "sd_tree.h"
+
+#include "math/constants.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cblt
+{
+    namespace
+    {
+        const float sd_split_base = 12000.f;  // records a spatial leaf needs before splitting, grows by sqrt(2) a pass
+        const int sd_max_depth = 20;
+        const float d_split_fraction = .01f;  // fraction of the energy a directional quadrant needs before splitting
+        const int d_max_depth = 20;
+
+        void AtomicAdd(std::atomic<float> &dst, float val)
+        {
+            float cur = dst.load(std::memory_order_relaxed);
+            while (!dst.compare_exchange_weak(cur, cur + val, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        // area preserving map from the sphere of directions to the unit square
+        void DirToSquare(const Vec3 &dir, float &x, float &y)
+        {
+            float cos_theta = std::max(-1.f, std::min(1.f, dir.z));
+            float phi = std::atan2(dir.y, dir.x);
+            if (phi < 0.f)
+            {
+                phi += 2.f * PI_f;
+            }
+            x = std::min(.5f * (cos_theta + 1.f), .99999994f);
+            y = std::min(phi / (2.f * PI_f), .99999994f);
+        }
+
+        Vec3 SquareToDir(float x, float y)
+        {
+            float cos_theta = 2.f * x - 1.f;
+            float sin_theta = std::sqrt(std::max(0.f, 1.f - cos_theta * cos_theta));
+            float phi = 2.f * PI_f * y;
+            return Vec3(sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta);
+        }
+
+        // the quadrant of the unit square containing (x, y), which is then rescaled to the quadrant
+        int Quadrant(float &x, float &y)
+        {
+            int quad = 0;
+            x *= 2.f;
+            y *= 2.f;
+            if (x >= 1.f)
+            {
+                quad += 1;
+                x -= 1.f;
+            }
+            if (y >= 1.f)
+            {
+                quad += 2;
+                y -= 1.f;
+            }
+            return quad;
+        }
+    }
+
+    DTree::Node::Node()
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            sum_[i].store(0.f, std::memory_order_relaxed);
+        }
+    }
+
+    DTree::Node::Node(const Node &other)
+    {
+        *this = other;
+    }
+
+    DTree::Node &DTree::Node::operator=(const Node &other)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            sum_[i].store(other.sum_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            child_[i] = other.child_[i];
+        }
+        return *this;
+    }
+
+    DTree::DTree() : sampling_(1), building_(1), num_samples_(0)
+    {
+    }
+
+    DTree::DTree(const DTree &other) : num_samples_(0)
+    {
+        *this = other;
+    }
+
+    DTree &DTree::operator=(const DTree &other)
+    {
+        sampling_ = other.sampling_;
+        building_ = other.building_;
+        sampling_total_ = other.sampling_total_;
+        num_samples_.store(other.NumSamples(), std::memory_order_relaxed);
+        return *this;
+    }
+
+    void DTree::Record(const Vec3 &dir, float radiance)
+    {
+        if (!std::isfinite(radiance) || radiance < 0.f)
+        {
+            return;
+        }
+        num_samples_.fetch_add(1, std::memory_order_relaxed);
+        if (radiance == 0.f)
+        {
+            return;
+        }
+
+        float x, y;
+        DirToSquare(dir, x, y);
+        int node = 0;
+        while (true)
+        {
+            int quad = Quadrant(x, y);
+            AtomicAdd(building_[node].sum_[quad], radiance);
+            node = building_[node].child_[quad];
+            if (node == 0)
+            {
+                return;
+            }
+        }
+    }
+
+    Vec3 DTree::Sample(float u1, float u2) const
+    {
+        // the sampled point is built up from the quadrant chosen at each level
+        float org_x = 0.f, org_y = 0.f, size = 1.f;
+        int node = 0;
+        while (true)
+        {
+            const Node &cur = sampling_[node];
+            float sums[4];
+            for (int i = 0; i < 4; ++i)
+            {
+                sums[i] = cur.sum_[i].load(std::memory_order_relaxed);
+            }
+            float total = sums[0] + sums[1] + sums[2] + sums[3];
+            if (total <= 0.f)
+            {
+                sums[0] = sums[1] = sums[2] = sums[3] = total = 1.f;
+            }
+
+            // choose the left or right half, then the bottom or top quadrant of that half
+            int quad = 0;
+            float left = (sums[0] + sums[2]) / total;
+            if (u1 < left)
+            {
+                u1 /= left;
+            }
+            else
+            {
+                u1 = (u1 - left) / (1.f - left);
+                quad += 1;
+            }
+            float bottom = sums[quad] / (sums[quad] + sums[quad + 2]);
+            if (u2 < bottom)
+            {
+                u2 /= bottom;
+            }
+            else
+            {
+                u2 = (u2 - bottom) / (1.f - bottom);
+                quad += 2;
+            }
+            u1 = std::min(u1, .99999994f);
+            u2 = std::min(u2, .99999994f);
+
+            size *= .5f;
+            org_x += (quad & 1) ? size : 0.f;
+            org_y += (quad & 2) ? size : 0.f;
+            node = cur.child_[quad];
+            if (node == 0)
+            {
+                // uniform within the leaf
+                return SquareToDir(org_x + u1 * size, org_y + u2 * size);
+            }
+        }
+    }
+
+    float DTree::Pdf(const Vec3 &dir) const
+    {
+        float pdf = 1.f / (4.f * PI_f);
+        if (!Valid())
+        {
+            return pdf;
+        }
+
+        float x, y;
+        DirToSquare(dir, x, y);
+        int node = 0;
+        while (true)
+        {
+            const Node &cur = sampling_[node];
+            int quad = Quadrant(x, y);
+            float total = 0.f;
+            for (int i = 0; i < 4; ++i)
+            {
+                total += cur.sum_[i].load(std::memory_order_relaxed);
+            }
+            if (total > 0.f)
+            {
+                pdf *= 4.f * cur.sum_[quad].load(std::memory_order_relaxed) / total;
+            }
+            node = cur.child_[quad];
+            if (node == 0 || pdf == 0.f)
+            {
+                return pdf;
+            }
+        }
+    }
+
+    void DTree::Update(float split_fraction, int max_depth)
+    {
+        sampling_ = building_;
+        sampling_total_ = 0.f;
+        for (int i = 0; i < 4; ++i)
+        {
+            sampling_total_ += sampling_[0].sum_[i].load(std::memory_order_relaxed);
+        }
+        num_samples_.store(0, std::memory_order_relaxed);
+        if (sampling_total_ <= 0.f)
+        {
+            // nothing was learnt, keep the structure and record into it again
+            for (Node &node : building_)
+            {
+                node = Node();
+            }
+            return;
+        }
+
+        // rebuild the tree so it's refined wherever the energy is, quadrants which the sampled tree did not
+        // subdivide are assumed to spread their energy evenly
+        struct Entry
+        {
+            int src;  // node of the sampled tree, -1 if there is none
+            int dst;
+            int depth;
+            float frac[4];
+        };
+        building_.assign(1, Node());
+        std::vector<Entry> stack;
+        Entry root = { 0, 0, 1, {} };
+        for (int i = 0; i < 4; ++i)
+        {
+            root.frac[i] = sampling_[0].sum_[i].load(std::memory_order_relaxed) / sampling_total_;
+        }
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            Entry cur = stack.back();
+            stack.pop_back();
+            if (cur.depth >= max_depth)
+            {
+                continue;
+            }
+            for (int q = 0; q < 4; ++q)
+            {
+                if (cur.frac[q] <= split_fraction)
+                {
+                    continue;
+                }
+                Entry child = { -1, static_cast<int>(building_.size()), cur.depth + 1, {} };
+                building_.emplace_back();
+                building_[cur.dst].child_[q] = child.dst;
+                int src_child = (cur.src >= 0) ? sampling_[cur.src].child_[q] : 0;
+                if (src_child != 0)
+                {
+                    child.src = src_child;
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        child.frac[i] = sampling_[src_child].sum_[i].load(std::memory_order_relaxed) / sampling_total_;
+                    }
+                }
+                else
+                {
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        child.frac[i] = .25f * cur.frac[q];
+                    }
+                }
+                stack.push_back(child);
+            }
+        }
+    }
+
+    SDTree::SDTree(const Vec3 &cen, float half_size) : nodes_(1), dtrees_(1), cen_(cen), half_size_(half_size)
+    {
+        nodes_[0].dtree_ = 0;
+    }
+
+    DTree &SDTree::Lookup(const Vec3 &pos)
+    {
+        Vec3 p = (pos - cen_) / half_size_;
+        int node = 0;
+        while (nodes_[node].child_ >= 0)
+        {
+            int oct = 0;
+            oct += (p.x >= 0.f) ? 1 : 0;
+            oct += (p.y >= 0.f) ? 2 : 0;
+            oct += (p.z >= 0.f) ? 4 : 0;
+            p.x = 2.f * p.x + ((p.x >= 0.f) ? -1.f : 1.f);
+            p.y = 2.f * p.y + ((p.y >= 0.f) ? -1.f : 1.f);
+            p.z = 2.f * p.z + ((p.z >= 0.f) ? -1.f : 1.f);
+            node = nodes_[node].child_ + oct;
+        }
+        return dtrees_[nodes_[node].dtree_];
+    }
+
+    void SDTree::Update(int pass)
+    {
+        // split the leaves which received many records, the children inherit the leaf's distribution
+        float threshold = sd_split_base * std::sqrt(std::pow(2.f, static_cast<float>(pass)));
+        for (size_t i = 0; i < nodes_.size(); ++i)
+        {
+            if (nodes_[i].child_ >= 0 || nodes_[i].depth_ >= sd_max_depth)
+            {
+                continue;
+            }
+            int dtree = nodes_[i].dtree_;
+            int num_samples = dtrees_[dtree].NumSamples();
+            if (num_samples <= threshold)
+            {
+                continue;
+            }
+            dtrees_[dtree].SetNumSamples(num_samples / 8);
+            int first = static_cast<int>(nodes_.size());
+            nodes_[i].child_ = first;
+            nodes_[i].dtree_ = -1;
+            for (int c = 0; c < 8; ++c)
+            {
+                Node child;
+                child.depth_ = nodes_[i].depth_ + 1;
+                if (c == 0)
+                {
+                    child.dtree_ = dtree;
+                }
+                else
+                {
+                    child.dtree_ = static_cast<int>(dtrees_.size());
+                    dtrees_.push_back(DTree(dtrees_[dtree]));
+                }
+                nodes_.push_back(child);
+            }
+        }
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < static_cast<int>(dtrees_.size()); ++i)
+        {
+            dtrees_[i].Update(d_split_fraction, d_max_depth);
+        }
+        trained_ = true;
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef CBLT_SD_TREE_H
+#define CBLT_SD_TREE_H
+
+#include "math/vec.h"
+
+#include <atomic>
+#include <vector>
+
+namespace cblt
+{
+    /**
+     * @brief A quadtree over the sphere of directions, which learns the distribution of incident radiance at a
+     * region of the scene. Directions are mapped to the unit square with cylindrical coordinates (cos theta, phi),
+     * which preserves area, so the tree's density over the square is proportional to its density over solid
+     * angle. The tree keeps two copies: the one being built, which render threads record radiance into
+     * concurrently, and the one learnt during the previous pass, which is sampled.
+     */
+    class DTree
+    {
+        public:
+        DTree();
+        DTree(const DTree &other);
+        DTree &operator=(const DTree &other);
+
+        // add a radiance estimate arriving along dir to the tree being built, safe to call from any thread
+        void Record(const Vec3 &dir, float radiance);
+        // sample a direction from the distribution learnt during the previous pass
+        Vec3 Sample(float u1, float u2) const;
+        // solid angle density with which Sample() chooses dir
+        float Pdf(const Vec3 &dir) const;
+        // false until a pass has recorded some radiance, until then there is nothing to sample
+        bool Valid() const { return sampling_total_ > 0.f; };
+        // energy of the distribution being sampled, i.e. everything recorded before the last Update()
+        float Energy() const { return sampling_total_; };
+        // nodes of the tree being built, which Update() refines wherever the energy was
+        int NumNodes() const { return static_cast<int>(building_.size()); };
+        int NumSamples() const { return num_samples_.load(std::memory_order_relaxed); };
+        void SetNumSamples(int num_samples) { num_samples_.store(num_samples, std::memory_order_relaxed); };
+        // sample what was learnt during the last pass from now on, and start building a new tree which is
+        // subdivided wherever a quadrant received more than split_fraction of the energy
+        void Update(float split_fraction, int max_depth);
+
+        private:
+        struct Node
+        {
+            std::atomic<float> sum_[4];  //! energy recorded in each quadrant, including all of its descendants
+            int child_[4] = { 0, 0, 0, 0 };  //! index of each quadrant's node, 0 for leaves since the root is never a child
+
+            Node();
+            Node(const Node &other);
+            Node &operator=(const Node &other);
+        };
+
+        std::vector<Node> sampling_;
+        std::vector<Node> building_;
+        float sampling_total_ = 0.f;  //! energy in the sampled tree
+        std::atomic<int> num_samples_;  //! number of records in the tree being built
+    };
+
+    /**
+     * @brief Spatial-directional tree for path guiding, from "Practical Path Guiding for Efficient Light-Transport
+     * Simulation" by Muller et al. An octree over the scene stores a DTree in every leaf. The render is split
+     * into passes with doubling sample counts. After each pass, leaves which received many records are split,
+     * so the spatial resolution follows the paths, & each DTree starts sampling what it learnt during the pass.
+     */
+    class SDTree
+    {
+        public:
+        SDTree(const Vec3 &cen, float half_size);
+        // the directional distribution of the leaf containing pos, the tree's structure only changes in Update()
+        // so this is safe to call from any thread during a pass
+        DTree &Lookup(const Vec3 &pos);
+        // refine the tree after the pass with index pass, which must not run concurrently with a render pass
+        void Update(int pass);
+        // true once a pass has been learnt from, so the distributions can be sampled
+        bool Trained() const { return trained_; };
+
+        private:
+        struct Node
+        {
+            int child_ = -1;  //! index of the first of 8 consecutive children, or -1 for leaves
+            int dtree_ = -1;  //! index of the leaf's directional tree
+            int depth_ = 0;
+        };
+
+        std::vector<Node> nodes_;
+        std::vector<DTree> dtrees_;
+        Vec3 cen_;
+        float half_size_;  //! the octree's root is a cube
+        bool trained_ = false;
+    };
+}
+
+#endif  // CBLT_SD_TREE_H
@@ -0,0 +1,32 @@
+#ifndef CBLT_SHADING_PACKET_H
+#define CBLT_SHADING_PACKET_H
+
+#include "geom/hit_info.h"
+#include "math/vec_packet.h"
+
+namespace cblt
+{
+    /**
+     * @brief The parts of packet_width HitInfos which materials read when shading, in structure of arrays layout
+     * for the batched BRDF functions. Every lane is evaluated, so unused lanes can be left zeroed.
+     */
+    struct ShadingPacket
+    {
+        Vec3x8 norm;
+        Vec3x8 albedo;  // red, green & blue in x, y & z
+        Floatx8 roughness = Floatx8(1.f);
+        Floatx8 metallic = Floatx8(0.f);
+
+        ShadingPacket() : norm(Vec3(0.f, 0.f, 0.f)), albedo(Vec3(0.f, 0.f, 0.f)) {};
+        // copy the shading parameters of a hit, after its textures have been evaluated
+        void Set(int lane, const HitInfo &collision_pt)
+        {
+            norm.Set(lane, collision_pt.norm);
+            albedo.Set(lane, Vec3(collision_pt.albedo.r, collision_pt.albedo.g, collision_pt.albedo.b));
+            roughness[lane] = collision_pt.roughness;
+            metallic[lane] = collision_pt.metallic;
+        };
+    };
+}
+
+#endif  // CBLT_SHADING_PACKET_H
@@ -0,0 +1,588 @@
+#include "texture.h"
+
+#include "math/constants.h"
+#include "math/math_helpers.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <unordered_set>
+
+namespace cblt
+{
+    namespace
+    {
+        uint16_t FloatToHalf(float val)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &val, sizeof(bits));
+            uint32_t sign = (bits >> 16) & 0x8000;
+            uint32_t mant = bits & 0x7fffff;
+            int exp = static_cast<int>((bits >> 23) & 0xff);
+            if (exp == 0xff)
+            {
+                // inf or nan
+                return static_cast<uint16_t>(sign | 0x7c00 | (mant ? 0x200 : 0));
+            }
+            exp = exp - 127 + 15;
+            if (exp >= 0x1f)
+            {
+                // too large, so clamp to inf
+                return static_cast<uint16_t>(sign | 0x7c00);
+            }
+            if (exp <= 0)
+            {
+                // subnormal half, or too small to represent
+                if (exp < -10)
+                {
+                    return static_cast<uint16_t>(sign);
+                }
+                mant |= 0x800000;
+                int shift = 14 - exp;
+                uint32_t half = mant >> shift;
+                half += (mant >> (shift - 1)) & 1;
+                return static_cast<uint16_t>(sign | half);
+            }
+            uint32_t half = sign | (exp << 10) | (mant >> 13);
+            // round to nearest, a carry into the exponent is still correct
+            half += (mant >> 12) & 1;
+            return static_cast<uint16_t>(half);
+        }
+
+        float HalfToFloat(uint16_t half)
+        {
+            uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+            uint32_t exp = (half >> 10) & 0x1f;
+            uint32_t mant = half & 0x3ff;
+            uint32_t bits;
+            if (exp == 0)
+            {
+                if (mant == 0)
+                {
+                    bits = sign;
+                }
+                else
+                {
+                    // renormalize the subnormal value
+                    exp = 127 - 15 + 1;
+                    while (!(mant & 0x400))
+                    {
+                        mant <<= 1;
+                        --exp;
+                    }
+                    mant &= 0x3ff;
+                    bits = sign | (exp << 23) | (mant << 13);
+                }
+            }
+            else if (exp == 0x1f)
+            {
+                bits = sign | 0x7f800000 | (mant << 13);
+            }
+            else
+            {
+                bits = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+            }
+            float val;
+            std::memcpy(&val, &bits, sizeof(val));
+            return val;
+        }
+
+        int Wrap(int coord, int size)
+        {
+            coord %= size;
+            return (coord < 0) ? coord + size : coord;
+        }
+
+        // mip levels of 8 bit images are rounded back to 8 bits, those of high dynamic range images stay floats
+        uint8_t Average(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+        {
+            return static_cast<uint8_t>((a + b + c + d + 2) / 4);
+        }
+
+        float Average(float a, float b, float c, float d)
+        {
+            return .25f * (a + b + c + d);
+        }
+
+        // 8 bit texels are stored as they are, floats as halves
+        void StoreTexel(const uint8_t *src, uint8_t *dst)
+        {
+            std::memcpy(dst, src, 3 * sizeof(uint8_t));
+        }
+
+        void StoreTexel(const float *src, uint8_t *dst)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                uint16_t half = FloatToHalf(src[c]);
+                std::memcpy(dst + c * sizeof(uint16_t), &half, sizeof(half));
+            }
+        }
+
+        // a tile this thread used recently
+        struct ThreadTile
+        {
+            uint64_t key = 0;
+            TextureCache::Tile tile;
+        };
+
+        const uint64_t thread_tile_cache_size = 32;
+
+        int Seek(std::FILE *file, size_t offset)
+        {
+            #ifdef _MSC_VER
+            return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET);
+            #else
+            return fseeko(file, static_cast<off_t>(offset), SEEK_SET);
+            #endif
+        }
+
+        // hash & size of a file's contents, read a block at a time
+        bool HashFile(const std::string &file_name, std::pair<uint64_t, uint64_t> &content)
+        {
+            std::FILE *file = std::fopen(file_name.c_str(), "rb");
+            if (file == nullptr)
+            {
+                return false;
+            }
+            uint64_t hash = hashBytes(nullptr, 0);
+            uint64_t size = 0;
+            std::vector<char> block(size_t(1) << 16);
+            size_t read;
+            while ((read = std::fread(block.data(), 1, block.size(), file)) > 0)
+            {
+                hash = hashBytes(block.data(), read, hash);
+                size += read;
+            }
+            bool ok = !std::ferror(file);
+            std::fclose(file);
+            content = std::make_pair(hash, size);
+            return ok;
+        }
+    }
+
+    TextureCache::TextureCache(size_t budget_bytes) : budget_(budget_bytes)
+    {
+
+    }
+
+    const std::vector<uint8_t> &TextureCache::GetTile(const Texture &tex, int tile_id)
+    {
+        // texture ids are never reused, so the key alone identifies a tile whichever cache it came from
+        uint64_t key = (static_cast<uint64_t>(tex.id_) << 32) | static_cast<uint32_t>(tile_id);
+        // a bilinear lookup between two levels touches at most 8 tiles, so this holds several textures' worth. The
+        // tiles held here may outlive their eviction, which lets the cache exceed its budget by a few tiles a thread
+        thread_local ThreadTile recent[thread_tile_cache_size];
+        ThreadTile &entry = recent[(static_cast<uint64_t>(tex.id_) * 7 + tile_id) % thread_tile_cache_size];
+        if (entry.tile && entry.key == key)
+        {
+            // only write the flag once the clock hand has cleared it, so the tiles every thread uses stay shared
+            if (!entry.tile->referenced_.load(std::memory_order_relaxed))
+            {
+                entry.tile->referenced_.store(true, std::memory_order_relaxed);
+            }
+            return entry.tile->texels_;
+        }
+        entry.tile = Load(tex, tile_id, key);
+        entry.key = key;
+        return entry.tile->texels_;
+    }
+
+    TextureCache::Tile TextureCache::Load(const Texture &tex, int tile_id, uint64_t key)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            auto found = lookup_.find(key);
+            if (found != lookup_.end())
+            {
+                Tile &tile = slots_[found->second].tile_;
+                tile->referenced_.store(true, std::memory_order_relaxed);
+                return tile;
+            }
+        }
+
+        // page the tile in outside the lock, so other threads can keep using resident tiles
+        std::shared_ptr<TileData> loaded = std::make_shared<TileData>();
+        loaded->texels_ = tex.ReadTile(tile_id);
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto found = lookup_.find(key);
+        if (found != lookup_.end())
+        {
+            // another thread loaded the same tile in the meantime
+            Tile &tile = slots_[found->second].tile_;
+            tile->referenced_.store(true, std::memory_order_relaxed);
+            return tile;
+        }
+
+        // evict until the new tile fits, sparing each tile used since the hand last passed it once. The hand clears
+        // every flag it passes, so this ends within two turns
+        while (resident_ + loaded->texels_.size() > budget_ && !slots_.empty())
+        {
+            if (hand_ >= slots_.size())
+            {
+                hand_ = 0;
+            }
+            Slot &slot = slots_[hand_];
+            if (slot.tile_->referenced_.exchange(false, std::memory_order_relaxed))
+            {
+                ++hand_;
+                continue;
+            }
+            resident_ -= slot.tile_->texels_.size();
+            lookup_.erase(slot.key_);
+            // the last slot fills the gap, the hand stays put to visit it next
+            if (hand_ + 1 != slots_.size())
+            {
+                slot = std::move(slots_.back());
+                lookup_[slot.key_] = hand_;
+            }
+            slots_.pop_back();
+        }
+        resident_ += loaded->texels_.size();
+        lookup_[key] = slots_.size();
+        slots_.push_back(Slot{ key, loaded });
+        return loaded;
+    }
+
+    size_t TextureCache::BytesResident() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return resident_;
+    }
+
+    Texture::Texture(const std::string &file_name, const std::shared_ptr<TextureCache> &cache) : cache_(cache)
+    {
+        static std::atomic<uint32_t> next_id(0);
+        id_ = next_id++;
+
+        // the decoded image is tiled as it is, 8 bit images are never expanded to floats
+        int width, height, num_components;
+        if (stbi_is_hdr(file_name.c_str()))
+        {
+            float *data = stbi_loadf(file_name.c_str(), &width, &height, &num_components, 3);
+            if (data == nullptr)
+            {
+                return;
+            }
+            format_ = half_float;
+            BuildLevels(data, width, height);
+            stbi_image_free(data);
+        }
+        else
+        {
+            unsigned char *data = stbi_load(file_name.c_str(), &width, &height, &num_components, 3);
+            if (data == nullptr)
+            {
+                return;
+            }
+            format_ = unorm8;
+            BuildLevels(data, width, height);
+            stbi_image_free(data);
+        }
+    }
+
+    Texture::~Texture()
+    {
+        if (backing_ != nullptr)
+        {
+            std::fclose(backing_);
+        }
+    }
+
+    size_t Texture::Bytes() const
+    {
+        if (levels_.empty())
+        {
+            return 0;
+        }
+        const MipLevel &last = levels_.back();
+        size_t num_tiles = last.first_tile_ + last.tiles_x_ * ((last.height_ + tex_tile_size - 1) / tex_tile_size);
+        return num_tiles * tile_bytes_;
+    }
+
+    template <typename T>
+    void Texture::BuildLevels(const T *texels, int width, int height)
+    {
+        texel_bytes_ = (format_ == unorm8) ? 3 * sizeof(uint8_t) : 3 * sizeof(uint16_t);
+        tile_bytes_ = texel_bytes_ * tex_tile_size * tex_tile_size;
+        backing_ = std::tmpfile();
+
+        // only the level being filtered from & the quarter sized level filtered from it are held at once
+        std::vector<T> level_texels;
+        int tile_count = 0;
+        while (true)
+        {
+            MipLevel level;
+            level.width_ = width;
+            level.height_ = height;
+            level.tiles_x_ = (width + tex_tile_size - 1) / tex_tile_size;
+            level.first_tile_ = tile_count;
+            WriteLevel(texels, level);
+            levels_.push_back(level);
+            tile_count += level.tiles_x_ * ((height + tex_tile_size - 1) / tex_tile_size);
+
+            if (width == 1 && height == 1)
+            {
+                break;
+            }
+
+            // box filter down to the next level, clamping at the edges of odd sized levels
+            int next_w = std::max(1, width / 2);
+            int next_h = std::max(1, height / 2);
+            std::vector<T> next(static_cast<size_t>(next_w) * next_h * 3);
+            for (int y = 0; y < next_h; ++y)
+            {
+                const T *row0 = texels + 3 * static_cast<size_t>(std::min(2 * y, height - 1)) * width;
+                const T *row1 = texels + 3 * static_cast<size_t>(std::min(2 * y + 1, height - 1)) * width;
+                for (int x = 0; x < next_w; ++x)
+                {
+                    int x0 = 3 * std::min(2 * x, width - 1), x1 = 3 * std::min(2 * x + 1, width - 1);
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        next[3 * (static_cast<size_t>(y) * next_w + x) + c] = Average(row0[x0 + c], row0[x1 + c], row1[x0 + c], row1[x1 + c]);
+                    }
+                }
+            }
+            level_texels.swap(next);
+            texels = level_texels.data();
+            width = next_w;
+            height = next_h;
+        }
+    }
+
+    template <typename T>
+    void Texture::WriteLevel(const T *texels, const MipLevel &level)
+    {
+        int tiles_y = (level.height_ + tex_tile_size - 1) / tex_tile_size;
+        std::vector<uint8_t> tile(tile_bytes_);
+        for (int tile_y = 0; tile_y < tiles_y; ++tile_y)
+        {
+            for (int tile_x = 0; tile_x < level.tiles_x_; ++tile_x)
+            {
+                // tiles on the right & bottom edges are padded out to the full tile size
+                std::fill(tile.begin(), tile.end(), uint8_t(0));
+                int count_x = std::min(tex_tile_size, level.width_ - tile_x * tex_tile_size);
+                int count_y = std::min(tex_tile_size, level.height_ - tile_y * tex_tile_size);
+                for (int y = 0; y < count_y; ++y)
+                {
+                    for (int x = 0; x < count_x; ++x)
+                    {
+                        size_t src = 3 * (static_cast<size_t>(tile_y * tex_tile_size + y) * level.width_ + tile_x * tex_tile_size + x);
+                        StoreTexel(texels + src, tile.data() + (y * tex_tile_size + x) * texel_bytes_);
+                    }
+                }
+
+                // tile ids are assigned in the order tiles are written, so the store is only ever appended to
+                if (backing_ != nullptr)
+                {
+                    std::fwrite(tile.data(), 1, tile_bytes_, backing_);
+                }
+                else
+                {
+                    backing_mem_.insert(backing_mem_.end(), tile.begin(), tile.end());
+                }
+            }
+        }
+        if (backing_ != nullptr)
+        {
+            std::fflush(backing_);
+        }
+    }
+
+    std::vector<uint8_t> Texture::ReadTile(int tile_id) const
+    {
+        std::vector<uint8_t> tile(tile_bytes_, uint8_t(0));
+        size_t offset = static_cast<size_t>(tile_id) * tile_bytes_;
+        std::lock_guard<std::mutex> lock(backing_mtx_);
+        if (backing_ != nullptr)
+        {
+            if (Seek(backing_, offset) == 0)
+            {
+                std::fread(tile.data(), 1, tile_bytes_, backing_);
+            }
+        }
+        else if (offset + tile_bytes_ <= backing_mem_.size())
+        {
+            std::memcpy(tile.data(), backing_mem_.data() + offset, tile_bytes_);
+        }
+        return tile;
+    }
+
+    Color Texture::Sample(const Vec2 &uv, float uv_width) const
+    {
+        if (levels_.empty())
+        {
+            return Color::GreyScale(0.f);
+        }
+        // choose the level where a texel is about as wide as the footprint, and blend between the two closest levels
+        float texel_width = std::max(uv_width * std::max(levels_[0].width_, levels_[0].height_), 1.f);
+        float level = std::min(std::log2(texel_width), static_cast<float>(levels_.size() - 1));
+        int level_lo = static_cast<int>(level);
+        float t = level - level_lo;
+        if (t <= 0.f || level_lo + 1 >= static_cast<int>(levels_.size()))
+        {
+            return Bilinear(level_lo, uv);
+        }
+        return Bilinear(level_lo, uv) * (1.f - t) + Bilinear(level_lo + 1, uv) * t;
+    }
+
+    Color Texture::Bilinear(int level, const Vec2 &uv) const
+    {
+        const MipLevel &lvl = levels_[level];
+        float x = uv.x * lvl.width_ - .5f;
+        float y = uv.y * lvl.height_ - .5f;
+        int x0 = static_cast<int>(std::floor(x));
+        int y0 = static_cast<int>(std::floor(y));
+        float dx = x - x0;
+        float dy = y - y0;
+
+        Color result = Color::GreyScale(0.f);
+        int cur_tile = -1;
+        const uint8_t *tile = nullptr;
+        for (int i = 0; i < 4; ++i)
+        {
+            // the uv coordinates repeat outside of [0, 1]
+            int tx = Wrap(x0 + (i & 1), lvl.width_);
+            int ty = Wrap(y0 + (i >> 1), lvl.height_);
+            int tile_id = lvl.first_tile_ + (ty / tex_tile_size) * lvl.tiles_x_ + tx / tex_tile_size;
+            if (tile_id != cur_tile)
+            {
+                // neighbouring texels usually share a tile, so only go to the cache when it changes
+                tile = cache_->GetTile(*this, tile_id).data();
+                cur_tile = tile_id;
+            }
+
+            const uint8_t *texel = tile + ((ty % tex_tile_size) * tex_tile_size + tx % tex_tile_size) * texel_bytes_;
+            Color clr;
+            if (format_ == unorm8)
+            {
+                clr = Color(texel[0] / 255.f, texel[1] / 255.f, texel[2] / 255.f);
+            }
+            else
+            {
+                uint16_t half[3];
+                std::memcpy(half, texel, sizeof(half));
+                clr = Color(HalfToFloat(half[0]), HalfToFloat(half[1]), HalfToFloat(half[2]));
+            }
+            float weight = ((i & 1) ? dx : 1.f - dx) * ((i >> 1) ? dy : 1.f - dy);
+            result = result + clr * weight;
+        }
+        return result;
+    }
+
+    TextureLibrary::TextureLibrary(const std::shared_ptr<TextureCache> &cache) : cache_(cache)
+    {
+    }
+
+    std::shared_ptr<Texture> TextureLibrary::Get(const std::string &file_name)
+    {
+        // a texture someone else loaded is counted once it's ready, since its size isn't known until then
+        auto reuse = [this](const Pending &pending)
+        {
+            std::shared_ptr<Texture> tex = pending.get();
+            std::lock_guard<std::mutex> lock(mtx_);
+            ++shared_;
+            bytes_saved_ += tex->Bytes();
+            return tex;
+        };
+
+        // the same file named relative to different directories is still one texture
+        std::error_code err;
+        std::string key = std::filesystem::weakly_canonical(file_name, err).string();
+        if (err)
+        {
+            key = file_name;
+        }
+        std::filesystem::file_time_type mod_time = std::filesystem::last_write_time(file_name, err);
+        std::promise<std::shared_ptr<Texture>> loaded;
+        Pending pending = loaded.get_future().share();
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            auto named = by_name_.find(key);
+            if (named != by_name_.end() && named->second.mod_time_ == mod_time)
+            {
+                Pending other = named->second.pending_;
+                lock.unlock();
+                return reuse(other);
+            }
+            // new, or saved since it was loaded, in which case the new contents hash differently too
+            by_name_[key] = Named{ pending, mod_time };
+        }
+
+        // a file under a new name may still be a copy of one already loaded
+        std::pair<uint64_t, uint64_t> content;
+        if (HashFile(file_name, content))
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            auto same = by_content_.find(content);
+            if (same != by_content_.end())
+            {
+                Pending other = same->second;
+                lock.unlock();
+                std::shared_ptr<Texture> tex = reuse(other);
+                loaded.set_value(tex);
+                return tex;
+            }
+            by_content_[content] = pending;
+        }
+        std::shared_ptr<Texture> tex = std::make_shared<Texture>(file_name, cache_);
+        loaded.set_value(tex);
+        return tex;
+    }
+
+    void TextureLibrary::ReleaseUnused()
+    {
+        // a texture which is still loading is about to be used
+        auto ready = [](const Pending &pending)
+        {
+            return pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        };
+        std::lock_guard<std::mutex> lock(mtx_);
+        // the library holds a texture once for its load & once for each copy found under another name, while
+        // by_name_ & by_content_ share the future of a load
+        std::unordered_set<const std::shared_ptr<Texture> *> loads;
+        std::unordered_map<const Texture *, long> held;
+        auto count = [&](const Pending &pending)
+        {
+            if (ready(pending) && loads.insert(&pending.get()).second)
+            {
+                ++held[pending.get().get()];
+            }
+        };
+        for (const auto &named : by_name_)
+        {
+            count(named.second.pending_);
+        }
+        for (const auto &content : by_content_)
+        {
+            count(content.second);
+        }
+        auto unused = [&](const Pending &pending)
+        {
+            return ready(pending) && pending.get().use_count() == held[pending.get().get()];
+        };
+        for (auto iter = by_name_.begin(); iter != by_name_.end();)
+        {
+            iter = unused(iter->second.pending_) ? by_name_.erase(iter) : std::next(iter);
+        }
+        for (auto iter = by_content_.begin(); iter != by_content_.end();)
+        {
+            iter = unused(iter->second) ? by_content_.erase(iter) : std::next(iter);
+        }
+    }
+
+    size_t TextureLibrary::Shared() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return shared_;
+    }
+
+    size_t TextureLibrary::BytesSaved() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return bytes_saved_;
+    }
+}
@@ -0,0 +1,164 @@
+#ifndef CBLT_TEXTURE_H
+#define CBLT_TEXTURE_H
+
+#include "image_lib.h"
+#include "math/vec.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace cblt
+{
+    class Texture;
+
+    // width & height of a texture tile in texels
+    const int tex_tile_size = 64;
+    // default upper limit on the texel memory held by a texture cache
+    const size_t tex_cache_budget_default = size_t(256) << 20;
+
+    enum texel_format
+    {
+        unorm8,  // 8 bits per channel, used for low dynamic range images
+        half_float  // 16 bit floats per channel, used for high dynamic range images
+    };
+
+    /**
+     * @brief A cache of texture tiles, shared by all the textures in a scene. Tiles are paged in from each texture's
+     * backing store on demand, and once the resident texels exceed the byte budget tiles are evicted with the clock
+     * algorithm, which passes over any tile used since the hand last reached it. This keeps the memory used for
+     * textures bounded regardless of how many textures a scene references. Each thread also keeps the last few
+     * tiles it used, so most lookups never take the cache's lock.
+     */
+    class TextureCache
+    {
+        public:
+        struct TileData
+        {
+            std::vector<uint8_t> texels_;
+            mutable std::atomic<bool> referenced_{ true };  //! used since the clock hand last passed it
+        };
+        using Tile = std::shared_ptr<const TileData>;
+
+        TextureCache(size_t budget_bytes = tex_cache_budget_default);
+        // get the texels of a tile, loading it from the texture if it isn't resident. The texels stay valid until
+        // the calling thread's next GetTile()
+        const std::vector<uint8_t> &GetTile(const Texture &tex, int tile_id);
+        size_t BytesResident() const;
+        private:
+        struct Slot
+        {
+            uint64_t key_;
+            Tile tile_;
+        };
+
+        // the resident tile, or the tile read from the texture's backing store
+        Tile Load(const Texture &tex, int tile_id, uint64_t key);
+
+        std::vector<Slot> slots_;  //! resident tiles, in the order the clock hand visits them
+        std::unordered_map<uint64_t, size_t> lookup_;  //! slot of each resident tile
+        size_t hand_ = 0;
+        size_t budget_;
+        size_t resident_ = 0;
+        mutable std::mutex mtx_;
+    };
+
+    /**
+     * @brief A mip mapped image texture stored as 8 bit or half float texels. Each mip level is split into
+     * square tiles which are written to a temporary backing file when the texture is loaded, and only read
+     * back through the TextureCache when a lookup needs them. Lookups are trilinearly filtered, with the
+     * mip level chosen from the width of the ray footprint in uv space.
+     */
+    class Texture
+    {
+        public:
+        Texture(const std::string &file_name, const std::shared_ptr<TextureCache> &cache);
+        ~Texture();
+        Texture(const Texture &) = delete;
+        Texture &operator=(const Texture &) = delete;
+        // false if the image could not be loaded, which is left to whoever asked for the texture to report
+        bool Valid() const { return !levels_.empty(); };
+        // filtered lookup, uv_width is the width of the lookup footprint in uv space
+        Color Sample(const Vec2 &uv, float uv_width) const;
+        int Width() const { return levels_.empty() ? 0 : levels_[0].width_; };
+        int Height() const { return levels_.empty() ? 0 : levels_[0].height_; };
+        // size of every mip level's texels in the backing store
+        size_t Bytes() const;
+        private:
+        struct MipLevel
+        {
+            int width_;
+            int height_;
+            int tiles_x_;  //! number of tiles in each row of the level
+            int first_tile_;  //! id of the first tile of this level
+        };
+
+        Color Bilinear(int level, const Vec2 &uv) const;
+        // write the tiles of level 0 & of each level filtered down from the one before it, so no level is copied
+        template <typename T>
+        void BuildLevels(const T *texels, int width, int height);
+        template <typename T>
+        void WriteLevel(const T *texels, const MipLevel &level);
+        std::vector<uint8_t> ReadTile(int tile_id) const;
+
+        std::vector<MipLevel> levels_;
+        texel_format format_;
+        size_t texel_bytes_;
+        size_t tile_bytes_;
+
+        // tiles are stored in a temporary file, or in memory if the file couldn't be created
+        std::FILE *backing_ = nullptr;
+        std::vector<uint8_t> backing_mem_;
+        mutable std::mutex backing_mtx_;
+
+        std::shared_ptr<TextureCache> cache_;
+        uint32_t id_;  //! unique id, used to key this texture's tiles in the cache
+
+        friend class TextureCache;
+    };
+
+    /**
+     * @brief The textures of a scene, or of every scene loaded with it, so an image is decoded & mip mapped once
+     * however many materials use it. Textures are found by file name, & a file with a new name is hashed so copies
+     * of an image under different names share one texture as well. A file saved since it was loaded is loaded
+     * again. Safe to use from several loading threads, a texture asked for while another thread is loading it is
+     * waited for rather than loaded twice.
+     */
+    class TextureLibrary
+    {
+        public:
+        TextureLibrary(const std::shared_ptr<TextureCache> &cache);
+        // the texture for file_name, which may not be Valid() if the image couldn't be loaded
+        std::shared_ptr<Texture> Get(const std::string &file_name);
+        // forget the textures nothing else holds, e.g. once the scenes which used them are released
+        void ReleaseUnused();
+        // number of requests which were given a texture loaded for an earlier one, & the texels they didn't store
+        size_t Shared() const;
+        size_t BytesSaved() const;
+        private:
+        using Pending = std::shared_future<std::shared_ptr<Texture>>;
+        struct Named
+        {
+            Pending pending_;
+            std::filesystem::file_time_type mod_time_;  //! of the file when it was loaded
+        };
+
+        std::shared_ptr<TextureCache> cache_;
+        std::unordered_map<std::string, Named> by_name_;
+        std::map<std::pair<uint64_t, uint64_t>, Pending> by_content_;  //! keyed by the file's hash & size
+        size_t shared_ = 0;
+        size_t bytes_saved_ = 0;
+        mutable std::mutex mtx_;
+    };
+}
+
+#endif  // CBLT_TEXTURE_H
@@ -0,0 +1,87 @@
+#include "affine.h"
+
+
+namespace cblt {
+
+    Affine::Affine(float diag) {
+        for (int row = 0; row < 3; ++row) {
+            for (int col = 0; col < 4; ++col) {
+                data_[row][col] = (row == col) ? diag : 0.f;
+            }
+        }
+    }
+
+    Affine::Affine(const Mat4 &mat) {
+        // Mat4 is column major
+        for (int row = 0; row < 3; ++row) {
+            for (int col = 0; col < 4; ++col) {
+                data_[row][col] = mat.data_[4 * col + row];
+            }
+        }
+    }
+
+    Vec3 Affine::Point(const Vec3 &pt) const {
+#ifdef CBLT_USE_SSE
+        // w = 1 picks up the translation column
+        __m128 p = _mm_blend_ps(pt.Load(), _mm_set1_ps(1.f), 0x8);
+        __m128 x = _mm_dp_ps(_mm_load_ps(data_[0]), p, 0xF1);
+        __m128 y = _mm_dp_ps(_mm_load_ps(data_[1]), p, 0xF2);
+        __m128 z = _mm_dp_ps(_mm_load_ps(data_[2]), p, 0xF4);
+        return Vec3::Store(_mm_or_ps(_mm_or_ps(x, y), z));
+#else
+        return Vec3(data_[0][0] * pt.x + data_[0][1] * pt.y + data_[0][2] * pt.z + data_[0][3],
+                    data_[1][0] * pt.x + data_[1][1] * pt.y + data_[1][2] * pt.z + data_[1][3],
+                    data_[2][0] * pt.x + data_[2][1] * pt.y + data_[2][2] * pt.z + data_[2][3]);
+#endif
+    }
+
+    Vec3 Affine::Vector(const Vec3 &vec) const {
+#ifdef CBLT_USE_SSE
+        // only the linear part, the translation column is masked out of the dot products
+        __m128 v = vec.Load();
+        __m128 x = _mm_dp_ps(_mm_load_ps(data_[0]), v, 0x71);
+        __m128 y = _mm_dp_ps(_mm_load_ps(data_[1]), v, 0x72);
+        __m128 z = _mm_dp_ps(_mm_load_ps(data_[2]), v, 0x74);
+        return Vec3::Store(_mm_or_ps(_mm_or_ps(x, y), z));
+#else
+        return Vec3(data_[0][0] * vec.x + data_[0][1] * vec.y + data_[0][2] * vec.z,
+                    data_[1][0] * vec.x + data_[1][1] * vec.y + data_[1][2] * vec.z,
+                    data_[2][0] * vec.x + data_[2][1] * vec.y + data_[2][2] * vec.z);
+#endif
+    }
+
+    Vec3 Affine::TransposeVector(const Vec3 &vec) const {
+        return Vec3(data_[0][0] * vec.x + data_[1][0] * vec.y + data_[2][0] * vec.z,
+                    data_[0][1] * vec.x + data_[1][1] * vec.y + data_[2][1] * vec.z,
+                    data_[0][2] * vec.x + data_[1][2] * vec.y + data_[2][2] * vec.z);
+    }
+
+    Affine Inverse(const Affine &xform) {
+        // invert the linear part using its adjugate, then undo the translation
+        const float (&m)[3][4] = xform.data_;
+        Affine inverse;
+        inverse.data_[0][0] = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+        inverse.data_[0][1] = m[0][2] * m[2][1] - m[0][1] * m[2][2];
+        inverse.data_[0][2] = m[0][1] * m[1][2] - m[0][2] * m[1][1];
+        inverse.data_[1][0] = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+        inverse.data_[1][1] = m[0][0] * m[2][2] - m[0][2] * m[2][0];
+        inverse.data_[1][2] = m[0][2] * m[1][0] - m[0][0] * m[1][2];
+        inverse.data_[2][0] = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+        inverse.data_[2][1] = m[0][1] * m[2][0] - m[0][0] * m[2][1];
+        inverse.data_[2][2] = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+
+        float det = m[0][0] * inverse.data_[0][0] + m[0][1] * inverse.data_[1][0] + m[0][2] * inverse.data_[2][0];
+        float inv_det = 1.f / det;
+        for (int row = 0; row < 3; ++row) {
+            for (int col = 0; col < 3; ++col) {
+                inverse.data_[row][col] *= inv_det;
+            }
+        }
+
+        Vec3 translation = inverse.Vector(Vec3(m[0][3], m[1][3], m[2][3]));
+        inverse.data_[0][3] = -translation.x;
+        inverse.data_[1][3] = -translation.y;
+        inverse.data_[2][3] = -translation.z;
+        return inverse;
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef MATH_AFFINE_H
+#define MATH_AFFINE_H
+
+#include "vec.h"
+#include "mat4.h"
+
+namespace cblt {
+
+    /**
+     * @brief A 3x4 affine transform. The bottom row of a Mat4 is always (0, 0, 0, 1) for the transforms
+     * used to place instances, so it isn't stored, which saves memory and a quarter of the multiplies
+     * when transforming rays.
+     */
+    class Affine {
+        public:
+        Affine(float diag = 1.0f);
+        // drops the bottom row of the matrix, which is assumed to be (0, 0, 0, 1)
+        explicit Affine(const Mat4 &mat);
+
+        Vec3 Point(const Vec3 &pt) const;
+        Vec3 Vector(const Vec3 &vec) const;
+        // multiply by the transpose of the linear part, call on the inverse transform to carry normals
+        Vec3 TransposeVector(const Vec3 &vec) const;
+        float At(int row, int col) const { return data_[row][col]; };
+
+        friend Affine Inverse(const Affine &xform);
+        friend class AnimatedAffine;
+
+        private:
+        // Row Major, each row is 16 byte aligned so it can be loaded straight into a SIMD register
+        alignas(16) float data_[3][4];
+    };
+
+    Affine Inverse(const Affine &xform);
+}
+#endif  // MATH_AFFINE_H
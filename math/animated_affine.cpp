@@ -0,0 +1,114 @@
+#include "animated_affine.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cblt {
+
+    AnimatedAffine::AnimatedAffine(const Affine &xform) {
+        keys_.push_back(Decompose(0.f, xform));
+    }
+
+    AnimatedAffine::AnimatedAffine(const std::vector<float> &times, const std::vector<Affine> &xforms) {
+        for (size_t i = 0; i < times.size() && i < xforms.size(); ++i) {
+            keys_.push_back(Decompose(times[i], xforms[i]));
+        }
+        if (keys_.empty()) {
+            keys_.push_back(Decompose(0.f, Affine()));
+        }
+        // keep neighbouring rotations in the same hemisphere, so slerp takes the short way between them
+        for (size_t i = 1; i < keys_.size(); ++i) {
+            if (Dot(keys_[i - 1].rot_, keys_[i].rot_) < 0.f) {
+                keys_[i].rot_ = keys_[i].rot_ * -1.f;
+            }
+        }
+    }
+
+    AnimatedAffine::Key AnimatedAffine::Decompose(float time, const Affine &xform) {
+        Key key;
+        key.time_ = time;
+        key.xform_ = xform;
+        key.trans_ = Vec3(xform.At(0, 3), xform.At(1, 3), xform.At(2, 3));
+
+        float lin[3][3];
+        for (int row = 0; row < 3; ++row) {
+            for (int col = 0; col < 3; ++col) {
+                lin[row][col] = xform.At(row, col);
+            }
+        }
+
+        // polar decomposition, averaging the matrix with its inverse transpose converges to the closest rotation
+        float rot[3][3];
+        std::copy(&lin[0][0], &lin[0][0] + 9, &rot[0][0]);
+        for (int iter = 0; iter < 100; ++iter) {
+            Affine cur;
+            for (int row = 0; row < 3; ++row) {
+                for (int col = 0; col < 3; ++col) {
+                    cur.data_[row][col] = rot[row][col];
+                }
+            }
+            Affine inv = Inverse(cur);
+            float change = 0.f;
+            for (int row = 0; row < 3; ++row) {
+                for (int col = 0; col < 3; ++col) {
+                    float next = .5f * (rot[row][col] + inv.data_[col][row]);
+                    change = std::max(change, std::abs(next - rot[row][col]));
+                    rot[row][col] = next;
+                }
+            }
+            if (change < 1e-6f) {
+                break;
+            }
+        }
+        key.rot_ = Normalize(Quaternion(rot));
+
+        // scale = rot^T * lin
+        key.rot_.ToMatrix(rot);
+        for (int row = 0; row < 3; ++row) {
+            for (int col = 0; col < 3; ++col) {
+                key.scale_[row][col] = rot[0][row] * lin[0][col] + rot[1][row] * lin[1][col] + rot[2][row] * lin[2][col];
+            }
+        }
+        return key;
+    }
+
+    Affine AnimatedAffine::Interpolate(float time) const {
+        if (keys_.size() == 1 || time <= keys_.front().time_) {
+            return keys_.front().xform_;
+        }
+        if (time >= keys_.back().time_) {
+            return keys_.back().xform_;
+        }
+        // find the segment containing time
+        auto upper = std::upper_bound(keys_.begin(), keys_.end(), time, [](float t, const Key &key) {
+            return t < key.time_;
+        });
+        const Key &k1 = *(upper - 1);
+        const Key &k2 = *upper;
+        float t = (time - k1.time_) / (k2.time_ - k1.time_);
+
+        Vec3 trans = k1.trans_ * (1.f - t) + k2.trans_ * t;
+        float rot[3][3];
+        Slerp(k1.rot_, k2.rot_, t).ToMatrix(rot);
+        float scale[3][3];
+        for (int row = 0; row < 3; ++row) {
+            for (int col = 0; col < 3; ++col) {
+                scale[row][col] = k1.scale_[row][col] * (1.f - t) + k2.scale_[row][col] * t;
+            }
+        }
+
+        Affine xform;
+        for (int row = 0; row < 3; ++row) {
+            for (int col = 0; col < 3; ++col) {
+                xform.data_[row][col] = rot[row][0] * scale[0][col] + rot[row][1] * scale[1][col] + rot[row][2] * scale[2][col];
+            }
+            xform.data_[row][3] = trans.xyz[row];
+        }
+        return xform;
+    }
+
+    float AnimatedAffine::SegmentAngle(int key) const {
+        float cos_half = std::min(std::abs(Dot(keys_[key].rot_, keys_[key + 1].rot_)), 1.f);
+        return 2.f * std::acos(cos_half);
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef MATH_ANIMATED_AFFINE_H
+#define MATH_ANIMATED_AFFINE_H
+
+#include "affine.h"
+#include "quaternion.h"
+
+#include <vector>
+
+namespace cblt {
+
+    /**
+     * @brief An affine transform which changes over time, given as a list of keyframes. Each keyframe is
+     * decomposed into a translation, a rotation and a scale/shear, which are interpolated separately so
+     * rotating instances sweep along arcs instead of shrinking between keyframes.
+     */
+    class AnimatedAffine {
+        public:
+        AnimatedAffine(const Affine &xform = Affine());
+        // times must be sorted in increasing order, with one transform per time
+        AnimatedAffine(const std::vector<float> &times, const std::vector<Affine> &xforms);
+
+        // false for a single keyframe, in which case Interpolate always returns it unchanged
+        bool IsAnimated() const { return keys_.size() > 1; };
+        // transform at the given time, clamped to the first and last keyframes
+        Affine Interpolate(float time) const;
+        int NumKeys() const { return static_cast<int>(keys_.size()); };
+        float KeyTime(int key) const { return keys_[key].time_; };
+        // angle, in radians, which the rotation sweeps through between key and key + 1
+        float SegmentAngle(int key) const;
+
+        private:
+        struct Key {
+            float time_;
+            Affine xform_;  //! the original transform, returned exactly at the keyframe time
+            Vec3 trans_;
+            Quaternion rot_;
+            float scale_[3][3];  //! row major, whatever is left of the linear part once the rotation is factored out
+        };
+
+        static Key Decompose(float time, const Affine &xform);
+
+        std::vector<Key> keys_;
+    };
+}
+#endif  // MATH_ANIMATED_AFFINE_H
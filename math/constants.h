@@ -12,6 +12,7 @@ namespace cblt
     const float inf_F = std::numeric_limits<float>::max();
     const float minus_inf_F = std::numeric_limits<float>::lowest();
     const float eps_zero_F = 1.e-6f;
+    const float eps_shadow_F = 1.e-3f;  // relative tolerance when testing if a shadow ray reaches its light
 
     constexpr const float  PI_f = 3.1415926535897932384626433832795028841971f;
     constexpr const double PI_d = 3.1415926535897932384626433832795028841971;
@@ -20,9 +21,9 @@ namespace cblt
     constexpr const double INV_PI_d = 1.f / PI_d;
     
     // vector constants
-    const Vec3 X_axis_F = {1.f, 0.f, 0.f};
-    const Vec3 Y_axis_F = {0.f, 1.f, 0.f};
-    const Vec3 Z_axis_F = {0.f, 0.f, 1.f};
+    constexpr const Vec3 X_axis_F = {1.f, 0.f, 0.f};
+    constexpr const Vec3 Y_axis_F = {0.f, 1.f, 0.f};
+    constexpr const Vec3 Z_axis_F = {0.f, 0.f, 1.f};
 
     // matrix constants
     const Mat4 Identity_F = Mat4(1.f);
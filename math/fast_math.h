@@ -0,0 +1,47 @@
+#ifndef MATH_FAST_MATH_H
+#define MATH_FAST_MATH_H
+
+#include "constants.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace cblt {
+    // Approximate transcendentals for the packet code. They are branch free & only use arithmetic, so loops marked
+    // omp simd which call them still vectorize, unlike the calls into libm the standard versions make.
+
+    // 2^x, relative error below 2e-6 for x in [-126, 126]
+    inline float FastExp2(float x) {
+        x = (x < -126.f) ? -126.f : ((x > 126.f) ? 126.f : x);
+        float whole = static_cast<float>(static_cast<int32_t>(x + 127.f) - 127);
+        float f = x - whole;
+        // Taylor series of 2^f = e^(f ln(2)) on [0, 1)
+        float p = 1.f + f * (.69314718f + f * (.24022651f + f * (.05550411f + f * (.00961813f + f * (.00133336f + f * .00015404f)))));
+        int32_t bits = (static_cast<int32_t>(whole) + 127) << 23;
+        float scale;
+        std::memcpy(&scale, &bits, sizeof(float));
+        return p * scale;
+    }
+
+    // sine & cosine together, absolute error below 1e-6 for |x| < 1e5
+    inline void FastSinCos(float x, float &sin_x, float &cos_x) {
+        // reduce to [-pi/4, pi/4] around the nearest multiple of pi/2
+        float q = x * (2.f * INV_PI_f);
+        q = static_cast<float>(static_cast<int32_t>(q + ((q < 0.f) ? -.5f : .5f)));
+        // subtract in two parts, so the reduction stays accurate for larger angles
+        float r = (x - q * 1.5703125f) - q * 4.8382679e-4f;
+        float r_sqr = r * r;
+        float s = r * (1.f + r_sqr * (-1.f / 6.f + r_sqr * (1.f / 120.f + r_sqr * (-1.f / 5040.f))));
+        float c = 1.f + r_sqr * (-.5f + r_sqr * (1.f / 24.f + r_sqr * (-1.f / 720.f + r_sqr * (1.f / 40320.f))));
+        int32_t quadrant = static_cast<int32_t>(q) & 3;
+        sin_x = (quadrant == 0) ? s : ((quadrant == 1) ? c : ((quadrant == 2) ? -s : -c));
+        cos_x = (quadrant == 0) ? c : ((quadrant == 1) ? -s : ((quadrant == 2) ? -c : s));
+    }
+
+    // x^5, the Schlick Fresnel falloff
+    inline float Pow5(float x) {
+        float x_sqr = x * x;
+        return x_sqr * x_sqr * x;
+    }
+}
+#endif  // MATH_FAST_MATH_H
@@ -0,0 +1,66 @@
+#ifndef MATH_FRAME_H
+#define MATH_FRAME_H
+
+#include "vec.h"
+
+namespace cblt {
+
+    /**
+     * @brief An orthonormal basis, used to move directions between world space and a local shading space. Since
+     * the axes are orthonormal the inverse is the transpose, so going either way is three dot products or
+     * three multiply-adds instead of a 4x4 matrix product.
+     */
+    class Frame {
+        public:
+        Frame() : Frame(Vec3(1.f, 0.f, 0.f), Vec3(0.f, 1.f, 0.f), Vec3(0.f, 0.f, 1.f)) {};
+        // the axes must be orthonormal, x, y & z map to local (1, 0, 0), (0, 1, 0) & (0, 0, 1)
+        Frame(const Vec3 &x, const Vec3 &y, const Vec3 &z) {
+            const Vec3 *axes[3] = { &x, &y, &z };
+            for (int i = 0; i < 3; ++i) {
+                axes_[i][0] = axes[i]->x;
+                axes_[i][1] = axes[i]->y;
+                axes_[i][2] = axes[i]->z;
+                axes_[i][3] = 0.f;
+            }
+        };
+
+        Vec3 X() const { return Vec3(axes_[0][0], axes_[0][1], axes_[0][2]); };
+        Vec3 Y() const { return Vec3(axes_[1][0], axes_[1][1], axes_[1][2]); };
+        Vec3 Z() const { return Vec3(axes_[2][0], axes_[2][1], axes_[2][2]); };
+
+        // world space to local space
+        Vec3 ToLocal(const Vec3 &vec) const {
+#ifdef CBLT_USE_SSE
+            __m128 v = vec.Load();
+            // each dot product lands in its own lane, so they can be blended together without shuffles
+            __m128 x = _mm_dp_ps(_mm_load_ps(axes_[0]), v, 0x71);
+            __m128 y = _mm_dp_ps(_mm_load_ps(axes_[1]), v, 0x72);
+            __m128 z = _mm_dp_ps(_mm_load_ps(axes_[2]), v, 0x74);
+            return Vec3::Store(_mm_or_ps(_mm_or_ps(x, y), z));
+#else
+            return Vec3(axes_[0][0] * vec.x + axes_[0][1] * vec.y + axes_[0][2] * vec.z,
+                        axes_[1][0] * vec.x + axes_[1][1] * vec.y + axes_[1][2] * vec.z,
+                        axes_[2][0] * vec.x + axes_[2][1] * vec.y + axes_[2][2] * vec.z);
+#endif
+        };
+
+        // local space to world space
+        Vec3 FromLocal(const Vec3 &vec) const {
+#ifdef CBLT_USE_SSE
+            __m128 res = _mm_mul_ps(_mm_load_ps(axes_[0]), _mm_set1_ps(vec.x));
+            res = _mm_add_ps(res, _mm_mul_ps(_mm_load_ps(axes_[1]), _mm_set1_ps(vec.y)));
+            res = _mm_add_ps(res, _mm_mul_ps(_mm_load_ps(axes_[2]), _mm_set1_ps(vec.z)));
+            return Vec3::Store(res);
+#else
+            return Vec3(axes_[0][0] * vec.x + axes_[1][0] * vec.y + axes_[2][0] * vec.z,
+                        axes_[0][1] * vec.x + axes_[1][1] * vec.y + axes_[2][1] * vec.z,
+                        axes_[0][2] * vec.x + axes_[1][2] * vec.y + axes_[2][2] * vec.z);
+#endif
+        };
+
+        private:
+        // each axis is padded to 4 floats so it can be loaded straight into a SIMD register
+        alignas(16) float axes_[3][4];
+    };
+}
+#endif  // MATH_FRAME_H
@@ -19,6 +19,7 @@ namespace cblt {
         friend Mat4 Inverse(const Mat4 &matrix);
         friend Mat4 OrthoInverse(const Mat4 &matrix);
         friend Mat4 Transpose(const Mat4 &matrix);
+        friend class Affine;
         
         private:
         // Column Major
@@ -1,6 +1,9 @@
 #ifndef CBLT_MATH_HELPERS_H
 #define CBLT_MATH_HELPERS_H
 
+#include <cstddef>
+#include <cstdint>
+
 namespace cblt {
     template <class T>
     inline T toRadians(T x) {
@@ -21,5 +24,14 @@ namespace cblt {
     inline T lerp(T x, T y, float t) {
         return x * (1.f - t) + y * t;
     }
+
+    // 64 bit FNV-1a, pass the last result as hash to continue hashing over several buffers
+    inline uint64_t hashBytes(const void *data, size_t size, uint64_t hash = 14695981039346656037ULL) {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+        return hash;
+    }
 }
 #endif  // CBLT_MATH_HELPERS_H
\ No newline at end of file
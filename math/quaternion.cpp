@@ -0,0 +1,65 @@
+#include "quaternion.h"
+
+#include <algorithm>
+
+namespace cblt {
+
+    Quaternion::Quaternion(const float (&rot)[3][3]) {
+        // pick the largest component to divide by, to stay numerically stable
+        float trace = rot[0][0] + rot[1][1] + rot[2][2];
+        if (trace > 0.f) {
+            float s = std::sqrt(trace + 1.f);
+            w_ = s * .5f;
+            s = .5f / s;
+            v_ = Vec3((rot[2][1] - rot[1][2]) * s, (rot[0][2] - rot[2][0]) * s, (rot[1][0] - rot[0][1]) * s);
+            return;
+        }
+        int i = 0;
+        if (rot[1][1] > rot[0][0]) {
+            i = 1;
+        }
+        if (rot[2][2] > rot[i][i]) {
+            i = 2;
+        }
+        int j = (i + 1) % 3;
+        int k = (j + 1) % 3;
+        float s = std::sqrt(rot[i][i] - rot[j][j] - rot[k][k] + 1.f);
+        v_.xyz[i] = s * .5f;
+        s = .5f / s;
+        v_.xyz[j] = (rot[j][i] + rot[i][j]) * s;
+        v_.xyz[k] = (rot[k][i] + rot[i][k]) * s;
+        w_ = (rot[k][j] - rot[j][k]) * s;
+    }
+
+    void Quaternion::ToMatrix(float (&rot)[3][3]) const {
+        float xx = v_.x * v_.x, yy = v_.y * v_.y, zz = v_.z * v_.z;
+        float xy = v_.x * v_.y, xz = v_.x * v_.z, yz = v_.y * v_.z;
+        float wx = v_.x * w_, wy = v_.y * w_, wz = v_.z * w_;
+
+        rot[0][0] = 1.f - 2.f * (yy + zz);
+        rot[0][1] = 2.f * (xy - wz);
+        rot[0][2] = 2.f * (xz + wy);
+        rot[1][0] = 2.f * (xy + wz);
+        rot[1][1] = 1.f - 2.f * (xx + zz);
+        rot[1][2] = 2.f * (yz - wx);
+        rot[2][0] = 2.f * (xz - wy);
+        rot[2][1] = 2.f * (yz + wx);
+        rot[2][2] = 1.f - 2.f * (xx + yy);
+    }
+
+    Quaternion Slerp(const Quaternion &q1, const Quaternion &q2, float t) {
+        float cos_theta = Dot(q1, q2);
+        // q and -q are the same rotation, so flip one to take the shorter way around
+        Quaternion end = (cos_theta < 0.f) ? q2 * -1.f : q2;
+        cos_theta = std::abs(cos_theta);
+        if (cos_theta > .9995f) {
+            // nearly parallel, so linear interpolation is accurate and avoids dividing by sin(theta) ~ 0
+            return Normalize(q1 * (1.f - t) + end * t);
+        }
+        float theta = std::acos(std::min(cos_theta, 1.f));
+        float theta_t = theta * t;
+        // build an orthonormal partner of q1 in the plane of the arc
+        Quaternion perp = Normalize(end - q1 * cos_theta);
+        return q1 * std::cos(theta_t) + perp * std::sin(theta_t);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef MATH_QUATERNION_H
+#define MATH_QUATERNION_H
+
+#include "vec.h"
+
+namespace cblt {
+
+    /**
+     * @brief A unit quaternion representing a rotation, used to interpolate the rotation of animated transforms
+     * without the shearing that comes from interpolating matrices directly.
+     */
+    class Quaternion {
+        public:
+        Quaternion(const Vec3 &v = Vec3(0.f, 0.f, 0.f), float w = 1.f) : v_(v), w_(w) {};
+        // rotation part of a row major 3x3 matrix, which must be orthonormal
+        explicit Quaternion(const float (&rot)[3][3]);
+        // write the rotation as a row major 3x3 matrix
+        void ToMatrix(float (&rot)[3][3]) const;
+
+        Quaternion operator +(const Quaternion &rhs) const { return Quaternion(v_ + rhs.v_, w_ + rhs.w_); };
+        Quaternion operator -(const Quaternion &rhs) const { return Quaternion(v_ - rhs.v_, w_ - rhs.w_); };
+        Quaternion operator *(float rhs) const { return Quaternion(v_ * rhs, w_ * rhs); };
+
+        friend float Dot(const Quaternion &lhs, const Quaternion &rhs);
+        private:
+        Vec3 v_;
+        float w_;
+    };
+
+    inline float Dot(const Quaternion &lhs, const Quaternion &rhs) {
+        return Dot(lhs.v_, rhs.v_) + lhs.w_ * rhs.w_;
+    }
+
+    inline Quaternion Normalize(const Quaternion &q) {
+        return q * (1.f / std::sqrt(Dot(q, q)));
+    }
+
+    // spherical linear interpolation, which rotates at a constant angular velocity along the shortest arc
+    Quaternion Slerp(const Quaternion &q1, const Quaternion &q2, float t);
+}
+#endif  // MATH_QUATERNION_H
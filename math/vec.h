@@ -3,10 +3,22 @@
 
 #include <cmath>
 
+#ifdef CBLT_USE_SSE
+#include <smmintrin.h>
+// arithmetic is done with intrinsics, which can't be evaluated at compile time
+#define CBLT_VEC_CONSTEXPR inline
+#else
+#define CBLT_VEC_CONSTEXPR constexpr
+#endif
+
 namespace cblt {
+    // The vector library is header only so every operator can be inlined into the loops which use it. Constructors
+    // are always constexpr, and so is the arithmetic unless CBLT_USE_SSE is defined. In that case Vec3 is padded to
+    // 4 floats & 16 byte aligned, and its arithmetic runs on a single SSE register.
+
     class Vec2 {
         public:
-            Vec2(float x = 0, float y = 0);
+            constexpr Vec2(float _x = 0, float _y = 0) : x(_x), y(_y) {};
 
             union
             {
@@ -18,17 +30,22 @@ namespace cblt {
                 };
             };
 
-            Vec2 friend operator /(const float& lhs, const Vec2& rhs);
-            Vec2 friend operator *(const float& lhs, const Vec2& rhs);
-
-            Vec2 operator -() const;
-            Vec2 operator /(const float& rhs) const;
-            Vec2 operator *(const float& rhs) const;
-            Vec2 operator -(const Vec2& rhs) const;
-            Vec2 operator +(const Vec2& rhs) const;
+            constexpr Vec2 operator -() const { return Vec2(-x, -y); };
+            constexpr Vec2 operator /(const float& rhs) const { return Vec2(x / rhs, y / rhs); };
+            constexpr Vec2 operator *(const float& rhs) const { return Vec2(x * rhs, y * rhs); };
+            constexpr Vec2 operator -(const Vec2& rhs) const { return Vec2(x - rhs.x, y - rhs.y); };
+            constexpr Vec2 operator +(const Vec2& rhs) const { return Vec2(x + rhs.x, y + rhs.y); };
     };
 
-    inline float Dot(const Vec2 &lhs, const Vec2 &rhs) {
+    constexpr Vec2 operator /(const float& lhs, const Vec2& rhs) {
+        return Vec2(lhs / rhs.x, lhs / rhs.y);
+    }
+
+    constexpr Vec2 operator *(const float& lhs, const Vec2& rhs) {
+        return Vec2(lhs * rhs.x, lhs * rhs.y);
+    }
+
+    constexpr float Dot(const Vec2 &lhs, const Vec2 &rhs) {
         return lhs.x * rhs.x + lhs.y * rhs.y;
     }
 
@@ -40,7 +57,7 @@ namespace cblt {
         return std::sqrt(vec.x * vec.x + vec.y * vec.y);
     }
 
-    inline float MagnitudeSqr(const Vec2 &vec) {
+    constexpr float MagnitudeSqr(const Vec2 &vec) {
         return vec.x * vec.x + vec.y * vec.y;
     }
 
@@ -49,11 +66,15 @@ namespace cblt {
         return (vec / (len + 1e-6f));
     }
 
+#ifdef CBLT_USE_SSE
+    class alignas(16) Vec3 {
+#else
     class Vec3 {
+#endif
         public:
 
-            Vec3(float x = 0, float y = 0, float z = 0);
-            Vec3(const Vec2 &xy, float z);
+            constexpr Vec3(float _x = 0, float _y = 0, float _z = 0) : x(_x), y(_y), z(_z) {};
+            constexpr Vec3(const Vec2 &_xy, float _z) : x(_xy.x), y(_xy.y), z(_z) {};
             union
             {
                 float xyz[3];
@@ -62,19 +83,89 @@ namespace cblt {
                     float x;
                     float y;
                     float z;
+#ifdef CBLT_USE_SSE
+                    float pad_ = 0.f;  // kept at zero, so whole register operations never produce NaNs or infinities
+#endif
                 };
             };
 
-            Vec3 friend operator /(const float& lhs, const Vec3& rhs);
-            Vec3 friend operator *(const float& lhs, const Vec3& rhs);
+#ifdef CBLT_USE_SSE
+            __m128 Load() const { return _mm_load_ps(xyz); };
+            static Vec3 Store(__m128 val) {
+                Vec3 res;
+                _mm_store_ps(res.xyz, val);
+                // the padding lane doesn't survive every operation, e.g. 0 / 0
+                res.pad_ = 0.f;
+                return res;
+            };
+#endif
 
-            Vec3 operator -() const;
-            Vec3 operator /(const float& rhs) const;
-            Vec3 operator *(const float& rhs) const;
-            Vec3 operator -(const Vec3 &rhs) const;
-            Vec3 operator +(const Vec3 &rhs) const;
+            CBLT_VEC_CONSTEXPR Vec3 operator -() const;
+            CBLT_VEC_CONSTEXPR Vec3 operator /(const float& rhs) const;
+            CBLT_VEC_CONSTEXPR Vec3 operator *(const float& rhs) const;
+            CBLT_VEC_CONSTEXPR Vec3 operator -(const Vec3 &rhs) const;
+            CBLT_VEC_CONSTEXPR Vec3 operator +(const Vec3 &rhs) const;
     };
 
+#ifdef CBLT_USE_SSE
+    inline Vec3 Vec3::operator -() const {
+        return Store(_mm_sub_ps(_mm_setzero_ps(), Load()));
+    }
+
+    inline Vec3 Vec3::operator /(const float& rhs) const {
+        return Store(_mm_div_ps(Load(), _mm_set1_ps(rhs)));
+    }
+
+    inline Vec3 Vec3::operator *(const float& rhs) const {
+        return Store(_mm_mul_ps(Load(), _mm_set1_ps(rhs)));
+    }
+
+    inline Vec3 Vec3::operator -(const Vec3 &rhs) const {
+        return Store(_mm_sub_ps(Load(), rhs.Load()));
+    }
+
+    inline Vec3 Vec3::operator +(const Vec3 &rhs) const {
+        return Store(_mm_add_ps(Load(), rhs.Load()));
+    }
+
+    inline Vec3 operator /(const float& lhs, const Vec3& rhs) {
+        // computed as scalars, since dividing by the zero padding lane would produce infinity
+        return Vec3(lhs / rhs.x, lhs / rhs.y, lhs / rhs.z);
+    }
+
+    inline Vec3 operator *(const float& lhs, const Vec3& rhs) {
+        return rhs * lhs;
+    }
+#else
+    constexpr Vec3 Vec3::operator -() const {
+        return Vec3(-x, -y, -z);
+    }
+
+    constexpr Vec3 Vec3::operator /(const float& rhs) const {
+        return Vec3(x / rhs, y / rhs, z / rhs);
+    }
+
+    constexpr Vec3 Vec3::operator *(const float& rhs) const {
+        return Vec3(x * rhs, y * rhs, z * rhs);
+    }
+
+    constexpr Vec3 Vec3::operator -(const Vec3 &rhs) const {
+        return Vec3(x - rhs.x, y - rhs.y, z - rhs.z);
+    }
+
+    constexpr Vec3 Vec3::operator +(const Vec3 &rhs) const {
+        return Vec3(x + rhs.x, y + rhs.y, z + rhs.z);
+    }
+
+    constexpr Vec3 operator /(const float& lhs, const Vec3& rhs) {
+        return Vec3(lhs / rhs.x, lhs / rhs.y, lhs / rhs.z);
+    }
+
+    constexpr Vec3 operator *(const float& lhs, const Vec3& rhs) {
+        return Vec3(lhs * rhs.x, lhs * rhs.y, lhs * rhs.z);
+    }
+#endif
+
     inline float Dot(const Vec3 &lhs, const Vec3 &rhs) {
         return std::fmaf(lhs.x, rhs.x, std::fmaf(lhs.y, rhs.y, lhs.z * rhs.z));
     }
@@ -83,7 +174,7 @@ namespace cblt {
         return std::abs(Dot(lhs, rhs));
     }
 
-    inline Vec3 Cross(const Vec3 &lhs, const Vec3 &rhs) {
+    constexpr Vec3 Cross(const Vec3 &lhs, const Vec3 &rhs) {
         return Vec3(lhs.y * rhs.z - lhs.z * rhs.y,
                   - lhs.x * rhs.z + rhs.x * lhs.z,
                   + lhs.x * rhs.y - lhs.y * rhs.x);
@@ -93,7 +184,7 @@ namespace cblt {
         return std::sqrt(vec.x * vec.x + vec.y * vec.y + vec.z * vec.z);
     }
 
-    inline float MagnitudeSqr(const Vec3 &vec) {
+    constexpr float MagnitudeSqr(const Vec3 &vec) {
         return vec.x * vec.x + vec.y * vec.y + vec.z * vec.z;
     }
 
@@ -104,10 +195,10 @@ namespace cblt {
 
     class Vec4 {
         public:
-            Vec4(float x = 0, float y = 0, float z = 0, float w = 0);
-            Vec4(const Vec2 &xy, float z, float w);
-            Vec4(const Vec3 &xyz, float w);
-        
+            constexpr Vec4(float _x = 0, float _y = 0, float _z = 0, float _w = 0) : x(_x), y(_y), z(_z), w(_w) {};
+            constexpr Vec4(const Vec2 &_xy, float _z, float _w) : x(_xy.x), y(_xy.y), z(_z), w(_w) {};
+            constexpr Vec4(const Vec3 &_xyz, float _w) : x(_xyz.x), y(_xyz.y), z(_xyz.z), w(_w) {};
+
             union
             {
                 float xyzw[4];
@@ -120,17 +211,22 @@ namespace cblt {
                 };
             };
 
-            Vec4 friend operator /(const float& lhs, const Vec4& rhs);
-            Vec4 friend operator *(const float& lhs, const Vec4& rhs);
-
-            Vec4 operator -() const;
-            Vec4 operator /(const float &rhs) const;
-            Vec4 operator *(const float& rhs) const;
-            Vec4 operator -(const Vec4 &rhs) const;
-            Vec4 operator +(const Vec4 &rhs) const;
+            constexpr Vec4 operator -() const { return Vec4(-x, -y, -z, -w); };
+            constexpr Vec4 operator /(const float &rhs) const { return Vec4(x / rhs, y / rhs, z / rhs, w / rhs); };
+            constexpr Vec4 operator *(const float& rhs) const { return Vec4(x * rhs, y * rhs, z * rhs, w * rhs); };
+            constexpr Vec4 operator -(const Vec4 &rhs) const { return Vec4(x - rhs.x, y - rhs.y, z - rhs.z, w - rhs.w); };
+            constexpr Vec4 operator +(const Vec4 &rhs) const { return Vec4(x + rhs.x, y + rhs.y, z + rhs.z, w + rhs.w); };
     };
 
-    inline float Dot(const Vec4 &lhs, const Vec4 &rhs) {
+    constexpr Vec4 operator /(const float& lhs, const Vec4& rhs) {
+        return Vec4(lhs / rhs.x, lhs / rhs.y, lhs / rhs.z, lhs / rhs.w);
+    }
+
+    constexpr Vec4 operator *(const float& lhs, const Vec4& rhs) {
+        return Vec4(lhs * rhs.x, lhs * rhs.y, lhs * rhs.z, lhs * rhs.w);
+    }
+
+    constexpr float Dot(const Vec4 &lhs, const Vec4 &rhs) {
         return lhs.x * rhs.x + lhs.y * rhs.y + lhs.z * lhs.z + lhs.w * lhs.w;
     }
 
@@ -142,7 +238,7 @@ namespace cblt {
         return std::sqrt(vec.x * vec.x + vec.y * vec.y + vec.z * vec.z + vec.w * vec.w);
     }
 
-    inline float MagnitudeSqr(const Vec4 &vec) {
+    constexpr float MagnitudeSqr(const Vec4 &vec) {
         return vec.x * vec.x + vec.y * vec.y + vec.z * vec.z + vec.w * vec.w;
     }
 
@@ -0,0 +1,142 @@
+#ifndef MATH_VEC_PACKET_H
+#define MATH_VEC_PACKET_H
+
+#include "vec.h"
+
+#include <cmath>
+
+namespace cblt {
+
+    // number of lanes in the packet types, sized for one AVX register of floats
+    constexpr int packet_width = 8;
+
+    /**
+     * @brief Eight floats processed together. The packet types are plain structure of arrays loops marked with
+     * omp simd, so the compiler maps each operation to one AVX instruction, or two SSE ones, depending on the
+     * instruction set the build targets.
+     */
+    struct Floatx8 {
+        alignas(32) float v[packet_width];
+
+        Floatx8() = default;
+        explicit Floatx8(float val) {
+            #pragma omp simd
+            for (int i = 0; i < packet_width; ++i) {
+                v[i] = val;
+            }
+        };
+        float &operator[](int lane) { return v[lane]; };
+        float operator[](int lane) const { return v[lane]; };
+    };
+
+    /**
+     * @brief Eight Vec3s in structure of arrays layout, for code which shades or samples a packet of rays at once.
+     */
+    struct Vec3x8 {
+        alignas(32) float x[packet_width];
+        alignas(32) float y[packet_width];
+        alignas(32) float z[packet_width];
+
+        Vec3x8() = default;
+        // broadcast the same vector to every lane
+        explicit Vec3x8(const Vec3 &vec) {
+            #pragma omp simd
+            for (int i = 0; i < packet_width; ++i) {
+                x[i] = vec.x;
+                y[i] = vec.y;
+                z[i] = vec.z;
+            }
+        };
+        Vec3 Get(int lane) const { return Vec3(x[lane], y[lane], z[lane]); };
+        void Set(int lane, const Vec3 &vec) {
+            x[lane] = vec.x;
+            y[lane] = vec.y;
+            z[lane] = vec.z;
+        };
+    };
+
+    inline Floatx8 operator +(const Floatx8 &lhs, const Floatx8 &rhs) {
+        Floatx8 res;
+        #pragma omp simd
+        for (int i = 0; i < packet_width; ++i) {
+            res.v[i] = lhs.v[i] + rhs.v[i];
+        }
+        return res;
+    }
+
+    inline Floatx8 operator *(const Floatx8 &lhs, const Floatx8 &rhs) {
+        Floatx8 res;
+        #pragma omp simd
+        for (int i = 0; i < packet_width; ++i) {
+            res.v[i] = lhs.v[i] * rhs.v[i];
+        }
+        return res;
+    }
+
+    inline Vec3x8 operator +(const Vec3x8 &lhs, const Vec3x8 &rhs) {
+        Vec3x8 res;
+        #pragma omp simd
+        for (int i = 0; i < packet_width; ++i) {
+            res.x[i] = lhs.x[i] + rhs.x[i];
+            res.y[i] = lhs.y[i] + rhs.y[i];
+            res.z[i] = lhs.z[i] + rhs.z[i];
+        }
+        return res;
+    }
+
+    inline Vec3x8 operator -(const Vec3x8 &lhs, const Vec3x8 &rhs) {
+        Vec3x8 res;
+        #pragma omp simd
+        for (int i = 0; i < packet_width; ++i) {
+            res.x[i] = lhs.x[i] - rhs.x[i];
+            res.y[i] = lhs.y[i] - rhs.y[i];
+            res.z[i] = lhs.z[i] - rhs.z[i];
+        }
+        return res;
+    }
+
+    // scale every lane by its own factor
+    inline Vec3x8 operator *(const Vec3x8 &lhs, const Floatx8 &rhs) {
+        Vec3x8 res;
+        #pragma omp simd
+        for (int i = 0; i < packet_width; ++i) {
+            res.x[i] = lhs.x[i] * rhs.v[i];
+            res.y[i] = lhs.y[i] * rhs.v[i];
+            res.z[i] = lhs.z[i] * rhs.v[i];
+        }
+        return res;
+    }
+
+    inline Floatx8 Dot(const Vec3x8 &lhs, const Vec3x8 &rhs) {
+        Floatx8 res;
+        #pragma omp simd
+        for (int i = 0; i < packet_width; ++i) {
+            res.v[i] = lhs.x[i] * rhs.x[i] + lhs.y[i] * rhs.y[i] + lhs.z[i] * rhs.z[i];
+        }
+        return res;
+    }
+
+    inline Vec3x8 Cross(const Vec3x8 &lhs, const Vec3x8 &rhs) {
+        Vec3x8 res;
+        #pragma omp simd
+        for (int i = 0; i < packet_width; ++i) {
+            res.x[i] = lhs.y[i] * rhs.z[i] - lhs.z[i] * rhs.y[i];
+            res.y[i] = lhs.z[i] * rhs.x[i] - lhs.x[i] * rhs.z[i];
+            res.z[i] = lhs.x[i] * rhs.y[i] - lhs.y[i] * rhs.x[i];
+        }
+        return res;
+    }
+
+    inline Vec3x8 Normalize(const Vec3x8 &vec) {
+        Vec3x8 res;
+        #pragma omp simd
+        for (int i = 0; i < packet_width; ++i) {
+            float inv_len = 1.f / (std::sqrt(vec.x[i] * vec.x[i] + vec.y[i] * vec.y[i] + vec.z[i] * vec.z[i]) + 1e-6f);
+            res.x[i] = vec.x[i] * inv_len;
+            res.y[i] = vec.y[i] * inv_len;
+            res.z[i] = vec.z[i] * inv_len;
+        }
+        return res;
+    }
+}
+#endif  // MATH_VEC_PACKET_H
@@ -0,0 +1,105 @@
+#include "memory_arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace cblt
+{
+    MemoryArena::MemoryArena(size_t block_size) : block_size_(block_size)
+    {
+    }
+
+    MemoryArena::~MemoryArena()
+    {
+        std::fill(used_, used_ + mem_category_count, size_t(0));
+        Publish();
+        for (Block &block : blocks_)
+        {
+            ::operator delete(block.data_);
+        }
+    }
+
+    void *MemoryArena::Alloc(size_t bytes, size_t align, mem_category category)
+    {
+        // look for room in the current block, then in any blocks which are free again after a rewind
+        while (cur_block_ < blocks_.size())
+        {
+            Block &block = blocks_[cur_block_];
+            uintptr_t base = reinterpret_cast<uintptr_t>(block.data_);
+            size_t start = ((base + offset_ + align - 1) & ~(uintptr_t(align) - 1)) - base;
+            if (start + bytes <= block.size_)
+            {
+                offset_ = start + bytes;
+                used_[category] += bytes;
+                high_[category] = std::max(high_[category], used_[category]);
+                return block.data_ + start;
+            }
+            ++cur_block_;
+            offset_ = 0;
+        }
+
+        // out of space, so grab a new block big enough for the request
+        Block block;
+        block.size_ = std::max(block_size_, bytes + align);
+        block.data_ = static_cast<char *>(::operator new(block.size_));
+        blocks_.push_back(block);
+        cur_block_ = blocks_.size() - 1;
+        offset_ = 0;
+        Publish();
+        return Alloc(bytes, align, category);
+    }
+
+    MemoryArena::Marker MemoryArena::Mark() const
+    {
+        Marker marker;
+        marker.block_ = cur_block_;
+        marker.offset_ = offset_;
+        std::copy(used_, used_ + mem_category_count, marker.used_);
+        return marker;
+    }
+
+    void MemoryArena::Rewind(const Marker &marker)
+    {
+        cur_block_ = marker.block_;
+        offset_ = marker.offset_;
+        std::copy(marker.used_, marker.used_ + mem_category_count, used_);
+        Publish();
+    }
+
+    void MemoryArena::Publish()
+    {
+        // the counters are shared by every thread, so only the categories which changed since the last time are
+        // touched. Most scopes allocate scratch alone, or nothing at all
+        for (int i = 0; i < mem_category_count; ++i)
+        {
+            mem_category category = static_cast<mem_category>(i);
+            // the high water mark only rises between publishes, so it's never below what was published
+            if (high_[i] > published_[i])
+            {
+                MemoryStats::Add(category, high_[i] - published_[i]);
+            }
+            if (high_[i] > used_[i])
+            {
+                MemoryStats::Remove(category, high_[i] - used_[i]);
+            }
+            published_[i] = used_[i];
+            high_[i] = used_[i];
+        }
+    }
+
+    size_t MemoryArena::BytesUsed() const
+    {
+        size_t total = 0;
+        for (int i = 0; i < mem_category_count; ++i)
+        {
+            total += used_[i];
+        }
+        return total;
+    }
+
+    const std::shared_ptr<MemoryArena> &ThreadScratch()
+    {
+        thread_local std::shared_ptr<MemoryArena> scratch = std::make_shared<MemoryArena>();
+        return scratch;
+    }
+}
@@ -0,0 +1,158 @@
+#ifndef CBLT_MEMORY_ARENA_H
+#define CBLT_MEMORY_ARENA_H
+
+#include "memory_stats.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace cblt
+{
+    // size of each block requested from the system, larger requests get a block of their own
+    const size_t arena_block_size_default = size_t(1) << 20;
+
+    /**
+     * @brief A monotonic allocator, which hands out memory by bumping an offset into large blocks. Nothing is freed
+     * individually; all the blocks are released at once when the arena is destroyed, or rewound for reuse. This
+     * replaces millions of small heap allocations with a handful of large ones. An arena is not thread safe, so
+     * each thread should allocate from its own arena, e.g. ThreadScratch(). Usage is counted by the arena itself &
+     * only published to MemoryStats when a block is acquired or released, or the arena is rewound.
+     */
+    class MemoryArena
+    {
+        public:
+        MemoryArena(size_t block_size = arena_block_size_default);
+        ~MemoryArena();
+        MemoryArena(const MemoryArena &) = delete;
+        MemoryArena &operator=(const MemoryArena &) = delete;
+
+        void *Alloc(size_t bytes, size_t align, mem_category category);
+
+        // a position in the arena, everything allocated after it can be released with Rewind()
+        struct Marker
+        {
+            size_t block_;
+            size_t offset_;
+            size_t used_[mem_category_count];
+        };
+        Marker Mark() const;
+        void Rewind(const Marker &marker);
+        size_t BytesUsed() const;
+        // bring MemoryStats up to date with this arena, including the highest usage since it was last told. Long
+        // lived arenas should publish once they've been filled, or their last block isn't counted until released
+        void Publish();
+
+        private:
+        struct Block
+        {
+            char *data_;
+            size_t size_;
+        };
+
+        std::vector<Block> blocks_;
+        size_t block_size_;
+        size_t cur_block_ = 0;  //! index of the block being allocated from
+        size_t offset_ = 0;  //! offset of the next free byte in the current block
+        size_t used_[mem_category_count] = {};  //! bytes handed out per category
+        size_t high_[mem_category_count] = {};  //! most bytes handed out per category since the last Publish()
+        size_t published_[mem_category_count] = {};  //! bytes per category MemoryStats counts for this arena
+    };
+
+    /**
+     * @brief Releases everything allocated from an arena within a scope, so scratch memory can be reused by the
+     * next pixel, tile, or build step.
+     */
+    class ScratchScope
+    {
+        public:
+        ScratchScope(MemoryArena &arena) : arena_(arena), marker_(arena.Mark()) {};
+        ~ScratchScope() { arena_.Rewind(marker_); };
+        ScratchScope(const ScratchScope &) = delete;
+        ScratchScope &operator=(const ScratchScope &) = delete;
+        private:
+        MemoryArena &arena_;
+        MemoryArena::Marker marker_;
+    };
+
+    // arena for the calling thread's transient allocations
+    const std::shared_ptr<MemoryArena> &ThreadScratch();
+
+    /**
+     * @brief Standard library allocator which carves memory from an arena, deallocation does nothing. It holds a
+     * reference to the arena, so objects made with allocate_shared keep their arena alive for as long as they are.
+     */
+    template <class T>
+    class ArenaAllocator
+    {
+        public:
+        using value_type = T;
+
+        ArenaAllocator(const std::shared_ptr<MemoryArena> &arena, mem_category category) : arena_(arena), category_(category) {};
+        template <class U>
+        ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.arena_), category_(other.category_) {};
+
+        T *allocate(size_t count)
+        {
+            return static_cast<T *>(arena_->Alloc(count * sizeof(T), alignof(T), category_));
+        };
+        void deallocate(T *, size_t) {};
+
+        template <class U>
+        bool operator==(const ArenaAllocator<U> &other) const { return arena_ == other.arena_; };
+        template <class U>
+        bool operator!=(const ArenaAllocator<U> &other) const { return arena_ != other.arena_; };
+
+        private:
+        std::shared_ptr<MemoryArena> arena_;
+        mem_category category_;
+
+        template <class U>
+        friend class ArenaAllocator;
+    };
+
+    /**
+     * @brief Standard library allocator which uses the heap as usual, but counts what it holds towards a category
+     * in MemoryStats.
+     */
+    template <class T, mem_category category>
+    class TrackedAllocator
+    {
+        public:
+        using value_type = T;
+        template <class U>
+        struct rebind
+        {
+            using other = TrackedAllocator<U, category>;
+        };
+
+        TrackedAllocator() {};
+        template <class U>
+        TrackedAllocator(const TrackedAllocator<U, category> &) {};
+
+        T *allocate(size_t count)
+        {
+            MemoryStats::Add(category, count * sizeof(T));
+            return static_cast<T *>(::operator new(count * sizeof(T)));
+        };
+        void deallocate(T *ptr, size_t count)
+        {
+            MemoryStats::Remove(category, count * sizeof(T));
+            ::operator delete(ptr);
+        };
+
+        template <class U>
+        bool operator==(const TrackedAllocator<U, category> &) const { return true; };
+        template <class U>
+        bool operator!=(const TrackedAllocator<U, category> &) const { return false; };
+    };
+
+    // make_shared, with the object & its reference count placed in an arena
+    template <class T, class... Args>
+    std::shared_ptr<T> AllocateShared(const std::shared_ptr<MemoryArena> &arena, mem_category category, Args&&... args)
+    {
+        return std::allocate_shared<T>(ArenaAllocator<T>(arena, category), std::forward<Args>(args)...);
+    }
+}
+
+#endif  // CBLT_MEMORY_ARENA_H
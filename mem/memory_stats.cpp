@@ -0,0 +1,53 @@
+#include "memory_stats.h"
+
+#include <atomic>
+#include <iomanip>
+
+namespace cblt
+{
+    namespace
+    {
+        std::atomic<size_t> current_bytes[mem_category_count];
+        std::atomic<size_t> peak_bytes[mem_category_count];
+
+        const char *category_names[mem_category_count] = { "Geometry", "BVH", "Materials", "Scratch" };
+    }
+
+    void MemoryStats::Add(mem_category category, size_t bytes)
+    {
+        size_t now = current_bytes[category].fetch_add(bytes) + bytes;
+        size_t peak = peak_bytes[category].load();
+        // another thread may raise the peak at the same time, so retry until ours is stored or beaten
+        while (now > peak && !peak_bytes[category].compare_exchange_weak(peak, now))
+        {
+        }
+    }
+
+    void MemoryStats::Remove(mem_category category, size_t bytes)
+    {
+        current_bytes[category].fetch_sub(bytes);
+    }
+
+    size_t MemoryStats::Current(mem_category category)
+    {
+        return current_bytes[category].load();
+    }
+
+    size_t MemoryStats::Peak(mem_category category)
+    {
+        return peak_bytes[category].load();
+    }
+
+    void MemoryStats::Report(std::ostream &out)
+    {
+        const double to_mib = 1. / (1024. * 1024.);
+        out << "Memory (MiB)   current      peak\n";
+        for (int i = 0; i < mem_category_count; ++i)
+        {
+            mem_category category = static_cast<mem_category>(i);
+            out << std::left << std::setw(12) << category_names[i] << std::right << std::fixed << std::setprecision(2)
+                << std::setw(10) << Current(category) * to_mib << std::setw(10) << Peak(category) * to_mib << "\n";
+        }
+        out.unsetf(std::ios_base::floatfield);
+    }
+}
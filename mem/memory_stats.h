@@ -0,0 +1,35 @@
+#ifndef CBLT_MEMORY_STATS_H
+#define CBLT_MEMORY_STATS_H
+
+#include <cstddef>
+#include <ostream>
+
+namespace cblt
+{
+    // what a block of memory is used for, so usage can be reported per subsystem
+    enum mem_category
+    {
+        mem_geometry,  // triangles & instances
+        mem_bvh,  // acceleration structure nodes & primitive lists
+        mem_materials,
+        mem_scratch,  // transient per-thread memory used while building or rendering
+        mem_category_count
+    };
+
+    /**
+     * @brief Process wide counters of the memory handed out by the arenas & tracked allocators, along with the
+     * peak of each category. The counters are atomic, so they can be updated from any thread.
+     */
+    class MemoryStats
+    {
+        public:
+        static void Add(mem_category category, size_t bytes);
+        static void Remove(mem_category category, size_t bytes);
+        static size_t Current(mem_category category);
+        static size_t Peak(mem_category category);
+        // print the current & peak usage of every category
+        static void Report(std::ostream &out);
+    };
+}
+
+#endif  // CBLT_MEMORY_STATS_H
@@ -0,0 +1,482 @@
+#include "ray_tracer.h"
+
+#include "math/constants.h"
+
+#include "mem/memory_arena.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Bidirectional path tracing, following Veach's thesis & Physically Based Rendering 3rd Edition, Section 16.3.
+// Every sample traces a subpath from the camera & a subpath from a light, then connects each prefix of one to
+// each prefix of the other. Every connection is a different strategy for sampling a path of the same length, and
+// the strategies are weighed against each other with the power heuristic. Connecting light subpaths directly to
+// the camera (t = 1) would splat into other pixels, so those strategies aren't used, and aren't counted by the
+// weights either. Area lights are opaque here, so paths which hit one end there instead of passing through.
+
+namespace
+{
+    enum vertex_type
+    {
+        camera_vertex,
+        light_vertex,
+        surface_vertex
+    };
+
+    struct PathVertex
+    {
+        vertex_type type = surface_vertex;
+        // position & normal of every vertex, the rest is only filled in for surfaces. For lights at infinity
+        // the normal is the direction the light travels, and the position is unused
+        cblt::HitInfo hit;
+        cblt::Vec3 wo;  // direction towards the previous vertex of the subpath
+        Color beta;  // throughput of the subpath up to this vertex
+        float pdf_fwd = 0.f;  // area density of sampling this vertex from the previous one
+        float pdf_rev = 0.f;  // area density of sampling this vertex from the next one, in the other direction
+        int light_idx = -1;  // the light at this vertex, for light vertices & emissive surfaces
+        bool infinite = false;
+    };
+
+    using VertexVector = std::vector<PathVertex, cblt::ArenaAllocator<PathVertex>>;
+
+    // the densities of a vertex, with those at the ends of a connection changed to those of the connected path
+    struct Densities
+    {
+        float fwd;
+        float rev;
+    };
+
+    using DensityVector = std::vector<Densities, cblt::ArenaAllocator<Densities>>;
+
+    // the direction from one vertex to another
+    cblt::Vec3 Direction(const PathVertex &from, const PathVertex &to)
+    {
+        if (to.infinite)
+        {
+            return -to.hit.norm;
+        }
+        if (from.infinite)
+        {
+            return from.hit.norm;
+        }
+        return cblt::Normalize(to.hit.pos - from.hit.pos);
+    }
+
+    // convert a solid angle density at from into an area density at to
+    float ConvertDensity(float pdf, const PathVertex &from, const PathVertex &to)
+    {
+        if (to.infinite)
+        {
+            return pdf;
+        }
+        cblt::Vec3 w = to.hit.pos - from.hit.pos;
+        float dist_sqr = cblt::MagnitudeSqr(w);
+        if (dist_sqr <= 0.f)
+        {
+            return 0.f;
+        }
+        if (to.type != camera_vertex)
+        {
+            pdf *= cblt::AbsDot(to.hit.norm, w) / std::sqrt(dist_sqr);
+        }
+        return pdf / dist_sqr;
+    }
+
+    // area density with which the light at v emits a ray which reaches next
+    float PdfLight(cblt::Scene &scene, const PathVertex &v, const PathVertex &next, float scene_radius)
+    {
+        cblt::Vec3 w = Direction(v, next);
+        float pos_pdf, dir_pdf;
+        scene.GetLight(v.light_idx)->PdfLe(v.hit.pos, w, scene_radius, pos_pdf, dir_pdf);
+        if (v.infinite)
+        {
+            // the rays are parallel, so the density at next is the density of the ray origins on the disk
+            return (next.type == camera_vertex) ? pos_pdf : pos_pdf * cblt::AbsDot(next.hit.norm, w);
+        }
+        return ConvertDensity(dir_pdf, v, next);
+    }
+
+    // density with which v is chosen as the first vertex of a light subpath, which emits towards next
+    float PdfLightOrigin(cblt::Scene &scene, const PathVertex &v, const PathVertex &next, float scene_radius)
+    {
+        if (v.light_idx == -1)
+        {
+            return 0.f;
+        }
+        float pos_pdf, dir_pdf;
+        scene.GetLight(v.light_idx)->PdfLe(v.hit.pos, Direction(v, next), scene_radius, pos_pdf, dir_pdf);
+        // lights at infinity are found by direction, so their density is a solid angle density
+        return scene.EmitterPmf(v.light_idx) * ((v.infinite) ? dir_pdf : pos_pdf);
+    }
+
+    // area density with which cur samples next, for a subpath which arrived at cur from prev
+    float Pdf(cblt::Scene &scene, const PathVertex *prev, const PathVertex &cur, const PathVertex &next, float scene_radius)
+    {
+        if (cur.type == light_vertex)
+        {
+            return PdfLight(scene, cur, next, scene_radius);
+        }
+        float pdf;
+        scene.Materials().BRDF(cur.hit.mat_id, Direction(cur, next), Direction(cur, *prev), cur.hit, pdf);
+        return ConvertDensity(pdf, cur, next);
+    }
+
+    // true if nothing blocks the segment between the two vertices, area lights included
+    bool Unoccluded(cblt::Scene &scene, const PathVertex &from, const PathVertex &to, float time)
+    {
+        cblt::Vec3 dir = Direction(from, to);
+        float dist = (to.infinite) ? cblt::inf_F : cblt::Magnitude(to.hit.pos - from.hit.pos);
+        float max_time = dist * (1.f - cblt::eps_shadow_F);
+        cblt::Ray shadow_ray(from.hit.pos + dir * cblt::eps_zero_F, dir, time);
+        float occluder_time = cblt::inf_F;
+        scene.Intersects(shadow_ray, occluder_time);
+        if (occluder_time < max_time)
+        {
+            return false;
+        }
+        float light_time;
+        return scene.IntersectAreaLights(shadow_ray, max_time, light_time) == -1;
+    }
+
+    /**
+     * @brief Extend a subpath by sampling the BRDF at each vertex, until it leaves the scene, hits a light or has
+     * max_vertices vertices. The last vertex of path must already be filled in, and ray & pdf_dir are the ray
+     * leaving it & the solid angle density with which it was chosen. Camera subpaths keep the lights they hit as
+     * their final vertex, for the strategies which find emitters without connecting.
+     */
+    void RandomWalk(cblt::Scene &scene, cblt::Ray ray, Color beta, float pdf_dir, size_t max_vertices, bool from_camera,
+                    std::shared_ptr<cblt::Sampler> &sampler, VertexVector &path)
+    {
+        const cblt::MaterialTable &materials = scene.Materials();
+        while (path.size() < max_vertices)
+        {
+            PathVertex v;
+            v.beta = beta;
+            v.wo = -ray.dir;
+
+            v.hit.hit_time = cblt::inf_F;
+            bool hit = scene.ClosestIntersection(ray, v.hit);
+            float light_time;
+            int area_light = scene.IntersectAreaLights(ray, (hit) ? v.hit.hit_time : cblt::inf_F, light_time);
+            if (area_light != -1)
+            {
+                if (from_camera)
+                {
+                    v.type = light_vertex;
+                    v.light_idx = area_light;
+                    v.hit.pos = ray.pos + ray.dir * light_time;
+                    v.hit.norm = scene.GetLight(area_light)->Normal(v.hit.pos);
+                    v.pdf_fwd = ConvertDensity(pdf_dir, path.back(), v);
+                    path.push_back(v);
+                }
+                return;
+            }
+            if (!hit)
+            {
+                if (from_camera && scene.EnvironmentIndex() != -1)
+                {
+                    v.type = light_vertex;
+                    v.light_idx = scene.EnvironmentIndex();
+                    v.infinite = true;
+                    v.hit.norm = -ray.dir;
+                    v.pdf_fwd = pdf_dir;
+                    path.push_back(v);
+                }
+                return;
+            }
+            if (v.hit.mat_id == cblt::invalid_material)
+            {
+                return;
+            }
+
+            v.type = surface_vertex;
+            v.light_idx = scene.EmitterIndex(v.hit);
+            v.pdf_fwd = ConvertDensity(pdf_dir, path.back(), v);
+            path.push_back(v);
+            if (path.size() == max_vertices)
+            {
+                return;
+            }
+
+            // sample the BRDF to continue the path
+            cblt::Vec3 incoming;
+            float pdf;
+            Color f = materials.Sample(v.hit.mat_id, v.wo, incoming, pdf, v.hit, sampler);
+            if (pdf <= 0.f || f.r + f.g + f.b < cblt::eps_zero_F)
+            {
+                return;
+            }
+            beta = beta * f * cblt::AbsDot(v.hit.norm, incoming) / pdf;
+
+            // the density of walking this segment the other way round
+            float pdf_rev;
+            materials.BRDF(v.hit.mat_id, v.wo, incoming, v.hit, pdf_rev);
+            PathVertex &prev = path[path.size() - 2];
+            prev.pdf_rev = ConvertDensity(pdf_rev, path.back(), prev);
+            pdf_dir = pdf;
+
+            float cone_width = ray.cone_width + ray.cone_spread * v.hit.hit_time;
+            float cone_spread = ray.cone_spread;
+            ray = cblt::Ray(v.hit.pos + incoming * cblt::eps_zero_F, incoming, ray.time);
+            ray.cone_width = cone_width;
+            ray.cone_spread = cone_spread;
+        }
+    }
+
+    // a density of zero is taken as one, as PBRT does. The vertex's ratio is then neutral rather than ending the
+    // product, which would drop every strategy beyond it from the sum
+    float Remap0(float pdf)
+    {
+        return (pdf != 0.f) ? pdf : 1.f;
+    }
+
+    /**
+     * @brief The power heuristic weight of the strategy which connects the first s vertices of the light subpath
+     * to the first t vertices of the camera subpath. The weight needs the density of every other strategy for the
+     * same path, which only differ from this one by ratios of the forward & reverse densities of each vertex. For
+     * s == 1 the light vertex was sampled for this connection, and replaces the first vertex of the light subpath.
+     * cam_pdfs & light_pdfs are the sample's buffers, which hold at least t & s densities.
+     */
+    float MISWeight(cblt::Scene &scene, const VertexVector &camera, const VertexVector &light, const PathVertex &sampled,
+                    int s, int t, float scene_radius, DensityVector &cam_pdfs, DensityVector &light_pdfs)
+    {
+        if (s + t == 2)
+        {
+            // an emitter seen directly by the camera, the only strategy for this path
+            return 1.f;
+        }
+        const PathVertex &pt = camera[t - 1];
+        const PathVertex &pt_minus = camera[t - 2];
+        const PathVertex *qs = (s == 1) ? &sampled : (s > 1) ? &light[s - 1] : nullptr;
+        const PathVertex *qs_minus = (s > 1) ? &light[s - 2] : nullptr;
+
+        for (int i = 0; i < t; ++i)
+        {
+            cam_pdfs[i] = { camera[i].pdf_fwd, camera[i].pdf_rev };
+        }
+        for (int i = 0; i < s; ++i)
+        {
+            const PathVertex &v = (i == 0 && s == 1) ? sampled : light[i];
+            light_pdfs[i] = { v.pdf_fwd, v.pdf_rev };
+        }
+
+        cam_pdfs[t - 1].rev = (s > 0) ? Pdf(scene, qs_minus, *qs, pt, scene_radius) : PdfLightOrigin(scene, pt, pt_minus, scene_radius);
+        cam_pdfs[t - 2].rev = (s > 0) ? Pdf(scene, qs, pt, pt_minus, scene_radius) : PdfLight(scene, pt, pt_minus, scene_radius);
+        if (s > 0)
+        {
+            light_pdfs[s - 1].rev = Pdf(scene, &pt_minus, pt, *qs, scene_radius);
+        }
+        if (s > 1)
+        {
+            light_pdfs[s - 2].rev = Pdf(scene, &pt, *qs, *qs_minus, scene_radius);
+        }
+
+        // walk along each subpath, moving the connection one vertex further each step. The camera subpath has to
+        // keep at least two vertices, since the strategies with t = 1 aren't used
+        float sum_ri = 0.f;
+        float ri = 1.f;
+        for (int i = t - 1; i > 1; --i)
+        {
+            ri *= Remap0(cam_pdfs[i].rev) / Remap0(cam_pdfs[i].fwd);
+            sum_ri += ri * ri;
+        }
+        ri = 1.f;
+        int light_idx = (s == 1) ? sampled.light_idx : (s > 1) ? light[0].light_idx : -1;
+        for (int i = s - 1; i >= 0; --i)
+        {
+            ri *= Remap0(light_pdfs[i].rev) / Remap0(light_pdfs[i].fwd);
+            // a dirac delta light can't be hit, so it can't be the end of a camera subpath
+            if (i > 0 || !scene.GetLight(light_idx)->isDiracDelta())
+            {
+                sum_ri += ri * ri;
+            }
+        }
+        return 1.f / (1.f + sum_ri);
+    }
+
+    // the weighted contribution of connecting the first s vertices of the light subpath to the first t vertices
+    // of the camera subpath
+    Color ConnectSubpaths(cblt::Scene &scene, const VertexVector &camera, const VertexVector &light, int s, int t,
+                          const cblt::Vec3 &scene_cen, float scene_radius, std::shared_ptr<cblt::Sampler> &sampler,
+                          DensityVector &cam_pdfs, DensityVector &light_pdfs)
+    {
+        const cblt::MaterialTable &materials = scene.Materials();
+        const PathVertex &pt = camera[t - 1];
+        const PathVertex &pt_minus = camera[t - 2];
+        Color L = Color::GreyScale(0.f);
+        PathVertex sampled;
+        if (s == 0)
+        {
+            // the camera subpath found an emitter by itself
+            if (pt.type == light_vertex)
+            {
+                float pdf;
+                cblt::Vec3 light_pos = (pt.infinite) ? pt_minus.hit.pos - pt.hit.norm : pt.hit.pos;
+                L = pt.beta * scene.GetLight(pt.light_idx)->Radiance(light_pos, pt_minus.hit.pos, pt_minus.hit.norm, pdf);
+            }
+            else
+            {
+                L = pt.beta * materials.Emittance(pt.hit.mat_id);
+            }
+        }
+        else
+        {
+            if (pt.type != surface_vertex)
+            {
+                return L;
+            }
+            if (s == 1)
+            {
+                // choose a new point on a light, as for direct lighting, rather than reuse the light subpath's
+                float light_u, light_pmf;
+                sampler->Next1D(light_u);
+                int light_idx = scene.SampleEmitter(light_u, light_pmf);
+                if (light_idx == -1 || light_pmf <= 0.f)
+                {
+                    return L;
+                }
+                const std::shared_ptr<cblt::Light> &light_src = scene.GetLight(light_idx);
+                cblt::Vec3 to_light;
+                float dist, light_pdf;
+                Color light_rad = light_src->Sample(to_light, pt.hit.pos, pt.hit.norm, dist, light_pdf, sampler);
+                if (light_pdf <= 0.f || light_rad.Luminance() <= cblt::eps_zero_F)
+                {
+                    return L;
+                }
+                sampled.type = light_vertex;
+                sampled.light_idx = light_idx;
+                sampled.infinite = light_src->isInfinite();
+                if (sampled.infinite)
+                {
+                    sampled.hit.norm = -to_light;
+                }
+                else
+                {
+                    sampled.hit.pos = pt.hit.pos + to_light * dist;
+                    sampled.hit.norm = light_src->Normal(sampled.hit.pos);
+                }
+                float cos_pt = cblt::AbsDot(pt.hit.norm, to_light);
+                if (cos_pt <= cblt::eps_zero_F)
+                {
+                    return L;
+                }
+                sampled.pdf_fwd = PdfLightOrigin(scene, sampled, pt, scene_radius);
+
+                float pdf;
+                Color f = materials.BRDF(pt.hit.mat_id, to_light, pt.wo, pt.hit, pdf);
+                L = pt.beta * f * light_rad * cos_pt / (light_pdf * light_pmf);
+                if (L.Luminance() > 0.f && !Unoccluded(scene, pt, sampled, pt.hit.time))
+                {
+                    return Color::GreyScale(0.f);
+                }
+            }
+            else
+            {
+                const PathVertex &qs = light[s - 1];
+                if (qs.type != surface_vertex)
+                {
+                    return L;
+                }
+                cblt::Vec3 to_qs = qs.hit.pos - pt.hit.pos;
+                float dist_sqr = cblt::MagnitudeSqr(to_qs);
+                if (dist_sqr <= 0.f)
+                {
+                    return L;
+                }
+                to_qs = to_qs / std::sqrt(dist_sqr);
+                float geom = cblt::AbsDot(pt.hit.norm, to_qs) * cblt::AbsDot(qs.hit.norm, to_qs) / dist_sqr;
+                if (geom <= 0.f)
+                {
+                    // the BRDFs aren't defined for grazing directions
+                    return L;
+                }
+                float pdf;
+                Color f_pt = materials.BRDF(pt.hit.mat_id, to_qs, pt.wo, pt.hit, pdf);
+                Color f_qs = materials.BRDF(qs.hit.mat_id, -to_qs, qs.wo, qs.hit, pdf);
+                L = qs.beta * f_qs * f_pt * pt.beta * geom;
+                if (L.Luminance() > 0.f && !Unoccluded(scene, pt, qs, pt.hit.time))
+                {
+                    return Color::GreyScale(0.f);
+                }
+            }
+        }
+        if (L.Luminance() <= 0.f)
+        {
+            return Color::GreyScale(0.f);
+        }
+        return L * MISWeight(scene, camera, light, sampled, s, t, scene_radius, cam_pdfs, light_pdfs);
+    }
+}
+
+Color RayTracer::BidirectionalPathTrace(cblt::Ray cam_ray, std::shared_ptr<cblt::Sampler> &generator, const cblt::Vec3 &scene_cen, float scene_radius)
+{
+    cblt::Scene &scene = *image_scene_;
+
+    // the vertices only live for this sample, so they come from the thread's scratch arena
+    cblt::ArenaAllocator<PathVertex> alloc(cblt::ThreadScratch(), cblt::mem_scratch);
+    size_t max_depth = static_cast<size_t>(image_settings_.path_depth);
+    VertexVector camera(alloc);
+    VertexVector light(alloc);
+    camera.reserve(max_depth + 2);
+    light.reserve(max_depth + 1);
+    // every strategy's weight is worked out in the same buffers, which fit the longest subpaths
+    DensityVector cam_pdfs(max_depth + 2, Densities(), cblt::ArenaAllocator<Densities>(alloc));
+    DensityVector light_pdfs(max_depth + 1, Densities(), cblt::ArenaAllocator<Densities>(alloc));
+
+    // the camera subpath, the camera vertex only needs a position since t = 1 strategies aren't used
+    PathVertex cam_vertex;
+    cam_vertex.type = camera_vertex;
+    cam_vertex.hit.pos = cam_ray.pos;
+    cam_vertex.beta = Color(1.f, 1.f, 1.f);
+    camera.push_back(cam_vertex);
+    RandomWalk(scene, cam_ray, cam_vertex.beta, 1.f, max_depth + 2, true, generator, camera);
+
+    // the light subpath
+    float light_u, light_pmf;
+    generator->Next1D(light_u);
+    int light_idx = scene.SampleEmitter(light_u, light_pmf);
+    if (light_idx != -1 && light_pmf > 0.f)
+    {
+        const std::shared_ptr<cblt::Light> &light_src = scene.GetLight(light_idx);
+        cblt::Ray light_ray;
+        PathVertex light_vertex_0;
+        float pos_pdf, dir_pdf;
+        Color light_rad = light_src->SampleLe(light_ray, light_vertex_0.hit.norm, pos_pdf, dir_pdf, scene_cen, scene_radius, generator);
+        if (pos_pdf > 0.f && dir_pdf > 0.f && light_rad.Luminance() > 0.f)
+        {
+            light_ray.time = cam_ray.time;
+            light_vertex_0.type = light_vertex;
+            light_vertex_0.light_idx = light_idx;
+            light_vertex_0.infinite = light_src->isInfinite();
+            light_vertex_0.hit.pos = light_ray.pos;
+            light_vertex_0.beta = light_rad;
+            light_vertex_0.pdf_fwd = light_pmf * ((light_vertex_0.infinite) ? dir_pdf : pos_pdf);
+            light.push_back(light_vertex_0);
+
+            Color beta = light_rad * cblt::AbsDot(light_vertex_0.hit.norm, light_ray.dir) / (light_pmf * pos_pdf * dir_pdf);
+            RandomWalk(scene, light_ray, beta, dir_pdf, max_depth + 1, false, generator, light);
+            if (light_vertex_0.infinite && light.size() > 1)
+            {
+                // rays from lights at infinity are parallel, so the first hit's density is that of the ray origin
+                light[1].pdf_fwd = pos_pdf * cblt::AbsDot(light[1].hit.norm, light_ray.dir);
+            }
+        }
+    }
+
+    // connect every pair of prefixes, s = 1 doesn't need the light subpath since it samples a new light vertex
+    Color tot_light(0.f, 0.f, 0.f);
+    int num_light = static_cast<int>(light.size());
+    for (int t = 2; t <= static_cast<int>(camera.size()); ++t)
+    {
+        for (int s = 0; s <= std::max(num_light, 1); ++s)
+        {
+            if (s + t - 2 > image_settings_.path_depth)
+            {
+                break;
+            }
+            tot_light = tot_light + ConnectSubpaths(scene, camera, light, s, t, scene_cen, scene_radius, generator, cam_pdfs, light_pdfs);
+        }
+    }
+    return tot_light;
+}
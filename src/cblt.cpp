@@ -0,0 +1,319 @@
+#include "cblt.h"
+
+#include "ray_tracer.h"
+
+#include "mat/cook_torrence.h"
+#include "mat/disney_principled.h"
+#include "mat/material_table.h"
+#include "mat/texture.h"
+
+#include "math/vec.h"
+#include "math/mat4.h"
+#include "math/animated_affine.h"
+#include "math/math_helpers.h"
+
+#include "light/area_light.h"
+#include "light/direction_light.h"
+#include "light/environment_light.h"
+
+#include "geom/scene.h"
+#include "geom/scene_prim.h"
+#include "geom/triangle.h"
+#include "geom/triangle_mesh.h"
+
+#include "mem/memory_arena.h"
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+    const uint32_t invalid_handle = std::numeric_limits<uint32_t>::max();
+
+    cblt::Vec3 ToVec3(const float v[3])
+    {
+        return cblt::Vec3(v[0], v[1], v[2]);
+    }
+
+    Color ToColor(const float c[3])
+    {
+        return Color(c[0], c[1], c[2]);
+    }
+}
+
+struct cblt::SceneBuilder::Contents
+{
+    cblt::Camera cam;
+    // triangles are packed into the arena, each one keeps it alive for as long as the scene uses it
+    std::shared_ptr<cblt::MemoryArena> arena = std::make_shared<cblt::MemoryArena>();
+    std::shared_ptr<cblt::MaterialTable> materials = std::make_shared<cblt::MaterialTable>();
+    std::shared_ptr<cblt::TextureCache> tex_cache = std::make_shared<cblt::TextureCache>();
+    cblt::TextureLibrary textures{ tex_cache };  //! so materials which use the same image share one texture
+    std::vector<cblt::MaterialId> material_ids;  //! indexed by the handles given out by AddMaterial
+    std::vector<std::shared_ptr<cblt::Geometry>> meshes;
+    std::vector<std::shared_ptr<cblt::ScenePrim>> s_prims;
+    std::vector<std::shared_ptr<cblt::Light>> lights;
+};
+
+struct cblt::Renderer::Settings
+{
+    RenderSettings settings = { 1280, 720, 32, 8, 10, 32, true, path_tracing, false, false, false };
+};
+
+cblt::SceneBuilder::SceneBuilder() : contents_(std::make_unique<Contents>())
+{
+}
+
+cblt::SceneBuilder::~SceneBuilder()
+{
+}
+
+void cblt::SceneBuilder::SetCamera(const float eye[3], const float forward[3], const float up[3], float horiz_half_fov)
+{
+    contents_->cam.Orient(ToVec3(eye), ToVec3(forward), ToVec3(up), cblt::toRadians(horiz_half_fov));
+}
+
+void cblt::SceneBuilder::SetShutter(float open, float close)
+{
+    contents_->cam.SetShutter(open, close);
+}
+
+uint32_t cblt::SceneBuilder::AddMaterial(const PrincipledMaterialData &material)
+{
+    Color base = ToColor(material.base_color);
+    cblt::DisneyPrincipledMaterial mat(base, material.subsurface, material.metallic, material.specular, material.specular_tint, material.roughness,
+                                       material.anisotropic, material.sheen, material.sheen_tint, material.clearcoat, material.clearcoat_gloss, material.ior, false);
+    if (!material.base_texture.empty())
+    {
+        std::shared_ptr<cblt::Texture> tex = contents_->textures.Get(material.base_texture);
+        if (!tex->Valid())
+        {
+            return invalid_handle;
+        }
+        mat.SetBaseTexture(tex);
+    }
+    contents_->material_ids.push_back(contents_->materials->Add(mat));
+    return static_cast<uint32_t>(contents_->material_ids.size() - 1);
+}
+
+uint32_t cblt::SceneBuilder::AddMaterial(const CookTorrenceMaterialData &material)
+{
+    std::shared_ptr<cblt::Texture> tex;
+    if (!material.albedo_texture.empty())
+    {
+        tex = contents_->textures.Get(material.albedo_texture);
+        if (!tex->Valid())
+        {
+            return invalid_handle;
+        }
+    }
+    // with a texture the albedo comes from it instead
+    Color albedo = tex ? Color::GreyScale(1.f) : ToColor(material.albedo);
+    cblt::CookTorrenceMaterial mat(albedo, ToColor(material.specular), ToColor(material.emissive), material.ior, material.roughness, material.metallic);
+    if (tex)
+    {
+        mat.SetBaseTexture(tex);
+    }
+    contents_->material_ids.push_back(contents_->materials->Add(mat));
+    return static_cast<uint32_t>(contents_->material_ids.size() - 1);
+}
+
+uint32_t cblt::SceneBuilder::AddMesh(const MeshData &mesh)
+{
+    if (!mesh.positions || !mesh.indices)
+    {
+        return invalid_handle;
+    }
+    for (size_t i = 0; i < 3 * mesh.num_tris; ++i)
+    {
+        if (mesh.indices[i] >= mesh.num_verts)
+        {
+            return invalid_handle;
+        }
+    }
+
+    auto vertex = [](const float *arr, uint32_t id) { return cblt::Vec3(arr[3 * id], arr[3 * id + 1], arr[3 * id + 2]); };
+    std::vector<std::shared_ptr<cblt::Triangle>> tris;
+    tris.reserve(mesh.num_tris);
+    for (size_t i = 0; i < mesh.num_tris; ++i)
+    {
+        uint32_t id1 = mesh.indices[3 * i];
+        uint32_t id2 = mesh.indices[3 * i + 1];
+        uint32_t id3 = mesh.indices[3 * i + 2];
+        cblt::Vec3 pos1 = vertex(mesh.positions, id1);
+        cblt::Vec3 pos2 = vertex(mesh.positions, id2);
+        cblt::Vec3 pos3 = vertex(mesh.positions, id3);
+        uint32_t handle = mesh.materials ? mesh.materials[i] : mesh.material;
+        cblt::MaterialId cur_mat = (handle < contents_->material_ids.size()) ? contents_->material_ids[handle] : cblt::invalid_material;
+
+        if (mesh.uvs)
+        {
+            cblt::Vec2 uv1(mesh.uvs[2 * id1], mesh.uvs[2 * id1 + 1]);
+            cblt::Vec2 uv2(mesh.uvs[2 * id2], mesh.uvs[2 * id2 + 1]);
+            cblt::Vec2 uv3(mesh.uvs[2 * id3], mesh.uvs[2 * id3 + 1]);
+            // textured meshes without normals are shaded flat, with the face normal at every corner
+            cblt::Vec3 face_norm = cblt::Normalize(cblt::Cross(pos3 - pos1, pos2 - pos1));
+            cblt::Vec3 norm1 = mesh.normals ? vertex(mesh.normals, id1) : face_norm;
+            cblt::Vec3 norm2 = mesh.normals ? vertex(mesh.normals, id2) : face_norm;
+            cblt::Vec3 norm3 = mesh.normals ? vertex(mesh.normals, id3) : face_norm;
+            tris.push_back(cblt::AllocateShared<cblt::Triangle>(contents_->arena, cblt::mem_geometry, pos1, pos2, pos3,
+                           norm1, norm2, norm3, uv1, uv2, uv3, cur_mat));
+        }
+        else if (mesh.normals)
+        {
+            tris.push_back(cblt::AllocateShared<cblt::Triangle>(contents_->arena, cblt::mem_geometry, pos1, pos2, pos3,
+                           vertex(mesh.normals, id1), vertex(mesh.normals, id2), vertex(mesh.normals, id3), cur_mat));
+        }
+        else
+        {
+            tris.push_back(cblt::AllocateShared<cblt::Triangle>(contents_->arena, cblt::mem_geometry, pos1, pos2, pos3, cur_mat));
+        }
+    }
+    contents_->arena->Publish();
+    contents_->meshes.push_back(std::make_shared<cblt::TriangleMesh>(tris, *contents_->materials));
+    return static_cast<uint32_t>(contents_->meshes.size() - 1);
+}
+
+bool cblt::SceneBuilder::AddInstance(uint32_t mesh, const float transform[16])
+{
+    return AddInstance(mesh, nullptr, transform, 1);
+}
+
+bool cblt::SceneBuilder::AddInstance(uint32_t mesh, const float *times, const float *transforms, size_t num_keys)
+{
+    if (mesh >= contents_->meshes.size() || num_keys == 0)
+    {
+        return false;
+    }
+    // keyframes are sorted by time, as the scene file loader does
+    std::vector<size_t> order(num_keys);
+    for (size_t i = 0; i < num_keys; ++i)
+    {
+        order[i] = i;
+    }
+    if (times)
+    {
+        std::sort(order.begin(), order.end(), [times](size_t a, size_t b) { return times[a] < times[b]; });
+    }
+    std::vector<float> key_times;
+    std::vector<cblt::Affine> key_xforms;
+    for (size_t i : order)
+    {
+        float data[16];
+        std::copy(transforms + 16 * i, transforms + 16 * (i + 1), data);
+        key_times.push_back(times ? times[i] : 0.f);
+        key_xforms.emplace_back(cblt::Mat4(data));
+    }
+    contents_->s_prims.push_back(std::make_shared<cblt::ScenePrim>(contents_->meshes[mesh], cblt::AnimatedAffine(key_times, key_xforms)));
+    return true;
+}
+
+void cblt::SceneBuilder::AddAreaLight(const float pos[3], const float length_dir[3], const float normal[3], const float width_dir[3],
+                                      const float color[3], float power, float length, float width)
+{
+    contents_->lights.push_back(std::make_shared<cblt::AreaLight>(ToVec3(pos), ToVec3(length_dir), ToVec3(normal), ToVec3(width_dir),
+                                                                  ToColor(color), power, length, width));
+}
+
+void cblt::SceneBuilder::AddDirectionLight(const float dir[3], const float color[3], float power, float angular_spread)
+{
+    cblt::Vec3 light_dir = ToVec3(dir);
+    Color light_clr = ToColor(color);
+    contents_->lights.push_back(std::make_shared<cblt::DirectionLight>(light_dir, light_clr, power, angular_spread));
+}
+
+bool cblt::SceneBuilder::AddEnvironmentLight(const std::string &file_name, float power)
+{
+    std::shared_ptr<cblt::EnvironmentLight> env_light = std::make_shared<cblt::EnvironmentLight>(file_name, power);
+    if (!env_light->Valid())
+    {
+        return false;
+    }
+    contents_->lights.push_back(env_light);
+    return true;
+}
+
+std::shared_ptr<cblt::Scene> cblt::SceneBuilder::Build()
+{
+    std::shared_ptr<cblt::Scene> scene = std::make_shared<cblt::Scene>(contents_->cam, contents_->s_prims, contents_->lights, contents_->materials);
+    contents_ = std::make_unique<Contents>();
+    return scene;
+}
+
+cblt::Renderer::Renderer() : settings_(std::make_unique<Settings>())
+{
+}
+
+cblt::Renderer::~Renderer()
+{
+}
+
+bool cblt::Renderer::Configure(const std::string &settings)
+{
+    RenderSettings changed = settings_->settings;
+    std::istringstream in(settings);
+    std::string key;
+    while (in >> key)
+    {
+        if (!ParseSetting(key, in, changed) || in.fail())
+        {
+            return false;
+        }
+    }
+    if (changed.img_width <= 0 || changed.img_height <= 0 || changed.num_samples <= 0)
+    {
+        return false;
+    }
+    settings_->settings = changed;
+    return true;
+}
+
+int cblt::Renderer::Width() const
+{
+    return settings_->settings.img_width;
+}
+
+int cblt::Renderer::Height() const
+{
+    return settings_->settings.img_height;
+}
+
+bool cblt::Renderer::Render(const std::shared_ptr<Scene> &scene, float *rgb, const TileCallback &on_tile)
+{
+    if (!scene || !rgb)
+    {
+        return false;
+    }
+    const RenderSettings &settings = settings_->settings;
+    int width = settings.img_width;
+    // the ray tracer fits its own copy of the camera to the image, so renders can share the scene
+    std::shared_ptr<cblt::Scene> image_scene = scene;
+    RayTracer ray_tracer(settings, image_scene);
+    // tiles are copied out as they finish, so the caller can watch the image refine. Tiles don't overlap, so only
+    // the caller's callback, which is promised never to run concurrently, is serialized
+    std::mutex on_tile_mutex;
+    ray_tracer.SetTileCallback([rgb, width, &on_tile, &on_tile_mutex](const TileUpdate &tile)
+    {
+        for (int y = 0; y < tile.count_y; ++y)
+        {
+            for (int x = 0; x < tile.count_x; ++x)
+            {
+                Color pixel = tile.radiance[y * tile.stride + x] * tile.scale;
+                float *dst = rgb + 3 * ((tile.start_y + y) * width + tile.start_x + x);
+                dst[0] = pixel.r;
+                dst[1] = pixel.g;
+                dst[2] = pixel.b;
+            }
+        }
+        if (on_tile)
+        {
+            std::lock_guard<std::mutex> lock(on_tile_mutex);
+            on_tile(tile.start_x, tile.start_y, tile.count_x, tile.count_y);
+        }
+    });
+    ray_tracer.RenderRadiance();
+    return true;
+}
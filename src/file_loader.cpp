@@ -0,0 +1,34 @@
+#include "file_loader.h"
+
+#include "legacy_file_loader.h"
+#include "sdesc_file_loader.h"
+
+std::shared_ptr<cblt::Scene> LoadSceneFile(const std::string &file_name, const std::shared_ptr<cblt::TextureLibrary> &textures,
+                                           std::vector<std::string> *dependencies, std::ostream *log)
+{
+    if (file_name.find(".txt") != std::string::npos)
+    {
+        // legacy files from CSCI 5607 format
+        if (log)
+        {
+            *log << "Legacy format detected\n";
+        }
+        LegacyFileLoader file_loader;
+        return file_loader.LoadScene(file_name);
+    }
+    else if (file_name.find(".sdesc") != std::string::npos)
+    {
+        if (log)
+        {
+            *log << "SDesc format detected\n";
+        }
+        SDescFileLoader file_loader(textures, log);
+        std::shared_ptr<cblt::Scene> scene = file_loader.LoadScene(file_name);
+        if (dependencies)
+        {
+            dependencies->insert(dependencies->end(), file_loader.Dependencies().begin(), file_loader.Dependencies().end());
+        }
+        return scene;
+    }
+    return nullptr;
+}
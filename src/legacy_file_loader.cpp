@@ -2,6 +2,7 @@
 
 #include "mat/cook_torrence.h"
 #include "mat/disney_principled.h"
+#include "mat/material_table.h"
 
 #include "math/vec.h"
 #include "math/constants.h"
@@ -13,6 +14,8 @@
 #include "geom/triangle_mesh.h"
 #include "geom/scene_prim.h"
 
+#include "mem/memory_arena.h"
+
 #include <fstream>
 #include <memory>
 
@@ -22,14 +25,17 @@ std::shared_ptr<cblt::Scene> LegacyFileLoader::LoadScene(std::string file_name)
     if (!in_file.good()) {
         return nullptr;
     }
+    // triangles are packed into one arena, each one keeps it alive for as long as the scene uses it
+    std::shared_ptr<cblt::MemoryArena> scene_arena = std::make_shared<cblt::MemoryArena>();
+    std::shared_ptr<cblt::MaterialTable> materials = std::make_shared<cblt::MaterialTable>();
     // text-based OBJ style, can process line-by-line
     // The default material is a matte white
     int num_mats = 1;
-    std::shared_ptr<cblt::Material> cur_mat = std::make_unique<cblt::CookTorrenceMaterial>(
+    cblt::MaterialId cur_mat = materials->Add(cblt::CookTorrenceMaterial(
             Color(1.f, 1.f, 1.f), 
             Color(1.f, 1.f, 1.f), 
             Color(0.f, 0.f, 0.f),
-            1.f, 1.f, 0.0f);
+            1.f, 1.f, 0.0f));
     
     std::vector<std::shared_ptr<cblt::Light>> lights;
     
@@ -70,12 +76,12 @@ std::shared_ptr<cblt::Scene> LegacyFileLoader::LoadScene(std::string file_name)
                     >> ior >> rough >> metal;
             if (emissive.r + emissive.g + emissive.b > 0.f || metal == 0.f)
             {
-                cur_mat = std::make_unique<cblt::CookTorrenceMaterial>(albedo, specular, emissive, ior, rough, metal);
+                cur_mat = materials->Add(cblt::CookTorrenceMaterial(albedo, specular, emissive, ior, rough, metal));
             }
             else
             {
                 Color base(albedo.r, albedo.g, albedo.b);
-                cur_mat = std::make_unique<cblt::DisneyPrincipledMaterial>(base, 0.f, metal, 0.f, 0.f, rough, 1.f, 0.f, 0.f, 0.f, 0.f, 1.0, false);
+                cur_mat = materials->Add(cblt::DisneyPrincipledMaterial(base, 0.f, metal, 0.f, 0.f, rough, 1.f, 0.f, 0.f, 0.f, 0.f, 1.0, false));
             }            
         }
         else if (!command.compare("max_vertices:")) {
@@ -108,7 +114,7 @@ std::shared_ptr<cblt::Scene> LegacyFileLoader::LoadScene(std::string file_name)
                 continue;
             }
             // Find the corresponding vertices in the vertex array and add them to the triangle
-            tris.push_back(std::make_shared<cblt::Triangle>(verts[p1], verts[p2], verts[p3], cur_mat));
+            tris.push_back(cblt::AllocateShared<cblt::Triangle>(scene_arena, cblt::mem_geometry, verts[p1], verts[p2], verts[p3], cur_mat));
             //new_tri.mat_ = cur_mat;
         }
         else if (!command.compare("normal_triangle:")) {
@@ -119,7 +125,7 @@ std::shared_ptr<cblt::Scene> LegacyFileLoader::LoadScene(std::string file_name)
                 continue;
             }
             //new_tri.mat_ = cur_mat;
-            tris.push_back(std::make_shared<cblt::Triangle>(verts[p1], verts[p2], verts[p3], norms[n1], norms[n2], norms[n3], cur_mat));
+            tris.push_back(cblt::AllocateShared<cblt::Triangle>(scene_arena, cblt::mem_geometry, verts[p1], verts[p2], verts[p3], norms[n1], norms[n2], norms[n3], cur_mat));
         }
         /*else if (!command.compare("point_light:")) {
             Vec4 pos(0.f, 0.f, 0.f, 1.f);
@@ -157,8 +163,9 @@ std::shared_ptr<cblt::Scene> LegacyFileLoader::LoadScene(std::string file_name)
             continue;
         }
     }
+    scene_arena->Publish();
     // store all the triangles in a single mesh
-    std::shared_ptr<cblt::Geometry> geom = std::make_shared<cblt::TriangleMesh>(tris);
+    std::shared_ptr<cblt::Geometry> geom = std::make_shared<cblt::TriangleMesh>(tris, *materials);
     std::vector<std::shared_ptr<cblt::ScenePrim>> mesh;
     mesh.push_back(std::make_shared<cblt::ScenePrim>(geom, cblt::Identity_F));
     
@@ -166,6 +173,6 @@ std::shared_ptr<cblt::Scene> LegacyFileLoader::LoadScene(std::string file_name)
     cblt::Camera cam(cam_eye, cam_fwd, cam_up, cam_FOV);
 
     // construct the scene
-    std::shared_ptr<cblt::Scene> new_scene = std::make_shared<cblt::Scene>(cam, mesh, lights);
+    std::shared_ptr<cblt::Scene> new_scene = std::make_shared<cblt::Scene>(cam, mesh, lights, materials);
     return new_scene;
 }
\ No newline at end of file
@@ -1,23 +1,28 @@
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <chrono>
 
-#define STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "config.h"
 #include "camera.h"
 #include "image_lib.h"
-#include "legacy_file_loader.h"
-#include "sdesc_file_loader.h"
+#include "file_loader.h"
 #include "ray_tracer.h"
+#include "render_server.h"
+#include "mat/exr_tile_writer.h"
+#include "mem/memory_stats.h"
 
 bool loadConfiguration(std::string &file_path, RenderSettings &settings);
 
 int main(int argc, char* argv[])
 {
-    RenderSettings settings = { 1280, 720, 32, 8, 10, 32 };
+    RenderSettings settings = { 1280, 720, 32, 8, 10, 32, true, path_tracing, false, false, true };
     std::string file_name = std::string(DEBUG_DIR) + '/'; 
     std::string out_name = std::string(DEBUG_DIR) + '/';
+    std::string server_endpoint;
+    size_t scene_cache_size = 4;
+    // print the memory used by each subsystem after loading & after rendering, --memory takes no value
+    bool report_memory = std::find_if(argv + 1, argv + argc, [](const char *arg) { return !std::string(arg).compare("--memory"); }) != argv + argc;
     for (int i = 1; i < argc - 1; ++i)
     {
         std::string arg = argv[i];
@@ -51,33 +56,72 @@ int main(int argc, char* argv[])
             // set image size
             settings.img_height = std::stoi(argv[++i]);
         }
+        else if (!arg.compare("--server") || !arg.compare("-s"))
+        {
+            // render jobs sent to a port or Unix domain socket, rather than a single scene
+            server_endpoint = argv[++i];
+        }
+        else if (!arg.compare("--cache"))
+        {
+            // number of scenes the server keeps loaded
+            scene_cache_size = std::stoul(argv[++i]);
+        }
     }
-    
-    std::cout << "Opening " << file_name << std::endl;
-    std::shared_ptr<cblt::Scene> my_scene;
-    if (file_name.find(".txt") != std::string::npos)
-    {
-        // legacy files from CSCI 5607 format
-        std::cout << "Legacy format detected\n";
-        LegacyFileLoader file_loader;
-        my_scene = file_loader.LoadScene(file_name);
-    }
-    else if (file_name.find(".sdesc") != std::string::npos)
+
+    if (!server_endpoint.empty())
     {
-        std::cout << "SDesc format detected\n";
-        SDescFileLoader file_loader;
-        my_scene = file_loader.LoadScene(file_name);
+        RenderServer server(settings, scene_cache_size);
+        return server.Run(server_endpoint) ? 0 : 1;
     }
-    else
+    
+    std::cout << "Opening " << file_name << std::endl;
+    std::shared_ptr<cblt::Scene> my_scene = LoadSceneFile(file_name, nullptr, nullptr, &std::cout);
+    if (!my_scene)
     {
         std::cerr << "Invalid file format" << std::endl;
         std::exit(1);
     }
     
-    my_scene->cam_.ConfigureExtent(static_cast<float>(settings.img_width), static_cast<float>(settings.img_height));
+    if (report_memory)
+    {
+        cblt::MemoryStats::Report(std::cout);
+    }
     RayTracer ray_tracer(settings, my_scene);
     auto s_time = std::chrono::high_resolution_clock::now();
-    std::shared_ptr<Image> img = ray_tracer.Render();
+    // EXR output is linear radiance, written a tile at a time as tiles finish so the frame is never held whole
+    bool exr = out_name.size() > 4 && !out_name.compare(out_name.size() - 4, 4, ".exr");
+    std::shared_ptr<Image> img;
+    cblt::TiledEXRWriter exr_writer;
+    if (exr)
+    {
+        if (!exr_writer.Open(out_name, settings.img_width, settings.img_height, settings.tile_size))
+        {
+            std::cerr << "Unable to write " << out_name << std::endl;
+            std::exit(1);
+        }
+        ray_tracer.SetTileCallback([&exr_writer](const TileUpdate &tile)
+        {
+            exr_writer.WriteTile(tile.start_x, tile.start_y, tile.count_x, tile.count_y, tile.radiance, tile.stride, tile.scale);
+        });
+        if (!ray_tracer.RenderStreaming())
+        {
+            // the integrator needs the whole frame, which is then written out tile by tile
+            ray_tracer.SetTileCallback(nullptr);
+            std::vector<Color> radiance = ray_tracer.RenderRadiance();
+            for (int y = 0; y < settings.img_height; y += settings.tile_size)
+            {
+                for (int x = 0; x < settings.img_width; x += settings.tile_size)
+                {
+                    exr_writer.WriteTile(x, y, std::min(settings.tile_size, settings.img_width - x), std::min(settings.tile_size, settings.img_height - y),
+                                         &radiance[y * settings.img_width + x], settings.img_width, 1.f);
+                }
+            }
+        }
+    }
+    else
+    {
+        img = ray_tracer.Render();
+    }
     auto e_time = std::chrono::high_resolution_clock::now();
     
     auto mil = std::chrono::duration_cast<std::chrono::milliseconds>(e_time - s_time);
@@ -85,6 +129,10 @@ int main(int argc, char* argv[])
     int seconds = static_cast<int>(mil.count() / 1000 - 60 * minutes);
     int milliseconds = static_cast<int>(mil.count() - 60000 * minutes - 1000 * seconds); 
     std::cout << "\nRender Time " << minutes << ":" << seconds << "." << milliseconds << "\n"; 
+    if (report_memory)
+    {
+        cblt::MemoryStats::Report(std::cout);
+    }
     /*std::cout << "Change output file name (y/n)? ";
     char new_file_name;
     std::cin >> new_file_name;
@@ -94,7 +142,11 @@ int main(int argc, char* argv[])
         std::cin >> out_name;
         out_name = std::string(DEBUG_DIR) + '/' + out_name; 
     }*/
-    img->write(out_name.c_str());
+    if (exr ? !exr_writer.Close() : !img->write(out_name.c_str()))
+    {
+        std::cerr << "Unable to write " << out_name << std::endl;
+        return 1;
+    }
     std::cout << "Wrote result to " << out_name << std::endl;
     return 0;
 }
@@ -108,33 +160,9 @@ bool loadConfiguration(std::string &file_path, RenderSettings &settings)
     }
 
     std::string line;
-    while (!fin.eof())
+    while (fin >> line)
     {
-        fin >> line;
-        if (!line.compare("width:"))
-        {
-            fin >> settings.img_width;
-        }
-        else if (!line.compare("height:"))
-        {
-            fin >> settings.img_height;
-        }
-        else if (!line.compare("path_depth:"))
-        {
-            fin >> settings.path_depth;
-        }
-        else if (!line.compare("num_samples:"))
-        {
-            fin >> settings.num_samples;
-        }
-        else if (!line.compare("tile_size:"))
-        {
-            fin >> settings.tile_size;
-        }
-        else if (!line.compare("num_threads:"))
-        {
-            fin >> settings.num_threads;
-        }
+        ParseSetting(line, fin, settings);
     }
     
     return true;
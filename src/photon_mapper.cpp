@@ -0,0 +1,433 @@
+#include "ray_tracer.h"
+
+#include "math/constants.h"
+
+#include "mat/multiple_importance_heuristics.h"
+#include "mat/random_sampler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <omp.h>
+#include <vector>
+
+// Stochastic progressive photon mapping, following Hachisuka & Jensen's "Stochastic Progressive Photon Mapping" &
+// Physically Based Rendering 3rd Edition, Section 16.2. Every iteration traces photons from the lights into a hash
+// grid, then traces a camera path through each pixel which passes through smooth surfaces until it reaches a rough
+// one. There direct light is sampled as the path tracer would, & the photons within the pixel's radius estimate
+// the indirect light. Each pixel's radius shrinks as photons accumulate, so the estimate converges, & caustics
+// seen through or reflected off smooth surfaces, which no bounce towards a light can find, come from the photons.
+
+namespace
+{
+    // surfaces smoother than this are treated as mirrors, camera paths pass by them & photons aren't stored on them
+    const float specular_roughness = .1f;
+    // fraction of each iteration's photons which count towards shrinking the radius
+    const float photon_alpha = 2.f / 3.f;
+    // initial radius, as a fraction of the scene's bounding sphere
+    const float initial_radius_fraction = .005f;
+
+    struct Photon
+    {
+        cblt::Vec3 pos;
+        cblt::Vec3 wi;  // direction the photon arrived from
+        Color power;
+    };
+
+    struct PixelStats
+    {
+        Color direct;  // sum of the light found by the camera paths, rather than from photons
+        Color tau;  // flux gathered from photons, rescaled whenever the radius shrinks
+        float n = 0.f;  // number of photons accounted for by the radius
+        float radius = 0.f;
+    };
+
+    /**
+     * @brief Photons sorted by the cell of a uniform grid which contains them, so the photons a lookup visits are
+     * contiguous in memory. Cells are hashed into a table with an entry for each photon, which is filled by a
+     * counting sort, so every step of the build runs in parallel.
+     */
+    class PhotonGrid
+    {
+        public:
+        // photons are traced into a list per thread, so they don't need a lock
+        void Build(const std::vector<std::vector<Photon>> &thread_photons, float cell_size)
+        {
+            std::vector<size_t> offsets(thread_photons.size() + 1, 0);
+            for (size_t i = 0; i < thread_photons.size(); ++i)
+            {
+                offsets[i + 1] = offsets[i] + thread_photons[i].size();
+            }
+            int num_photons = static_cast<int>(offsets.back());
+            inv_cell_size_ = 1.f / cell_size;
+            table_size_ = std::max(1, num_photons);
+
+            std::vector<Photon> unsorted(num_photons);
+            std::vector<unsigned> cells(num_photons);
+            std::vector<std::atomic<int>> counts(table_size_ + 1);
+            #ifndef _DEBUG
+            #pragma omp parallel
+            #endif
+            {
+                #ifndef _DEBUG
+                #pragma omp for
+                #endif
+                for (int i = 0; i < static_cast<int>(thread_photons.size()); ++i)
+                {
+                    std::copy(thread_photons[i].begin(), thread_photons[i].end(), unsorted.begin() + offsets[i]);
+                }
+                #ifndef _DEBUG
+                #pragma omp for
+                #endif
+                for (int i = 0; i <= table_size_; ++i)
+                {
+                    counts[i].store(0, std::memory_order_relaxed);
+                }
+                #ifndef _DEBUG
+                #pragma omp for
+                #endif
+                for (int i = 0; i < num_photons; ++i)
+                {
+                    int x, y, z;
+                    Cell(unsorted[i].pos, x, y, z);
+                    cells[i] = Hash(x, y, z);
+                    counts[cells[i]].fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+
+            // the first photon of each cell, then scatter the photons after it
+            cell_start_.resize(table_size_ + 1);
+            int start = 0;
+            for (int i = 0; i <= table_size_; ++i)
+            {
+                cell_start_[i] = start;
+                start += counts[i].load(std::memory_order_relaxed);
+                counts[i].store(cell_start_[i], std::memory_order_relaxed);
+            }
+            photons_.resize(num_photons);
+            #ifndef _DEBUG
+            #pragma omp parallel for
+            #endif
+            for (int i = 0; i < num_photons; ++i)
+            {
+                photons_[counts[cells[i]].fetch_add(1, std::memory_order_relaxed)] = unsorted[i];
+            }
+        }
+
+        // call visit with every photon within radius of pos, the radius must be no larger than the cell size
+        template <typename Visitor>
+        void Gather(const cblt::Vec3 &pos, float radius, Visitor visit) const
+        {
+            if (photons_.empty())
+            {
+                return;
+            }
+            int min_x, min_y, min_z, max_x, max_y, max_z;
+            Cell(pos - cblt::Vec3(radius, radius, radius), min_x, min_y, min_z);
+            Cell(pos + cblt::Vec3(radius, radius, radius), max_x, max_y, max_z);
+            float radius_sqr = radius * radius;
+            // the radius spans at most 3 cells on each axis. Cells which hash to the same entry share its photons,
+            // so each entry is only visited once or its photons would be counted again
+            unsigned visited[27];
+            int num_visited = 0;
+            for (int z = min_z; z <= max_z; ++z)
+            {
+                for (int y = min_y; y <= max_y; ++y)
+                {
+                    for (int x = min_x; x <= max_x; ++x)
+                    {
+                        // other cells may share the entry, so the distance is always checked
+                        unsigned cell = Hash(x, y, z);
+                        if (std::find(visited, visited + num_visited, cell) != visited + num_visited)
+                        {
+                            continue;
+                        }
+                        if (num_visited < 27)
+                        {
+                            visited[num_visited++] = cell;
+                        }
+                        for (int i = cell_start_[cell]; i < cell_start_[cell + 1]; ++i)
+                        {
+                            if (cblt::MagnitudeSqr(photons_[i].pos - pos) <= radius_sqr)
+                            {
+                                visit(photons_[i]);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        private:
+        void Cell(const cblt::Vec3 &pos, int &x, int &y, int &z) const
+        {
+            x = static_cast<int>(std::floor(pos.x * inv_cell_size_));
+            y = static_cast<int>(std::floor(pos.y * inv_cell_size_));
+            z = static_cast<int>(std::floor(pos.z * inv_cell_size_));
+        }
+
+        unsigned Hash(int x, int y, int z) const
+        {
+            return ((static_cast<unsigned>(x) * 73856093U) ^ (static_cast<unsigned>(y) * 19349663U) ^
+                    (static_cast<unsigned>(z) * 83492791U)) % static_cast<unsigned>(table_size_);
+        }
+
+        std::vector<Photon> photons_;
+        std::vector<int> cell_start_;  //! index of the first photon of each table entry, & one past the last
+        int table_size_ = 1;
+        float inv_cell_size_ = 1.f;
+    };
+
+    // trace a photon from a light chosen by power, storing it at every rough surface it reaches after its first
+    // bounce, since the camera paths sample direct light themselves
+    void TracePhoton(cblt::Scene &scene, int max_depth, const cblt::Vec3 &scene_cen, float scene_radius,
+                     std::shared_ptr<cblt::Sampler> &sampler, std::vector<Photon> &photons)
+    {
+        float light_u, light_pmf;
+        sampler->Next1D(light_u);
+        int light_idx = scene.SampleEmitter(light_u, light_pmf);
+        if (light_idx == -1 || light_pmf <= 0.f)
+        {
+            return;
+        }
+        cblt::Ray ray;
+        cblt::Vec3 light_norm;
+        float pos_pdf, dir_pdf;
+        Color light_rad = scene.GetLight(light_idx)->SampleLe(ray, light_norm, pos_pdf, dir_pdf, scene_cen, scene_radius, sampler);
+        if (pos_pdf <= 0.f || dir_pdf <= 0.f || light_rad.Luminance() <= 0.f)
+        {
+            return;
+        }
+        // photons are emitted at a random moment of the shutter, like the camera rays
+        float shutter_u;
+        sampler->Next1D(shutter_u);
+        ray.time = scene.cam_.CreateRay(0.f, 0.f, shutter_u).time;
+
+        const cblt::MaterialTable &materials = scene.Materials();
+        Color beta = light_rad * cblt::AbsDot(light_norm, ray.dir) / (light_pmf * pos_pdf * dir_pdf);
+        for (int depth = 0; depth < max_depth; ++depth)
+        {
+            cblt::HitInfo hit;
+            hit.hit_time = cblt::inf_F;
+            if (!scene.ClosestIntersection(ray, hit) || hit.mat_id == cblt::invalid_material)
+            {
+                return;
+            }
+            if (depth > 0 && hit.roughness >= specular_roughness)
+            {
+                photons.push_back({ hit.pos, -ray.dir, beta });
+            }
+
+            cblt::Vec3 incoming;
+            float pdf;
+            Color f = materials.Sample(hit.mat_id, -ray.dir, incoming, pdf, hit, sampler);
+            if (pdf <= 0.f || f.r + f.g + f.b < cblt::eps_zero_F)
+            {
+                return;
+            }
+            Color new_beta = beta * f * cblt::AbsDot(hit.norm, incoming) / pdf;
+
+            // russian roulette, keeping the photons' power about constant
+            float survive = std::min(1.f, new_beta.Luminance() / beta.Luminance());
+            float cutoff;
+            sampler->Next1D(cutoff);
+            if (!(survive > 0.f) || cutoff > survive)
+            {
+                return;
+            }
+            beta = new_beta / survive;
+            ray = cblt::Ray(hit.pos + incoming * cblt::eps_zero_F, incoming, ray.time);
+        }
+    }
+}
+
+std::vector<Color> RayTracer::RenderProgressivePhotons()
+{
+    cblt::Scene &scene = *image_scene_;
+    const cblt::MaterialTable &materials = scene.Materials();
+    int width = image_settings_.img_width;
+    int height = image_settings_.img_height;
+    float half_width = width * .5f;
+    float half_height = height * .5f;
+    cblt::Vec3 scene_cen;
+    float scene_radius;
+    scene.BoundingSphere(scene_cen, scene_radius);
+
+    float max_radius = initial_radius_fraction * scene_radius;
+    std::vector<PixelStats> pixels(width * height);
+    for (PixelStats &stats : pixels)
+    {
+        stats.radius = max_radius;
+    }
+    // as many photons as pixels, so each iteration costs about the same for photons & camera paths
+    int photons_per_pass = width * height;
+    int num_passes = image_settings_.num_samples;
+    std::vector<std::vector<Photon>> thread_photons(omp_get_max_threads());
+    PhotonGrid grid;
+
+    if (image_settings_.show_progress)
+    {
+        std::cout << "Iterations: 0/" << num_passes << std::flush;
+    }
+    for (int pass = 0; pass < num_passes; ++pass)
+    {
+        #ifndef _DEBUG
+        #pragma omp parallel
+        #endif
+        {
+            std::shared_ptr<cblt::Sampler> generator = std::make_shared<cblt::RandomSampler>(omp_get_thread_num() * 1234U + pass * 7919U);
+            std::vector<Photon> &photons = thread_photons[omp_get_thread_num()];
+            photons.clear();
+            #ifndef _DEBUG
+            #pragma omp for schedule(dynamic, 256)
+            #endif
+            for (int i = 0; i < photons_per_pass; ++i)
+            {
+                TracePhoton(scene, image_settings_.path_depth, scene_cen, scene_radius, generator, photons);
+            }
+        }
+        // radii only shrink, so no lookup reaches further than the neighbouring cells
+        grid.Build(thread_photons, max_radius);
+
+        #ifndef _DEBUG
+        #pragma omp parallel
+        #endif
+        {
+            std::shared_ptr<cblt::Sampler> generator = std::make_shared<cblt::RandomSampler>(omp_get_thread_num() * 1234U + pass * 7919U + 104729U);
+            #ifndef _DEBUG
+            #pragma omp for schedule(dynamic, 4)
+            #endif
+            for (int y = 0; y < height; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    PixelStats &stats = pixels[y * width + x];
+                    float jitter_x, jitter_y;
+                    generator->Next2D(jitter_x, jitter_y);
+                    float shutter_u;
+                    generator->Next1D(shutter_u);
+                    cblt::Ray ray = camera_.CreateRay(half_width - (x + jitter_x), half_height - (y + jitter_y), shutter_u);
+
+                    // follow the path past smooth surfaces, picking up any light it sees on the way
+                    Color beta(1.f, 1.f, 1.f);
+                    cblt::Vec3 prev_pos, prev_norm;
+                    for (int depth = 0; depth < image_settings_.path_depth; ++depth)
+                    {
+                        cblt::HitInfo hit;
+                        hit.hit_time = cblt::inf_F;
+                        bool found = scene.ClosestIntersection(ray, hit);
+                        float light_pdf;
+                        if (depth > 0)
+                        {
+                            stats.direct = stats.direct + beta * scene.AreaLightRadiance(ray, (found) ? hit.hit_time : cblt::inf_F, prev_pos, prev_norm, light_pdf);
+                        }
+                        if (!found)
+                        {
+                            stats.direct = stats.direct + beta * scene.EnvironmentRadiance(prev_pos, prev_norm, ray.dir, light_pdf);
+                            break;
+                        }
+                        if (hit.mat_id == cblt::invalid_material)
+                        {
+                            break;
+                        }
+                        stats.direct = stats.direct + beta * materials.Emittance(hit.mat_id);
+
+                        if (hit.roughness >= specular_roughness || depth + 1 == image_settings_.path_depth)
+                        {
+                            // direct light, with the BRDF half of MIS found by a bounce as in the path tracer
+                            stats.direct = stats.direct + beta * scene.SampleSingleLight(-ray.dir, hit, generator, true);
+                            cblt::Vec3 incoming;
+                            float pdf;
+                            Color f = materials.Sample(hit.mat_id, -ray.dir, incoming, pdf, hit, generator);
+                            if (pdf > 0.f && f.r + f.g + f.b >= cblt::eps_zero_F)
+                            {
+                                Color bounce_beta = beta * f * cblt::AbsDot(hit.norm, incoming) / pdf;
+                                cblt::Ray bounce(hit.pos + incoming * cblt::eps_zero_F, incoming, hit.time);
+                                cblt::HitInfo light_pt;
+                                light_pt.hit_time = cblt::inf_F;
+                                bool bounce_found = scene.ClosestIntersection(bounce, light_pt);
+                                Color area = scene.AreaLightRadiance(bounce, (bounce_found) ? light_pt.hit_time : cblt::inf_F, hit.pos, hit.norm, light_pdf);
+                                if (light_pdf > 0.f)
+                                {
+                                    stats.direct = stats.direct + bounce_beta * area * cblt::PowerHeuristic(pdf, light_pdf, 2.f);
+                                }
+                                if (!bounce_found)
+                                {
+                                    Color env = scene.EnvironmentRadiance(hit.pos, hit.norm, incoming, light_pdf);
+                                    stats.direct = stats.direct + bounce_beta * env * cblt::PowerHeuristic(pdf, light_pdf, 2.f);
+                                }
+                                else if (light_pt.mat_id != cblt::invalid_material)
+                                {
+                                    Color emitted = materials.Emittance(light_pt.mat_id);
+                                    if (emitted.Luminance() > 0.f)
+                                    {
+                                        light_pdf = scene.LightPdf(hit.pos, hit.norm, light_pt);
+                                        stats.direct = stats.direct + bounce_beta * emitted * cblt::PowerHeuristic(pdf, light_pdf, 2.f);
+                                    }
+                                }
+                            }
+
+                            // indirect light from the photons around the point
+                            Color phi(0.f, 0.f, 0.f);
+                            int num_found = 0;
+                            grid.Gather(hit.pos, stats.radius, [&](const Photon &photon)
+                            {
+                                float photon_pdf;
+                                phi = phi + materials.BRDF(hit.mat_id, photon.wi, -ray.dir, hit, photon_pdf) * photon.power;
+                                ++num_found;
+                            });
+                            if (num_found > 0)
+                            {
+                                float new_n = stats.n + photon_alpha * num_found;
+                                float new_radius = stats.radius * std::sqrt(new_n / (stats.n + num_found));
+                                float scale = (new_radius * new_radius) / (stats.radius * stats.radius);
+                                stats.tau = (stats.tau + beta * phi) * scale;
+                                stats.n = new_n;
+                                stats.radius = new_radius;
+                            }
+                            break;
+                        }
+
+                        cblt::Vec3 incoming;
+                        float pdf;
+                        Color f = materials.Sample(hit.mat_id, -ray.dir, incoming, pdf, hit, generator);
+                        if (pdf <= 0.f || f.r + f.g + f.b < cblt::eps_zero_F)
+                        {
+                            break;
+                        }
+                        beta = beta * f * cblt::AbsDot(hit.norm, incoming) / pdf;
+                        prev_pos = hit.pos;
+                        prev_norm = hit.norm;
+
+                        float cone_width = ray.cone_width + ray.cone_spread * hit.hit_time;
+                        float cone_spread = ray.cone_spread;
+                        ray = cblt::Ray(hit.pos + incoming * cblt::eps_zero_F, incoming, hit.time);
+                        ray.cone_width = cone_width;
+                        ray.cone_spread = cone_spread;
+                    }
+                }
+            }
+        }
+
+        max_radius = 0.f;
+        for (const PixelStats &stats : pixels)
+        {
+            max_radius = std::max(max_radius, stats.radius);
+        }
+        if (image_settings_.show_progress)
+        {
+            std::cout << "\rIterations: " << pass + 1 << "/" << num_passes << std::flush;
+        }
+    }
+
+    // average the light the camera paths found, & add the density of the photons within each pixel's radius
+    std::vector<Color> radiance(width * height);
+    float photon_norm = 1.f / (static_cast<float>(num_passes) * photons_per_pass * cblt::PI_f);
+    for (int i = 0; i < width * height; ++i)
+    {
+        const PixelStats &stats = pixels[i];
+        radiance[i] = stats.direct / static_cast<float>(num_passes) + stats.tau * (photon_norm / (stats.radius * stats.radius));
+    }
+    return radiance;
+}
@@ -8,9 +8,12 @@
 #include "math/constants.h"
 
 #include "mat/material.h"
+#include "mat/multiple_importance_heuristics.h"
 #include "mat/random_sampler.h"
 #include "mat/sobol2D.h"
 
+#include "mem/memory_arena.h"
+
 #include <iostream>
 
 RayTracer::RayTracer(int width, int height, std::shared_ptr<cblt::Scene> &scene_data)
@@ -25,12 +28,26 @@ RayTracer::RayTracer(int width, int height, std::shared_ptr<cblt::Scene> &scene_
 
     image_settings_.num_threads = 10;
     image_settings_.tile_size = 32;
+    image_settings_.single_sample_mis = true;
+    image_settings_.integrator = path_tracing;
+    image_settings_.path_guiding = false;
+    image_settings_.resampled_direct = false;
+
+    camera_ = scene_data->cam_;
+    camera_.ConfigureExtent(static_cast<float>(width), static_cast<float>(height));
 }
 
 RayTracer::RayTracer(const RenderSettings &settings, std::shared_ptr<cblt::Scene> &scene_data)
+    : RayTracer(settings, scene_data, scene_data->cam_)
+{
+}
+
+RayTracer::RayTracer(const RenderSettings &settings, std::shared_ptr<cblt::Scene> &scene_data, const cblt::Camera &camera)
 {
     image_scene_ = scene_data;
     image_settings_ = settings;
+    camera_ = camera;
+    camera_.ConfigureExtent(static_cast<float>(settings.img_width), static_cast<float>(settings.img_height));
 }
 
 RayTracer::~RayTracer()
@@ -39,13 +56,53 @@ RayTracer::~RayTracer()
 
 std::shared_ptr<Image> RayTracer::Render()
 {
-    std::shared_ptr<Image> result = std::make_shared<Image>(image_settings_.img_width, image_settings_.img_height);
+    return ToneMap(RenderRadiance(), 1.f);
+}
+
+std::vector<Color> RayTracer::RenderRadiance()
+{
+    // lights added or moved since the last render are only now built into the light BVH
+    image_scene_->UpdateLights();
+    omp_set_num_threads(image_settings_.num_threads);
+    if (image_settings_.integrator == progressive_photon_mapping ||
+        (image_settings_.resampled_direct && image_settings_.integrator == path_tracing))
+    {
+        std::vector<Color> radiance = (image_settings_.integrator == progressive_photon_mapping) ? RenderProgressivePhotons() : RenderResampledDirect();
+        if (tile_callback_)
+        {
+            tile_callback_({ 0, 0, image_settings_.img_width, image_settings_.img_height, radiance.data(), image_settings_.img_width, 1.f });
+        }
+        return radiance;
+    }
+    return RenderTiles(false);
+}
+
+bool RayTracer::RenderStreaming()
+{
+    if (!CanStream())
+    {
+        return false;
+    }
+    image_scene_->UpdateLights();
+    omp_set_num_threads(image_settings_.num_threads);
+    RenderTiles(true);
+    return true;
+}
+
+bool RayTracer::CanStream() const
+{
+    // the other integrators, & guided path tracing, need the whole frame at once
+    return image_settings_.integrator == bidirectional_path_tracing ||
+           (image_settings_.integrator == path_tracing && !image_settings_.resampled_direct && !image_settings_.path_guiding);
+}
+
+std::vector<Color> RayTracer::RenderTiles(bool stream)
+{
     float half_width = image_settings_.img_width * .5f;
     float half_height = image_settings_.img_height * .5f;
     
     float frac = 1.f / static_cast<float>(image_settings_.num_samples);
-    
-    omp_set_num_threads(image_settings_.num_threads);
+
     // prepare tiles
     struct RenderTileWork
     {
@@ -73,103 +130,328 @@ std::shared_ptr<Image> RayTracer::Render()
         }
     }
 
+    // guided renders are split into passes which double in size, each one learning from the paths of the last.
+    // The final pass renders with the most refined guide, so it takes whatever is left over
+    std::vector<int> pass_samples;
+    if (image_settings_.path_guiding && image_settings_.integrator == path_tracing)
+    {
+        cblt::Vec3 scene_cen;
+        float scene_radius;
+        image_scene_->BoundingSphere(scene_cen, scene_radius);
+        guide_ = std::make_shared<cblt::SDTree>(scene_cen, scene_radius);
+        int remaining = image_settings_.num_samples;
+        for (int spp = 1; remaining - spp >= 2 * spp; spp *= 2)
+        {
+            pass_samples.push_back(spp);
+            remaining -= spp;
+        }
+        pass_samples.push_back(remaining);
+    }
+    else
+    {
+        guide_ = nullptr;
+        pass_samples.push_back(image_settings_.num_samples);
+    }
+    int num_passes = static_cast<int>(pass_samples.size());
+
+    // streamed tiles are rendered into a buffer of their thread's, & only live until they're handed over
+    std::vector<Color> accum;
+    if (!stream)
+    {
+        accum.assign(image_settings_.img_width * image_settings_.img_height, Color(0.f, 0.f, 0.f));
+    }
     int tiles_complete = 0;
-    int tiles_tot = tiles.size();
+    int tiles_tot = tiles.size() * num_passes;
 
-    std::cout << "Tiles: " << tiles_complete << "/" << tiles_tot << std::flush;
+    if (image_settings_.show_progress)
+    {
+        std::cout << "Tiles: " << tiles_complete << "/" << tiles_tot << std::flush;
+    }
 
-    #ifndef _DEBUG
-    #pragma omp parallel
-    #endif
+    // light paths of the bidirectional path tracer start from the scene's bounds, which don't change during a render
+    cblt::Vec3 scene_cen;
+    float scene_radius;
+    image_scene_->BoundingSphere(scene_cen, scene_radius);
+
+    int samples_done = 0;
+    for (int pass = 0; pass < num_passes; ++pass)
     {
-        std::shared_ptr<cblt::Sampler> generator = std::make_shared<cblt::RandomSampler>(omp_get_thread_num() * 1234U);
-        int tile_count = 0;
+        record_guide_ = guide_ && pass + 1 < num_passes;
+        int num_samples = pass_samples[pass];
+        samples_done += num_samples;
+        float pass_frac = 1.f / static_cast<float>(samples_done);
         #ifndef _DEBUG
-        #pragma omp for schedule(guided) nowait
+        #pragma omp parallel
         #endif
-        for (int idx = 0; idx < tiles.size(); ++idx)
-        {  
-            RenderTileWork &cur_tile = tiles[idx];
-            for (int pixel_y = 0; pixel_y < cur_tile.count_y; ++pixel_y)
-            {
-                for (int pixel_x = 0; pixel_x < cur_tile.count_x; ++pixel_x)
+        {
+            std::shared_ptr<cblt::Sampler> generator = std::make_shared<cblt::RandomSampler>(omp_get_thread_num() * 1234U + pass * 7919U);
+            cblt::MemoryArena &scratch = *cblt::ThreadScratch();
+            std::vector<Color> tile_buffer(stream ? t_size * t_size : 0);
+            int tile_count = 0;
+            #ifndef _DEBUG
+            #pragma omp for schedule(guided) nowait
+            #endif
+            for (int idx = 0; idx < tiles.size(); ++idx)
+            {  
+                RenderTileWork &cur_tile = tiles[idx];
+                // pixels of the tile, in the frame or the thread's own buffer
+                Color *tile_radiance = stream ? tile_buffer.data() : &accum[cur_tile.start_y * image_settings_.img_width + cur_tile.start_x];
+                int stride = stream ? cur_tile.count_x : image_settings_.img_width;
+                if (stream)
                 {
-                    int x = pixel_x + cur_tile.start_x;
-                    int y = pixel_y + cur_tile.start_y;
-                    Color tot_clr(0, 0, 0);
-                    for (int i = 1; i <= image_settings_.num_samples; i++)
+                    std::fill(tile_buffer.begin(), tile_buffer.end(), Color(0.f, 0.f, 0.f));
+                }
+                for (int pixel_y = 0; pixel_y < cur_tile.count_y; ++pixel_y)
+                {
+                    for (int pixel_x = 0; pixel_x < cur_tile.count_x; ++pixel_x)
                     {
-                        float jitter_x, jitter_y;
-                        generator->Next2D(jitter_x, jitter_y);
+                        int x = pixel_x + cur_tile.start_x;
+                        int y = pixel_y + cur_tile.start_y;
+                        Color tot_clr(0, 0, 0);
+                        for (int i = 1; i <= num_samples; i++)
+                        {
+                            // anything a sample allocates from the thread's scratch arena is released once it finishes
+                            cblt::ScratchScope sample_scope(scratch);
+                            float jitter_x, jitter_y;
+                            generator->Next2D(jitter_x, jitter_y);
 
-                        float u = half_width - (x + jitter_x);
-                        float v = half_height - (y + jitter_y);
+                            float u = half_width - (x + jitter_x);
+                            float v = half_height - (y + jitter_y);
 
-                        cblt::Ray ray = image_scene_->cam_.CreateRay(u, v);
-                        tot_clr = tot_clr + PathTraceIterative(ray, generator);
+                            float shutter_u;
+                            generator->Next1D(shutter_u);
+                            cblt::Ray ray = camera_.CreateRay(u, v, shutter_u);
+                            if (image_settings_.integrator == bidirectional_path_tracing)
+                            {
+                                tot_clr = tot_clr + BidirectionalPathTrace(ray, generator, scene_cen, scene_radius);
+                            }
+                            else
+                            {
+                                tot_clr = tot_clr + PathTraceIterative(ray, generator);
+                            }
+                        }
+                        Color &pixel = tile_radiance[pixel_y * stride + pixel_x];
+                        pixel = pixel + tot_clr;
                     }
-                    tot_clr = tot_clr * frac;
-                    // Reihard Tone Map
-                    Color hdr = tot_clr / (Color(1.f, 1.f, 1.f) + tot_clr);
-                    result->setPixel(x, y, Color(std::pow(hdr.r, 1.f / 2.2f), std::pow(hdr.g, 1.f / 2.2f), std::pow(hdr.b, 1.f / 2.2f)));
+                }
+                if (tile_callback_)
+                {
+                    // not serialized here, callbacks which share state lock only the part that needs it
+                    tile_callback_({ cur_tile.start_x, cur_tile.start_y, cur_tile.count_x, cur_tile.count_y, tile_radiance, stride, pass_frac });
+                }
+                ++tile_count;
+                if (tile_count == 10)
+                {
+                    #ifndef _DEBUG
+                    #pragma omp critical
+                    #endif
+                    {
+                        tiles_complete += 10;
+                        if (image_settings_.show_progress)
+                        {
+                            std::cout << "\rTiles: " << tiles_complete << "/" << tiles_tot << std::flush;
+                        }
+                    }
+                    tile_count = 0;
                 }
             }
-            ++tile_count;
-            if (tile_count == 10)
+            #ifndef _DEBUG
+            #pragma omp critical
+            #endif
             {
-                #ifndef _DEBUG
-                #pragma omp critical
-                #endif
+                tiles_complete += tile_count;
+                if (image_settings_.show_progress)
                 {
-                    tiles_complete += 10;
                     std::cout << "\rTiles: " << tiles_complete << "/" << tiles_tot << std::flush;
                 }
-                tile_count = 0;
             }
         }
-        #ifndef _DEBUG
-        #pragma omp critical
-        #endif
+        if (record_guide_)
+        {
+            guide_->Update(pass);
+        }
+    }
+    record_guide_ = false;
+    for (Color &pixel : accum)
+    {
+        pixel = pixel * frac;
+    }
+    return accum;
+}
+
+std::shared_ptr<Image> RayTracer::ToneMap(const std::vector<Color> &radiance, float scale) const
+{
+    std::shared_ptr<Image> result = std::make_shared<Image>(image_settings_.img_width, image_settings_.img_height);
+    #ifndef _DEBUG
+    #pragma omp parallel for
+    #endif
+    for (int y = 0; y < image_settings_.img_height; ++y)
+    {
+        for (int x = 0; x < image_settings_.img_width; ++x)
         {
-            tiles_complete += tile_count;
-            std::cout << "\rTiles: " << tiles_complete << "/" << tiles_tot << std::flush;
+            Color tot_clr = radiance[y * image_settings_.img_width + x] * scale;
+            // Reihard Tone Map
+            Color hdr = tot_clr / (Color(1.f, 1.f, 1.f) + tot_clr);
+            result->setPixel(x, y, Color(std::pow(hdr.r, 1.f / 2.2f), std::pow(hdr.g, 1.f / 2.2f), std::pow(hdr.b, 1.f / 2.2f)));
         }
     }
     return result;
 }
 
-Color RayTracer::PathTraceIterative(cblt::Ray cam_ray, std::shared_ptr<cblt::Sampler> &generator)
+Color RayTracer::PathTraceIterative(cblt::Ray cam_ray, std::shared_ptr<cblt::Sampler> &generator, const PrimaryVertex *primary)
 {
     Color tot_light(0.f, 0.f, 0.f), throughput(1.f, 1.f, 1.f);
     cblt::Ray path_ray = cam_ray;
+    // the previous path vertex, needed to weigh emission found by BRDF sampling against light sampling
+    cblt::Vec3 prev_pos, prev_norm;
+    float prev_pdf = 0.f;
+
+    // guided paths remember each vertex they bounced from, so the light which eventually arrives along the bounce
+    // can be recorded into the guide once the path ends
+    struct GuideRecord
+    {
+        cblt::DTree *dtree;
+        cblt::Vec3 dir;
+        Color throughput;  // throughput of the path after the bounce
+        float radiance;
+        float pdf;
+    };
+    std::vector<GuideRecord, cblt::ArenaAllocator<GuideRecord>> records(cblt::ArenaAllocator<GuideRecord>(cblt::ThreadScratch(), cblt::mem_scratch));
+    auto add_light = [&](const Color &light)
+    {
+        tot_light = tot_light + light;
+        for (GuideRecord &rec : records)
+        {
+            rec.radiance += light.Luminance() / rec.throughput.Luminance();
+        }
+    };
+
     for (int depth = 0; depth < image_settings_.path_depth; ++depth)
     {
         // intersect scene
         cblt::HitInfo scene_pt;
         scene_pt.hit_time = cblt::inf_F;
-        bool hit = SceneIntersect(path_ray, scene_pt);
+        bool hit;
+        if (primary && depth == 0)
+        {
+            scene_pt = primary->hit;
+            hit = primary->found;
+        }
+        else
+        {
+            hit = SceneIntersect(path_ray, scene_pt);
+        }
+        // the first vertex's direct light was resampled from every light, so light found by its bounce is counted
+        bool direct_resampled = primary && depth == 1;
+
+        if (image_settings_.single_sample_mis && depth > 0 && !direct_resampled)
+        {
+            // the BRDF half of MIS for the area light sampled at the previous vertex
+            float light_pdf;
+            Color area = image_scene_->AreaLightRadiance(path_ray, (hit) ? scene_pt.hit_time : cblt::inf_F, prev_pos, prev_norm, light_pdf);
+            if (light_pdf > 0.f)
+            {
+                float MIS = cblt::PowerHeuristic(prev_pdf, light_pdf, 2.f);
+                add_light(throughput * area * MIS);
+            }
+        }
         
         if (!hit) 
         {
+            // the path escaped the scene, so pick up light from the environment
+            float light_pdf;
+            Color env = image_scene_->EnvironmentRadiance(prev_pos, prev_norm, path_ray.dir, light_pdf);
+            float MIS = (depth == 0) ? 1.f : cblt::PowerHeuristic(prev_pdf, light_pdf, 2.f);
+            MIS = (direct_resampled) ? 0.f : MIS;
+            add_light(throughput * env * MIS);
             break;
         }
 
+        if (scene_pt.mat_id == cblt::invalid_material)
+        {
+            // a surface without a material absorbs the path, as in the other integrators
+            break;
+        }
+
+        // add emission from surfaces the path has hit
+        const cblt::MaterialTable &materials = image_scene_->Materials();
+        Color emitted = materials.Emittance(scene_pt.mat_id);
+        if (emitted.Luminance() > 0.f && !direct_resampled)
+        {
+            if (depth == 0)
+            {
+                // directly visible, there is no light sampling strategy for this path
+                add_light(throughput * emitted);
+            }
+            else
+            {
+                float light_pdf = image_scene_->LightPdf(prev_pos, prev_norm, scene_pt);
+                float MIS = cblt::PowerHeuristic(prev_pdf, light_pdf, 2.f);
+                add_light(throughput * emitted * MIS);
+            }
+        }
+
+        // once the guide has learnt something here, bounces are sampled from it or the BRDF with equal odds
+        cblt::DTree *dtree = (guide_) ? &guide_->Lookup(scene_pt.pos) : nullptr;
+        const cblt::DTree *sample_dtree = (dtree && dtree->Valid()) ? dtree : nullptr;
+        float guide_fraction = (sample_dtree) ? .5f : 0.f;
+
         // compute direct lighting contribution
-        tot_light = tot_light + throughput * image_scene_->SampleSingleLight(-path_ray.dir, scene_pt, generator);
+        if (primary && depth == 0)
+        {
+            add_light(throughput * primary->direct);
+        }
+        else
+        {
+            add_light(throughput * image_scene_->SampleSingleLight(-path_ray.dir, scene_pt, generator, image_settings_.single_sample_mis, sample_dtree, guide_fraction));
+        }
         
         // sample BRDF at point to determine how light is transmitted to the next point on the path
         cblt::Vec3 incoming;
         float pdf;
-        Color f = scene_pt.m->Sample(-path_ray.dir, incoming, pdf, scene_pt, generator);
+        Color f;
+        if (sample_dtree)
+        {
+            float strategy, u1, u2;
+            generator->Next1D(strategy);
+            if (strategy < guide_fraction)
+            {
+                generator->Next2D(u1, u2);
+                incoming = sample_dtree->Sample(u1, u2);
+                f = materials.BRDF(scene_pt.mat_id, incoming, -path_ray.dir, scene_pt, pdf);
+            }
+            else
+            {
+                f = materials.Sample(scene_pt.mat_id, -path_ray.dir, incoming, pdf, scene_pt, generator);
+            }
+            pdf = guide_fraction * sample_dtree->Pdf(incoming) + (1.f - guide_fraction) * pdf;
+        }
+        else
+        {
+            f = materials.Sample(scene_pt.mat_id, -path_ray.dir, incoming, pdf, scene_pt, generator);
+        }
         if (f.r + f.g + f.b < cblt::eps_zero_F)
         {
             break;
         }
         
+        if (pdf <= 0.f)
+        {
+            break;
+        }
+        
         float cos_theta = cblt::AbsDot(scene_pt.norm, incoming);
         throughput = throughput * f * cos_theta / pdf;
+        prev_pos = scene_pt.pos;
+        prev_norm = scene_pt.norm;
+        prev_pdf = pdf;
         
-        path_ray = cblt::Ray(scene_pt.pos + incoming * cblt::eps_zero_F, incoming);
+        // the footprint keeps growing from its width at this vertex
+        float cone_width = path_ray.cone_width + path_ray.cone_spread * scene_pt.hit_time;
+        float cone_spread = path_ray.cone_spread;
+        path_ray = cblt::Ray(scene_pt.pos + incoming * cblt::eps_zero_F, incoming, scene_pt.time);
+        path_ray.cone_width = cone_width;
+        path_ray.cone_spread = cone_spread;
 
         // russian roulette
         if (depth > 3)
@@ -183,6 +465,16 @@ Color RayTracer::PathTraceIterative(cblt::Ray cam_ray, std::shared_ptr<cblt::Sam
             }
             throughput = throughput / p;
         }
+
+        if (record_guide_ && throughput.Luminance() > 0.f)
+        {
+            records.push_back({ dtree, incoming, throughput, 0.f, pdf });
+        }
+    }
+
+    for (const GuideRecord &rec : records)
+    {
+        rec.dtree->Record(rec.dir, rec.radiance / rec.pdf);
     }
     return tot_light;
 }
@@ -191,4 +483,68 @@ Color RayTracer::PathTraceIterative(cblt::Ray cam_ray, std::shared_ptr<cblt::Sam
 bool RayTracer::SceneIntersect(cblt::Ray ray, cblt::HitInfo &hit)
 {
     return image_scene_->ClosestIntersection(ray, hit);
-}
\ No newline at end of file
+}
+
+bool ParseSetting(const std::string &key, std::istream &in, RenderSettings &settings)
+{
+    if (!key.compare("width:"))
+    {
+        in >> settings.img_width;
+    }
+    else if (!key.compare("height:"))
+    {
+        in >> settings.img_height;
+    }
+    else if (!key.compare("path_depth:"))
+    {
+        in >> settings.path_depth;
+    }
+    else if (!key.compare("num_samples:"))
+    {
+        in >> settings.num_samples;
+    }
+    else if (!key.compare("tile_size:"))
+    {
+        in >> settings.tile_size;
+    }
+    else if (!key.compare("num_threads:"))
+    {
+        in >> settings.num_threads;
+    }
+    else if (!key.compare("single_sample_mis:"))
+    {
+        in >> settings.single_sample_mis;
+    }
+    else if (!key.compare("integrator:"))
+    {
+        // "path", "bidirectional" or "photon"
+        std::string integrator;
+        in >> integrator;
+        settings.integrator = path_tracing;
+        if (!integrator.compare("bidirectional"))
+        {
+            settings.integrator = bidirectional_path_tracing;
+        }
+        else if (!integrator.compare("photon"))
+        {
+            settings.integrator = progressive_photon_mapping;
+        }
+    }
+    else if (!key.compare("path_guiding:"))
+    {
+        in >> settings.path_guiding;
+    }
+    else if (!key.compare("resampled_direct:"))
+    {
+        in >> settings.resampled_direct;
+    }
+    else if (!key.compare("show_progress:"))
+    {
+        in >> settings.show_progress;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,465 @@
+#include "render_server.h"
+
+#include "config.h"
+#include "file_loader.h"
+
+#include "math/math_helpers.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+    typedef SOCKET socket_t;
+    const socket_t invalid_socket = INVALID_SOCKET;
+
+    void CloseSocket(socket_t sock)
+    {
+        closesocket(sock);
+    }
+#else
+    typedef int socket_t;
+    const socket_t invalid_socket = -1;
+
+    void CloseSocket(socket_t sock)
+    {
+        close(sock);
+    }
+#endif
+
+    bool IsPort(const std::string &endpoint)
+    {
+        if (endpoint.empty())
+        {
+            return false;
+        }
+        for (char c : endpoint)
+        {
+            if (!std::isdigit(static_cast<unsigned char>(c)))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // the port an all digit endpoint names, or 0 if it's out of range
+    unsigned short ParsePort(const std::string &endpoint)
+    {
+        errno = 0;
+        long port = std::strtol(endpoint.c_str(), nullptr, 10);
+        if (errno == ERANGE || port < 1 || port > 65535)
+        {
+            return 0;
+        }
+        return static_cast<unsigned short>(port);
+    }
+
+    socket_t OpenListener(const std::string &endpoint)
+    {
+        socket_t listener = invalid_socket;
+        if (IsPort(endpoint))
+        {
+            unsigned short port = ParsePort(endpoint);
+            if (port == 0)
+            {
+                std::cerr << "Ports range from 1 to 65535" << std::endl;
+                return invalid_socket;
+            }
+            listener = socket(AF_INET, SOCK_STREAM, 0);
+            if (listener == invalid_socket)
+            {
+                return invalid_socket;
+            }
+            int reuse = 1;
+            setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+            // jobs name files on this machine, so only local clients are served
+            sockaddr_in addr = {};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+            {
+                CloseSocket(listener);
+                return invalid_socket;
+            }
+        }
+        else
+        {
+#ifdef _WIN32
+            std::cerr << "Unix domain sockets are unsupported, serve on a port instead" << std::endl;
+            return invalid_socket;
+#else
+            sockaddr_un addr = {};
+            if (endpoint.size() >= sizeof(addr.sun_path))
+            {
+                std::cerr << "Socket path is too long" << std::endl;
+                return invalid_socket;
+            }
+            // a socket left behind by a server which didn't shut down would fail the bind, but anything else at
+            // the path is someone's file
+            struct stat info;
+            if (lstat(endpoint.c_str(), &info) == 0)
+            {
+                if (!S_ISSOCK(info.st_mode))
+                {
+                    std::cerr << endpoint << " exists & isn't a socket" << std::endl;
+                    return invalid_socket;
+                }
+                unlink(endpoint.c_str());
+            }
+            listener = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listener == invalid_socket)
+            {
+                return invalid_socket;
+            }
+            addr.sun_family = AF_UNIX;
+            endpoint.copy(addr.sun_path, endpoint.size());
+            if (bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+            {
+                CloseSocket(listener);
+                return invalid_socket;
+            }
+#endif
+        }
+        if (listen(listener, 8) != 0)
+        {
+            CloseSocket(listener);
+            return invalid_socket;
+        }
+        return listener;
+    }
+
+    bool SendLine(socket_t client, const std::string &line)
+    {
+        std::string msg = line + '\n';
+        int flags = 0;
+#ifdef MSG_NOSIGNAL
+        // a client which hung up shouldn't kill the server
+        flags = MSG_NOSIGNAL;
+#endif
+        size_t sent = 0;
+        while (sent < msg.size())
+        {
+            int count = static_cast<int>(send(client, msg.data() + sent, static_cast<int>(msg.size() - sent), flags));
+            if (count <= 0)
+            {
+                return false;
+            }
+            sent += count;
+        }
+        return true;
+    }
+
+    // when a file was last saved, a missing file is given the earliest time so it only matches another missing file
+    std::filesystem::file_time_type ModTime(const std::string &file_name)
+    {
+        std::error_code err;
+        std::filesystem::file_time_type mod_time = std::filesystem::last_write_time(file_name, err);
+        return err ? std::filesystem::file_time_type::min() : mod_time;
+    }
+
+    // relative paths are relative to the data directory, as they are on the command line
+    std::string ResolvePath(const std::string &file_name)
+    {
+        if (std::filesystem::path(file_name).is_absolute())
+        {
+            return file_name;
+        }
+        return std::string(DEBUG_DIR) + '/' + file_name;
+    }
+}
+
+SceneCache::SceneCache(size_t capacity, const std::shared_ptr<cblt::TextureLibrary> &textures) :
+    capacity_(std::max<size_t>(capacity, 1)), textures_(textures)
+{
+}
+
+std::shared_ptr<cblt::Scene> SceneCache::Get(const std::string &file_name, bool &loaded)
+{
+    loaded = false;
+    std::error_code err;
+    std::filesystem::file_time_type mod_time = std::filesystem::last_write_time(file_name, err);
+    if (err)
+    {
+        return nullptr;
+    }
+    // the same file may be named by different paths
+    std::string key = std::filesystem::weakly_canonical(file_name, err).string();
+    if (err)
+    {
+        key = file_name;
+    }
+
+    // textures of the scenes released here are only let go of once the new scene is loaded, so it can reuse them
+    bool released = false;
+    auto found = lookup_.find(key);
+    if (found != lookup_.end())
+    {
+        bool current = true;
+        for (const auto &file : found->second->files)
+        {
+            current = current && ModTime(file.first) == file.second;
+        }
+        if (current)
+        {
+            entries_.splice(entries_.begin(), entries_, found->second);
+            return entries_.front().scene;
+        }
+        // stale, the scene or one of its files was saved since it was loaded
+        entries_.erase(found->second);
+        lookup_.erase(found);
+        released = true;
+    }
+
+    std::vector<std::string> dependencies;
+    std::shared_ptr<cblt::Scene> scene = LoadSceneFile(file_name, textures_, &dependencies, &std::cout);
+    if (!scene)
+    {
+        if (released)
+        {
+            textures_->ReleaseUnused();
+        }
+        return nullptr;
+    }
+    loaded = true;
+    Entry entry = { key, { { file_name, mod_time } }, scene };
+    for (const std::string &dependency : dependencies)
+    {
+        entry.files.emplace_back(dependency, ModTime(dependency));
+    }
+    entries_.push_front(std::move(entry));
+    lookup_[key] = entries_.begin();
+    while (entries_.size() > capacity_)
+    {
+        lookup_.erase(entries_.back().file_name);
+        entries_.pop_back();
+        released = true;
+    }
+    if (released)
+    {
+        textures_->ReleaseUnused();
+    }
+    return scene;
+}
+
+RenderServer::RenderServer(const RenderSettings &defaults, size_t cache_size) :
+    defaults_(defaults), textures_(std::make_shared<cblt::TextureLibrary>(std::make_shared<cblt::TextureCache>())), scenes_(cache_size, textures_)
+{
+}
+
+bool RenderServer::Run(const std::string &endpoint)
+{
+#ifdef _WIN32
+    WSADATA wsa_data;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0)
+    {
+        return false;
+    }
+#endif
+    socket_t listener = OpenListener(endpoint);
+    if (listener == invalid_socket)
+    {
+        std::cerr << "Could not listen on " << endpoint << std::endl;
+        return false;
+    }
+    std::cout << "Serving render jobs on " << endpoint << std::endl;
+
+    bool shutdown = false;
+    while (!shutdown)
+    {
+        socket_t client = accept(listener, nullptr, nullptr);
+        if (client == invalid_socket)
+        {
+            continue;
+        }
+        // a client may send any number of jobs. Replies wait for their image to be written, but only the last
+        // one is held back while the client's next job renders, so they go out in order
+        struct Reply
+        {
+            size_t write_ticket;
+            std::string output;
+            std::string text;
+        };
+        std::deque<Reply> replies;
+        auto send_replies = [&](size_t keep)
+        {
+            while (replies.size() > keep)
+            {
+                const Reply &reply = replies.front();
+                SendLine(client, writer_.Wait(reply.write_ticket) ? reply.text : "error could not write " + reply.output);
+                replies.pop_front();
+            }
+        };
+        std::string pending;
+        char chunk[4096];
+        int count;
+        while (!shutdown && (count = static_cast<int>(recv(client, chunk, sizeof(chunk), 0))) > 0)
+        {
+            pending.append(chunk, count);
+            size_t end;
+            while (!shutdown && (end = pending.find('\n')) != std::string::npos)
+            {
+                std::string job = pending.substr(0, end);
+                pending.erase(0, end + 1);
+                if (!job.empty() && job.back() == '\r')
+                {
+                    job.pop_back();
+                }
+                if (job.find_first_not_of(" \t") == std::string::npos)
+                {
+                    continue;
+                }
+
+                Reply reply = { 0, "", "" };
+                if (!job.compare("shutdown"))
+                {
+                    reply.text = "ok shutdown";
+                    shutdown = true;
+                }
+                else
+                {
+                    reply.text = StartJob(job, reply.write_ticket, reply.output);
+                }
+                replies.push_back(reply);
+                send_replies(1);
+            }
+            // the client is waiting for answers rather than sending more jobs
+            send_replies(0);
+        }
+        send_replies(0);
+        CloseSocket(client);
+    }
+
+    CloseSocket(listener);
+#ifdef _WIN32
+    WSACleanup();
+#else
+    if (!IsPort(endpoint))
+    {
+        unlink(endpoint.c_str());
+    }
+#endif
+    return true;
+}
+
+std::string RenderServer::RenderJob(const std::string &job)
+{
+    size_t write_ticket;
+    std::string output;
+    std::string reply = StartJob(job, write_ticket, output);
+    if (!writer_.Wait(write_ticket))
+    {
+        return "error could not write " + output;
+    }
+    return reply;
+}
+
+std::string RenderServer::StartJob(const std::string &job, size_t &write_ticket, std::string &output)
+{
+    write_ticket = 0;
+    output.clear();
+    RenderSettings settings = defaults_;
+    std::string input;
+    cblt::Vec3 cam_eye, cam_fwd, cam_up;
+    float cam_fov = 0.f;
+    bool set_eye = false, set_fwd = false, set_up = false, set_fov = false;
+
+    std::istringstream in(job);
+    std::string key;
+    while (in >> key)
+    {
+        if (!key.compare("input:"))
+        {
+            in >> input;
+        }
+        else if (!key.compare("output:"))
+        {
+            in >> output;
+        }
+        else if (!key.compare("camera_pos:"))
+        {
+            in >> cam_eye.x >> cam_eye.y >> cam_eye.z;
+            set_eye = true;
+        }
+        else if (!key.compare("camera_fwd:"))
+        {
+            in >> cam_fwd.x >> cam_fwd.y >> cam_fwd.z;
+            set_fwd = true;
+        }
+        else if (!key.compare("camera_up:"))
+        {
+            in >> cam_up.x >> cam_up.y >> cam_up.z;
+            set_up = true;
+        }
+        else if (!key.compare("camera_fov_ha:"))
+        {
+            in >> cam_fov;
+            cam_fov = cblt::toRadians(cam_fov);
+            set_fov = true;
+        }
+        else if (!ParseSetting(key, in, settings))
+        {
+            return "error unknown key " + key;
+        }
+        if (in.fail())
+        {
+            return "error bad value for " + key;
+        }
+    }
+    bool move_camera = set_eye || set_fwd || set_up || set_fov;
+    if (input.empty() || output.empty())
+    {
+        return "error a job needs an input: & an output:";
+    }
+    if (settings.img_width <= 0 || settings.img_height <= 0 || settings.num_samples <= 0)
+    {
+        return "error bad image size or sample count";
+    }
+
+    input = ResolvePath(input);
+    output = ResolvePath(output);
+    bool loaded;
+    std::shared_ptr<cblt::Scene> scene = scenes_.Get(input, loaded);
+    if (!scene)
+    {
+        return "error could not load " + input;
+    }
+
+    auto s_time = std::chrono::high_resolution_clock::now();
+    // jobs move a copy of the camera, so the cached scene is left as it was loaded
+    cblt::Camera job_cam = scene->cam_;
+    if (move_camera)
+    {
+        job_cam.Orient(set_eye ? cam_eye : job_cam.Eye(), set_fwd ? cam_fwd : job_cam.Forward(),
+                       set_up ? cam_up : job_cam.Up(), set_fov ? cam_fov : job_cam.HalfFov());
+    }
+    RayTracer ray_tracer(settings, scene, job_cam);
+    std::shared_ptr<Image> img = ray_tracer.Render();
+    auto e_time = std::chrono::high_resolution_clock::now();
+    write_ticket = writer_.Write(img, output);
+
+    auto mil = std::chrono::duration_cast<std::chrono::milliseconds>(e_time - s_time);
+    std::ostringstream reply;
+    reply << "ok " << output << ' ' << mil.count() << ' ' << (loaded ? "loaded" : "cached");
+    return reply.str();
+}
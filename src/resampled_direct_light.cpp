@@ -0,0 +1,368 @@
+#include "ray_tracer.h"
+
+#include "math/constants.h"
+
+#include "mat/random_sampler.h"
+
+#include "mem/memory_arena.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <omp.h>
+#include <vector>
+
+// Direct lighting by reservoir-based spatiotemporal importance resampling (ReSTIR), following Bitterli et al.
+// "Spatiotemporal Reservoir Resampling for Real-Time Ray Tracing with Dynamic Direct Lighting". Each sample renders
+// the whole frame: every pixel draws many candidate light samples for its first hit & keeps one in a reservoir,
+// with probability proportional to the unshadowed light it reflects. The reservoir is combined with the pixel's
+// reservoir from the previous sample, then with those of a few neighbouring pixels, so each pixel effectively
+// chooses amongst hundreds of candidates. Only the chosen sample is tested for visibility. Samples are points on
+// the lights, or directions for lights at infinity, so they mean the same thing at every pixel. Reused samples
+// are weighed by the balance heuristic over the pixels which could have produced them, following Lin et al.
+// "Generalized Resampled Importance Sampling", so the unshadowed estimate stays unbiased even though neighbours
+// see different parts of the lights.
+
+namespace
+{
+    const int candidate_count = 32;
+    const int spatial_neighbours = 5;
+    // neighbours are chosen within this fraction of the image's diagonal, about 30 pixels for HD images
+    const float spatial_radius_fraction = .02f;
+    // the previous sample's reservoir counts for at most this many times the new candidates. The samples of a
+    // still image are averaged, so long histories would only correlate them
+    const float temporal_history = 1.f;
+    // neighbours whose first hit differs by more than this in normal or distance aren't reused
+    const float reuse_min_cos = .9f;
+    const float reuse_max_depth_diff = .1f;
+
+    struct LightSample
+    {
+        int light_idx = -1;
+        cblt::Vec3 pos;  // point on the light, or the direction towards it for lights at infinity
+        Color radiance;  // radiance of lights at infinity, which doesn't depend on the shading point
+        bool infinite = false;
+    };
+
+    struct Reservoir
+    {
+        LightSample y;
+        float w_sum = 0.f;
+        float M = 0.f;  // number of candidates the reservoir has seen
+        float W = 0.f;  // contribution weight of y, an estimate of 1 / pdf(y)
+
+        // stream in a candidate with resampling weight w
+        void Update(const LightSample &x, float w, float u)
+        {
+            w_sum += w;
+            M += 1.f;
+            if (w > 0.f && u * w_sum < w)
+            {
+                y = x;
+            }
+        }
+    };
+
+    struct GBufferPixel
+    {
+        PrimaryVertex primary;
+        cblt::Ray ray;
+    };
+
+    bool Shadeable(const GBufferPixel &px)
+    {
+        return px.primary.found && px.primary.hit.mat_id != cblt::invalid_material;
+    }
+
+    // the unshadowed light a sample reflects towards the camera, including the geometry term in the sample's
+    // measure, area for lights with a surface & solid angle for lights at infinity
+    Color Unshadowed(cblt::Scene &scene, const GBufferPixel &px, const LightSample &y, cblt::Vec3 &to_light, float &dist)
+    {
+        if (y.light_idx == -1 || !Shadeable(px))
+        {
+            return Color::GreyScale(0.f);
+        }
+        const cblt::HitInfo &hit = px.primary.hit;
+        const std::shared_ptr<cblt::Light> &light = scene.GetLight(y.light_idx);
+        Color radiance;
+        float geom;
+        if (y.infinite)
+        {
+            to_light = y.pos;
+            dist = cblt::inf_F;
+            radiance = y.radiance;
+            geom = cblt::AbsDot(hit.norm, to_light);
+        }
+        else
+        {
+            cblt::Vec3 offset = y.pos - hit.pos;
+            float dist_sqr = cblt::MagnitudeSqr(offset);
+            if (dist_sqr <= 0.f)
+            {
+                return Color::GreyScale(0.f);
+            }
+            dist = std::sqrt(dist_sqr);
+            to_light = offset / dist;
+            float light_pdf;
+            radiance = light->Radiance(y.pos, hit.pos, hit.norm, light_pdf);
+            if (light_pdf <= 0.f)
+            {
+                return Color::GreyScale(0.f);
+            }
+            geom = cblt::AbsDot(hit.norm, to_light) * cblt::AbsDot(light->Normal(y.pos), to_light) / dist_sqr;
+        }
+        float brdf_pdf;
+        return scene.Materials().BRDF(hit.mat_id, to_light, -px.ray.dir, hit, brdf_pdf) * radiance * geom;
+    }
+
+    float Target(cblt::Scene &scene, const GBufferPixel &px, const LightSample &y)
+    {
+        cblt::Vec3 to_light;
+        float dist;
+        return Unshadowed(scene, px, y, to_light, dist).Luminance();
+    }
+
+
+    bool Similar(const GBufferPixel &a, const GBufferPixel &b)
+    {
+        return Shadeable(a) && Shadeable(b) && cblt::Dot(a.primary.hit.norm, b.primary.hit.norm) > reuse_min_cos &&
+               std::abs(a.primary.hit.hit_time - b.primary.hit.hit_time) <= reuse_max_depth_diff * a.primary.hit.hit_time;
+    }
+
+    // choose from candidates drawn by the scene's light sampler, the resampling weight of each one is the light it
+    // reflects over the density of drawing it
+    Reservoir SampleCandidates(cblt::Scene &scene, const GBufferPixel &px, std::shared_ptr<cblt::Sampler> &sampler)
+    {
+        Reservoir r;
+        const cblt::HitInfo &hit = px.primary.hit;
+        for (int i = 0; i < candidate_count; ++i)
+        {
+            float light_u, light_pmf;
+            sampler->Next1D(light_u);
+            int light_idx = scene.SampleLight(hit.pos, hit.norm, light_u, light_pmf);
+            if (light_idx == -1 || light_pmf <= 0.f)
+            {
+                r.M += 1.f;
+                continue;
+            }
+            const std::shared_ptr<cblt::Light> &light = scene.GetLight(light_idx);
+            cblt::Vec3 to_light;
+            float dist, light_pdf;
+            Color radiance = light->Sample(to_light, hit.pos, hit.norm, dist, light_pdf, sampler);
+
+            LightSample x;
+            x.light_idx = light_idx;
+            x.infinite = light->isInfinite();
+            float source_pdf = light_pmf * light_pdf;
+            if (x.infinite)
+            {
+                x.pos = to_light;
+                x.radiance = radiance;
+            }
+            else
+            {
+                // from solid angle to area density
+                x.pos = hit.pos + to_light * dist;
+                source_pdf *= cblt::AbsDot(light->Normal(x.pos), to_light) / (dist * dist);
+            }
+            float u;
+            sampler->Next1D(u);
+            float target = (light_pdf > 0.f && source_pdf > 0.f) ? Target(scene, px, x) : 0.f;
+            r.Update(x, (target > 0.f) ? target / source_pdf : 0.f, u);
+        }
+        float target = Target(scene, px, r.y);
+        r.W = (target > 0.f) ? r.w_sum / (r.M * target) : 0.f;
+        return r;
+    }
+
+    // Resample amongst the samples of reservoirs found at other pixels, the first of which is px. Each sample is
+    // weighed by the balance heuristic over the pixels it could have come from, rather than normalizing by how many
+    // of them could have produced the chosen sample, which is noisier where the pixels' targets differ
+    Reservoir Combine(cblt::Scene &scene, const GBufferPixel &px, const Reservoir *const *inputs, const GBufferPixel *const *pixels,
+                      int count, std::shared_ptr<cblt::Sampler> &sampler)
+    {
+        Reservoir combined;
+        for (int i = 0; i < count; ++i)
+        {
+            const Reservoir &r = *inputs[i];
+            combined.M += r.M;
+            if (r.W <= 0.f)
+            {
+                continue;
+            }
+            float own = 0.f, all = 0.f;
+            for (int j = 0; j < count; ++j)
+            {
+                float pdf = inputs[j]->M * Target(scene, *pixels[j], r.y);
+                own = (j == i) ? pdf : own;
+                all += pdf;
+            }
+            float u;
+            sampler->Next1D(u);
+            float w = (all > 0.f) ? (own / all) * Target(scene, px, r.y) * r.W : 0.f;
+            combined.w_sum += w;
+            if (w > 0.f && u * combined.w_sum < w)
+            {
+                combined.y = r.y;
+            }
+        }
+        float target = Target(scene, px, combined.y);
+        combined.W = (target > 0.f) ? combined.w_sum / target : 0.f;
+        return combined;
+    }
+}
+
+std::vector<Color> RayTracer::RenderResampledDirect()
+{
+    cblt::Scene &scene = *image_scene_;
+    int width = image_settings_.img_width;
+    int height = image_settings_.img_height;
+    float half_width = width * .5f;
+    float half_height = height * .5f;
+    guide_ = nullptr;
+    record_guide_ = false;
+
+    std::vector<GBufferPixel> gbuffer(width * height), prev_gbuffer(width * height);
+    std::vector<Reservoir> reservoirs(width * height), spatial(width * height), prev(width * height);
+    std::vector<Color> accum(width * height, Color(0.f, 0.f, 0.f));
+    int num_samples = image_settings_.num_samples;
+    float spatial_radius = std::max(1.f, spatial_radius_fraction * std::sqrt(static_cast<float>(width * width + height * height)));
+
+    if (image_settings_.show_progress)
+    {
+        std::cout << "Samples: 0/" << num_samples << std::flush;
+    }
+    for (int sample = 0; sample < num_samples; ++sample)
+    {
+        #ifndef _DEBUG
+        #pragma omp parallel
+        #endif
+        {
+            std::shared_ptr<cblt::Sampler> generator = std::make_shared<cblt::RandomSampler>(omp_get_thread_num() * 1234U + sample * 7919U);
+            cblt::MemoryArena &scratch = *cblt::ThreadScratch();
+
+            // find each pixel's first hit & choose from new candidates, then add what the pixel chose last time
+            #ifndef _DEBUG
+            #pragma omp for schedule(dynamic, 4)
+            #endif
+            for (int y = 0; y < height; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    int idx = y * width + x;
+                    GBufferPixel &px = gbuffer[idx];
+                    float jitter_x, jitter_y;
+                    generator->Next2D(jitter_x, jitter_y);
+                    float shutter_u;
+                    generator->Next1D(shutter_u);
+                    px.ray = camera_.CreateRay(half_width - (x + jitter_x), half_height - (y + jitter_y), shutter_u);
+                    px.primary.hit = cblt::HitInfo();
+                    px.primary.hit.hit_time = cblt::inf_F;
+                    px.primary.found = SceneIntersect(px.ray, px.primary.hit);
+                    px.primary.direct = Color(0.f, 0.f, 0.f);
+                    if (!Shadeable(px))
+                    {
+                        reservoirs[idx] = Reservoir();
+                        continue;
+                    }
+
+                    Reservoir r = SampleCandidates(scene, px, generator);
+                    Reservoir history = prev[idx];
+                    if (sample > 0 && Similar(px, prev_gbuffer[idx]) && history.M > 0.f)
+                    {
+                        history.M = std::min(history.M, temporal_history * r.M);
+                        const Reservoir *inputs[2] = { &r, &history };
+                        const GBufferPixel *input_pixels[2] = { &px, &prev_gbuffer[idx] };
+                        r = Combine(scene, px, inputs, input_pixels, 2, generator);
+                    }
+                    reservoirs[idx] = r;
+                }
+            }
+
+            // combine with the reservoirs of random neighbours which saw about the same surface, the implicit
+            // barrier of the loop above means every pixel's reservoir is ready
+            #ifndef _DEBUG
+            #pragma omp for schedule(dynamic, 4)
+            #endif
+            for (int y = 0; y < height; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    int idx = y * width + x;
+                    const GBufferPixel &px = gbuffer[idx];
+                    if (!Shadeable(px))
+                    {
+                        spatial[idx] = Reservoir();
+                        continue;
+                    }
+                    const Reservoir *inputs[spatial_neighbours + 1];
+                    const GBufferPixel *input_pixels[spatial_neighbours + 1];
+                    int num_inputs = 0;
+                    inputs[num_inputs] = &reservoirs[idx];
+                    input_pixels[num_inputs++] = &px;
+                    for (int i = 0; i < spatial_neighbours; ++i)
+                    {
+                        float u1, u2;
+                        generator->Next2D(u1, u2);
+                        int n_x = x + static_cast<int>(std::floor((2.f * u1 - 1.f) * spatial_radius));
+                        int n_y = y + static_cast<int>(std::floor((2.f * u2 - 1.f) * spatial_radius));
+                        if (n_x < 0 || n_x >= width || n_y < 0 || n_y >= height || (n_x == x && n_y == y))
+                        {
+                            continue;
+                        }
+                        int n_idx = n_y * width + n_x;
+                        if (Similar(px, gbuffer[n_idx]))
+                        {
+                            inputs[num_inputs] = &reservoirs[n_idx];
+                            input_pixels[num_inputs++] = &gbuffer[n_idx];
+                        }
+                    }
+                    spatial[idx] = Combine(scene, px, inputs, input_pixels, num_inputs, generator);
+                }
+            }
+
+            // one shadow ray for the chosen sample, then the rest of the path
+            #ifndef _DEBUG
+            #pragma omp for schedule(dynamic, 4)
+            #endif
+            for (int y = 0; y < height; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    int idx = y * width + x;
+                    GBufferPixel &px = gbuffer[idx];
+                    const Reservoir &r = spatial[idx];
+                    if (Shadeable(px) && r.W > 0.f)
+                    {
+                        cblt::Vec3 to_light;
+                        float dist;
+                        Color unshadowed = Unshadowed(scene, px, r.y, to_light, dist);
+                        const cblt::HitInfo &hit = px.primary.hit;
+                        float occluder_time = cblt::inf_F;
+                        cblt::Ray shadow_ray(hit.pos + to_light * cblt::eps_zero_F, to_light, hit.time);
+                        scene.Intersects(shadow_ray, occluder_time);
+                        if (occluder_time >= dist * (1.f - cblt::eps_shadow_F))
+                        {
+                            px.primary.direct = unshadowed * r.W;
+                        }
+                    }
+                    // anything the path allocates from the thread's scratch arena is released once it finishes
+                    cblt::ScratchScope sample_scope(scratch);
+                    accum[idx] = accum[idx] + PathTraceIterative(px.ray, generator, &px.primary);
+                }
+            }
+        }
+        std::swap(gbuffer, prev_gbuffer);
+        std::swap(spatial, prev);
+        if (image_settings_.show_progress)
+        {
+            std::cout << "\rSamples: " << sample + 1 << "/" << num_samples << std::flush;
+        }
+    }
+    float frac = 1.f / static_cast<float>(num_samples);
+    for (Color &pixel : accum)
+    {
+        pixel = pixel * frac;
+    }
+    return accum;
+}
@@ -5,16 +5,24 @@
 
 #include "math/vec.h"
 #include "math/mat4.h"
+#include "math/animated_affine.h"
 #include "math/math_helpers.h"
 
 #include "light/area_light.h"
 #include "light/direction_light.h"
+#include "light/environment_light.h"
 
 #include "geom/triangle_mesh.h"
 
-#include <iostream>
+#include "mem/memory_stats.h"
+
+#include <algorithm>
+#include <iomanip>
 #include <sstream>
 #include <memory>
+#include <unordered_map>
+
+#include <omp.h>
 
 template<class T>
 void parseString(std::istream_iterator<T> iter, std::vector<T> &vals)
@@ -22,14 +30,27 @@ void parseString(std::istream_iterator<T> iter, std::vector<T> &vals)
     std::copy(iter, std::istream_iterator<T>(), std::back_inserter(vals));
 }
 
+SDescFileLoader::SDescFileLoader(const std::shared_ptr<cblt::TextureLibrary> &textures, std::ostream *log) : textures_(textures), log_(log)
+{
+    if (!textures_)
+    {
+        textures_ = std::make_shared<cblt::TextureLibrary>(std::make_shared<cblt::TextureCache>());
+    }
+}
+
 std::shared_ptr<cblt::Scene> SDescFileLoader::LoadScene(std::string file_name)
 {
+    dependencies_.clear();
     pugi::xml_document doc;
     pugi::xml_parse_result result = doc.load_file(file_name.c_str());
     if (!result)
     {
+        Log("Couldn't parse " + file_name + ": " + result.description());
         return nullptr;
     }
+    // the library may be shared with earlier scenes, so only this scene's sharing is reported
+    size_t shared_before = textures_->Shared();
+    size_t saved_before = textures_->BytesSaved();
     pugi::xpath_node_set cameras = doc.select_nodes("/SDesc/Library_Cameras/camera");
     for (pugi::xpath_node node: cameras)
     {
@@ -37,33 +58,160 @@ std::shared_ptr<cblt::Scene> SDescFileLoader::LoadScene(std::string file_name)
         ProcessCamera(camera);
     }
 
+    // stage 1: materials & lights, whose textures are decoded as they're read, alongside parsing every mesh
     pugi::xpath_node_set materials = doc.select_nodes("/SDesc/Library_Materials/Material");
-    for (pugi::xpath_node node: materials)
+    pugi::xpath_node_set geometry = doc.select_nodes("/SDesc/Library_Geometry/geometry");
+    pugi::xpath_node_set lights = doc.select_nodes("/SDesc/Library_Lights/light");
+    std::vector<std::optional<cblt::MaterialVariant>> mat_results(materials.size());
+    std::vector<MeshArrays> mesh_arrays(geometry.size());
+    std::vector<char> mesh_parsed(geometry.size(), false);  // not vector<bool>, whose elements share bytes
+    std::vector<std::shared_ptr<cblt::Light>> light_results(lights.size());
+    std::vector<std::shared_ptr<cblt::Geometry>> mesh_results(geometry.size());
+    thread_arenas_.assign(omp_get_max_threads(), nullptr);
+    std::vector<size_t> original(geometry.size());  //! the node each one's mesh is built from
+    size_t dup_meshes = 0, dup_tris = 0, built_tris = 0;
+    size_t mesh_bytes = cblt::MemoryStats::Current(cblt::mem_geometry) + cblt::MemoryStats::Current(cblt::mem_bvh);
+
+    #ifndef _DEBUG
+    #pragma omp parallel
+    #pragma omp single
+    #endif
     {
-        pugi::xml_node material = node.node();
-        std::string mat_type(material.select_node("material_type").node().text().as_string());
-        if (!mat_type.compare("Principled Material"))
+        // the largest jobs are usually textures, so they're started first
+        for (size_t i = 0; i < materials.size(); ++i)
+        {
+            #ifndef _DEBUG
+            #pragma omp task
+            #endif
+            {
+                pugi::xml_node material = materials[i].node();
+                ProcessMaterial(material, mat_results[i]);
+            }
+        }
+        for (size_t i = 0; i < lights.size(); ++i)
+        {
+            #ifndef _DEBUG
+            #pragma omp task
+            #endif
+            {
+                pugi::xml_node light = lights[i].node();
+                ProcessLight(light, light_results[i]);
+            }
+        }
+        for (size_t i = 0; i < geometry.size(); ++i)
+        {
+            #ifndef _DEBUG
+            #pragma omp task
+            #endif
+            {
+                pugi::xml_node geom = geometry[i].node();
+                mesh_parsed[i] = ParseMesh(geom, mesh_arrays[i]);
+            }
+        }
+        #ifndef _DEBUG
+        #pragma omp taskwait
+        #endif
+
+        // stage 2: every material the meshes refer to now exists
+        for (size_t i = 0; i < materials.size(); ++i)
+        {
+            if (mat_results[i])
+            {
+                material_map_[std::string(materials[i].node().attribute("ID").as_string())] = materials_->Add(*mat_results[i]);
+            }
+        }
+        mat_results.clear();
+
+        // geometry which is the same as an earlier node's becomes another instance of that mesh
+        std::unordered_multimap<uint64_t, size_t> by_hash;
+        for (size_t i = 0; i < geometry.size(); ++i)
         {
-            ProcessPrincipledMaterial(material);
+            original[i] = i;
+            if (!mesh_parsed[i])
+            {
+                continue;
+            }
+            auto candidates = by_hash.equal_range(mesh_arrays[i].hash);
+            for (auto iter = candidates.first; iter != candidates.second; ++iter)
+            {
+                if (mesh_arrays[iter->second] == mesh_arrays[i])
+                {
+                    original[i] = iter->second;
+                    break;
+                }
+            }
+            if (original[i] != i)
+            {
+                ++dup_meshes;
+                dup_tris += mesh_arrays[i].inds.size() / 3;
+                mesh_arrays[i] = MeshArrays();
+            }
+            else
+            {
+                by_hash.emplace(mesh_arrays[i].hash, i);
+                built_tris += mesh_arrays[i].inds.size() / 3;
+            }
         }
-        else if (!mat_type.compare("Cook Torrence Material"))
+
+        // stage 3: triangles & BVHs, each mesh's arrays are released as soon as it's built
+        for (size_t i = 0; i < geometry.size(); ++i)
         {
-            ProcessTorrenceMaterial(material);
+            if (!mesh_parsed[i] || original[i] != i)
+            {
+                continue;
+            }
+            #ifndef _DEBUG
+            #pragma omp task
+            #endif
+            {
+                std::shared_ptr<cblt::MemoryArena> &arena = thread_arenas_[omp_get_thread_num()];
+                if (!arena)
+                {
+                    arena = std::make_shared<cblt::MemoryArena>();
+                }
+                mesh_results[i] = BuildMesh(mesh_arrays[i], arena);
+                arena->Publish();
+                mesh_arrays[i] = MeshArrays();
+            }
         }
     }
 
-    pugi::xpath_node_set geometry = doc.select_nodes("/SDesc/Library_Geometry/geometry");
-    for (pugi::xpath_node node: geometry)
+    mesh_bytes = cblt::MemoryStats::Current(cblt::mem_geometry) + cblt::MemoryStats::Current(cblt::mem_bvh) - mesh_bytes;
+    for (size_t i = 0; i < geometry.size(); ++i)
     {
-        pugi::xml_node geom = node.node();
-        ProcessMesh(geom);
+        std::shared_ptr<cblt::Geometry> &mesh = mesh_results[original[i]];
+        if (mesh)
+        {
+            mesh_map_[std::string(geometry[i].node().attribute("ID").as_string())] = mesh;
+        }
     }
+    for (std::shared_ptr<cblt::Light> &light : light_results)
+    {
+        if (light)
+        {
+            lights_.push_back(light);
+        }
+    }
+    // the arenas are kept alive by their triangles from here on
+    thread_arenas_.clear();
 
-    pugi::xpath_node_set lights = doc.select_nodes("/SDesc/Library_Lights/light");
-    for (pugi::xpath_node node: lights)
+    // every texture & environment map named in the file, so a cached copy of the scene can tell when it's stale
+    for (pugi::xpath_node node : doc.select_nodes("//*[@format='texture'] | /SDesc/Library_Lights/light/file"))
     {
-        pugi::xml_node light = node.node();
-        ProcessLight(light);
+        dependencies_.push_back(node.node().text().as_string());
+    }
+
+    size_t shared_textures = textures_->Shared() - shared_before;
+    if (shared_textures > 0 || dup_meshes > 0)
+    {
+        // an instance's triangles & BVH would have taken about as much per triangle as the meshes which were built
+        double mesh_saved = built_tris ? static_cast<double>(mesh_bytes) * dup_tris / built_tris : 0.;
+        const double to_mib = 1. / (1024. * 1024.);
+        std::ostringstream report;
+        report << "Shared " << shared_textures << " duplicate textures & " << dup_meshes << " duplicate meshes, saving "
+               << std::fixed << std::setprecision(2) << (textures_->BytesSaved() - saved_before) * to_mib << " MiB of texels & about "
+               << mesh_saved * to_mib << " MiB of geometry";
+        Log(report.str());
     }
 
     // construct the scene
@@ -76,19 +224,44 @@ std::shared_ptr<cblt::Scene> SDescFileLoader::LoadScene(std::string file_name)
         // fetch mesh
         std::string id = elem_node.attribute("primitive_id").as_string();
         
-        std::vector<float> transform_arr;
-    
-        std::stringstream parse_mat(elem_node.child("Transform").text().as_string());
-        std::istream_iterator<float> mat_iter(parse_mat);
-        parseString(mat_iter, transform_arr);
-        cblt::Mat4 transform(reinterpret_cast<float*>(transform_arr.data()));
+        // an element with several Transforms is animated, each one is a keyframe at its time attribute
+        std::vector<float> key_times;
+        std::vector<cblt::Affine> key_xforms;
+        for (pugi::xml_node xform_node : elem_node.children("Transform"))
+        {
+            std::vector<float> transform_arr;
+        
+            std::stringstream parse_mat(xform_node.text().as_string());
+            std::istream_iterator<float> mat_iter(parse_mat);
+            parseString(mat_iter, transform_arr);
+            if (transform_arr.size() < 16)
+            {
+                continue;
+            }
+            cblt::Mat4 transform(reinterpret_cast<float*>(transform_arr.data()));
+            key_times.push_back(xform_node.attribute("time").as_float(0.f));
+            key_xforms.emplace_back(transform);
+        }
         if (mesh_map_[id] != nullptr)
         {
-            s_prims.push_back(std::make_shared<cblt::ScenePrim>(mesh_map_[id], transform));
+            std::vector<size_t> order(key_times.size());
+            for (size_t i = 0; i < order.size(); ++i)
+            {
+                order[i] = i;
+            }
+            std::sort(order.begin(), order.end(), [&key_times](size_t a, size_t b) { return key_times[a] < key_times[b]; });
+            std::vector<float> sorted_times;
+            std::vector<cblt::Affine> sorted_xforms;
+            for (size_t i : order)
+            {
+                sorted_times.push_back(key_times[i]);
+                sorted_xforms.push_back(key_xforms[i]);
+            }
+            s_prims.push_back(std::make_shared<cblt::ScenePrim>(mesh_map_[id], cblt::AnimatedAffine(sorted_times, sorted_xforms)));
         }
     }
     
-    return std::make_shared<cblt::Scene>(cam_, s_prims, lights_);
+    return std::make_shared<cblt::Scene>(cam_, s_prims, lights_, materials_);
 }
 
 bool SDescFileLoader::ProcessCamera(pugi::xml_node &camera_node)
@@ -123,10 +296,38 @@ bool SDescFileLoader::ProcessCamera(pugi::xml_node &camera_node)
     // fov
     float fov_val = cblt::toRadians(std::stof(fov.first_child().value()));
     cam_ = cblt::Camera(cam_vals[0], cam_vals[1], cam_vals[2], fov_val);
+
+    // optional shutter interval, given as the open & close times
+    pugi::xml_node shutter = camera_node.select_node("shutter").node();
+    if (shutter)
+    {
+        std::vector<float> shutter_vals;
+        std::stringstream parse(shutter.text().as_string());
+        std::istream_iterator<float> iter(parse);
+        parseString(iter, shutter_vals);
+        if (shutter_vals.size() >= 2)
+        {
+            cam_.SetShutter(shutter_vals[0], shutter_vals[1]);
+        }
+    }
     return true;
 }
 
-bool SDescFileLoader::ProcessPrincipledMaterial(pugi::xml_node &mat_node)
+bool SDescFileLoader::ProcessMaterial(pugi::xml_node &mat_node, std::optional<cblt::MaterialVariant> &material)
+{
+    std::string mat_type(mat_node.select_node("material_type").node().text().as_string());
+    if (!mat_type.compare("Principled Material"))
+    {
+        return ProcessPrincipledMaterial(mat_node, material);
+    }
+    else if (!mat_type.compare("Cook Torrence Material"))
+    {
+        return ProcessTorrenceMaterial(mat_node, material);
+    }
+    return false;
+}
+
+bool SDescFileLoader::ProcessPrincipledMaterial(pugi::xml_node &mat_node, std::optional<cblt::MaterialVariant> &material)
 {
     pugi::xml_node clr = mat_node.select_node("Base_Color").node();
     const char * text = clr.first_child().text().as_string();
@@ -135,7 +336,7 @@ bool SDescFileLoader::ProcessPrincipledMaterial(pugi::xml_node &mat_node)
     
     std::string clr_type = clr.attribute("format").as_string();
     std::vector<float> clr_vals;
-    std::shared_ptr<Image> base = nullptr;
+    std::shared_ptr<cblt::Texture> base = nullptr;
     Color mat_base;
     if (clr_type.compare("rgba") == 0)
     {
@@ -145,7 +346,12 @@ bool SDescFileLoader::ProcessPrincipledMaterial(pugi::xml_node &mat_node)
     else if (clr_type.compare("texture") == 0)
     {
         std::string file_name = clr.text().as_string();
-        base = std::make_shared<Image>(file_name.c_str());
+        base = textures_->Get(file_name);
+        if (!base->Valid())
+        {
+            Log("Couldn't load texture " + file_name);
+            return false;
+        }
     }
     // get scalar attribs
     float mat_sub = mat_node.select_node("Subsurface").node().text().as_float();
@@ -159,17 +365,20 @@ bool SDescFileLoader::ProcessPrincipledMaterial(pugi::xml_node &mat_node)
     float mat_clear = mat_node.select_node("Clearcoat").node().text().as_float();
     float mat_clear_coat = mat_node.select_node("Clearcoat_Gloss").node().text().as_float();
     float mat_ior = mat_node.select_node("IOR").node().text().as_float();
-    std::shared_ptr<cblt::Material> material = std::make_shared<cblt::DisneyPrincipledMaterial>(mat_base, mat_sub, mat_met, mat_spec, mat_spec_tint, mat_rough, mat_aniso, mat_shn, mat_shn_tint, mat_clear, mat_clear_coat, mat_ior, false);
+    cblt::DisneyPrincipledMaterial principled(mat_base, mat_sub, mat_met, mat_spec, mat_spec_tint, mat_rough, mat_aniso, mat_shn, mat_shn_tint, mat_clear, mat_clear_coat, mat_ior, false);
     if (base != nullptr)
     {
-        material->SetBaseImage(base);
+        principled.SetBaseTexture(base);
     }
-
-    material_map_[std::string(mat_node.attribute("ID").as_string())] = material;
+    if (!ProcessMaterialMaps(mat_node, principled))
+    {
+        return false;
+    }
+    material.emplace(principled);
     return true;
 }
 
-bool SDescFileLoader::ProcessTorrenceMaterial(pugi::xml_node &mat_node)
+bool SDescFileLoader::ProcessTorrenceMaterial(pugi::xml_node &mat_node, std::optional<cblt::MaterialVariant> &material)
 {
     pugi::xml_node albedo = mat_node.select_node("Albedo").node();
     pugi::xml_node specular = mat_node.select_node("Specular").node();
@@ -178,8 +387,20 @@ bool SDescFileLoader::ProcessTorrenceMaterial(pugi::xml_node &mat_node)
     std::array<std::vector<float>, 3> clr_vecs;
     std::array<Color, 3> clr_vals;
     
+    std::shared_ptr<cblt::Texture> albedo_tex;
+    if (!LoadTexture(albedo, albedo_tex))
+    {
+        return false;
+    }
+
     for(int i = 0; i < cam_nodes.size(); ++i)
     {
+        if (i == 0 && albedo_tex != nullptr)
+        {
+            // the albedo comes from the texture instead
+            clr_vals[i] = Color::GreyScale(1.f);
+            continue;
+        }
         const char *txt = cam_nodes[i].text().as_string();
         std::stringstream parse(txt);
         std::istream_iterator<float> iter(parse);
@@ -200,55 +421,134 @@ bool SDescFileLoader::ProcessTorrenceMaterial(pugi::xml_node &mat_node)
     float mat_metal = mat_node.select_node("Metallic").node().text().as_float();
     float mat_rough = mat_node.select_node("Roughness").node().text().as_float();
     
-    std::shared_ptr<cblt::Material> material = std::make_shared<cblt::CookTorrenceMaterial>(clr_vals[0], clr_vals[1], clr_vals[2], mat_ior, mat_rough, mat_metal);
-    material_map_[std::string(mat_node.attribute("ID").as_string())] = material;
+    cblt::CookTorrenceMaterial torrence(clr_vals[0], clr_vals[1], clr_vals[2], mat_ior, mat_rough, mat_metal);
+    if (albedo_tex != nullptr)
+    {
+        torrence.SetBaseTexture(albedo_tex);
+    }
+    if (!ProcessMaterialMaps(mat_node, torrence))
+    {
+        return false;
+    }
+    material.emplace(torrence);
+    return true;
+}
+
+bool SDescFileLoader::ProcessMaterialMaps(pugi::xml_node &mat_node, cblt::Material &material)
+{
+    // roughness & metallic can be given as a texture instead of a scalar, and the normal map is optional
+    pugi::xml_node node_rough = mat_node.select_node("Roughness").node();
+    pugi::xml_node node_metal = mat_node.select_node("Metallic").node();
+    pugi::xml_node node_norm = mat_node.select_node("Normal_Map").node();
+
+    std::shared_ptr<cblt::Texture> rough_tex, metal_tex, norm_tex;
+    if (!LoadTexture(node_rough, rough_tex) || !LoadTexture(node_metal, metal_tex) || !LoadTexture(node_norm, norm_tex))
+    {
+        return false;
+    }
+
+    if (rough_tex != nullptr)
+    {
+        material.SetRoughnessTexture(rough_tex);
+    }
+    if (metal_tex != nullptr)
+    {
+        material.SetMetallicTexture(metal_tex);
+    }
+    if (norm_tex != nullptr)
+    {
+        material.SetNormalTexture(norm_tex);
+    }
     return true;
 }
 
-bool SDescFileLoader::ProcessMesh(pugi::xml_node &mesh_node)
+bool SDescFileLoader::LoadTexture(pugi::xml_node &tex_node, std::shared_ptr<cblt::Texture> &tex)
 {
-    pugi::xml_node &node_verts = mesh_node.select_node("positions").node();
-    pugi::xml_node &node_tris  = mesh_node.select_node("indices").node();
-    pugi::xml_node &node_surfs = mesh_node.select_node("surface_materials").node();
-    pugi::xml_node &node_mats  = mesh_node.select_node("materials").node();
+    // only nodes marked with format="texture" hold a file name, anything else isn't an error
+    tex = nullptr;
+    std::string tex_type(tex_node.attribute("format").as_string());
+    if (!tex_node || tex_type.compare("texture") != 0)
+    {
+        return true;
+    }
+
+    std::string file_name(tex_node.text().as_string());
+    tex = textures_->Get(file_name);
+    if (!tex->Valid())
+    {
+        Log("Couldn't load texture " + file_name);
+        return false;
+    }
+    return true;
+}
+
+bool SDescFileLoader::ParseMesh(pugi::xml_node &mesh_node, MeshArrays &arrays)
+{
+    pugi::xml_node node_verts = mesh_node.select_node("positions").node();
+    pugi::xml_node node_tris  = mesh_node.select_node("indices").node();
+    pugi::xml_node node_surfs = mesh_node.select_node("surface_materials").node();
+    pugi::xml_node node_mats  = mesh_node.select_node("materials").node();
     // optional
-    pugi::xml_node &node_norms = mesh_node.select_node("normals").node();
-    pugi::xml_node &node_uvs   = mesh_node.select_node("uvs").node();
-    
-    std::vector<float> verts_arr, norms_arr, uvs_arr;
-    std::vector<int> ind_arr, mat_ind_arr;
-    std::vector<std::string> surfs_arr;
+    pugi::xml_node node_norms = mesh_node.select_node("normals").node();
+    pugi::xml_node node_uvs   = mesh_node.select_node("uvs").node();
+    if (node_verts.empty() || node_tris.empty())
+    {
+        return false;
+    }
     
     std::stringstream parse_vert(node_verts.text().as_string());
     std::istream_iterator<float> vert_iter(parse_vert);
-    parseString(vert_iter, verts_arr);
+    parseString(vert_iter, arrays.verts);
     
     std::stringstream parse_ind(node_tris.text().as_string());
     std::istream_iterator<int> ind_iter(parse_ind);
-    parseString(ind_iter, ind_arr);
+    parseString(ind_iter, arrays.inds);
     
     std::stringstream parse_surfs(node_surfs.text().as_string());
     std::istream_iterator<std::string> surfs_iter(parse_surfs);
-    parseString(surfs_iter, surfs_arr);
+    parseString(surfs_iter, arrays.surfs);
 
     std::stringstream parse_mat_ind(node_mats.text().as_string());
     std::istream_iterator<int> mat_ind_iter(parse_mat_ind);
-    parseString(mat_ind_iter, mat_ind_arr);
+    parseString(mat_ind_iter, arrays.mat_inds);
 
+    arrays.has_norms = !node_norms.empty();
     if (node_norms)
     {
         std::stringstream parse_norm(node_norms.text().as_string());
         std::istream_iterator<float> norm_iter(parse_norm);
-        parseString(norm_iter, norms_arr);
+        parseString(norm_iter, arrays.norms);
     }
 
+    arrays.has_uvs = !node_uvs.empty();
     if (node_uvs)
     {
         std::stringstream parse_uv(node_uvs.text().as_string());
         std::istream_iterator<float> uv_iter(parse_uv);
-        parseString(uv_iter, uvs_arr);
+        parseString(uv_iter, arrays.uvs);
     }
 
+    arrays.hash = cblt::hashBytes(arrays.verts.data(), arrays.verts.size() * sizeof(float));
+    arrays.hash = cblt::hashBytes(arrays.norms.data(), arrays.norms.size() * sizeof(float), arrays.hash);
+    arrays.hash = cblt::hashBytes(arrays.uvs.data(), arrays.uvs.size() * sizeof(float), arrays.hash);
+    arrays.hash = cblt::hashBytes(arrays.inds.data(), arrays.inds.size() * sizeof(int), arrays.hash);
+    arrays.hash = cblt::hashBytes(arrays.mat_inds.data(), arrays.mat_inds.size() * sizeof(int), arrays.hash);
+    for (const std::string &surf : arrays.surfs)
+    {
+        arrays.hash = cblt::hashBytes(surf.c_str(), surf.size() + 1, arrays.hash);
+    }
+    return true;
+}
+
+std::shared_ptr<cblt::Geometry> SDescFileLoader::BuildMesh(const MeshArrays &arrays, const std::shared_ptr<cblt::MemoryArena> &arena)
+{
+    const std::vector<float> &verts_arr = arrays.verts;
+    const std::vector<float> &norms_arr = arrays.norms;
+    const std::vector<float> &uvs_arr = arrays.uvs;
+    const std::vector<int> &ind_arr = arrays.inds;
+    const std::vector<int> &mat_ind_arr = arrays.mat_inds;
+    const std::vector<std::string> &surfs_arr = arrays.surfs;
+
     std::vector<std::shared_ptr<cblt::Triangle>> mesh;
     int num_tris = ind_arr.size() / 3;
     for (int i = 0; i < num_tris; ++i)
@@ -259,9 +559,10 @@ bool SDescFileLoader::ProcessMesh(pugi::xml_node &mesh_node)
         cblt::Vec3 pos1(verts_arr[3 * id1], verts_arr[3 * id1 + 1], verts_arr[3 * id1 + 2]);
         cblt::Vec3 pos2(verts_arr[3 * id2], verts_arr[3 * id2 + 1], verts_arr[3 * id2 + 2]);
         cblt::Vec3 pos3(verts_arr[3 * id3], verts_arr[3 * id3 + 1], verts_arr[3 * id3 + 2]);
-        std::shared_ptr<cblt::Material> &cur_mat = material_map_[surfs_arr[mat_ind_arr[i]]];
+        auto mat_iter = material_map_.find(surfs_arr[mat_ind_arr[i]]);
+        cblt::MaterialId cur_mat = (mat_iter != material_map_.end()) ? mat_iter->second : cblt::invalid_material;
         
-        if (node_norms && node_uvs)
+        if (arrays.has_norms && arrays.has_uvs)
         {
             cblt::Vec3 norm1(norms_arr[3 * id1], norms_arr[3 * id1 + 1], norms_arr[3 * id1 + 2]);
             cblt::Vec3 norm2(norms_arr[3 * id2], norms_arr[3 * id2 + 1], norms_arr[3 * id2 + 2]);
@@ -270,41 +571,44 @@ bool SDescFileLoader::ProcessMesh(pugi::xml_node &mesh_node)
             cblt::Vec2 uv1(uvs_arr[2 * id1], uvs_arr[2 * id1 + 1]);
             cblt::Vec2 uv2(uvs_arr[2 * id2], uvs_arr[2 * id2 + 1]);
             cblt::Vec2 uv3(uvs_arr[2 * id3], uvs_arr[2 * id3 + 1]);
-            mesh.push_back(std::make_shared<cblt::Triangle>(pos1, pos2, pos3, norm1, norm2, norm3, uv1, uv2, uv3, cur_mat));
+            mesh.push_back(cblt::AllocateShared<cblt::Triangle>(arena, cblt::mem_geometry, pos1, pos2, pos3, norm1, norm2, norm3, uv1, uv2, uv3, cur_mat));
         }
-        else if (node_norms)
+        else if (arrays.has_norms)
         {
             cblt::Vec3 norm1(norms_arr[3 * id1], norms_arr[3 * id1 + 1], norms_arr[3 * id1 + 2]);
             cblt::Vec3 norm2(norms_arr[3 * id2], norms_arr[3 * id2 + 1], norms_arr[3 * id2 + 2]);
             cblt::Vec3 norm3(norms_arr[3 * id3], norms_arr[3 * id3 + 1], norms_arr[3 * id3 + 2]);
 
-            mesh.push_back(std::make_shared<cblt::Triangle>(pos1, pos2, pos3, norm1, norm2, norm3, cur_mat));
+            mesh.push_back(cblt::AllocateShared<cblt::Triangle>(arena, cblt::mem_geometry, pos1, pos2, pos3, norm1, norm2, norm3, cur_mat));
         }
         else
         {
-            mesh.push_back(std::make_shared<cblt::Triangle>(pos1, pos2, pos3, cur_mat));
+            mesh.push_back(cblt::AllocateShared<cblt::Triangle>(arena, cblt::mem_geometry, pos1, pos2, pos3, cur_mat));
         }
     }
 
-    std::shared_ptr<cblt::Geometry> model = std::make_shared<cblt::TriangleMesh>(mesh);
-    mesh_map_[std::string(mesh_node.attribute("ID").as_string())] = model;
-    return true;
+    return std::make_shared<cblt::TriangleMesh>(mesh, *materials_);
 }
 
-bool SDescFileLoader::ProcessLight(pugi::xml_node &light_node)
+bool SDescFileLoader::ProcessLight(pugi::xml_node &light_node, std::shared_ptr<cblt::Light> &light)
 {
     std::string light_type(light_node.attribute("type").as_string()); 
     if (!light_type.compare("area light"))
     {
-        return ProcessAreaLight(light_node);
+        return ProcessAreaLight(light_node, light);
     }
     else if (!light_type.compare("direction light"))
     {
-        return ProcessDirLight(light_node);
+        return ProcessDirLight(light_node, light);
     }
+    else if (!light_type.compare("environment light"))
+    {
+        return ProcessEnvLight(light_node, light);
+    }
+    return false;
 }
 
-bool SDescFileLoader::ProcessDirLight(pugi::xml_node &light_node)
+bool SDescFileLoader::ProcessDirLight(pugi::xml_node &light_node, std::shared_ptr<cblt::Light> &light)
 {
     pugi::xml_node node_clr = light_node.select_node("color").node();
     pugi::xml_node node_power = light_node.select_node("power").node();
@@ -329,13 +633,30 @@ bool SDescFileLoader::ProcessDirLight(pugi::xml_node &light_node)
     Color light_clr(clr[0], clr[1], clr[2]);
     cblt::Vec3 light_dir(dir[0], dir[1], dir[2]);         
 
-    std::shared_ptr<cblt::Light> light = std::make_shared<cblt::DirectionLight>(light_dir, light_clr, power, angle);
-    
-    lights_.push_back(light);
+    light = std::make_shared<cblt::DirectionLight>(light_dir, light_clr, power, angle);
     return true;
 }
 
-bool SDescFileLoader::ProcessAreaLight(pugi::xml_node &light_node)
+bool SDescFileLoader::ProcessEnvLight(pugi::xml_node &light_node, std::shared_ptr<cblt::Light> &light)
+{
+    pugi::xml_node node_file = light_node.select_node("file").node();
+    pugi::xml_node node_power = light_node.select_node("power").node();
+
+    std::string file_name(node_file.text().as_string());
+    float power = node_power ? node_power.text().as_float() : 1.f;
+
+    std::shared_ptr<cblt::EnvironmentLight> env_light = std::make_shared<cblt::EnvironmentLight>(file_name, power);
+    if (!env_light->Valid())
+    {
+        Log("Couldn't load environment map " + file_name);
+        return false;
+    }
+
+    light = env_light;
+    return true;
+}
+
+bool SDescFileLoader::ProcessAreaLight(pugi::xml_node &light_node, std::shared_ptr<cblt::Light> &light)
 {
     pugi::xml_node node_clr = light_node.select_node("color").node();
     pugi::xml_node node_length = light_node.select_node("length").node();
@@ -377,13 +698,25 @@ bool SDescFileLoader::ProcessAreaLight(pugi::xml_node &light_node)
                light_l_d(dir_x[0], dir_x[1], dir_x[2]),
                light_w_d(dir_z[0], dir_z[1], dir_z[2]);
 
-    std::shared_ptr<cblt::Light> light = std::make_shared<cblt::AreaLight>(light_pos, light_l_d, light_dir, light_w_d, light_clr, power, length, width);
-    
-    lights_.push_back(light);
+    light = std::make_shared<cblt::AreaLight>(light_pos, light_l_d, light_dir, light_w_d, light_clr, power, length, width);
     return true;
 }
 
 bool SDescFileLoader::ProcessPrim(pugi::xml_node &elem_node)
 {
     return true;
+}
+
+void SDescFileLoader::Log(const std::string &message)
+{
+    if (!log_)
+    {
+        return;
+    }
+    #ifndef _DEBUG
+    #pragma omp critical(sdesc_log)
+    #endif
+    {
+        *log_ << message << "\n";
+    }
 }
\ No newline at end of file
@@ -0,0 +1,5 @@
+// stb is header only, its implementation is compiled once here so it's part of the library rather than the executable
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image.h"
+#include "stb_image_write.h"
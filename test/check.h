@@ -0,0 +1,35 @@
+#ifndef CBLT_TEST_CHECK_H
+#define CBLT_TEST_CHECK_H
+
+#include <iostream>
+#include <string>
+
+// The checks shared by the test programs, each of which counts its failures with Check() & returns Result() from main
+
+namespace cblt
+{
+    namespace test
+    {
+        inline int failures = 0;
+
+        // report what failed to stderr, returns passed
+        inline bool Check(bool passed, const std::string &what)
+        {
+            if (!passed)
+            {
+                std::cerr << "Failed: " << what << std::endl;
+                ++failures;
+            }
+            return passed;
+        }
+
+        // print how many checks failed, & return the program's exit code for CTest
+        inline int Result()
+        {
+            std::cout << failures << " checks failed" << std::endl;
+            return (failures == 0) ? 0 : 1;
+        }
+    }
+}
+
+#endif  // CBLT_TEST_CHECK_H
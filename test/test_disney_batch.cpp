@@ -0,0 +1,134 @@
+#include "mat/disney_principled.h"
+#include "mat/shading_packet.h"
+#include "math/vec_packet.h"
+
+#include "check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+
+// Checks the batched Disney BRDF against the scalar version, for random materials, normals & directions
+
+namespace
+{
+    using cblt::test::Check;
+
+    // replays fixed random numbers, so the scalar & batched samplers make the same choices
+    class ReplaySampler : public cblt::Sampler
+    {
+        public:
+        float vals_[3];
+        int next_ = 0;
+        void Next1D(float &x) override { x = vals_[next_++]; }
+        void Next2D(float &x, float &y) override { x = vals_[next_++]; y = vals_[next_++]; }
+    };
+
+    const float rel_tolerance = 2e-3f;
+    // sampled directions differ slightly because of the approximate sine & cosine, which is amplified by the
+    // narrow peaks of low roughness lobes
+    const float rel_tolerance_sampled = 1e-2f;
+    const float abs_tolerance = 1e-4f;
+
+    bool Close(float expected, float actual, float rel_tol = rel_tolerance)
+    {
+        return std::abs(expected - actual) <= abs_tolerance + rel_tol * std::abs(expected);
+    }
+
+    cblt::Vec3 RandomDir(std::mt19937 &rng, const cblt::Vec3 &norm)
+    {
+        std::uniform_real_distribution<float> dist(-1.f, 1.f);
+        cblt::Vec3 dir;
+        do
+        {
+            dir = cblt::Vec3(dist(rng), dist(rng), dist(rng));
+        } while (cblt::MagnitudeSqr(dir) > 1.f || cblt::MagnitudeSqr(dir) < .01f);
+        dir = cblt::Normalize(dir);
+        // mostly above the surface, with some below it to check the rejected lanes
+        return (cblt::Dot(dir, norm) < 0.f && dist(rng) < .8f) ? -dir : dir;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::mt19937 rng(5607);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    int checked = 0;
+    const int num_packets = 2000;
+
+    for (int p = 0; p < num_packets; ++p)
+    {
+        Color base(unit(rng), unit(rng), unit(rng));
+        cblt::DisneyPrincipledMaterial mat(base, 0.f, unit(rng), unit(rng), unit(rng), .05f + .95f * unit(rng), unit(rng),
+                                           unit(rng), unit(rng), unit(rng), unit(rng), 1.5f, false);
+
+        cblt::ShadingPacket pts;
+        cblt::Vec3x8 incoming, outgoing;
+        cblt::Floatx8 u_lobe, u1, u2;
+        cblt::HitInfo hits[cblt::packet_width];
+        for (int l = 0; l < cblt::packet_width; ++l)
+        {
+            hits[l].norm = cblt::Normalize(RandomDir(rng, cblt::Vec3(0.f, 1.f, 0.f)));
+            mat.EvaluateTextures(hits[l]);
+            hits[l].roughness = .05f + .95f * unit(rng);
+            hits[l].metallic = unit(rng);
+            pts.Set(l, hits[l]);
+            incoming.Set(l, RandomDir(rng, hits[l].norm));
+            outgoing.Set(l, RandomDir(rng, hits[l].norm));
+            u_lobe[l] = unit(rng);
+            u1[l] = unit(rng);
+            u2[l] = unit(rng);
+        }
+
+        // evaluation
+        cblt::Vec3x8 f;
+        cblt::Floatx8 pdf;
+        mat.BRDFBatch(incoming, outgoing, pts, f, pdf);
+        for (int l = 0; l < cblt::packet_width; ++l)
+        {
+            float ref_pdf;
+            Color ref = mat.BRDF(incoming.Get(l), outgoing.Get(l), hits[l], ref_pdf);
+            cblt::Vec3 res = f.Get(l);
+            ++checked;
+            if (!Check(Close(ref.r, res.x) && Close(ref.g, res.y) && Close(ref.b, res.z) && Close(ref_pdf, pdf[l]), "BRDF lane matches the scalar BRDF"))
+            {
+                std::cerr << "BRDF mismatch, expected " << ref.r << " " << ref.g << " " << ref.b << " pdf " << ref_pdf
+                          << ", got " << res.x << " " << res.y << " " << res.z << " pdf " << pdf[l] << "\n";
+            }
+        }
+
+        // sampling
+        cblt::Vec3x8 sampled;
+        mat.SampleBatch(outgoing, u_lobe, u1, u2, pts, sampled, f, pdf);
+        for (int l = 0; l < cblt::packet_width; ++l)
+        {
+            std::shared_ptr<cblt::Sampler> replay = std::make_shared<ReplaySampler>();
+            ReplaySampler &vals = static_cast<ReplaySampler &>(*replay);
+            vals.vals_[0] = u_lobe[l];
+            vals.vals_[1] = u1[l];
+            vals.vals_[2] = u2[l];
+            float ref_pdf;
+            cblt::Vec3 ref_dir;
+            Color ref = mat.Sample(outgoing.Get(l), ref_dir, ref_pdf, hits[l], replay);
+            if (ref_pdf <= 0.f)
+            {
+                // rejected samples are compared by evaluation, the direction may sit right on the horizon
+                continue;
+            }
+            cblt::Vec3 dir = sampled.Get(l);
+            cblt::Vec3 res = f.Get(l);
+            ++checked;
+            if (!Check(cblt::Dot(ref_dir, dir) >= 1.f - 1e-4f && Close(ref.r, res.x, rel_tolerance_sampled) && Close(ref.g, res.y, rel_tolerance_sampled) &&
+                       Close(ref.b, res.z, rel_tolerance_sampled) && Close(ref_pdf, pdf[l], rel_tolerance_sampled), "sampled lane matches the scalar sample"))
+            {
+                std::cerr << "Sample mismatch, expected dir " << ref_dir.x << " " << ref_dir.y << " " << ref_dir.z << " pdf " << ref_pdf
+                          << ", got dir " << dir.x << " " << dir.y << " " << dir.z << " pdf " << pdf[l] << "\n";
+            }
+        }
+    }
+
+    std::cout << checked << " lanes compared" << std::endl;
+    return cblt::test::Result();
+}
@@ -0,0 +1,89 @@
+#include "mat/png_encoder.h"
+
+#include "stb_image.h"
+
+#include "check.h"
+
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Encodes images of awkward sizes with the parallel PNG encoder, decodes them again with stb_image & checks every
+// byte survives. The larger images span several independently deflated chunks
+
+namespace
+{
+    // a check on one image, which names its size
+    void Check(bool passed, int width, int height, int channels, const char *what)
+    {
+        cblt::test::Check(passed, std::to_string(width) + "x" + std::to_string(height) + "x" + std::to_string(channels) + " " + what);
+    }
+
+    // half noise, which defeats the matcher, & half smooth gradients with repeats, which exercise the filters &
+    // long back references
+    std::vector<uint8_t> MakePixels(int width, int height, int channels, std::mt19937 &rng)
+    {
+        std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * channels);
+        std::uniform_int_distribution<int> byte(0, 255);
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                for (int c = 0; c < channels; ++c)
+                {
+                    size_t idx = (static_cast<size_t>(y) * width + x) * channels + c;
+                    pixels[idx] = (y % 2 == 0) ? static_cast<uint8_t>(byte(rng)) : static_cast<uint8_t>((x / 3 + y + 40 * c) & 0xff);
+                }
+            }
+        }
+        return pixels;
+    }
+
+    void RoundTrip(int width, int height, int channels, std::mt19937 &rng)
+    {
+        std::vector<uint8_t> pixels = MakePixels(width, height, channels, rng);
+        std::vector<uint8_t> png;
+        bool encoded = cblt::EncodePNG(width, height, channels, pixels.data(), png);
+        Check(encoded, width, height, channels, "encodes");
+        if (!encoded)
+        {
+            return;
+        }
+        int dec_width, dec_height, dec_channels;
+        stbi_uc *decoded = stbi_load_from_memory(png.data(), static_cast<int>(png.size()), &dec_width, &dec_height, &dec_channels, channels);
+        Check(decoded != nullptr, width, height, channels, "decodes");
+        if (!decoded)
+        {
+            return;
+        }
+        Check(dec_width == width && dec_height == height && dec_channels == channels, width, height, channels, "keeps its size");
+        bool same = dec_width == width && dec_height == height;
+        for (size_t i = 0; same && i < pixels.size(); ++i)
+        {
+            same = decoded[i] == pixels[i];
+        }
+        Check(same, width, height, channels, "keeps every byte");
+        stbi_image_free(decoded);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::mt19937 rng(7);
+    const int sizes[][2] = { { 1, 1 }, { 1, 7 }, { 7, 1 }, { 3, 2 }, { 33, 17 }, { 613, 151 }, { 1001, 301 } };
+    for (const int *size : sizes)
+    {
+        RoundTrip(size[0], size[1], 3, rng);
+        RoundTrip(size[0], size[1], 4, rng);
+    }
+
+    // failures to encode or write are reported rather than producing a broken file
+    uint8_t pixel[3] = { 1, 2, 3 };
+    std::vector<uint8_t> png;
+    Check(!cblt::EncodePNG(0, 1, 3, pixel, png), 0, 1, 3, "empty image is rejected");
+    Check(!cblt::EncodePNG(1, 1, 2, pixel, png), 1, 1, 2, "unsupported channel count is rejected");
+    Check(!cblt::WritePNG("missing_directory/out.png", 1, 1, 3, pixel), 1, 1, 3, "write to a missing directory fails");
+
+    return cblt::test::Result();
+}
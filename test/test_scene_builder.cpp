@@ -0,0 +1,149 @@
+#include "cblt.h"
+#include "geom/scene.h"
+
+#include "check.h"
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Builds small scenes through the library interface, checking the meshes which come out & that renders of one
+// scene at different sizes don't disturb each other
+
+namespace
+{
+    const float tolerance = 1e-4f;
+    const float identity[16] = { 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f };
+
+    using cblt::test::Check;
+
+    bool Close(float expected, float actual)
+    {
+        return std::abs(expected - actual) <= tolerance;
+    }
+
+    // a camera on the z axis looking at the origin, with a single triangle in the z = 0 plane in front of it
+    void AddCamera(cblt::SceneBuilder &builder)
+    {
+        const float eye[3] = { 0.f, 0.f, 4.f };
+        const float forward[3] = { 0.f, 0.f, 1.f };
+        const float up[3] = { 0.f, 1.f, 0.f };
+        builder.SetCamera(eye, forward, up, 30.f);
+    }
+
+    const float positions[9] = { -1.f, -1.f, 0.f, 1.f, -1.f, 0.f, 0.f, 1.f, 0.f };
+    const float uvs[6] = { 0.f, 0.f, 1.f, 0.f, .5f, 1.f };
+    const uint32_t indices[3] = { 0, 2, 1 };
+
+    // meshes given uvs but no normals keep their uvs & are shaded with the face normal
+    void TestUVsWithoutNormals()
+    {
+        cblt::SceneBuilder builder;
+        AddCamera(builder);
+        cblt::MeshData mesh;
+        mesh.positions = positions;
+        mesh.uvs = uvs;
+        mesh.num_verts = 3;
+        mesh.indices = indices;
+        mesh.num_tris = 1;
+        mesh.material = builder.AddMaterial(cblt::PrincipledMaterialData());
+        uint32_t handle = builder.AddMesh(mesh);
+        Check(handle != UINT32_MAX, "mesh with uvs & no normals is accepted");
+        Check(builder.AddInstance(handle, identity), "instance of the mesh is added");
+        std::shared_ptr<cblt::Scene> scene = builder.Build();
+        Check(scene != nullptr, "scene is built");
+        if (!scene)
+        {
+            return;
+        }
+
+        // the uvs are a linear function of position, u = (x + 1) / 2 & v = (y + 1) / 2
+        const float points[3][2] = { { 0.f, 0.f }, { .25f, -.5f }, { -.3f, .1f } };
+        for (const float *point : points)
+        {
+            cblt::Ray ray(cblt::Vec3(point[0], point[1], 2.f), cblt::Vec3(0.f, 0.f, -1.f));
+            cblt::HitInfo hit;
+            bool found = scene->ClosestIntersection(ray, hit);
+            Check(found, "ray toward the triangle hits it");
+            if (!found)
+            {
+                continue;
+            }
+            Check(Close((point[0] + 1.f) * .5f, hit.uv.x) && Close((point[1] + 1.f) * .5f, hit.uv.y), "uv is interpolated");
+            Check(Close(1.f, std::abs(hit.norm.z)) && Close(0.f, hit.norm.x) && Close(0.f, hit.norm.y), "normal is the face normal");
+        }
+    }
+
+    void TestInvalidInput()
+    {
+        cblt::SceneBuilder builder;
+        const uint32_t bad_indices[3] = { 0, 1, 3 };
+        cblt::MeshData mesh;
+        mesh.positions = positions;
+        mesh.num_verts = 3;
+        mesh.indices = bad_indices;
+        mesh.num_tris = 1;
+        Check(builder.AddMesh(mesh) == UINT32_MAX, "mesh with an out of range index is rejected");
+        Check(!builder.AddInstance(0, identity), "instance of a missing mesh is rejected");
+
+        cblt::Renderer renderer;
+        int width = renderer.Width();
+        Check(!renderer.Configure("width: 32 bogus_setting: 1"), "unknown setting is rejected");
+        Check(renderer.Width() == width, "rejected settings change nothing");
+        Check(!renderer.Render(nullptr, nullptr), "render without a scene fails");
+    }
+
+    std::vector<float> Render(const std::shared_ptr<cblt::Scene> &scene, int width, int height)
+    {
+        cblt::Renderer renderer;
+        std::string settings = "width: " + std::to_string(width) + " height: " + std::to_string(height) + " num_samples: 4 num_threads: 1";
+        Check(renderer.Configure(settings), "settings are accepted");
+        std::vector<float> rgb(3 * static_cast<size_t>(renderer.Width()) * renderer.Height(), -1.f);
+        int tiles = 0;
+        Check(renderer.Render(scene, rgb.data(), [&tiles](int, int, int, int) { ++tiles; }), "render succeeds");
+        Check(tiles > 0, "tiles are reported");
+        return rgb;
+    }
+
+    // a render at another size in between must not change the image, as the camera belongs to the scene
+    void TestSharedScene()
+    {
+        cblt::SceneBuilder builder;
+        AddCamera(builder);
+        cblt::MeshData mesh;
+        mesh.positions = positions;
+        mesh.num_verts = 3;
+        mesh.indices = indices;
+        mesh.num_tris = 1;
+        mesh.material = builder.AddMaterial(cblt::CookTorrenceMaterialData());
+        builder.AddInstance(builder.AddMesh(mesh), identity);
+        const float light_dir[3] = { 0.f, 0.f, -1.f };
+        const float light_color[3] = { 1.f, 1.f, 1.f };
+        builder.AddDirectionLight(light_dir, light_color, 1.f);
+        std::shared_ptr<cblt::Scene> scene = builder.Build();
+
+        std::vector<float> first = Render(scene, 16, 16);
+        Render(scene, 40, 8);
+        std::vector<float> second = Render(scene, 16, 16);
+        bool lit = false;
+        bool valid = true;
+        for (float value : first)
+        {
+            lit = lit || value > 0.f;
+            valid = valid && value >= 0.f && std::isfinite(value);
+        }
+        Check(valid, "every pixel is written with finite radiance");
+        Check(lit, "the triangle is lit");
+        Check(first == second, "rendering at another size leaves the scene unchanged");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    TestUVsWithoutNormals();
+    TestInvalidInput();
+    TestSharedScene();
+    return cblt::test::Result();
+}
@@ -0,0 +1,184 @@
+#include "mat/sd_tree.h"
+#include "math/constants.h"
+
+#include "check.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Checks the directional quadtree used for path guiding: recorded energy is conserved, quadrants split exactly when
+// they hold more than the split fraction, & Sample() draws directions with the density Pdf() reports
+
+namespace
+{
+    using cblt::test::Check;
+
+    bool Close(float expected, float actual, float rel_tol)
+    {
+        return std::abs(expected - actual) <= rel_tol * std::abs(expected);
+    }
+
+    // the direction at (x, y) of the unit square, which the tree maps to directions with cylindrical coordinates
+    cblt::Vec3 SquareToDir(float x, float y)
+    {
+        float cos_theta = 2.f * x - 1.f;
+        float sin_theta = std::sqrt(std::max(0.f, 1.f - cos_theta * cos_theta));
+        float phi = 2.f * cblt::PI_f * y;
+        return cblt::Vec3(sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta);
+    }
+
+    // a bright lobe around one direction over a dim uniform background, recorded over two passes so the sampled
+    // tree is refined around the lobe
+    void Train(cblt::DTree &tree, int max_depth, std::mt19937 &rng)
+    {
+        std::uniform_real_distribution<float> uni(0.f, 1.f);
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            for (int i = 0; i < 20000; ++i)
+            {
+                bool lobe = uni(rng) < .5f;
+                float x = lobe ? .8f + .05f * uni(rng) : uni(rng);
+                float y = lobe ? .3f + .1f * uni(rng) : uni(rng);
+                tree.Record(SquareToDir(x, y), lobe ? 10.f : 1.f);
+            }
+            tree.Update(.01f, max_depth);
+        }
+    }
+
+    void TestEnergyConserved()
+    {
+        cblt::DTree tree;
+        std::mt19937 rng(3);
+        std::uniform_real_distribution<float> uni(0.f, 1.f);
+        // the structure is refined first, so the second pass records into a multi level tree
+        Train(tree, 8, rng);
+        double recorded = 0.;
+        for (int i = 0; i < 5000; ++i)
+        {
+            float radiance = 4.f * uni(rng);
+            tree.Record(SquareToDir(uni(rng), uni(rng)), radiance);
+            recorded += radiance;
+        }
+        // negative & non finite estimates are dropped entirely rather than corrupting the sums
+        tree.Record(SquareToDir(.5f, .5f), -1.f);
+        tree.Record(SquareToDir(.5f, .5f), NAN);
+        Check(tree.NumSamples() == 5000, "every valid record is counted");
+        tree.Update(.01f, 8);
+        Check(Close(static_cast<float>(recorded), tree.Energy(), 1e-4f), "energy recorded equals the energy sampled");
+        Check(tree.NumSamples() == 0, "update starts a new pass");
+        tree.Update(.01f, 8);
+        Check(tree.Energy() == 0.f && !tree.Valid(), "a pass with no records has nothing to sample");
+    }
+
+    // one record at the center of each quadrant, so each holds exactly a quarter of the energy
+    void RecordQuadrants(cblt::DTree &tree)
+    {
+        for (int q = 0; q < 4; ++q)
+        {
+            tree.Record(SquareToDir((q & 1) ? .75f : .25f, (q & 2) ? .75f : .25f), 2.f);
+        }
+    }
+
+    void TestSplitThreshold()
+    {
+        cblt::DTree at_threshold;
+        RecordQuadrants(at_threshold);
+        at_threshold.Update(.25f, 20);
+        Check(at_threshold.NumNodes() == 1, "quadrants holding exactly the split fraction stay leaves");
+
+        cblt::DTree over_threshold;
+        RecordQuadrants(over_threshold);
+        over_threshold.Update(.24f, 20);
+        // the new quadrants are assumed to spread their quarter evenly, 1/16 each, which is under the fraction
+        Check(over_threshold.NumNodes() == 5, "quadrants holding more than the split fraction split once");
+
+        // energy at a single point refines the tree one level deeper around it each pass, down to the maximum
+        // depth. Below the last level that was recorded into, the energy is assumed even & under the fraction
+        cblt::DTree point;
+        bool deepens = true;
+        for (int pass = 0; pass < 6; ++pass)
+        {
+            point.Record(SquareToDir(.1f, .1f), 1.f);
+            point.Update(.3f, 5);
+            deepens = deepens && point.NumNodes() == std::min(pass + 2, 5);
+        }
+        Check(deepens, "a point of energy refines one level a pass, down to the maximum depth");
+    }
+
+    void TestSamplePdf()
+    {
+        const int max_depth = 6;
+        cblt::DTree tree;
+        std::mt19937 rng(11);
+        Train(tree, max_depth, rng);
+        Check(tree.Valid(), "trained tree can be sampled");
+
+        // the density is constant over squares no finer than 2^-max_depth, so a finer grid integrates it exactly
+        const int grid = 256;
+        double integral = 0.;
+        for (int y = 0; y < grid; ++y)
+        {
+            for (int x = 0; x < grid; ++x)
+            {
+                integral += tree.Pdf(SquareToDir((x + .5f) / grid, (y + .5f) / grid));
+            }
+        }
+        integral *= 4. * cblt::PI_f / (static_cast<double>(grid) * grid);
+        Check(Close(1.f, static_cast<float>(integral), 1e-3f), "pdf integrates to one over the sphere");
+
+        // bin samples over the square & compare each bin's share with the integral of the pdf over it
+        const int bins = 16;
+        const int num_samples = 400000;
+        std::vector<int> counts(bins * bins, 0);
+        std::uniform_real_distribution<float> uni(0.f, 1.f);
+        bool finite = true;
+        for (int i = 0; i < num_samples; ++i)
+        {
+            cblt::Vec3 dir = tree.Sample(uni(rng), uni(rng));
+            finite = finite && std::abs(cblt::Magnitude(dir) - 1.f) < 1e-4f && tree.Pdf(dir) > 0.f;
+            float x = std::min(.5f * (dir.z + 1.f), .99999994f);
+            float phi = std::atan2(dir.y, dir.x);
+            float y = std::min(((phi < 0.f) ? phi + 2.f * cblt::PI_f : phi) / (2.f * cblt::PI_f), .99999994f);
+            ++counts[static_cast<int>(y * bins) * bins + static_cast<int>(x * bins)];
+        }
+        Check(finite, "samples are unit directions with a positive pdf");
+
+        const int sub = grid / bins;
+        bool matches = true;
+        for (int by = 0; by < bins; ++by)
+        {
+            for (int bx = 0; bx < bins; ++bx)
+            {
+                double prob = 0.;
+                for (int y = 0; y < sub; ++y)
+                {
+                    for (int x = 0; x < sub; ++x)
+                    {
+                        prob += tree.Pdf(SquareToDir((bx * sub + x + .5f) / grid, (by * sub + y + .5f) / grid));
+                    }
+                }
+                prob *= 4. * cblt::PI_f / (static_cast<double>(grid) * grid);
+                double expected = prob * num_samples;
+                // five standard deviations of the binomial count, plus a little for float rounding at the edges
+                double allowed = 5. * std::sqrt(expected) + 1e-3 * expected + 2.;
+                if (std::abs(counts[by * bins + bx] - expected) > allowed)
+                {
+                    std::cerr << "bin " << bx << " " << by << " expected " << expected << " got " << counts[by * bins + bx] << std::endl;
+                    matches = false;
+                }
+            }
+        }
+        Check(matches, "samples follow the pdf");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    TestEnergyConserved();
+    TestSplitThreshold();
+    TestSamplePdf();
+    return cblt::test::Result();
+}